@@ -1,5 +1,8 @@
 import subprocess
 import os
+import re
+import json
+import tempfile
 import time
 
 # Paths
@@ -8,48 +11,118 @@ parent_dir = os.path.dirname(script_dir)
 input_dir = os.path.join(parent_dir, "validation/input")
 output_dir = os.path.join(parent_dir, "validation/output")
 
+# Snapshots taken with options or environment variables, and checks that rerun snapshots with more of them:
+# {
+#   "snapshots": [{"name": ..., "input": ..., "args": [...], "env": {...}, "masks": [[pattern, replacement], ...]}],
+#   "checks":    [{"snapshots": "*" or [name, ...], "skip": [name, ...], "args": [...], "env": {...}}]
+# }
+# A snapshot named in the manifest replaces the plain run of its input; every other input is run once with
+# no options. '{input}' in the arguments stands for the input file, which is then not piped to stdin, and
+# '{file}' for a temporary file whose contents are appended to the output. The masks replace what changes
+# from run to run, such as timings. A check appends its arguments and environment to those of each
+# snapshot and passes if the output matches the snapshot apart from the introduction, prompts, echo and
+# outro, which only a session on stdin prints. A check on "*" runs on every snapshot not in its "skip" list.
+manifest_path = os.path.join(parent_dir, "validation/runs.json")
+
 executable = "mainmat"
 
 # Ensure output directory exists
 os.makedirs(output_dir, exist_ok=True)
 
-# Run 'make' in the parent directory
-subprocess.run("make", shell=True, cwd=parent_dir)
-
-# Run 'make clean' in the parent directory
+# Run 'make clean' then 'make' in the parent directory, so the executable is rebuilt from the sources
 subprocess.run("make clean", shell=True, cwd=parent_dir)
+subprocess.run("make", shell=True, cwd=parent_dir, check=True)
 
-# Getting the list of test files
-test_files = [f for f in os.listdir(input_dir) if f.endswith(".txt")]
-
-total_files = len(test_files)
-processed_files = 0
-bar_length = 50  # Length of the progress bar in characters
-
-start_time = time.time()
-for test_file in test_files:
-
-    test_file_path = os.path.join(input_dir, test_file)
-
-    # Modify the output file name by adding '_output' tag before the extension
-    base_name, ext = os.path.splitext(test_file)
-    output_file_name = f"{base_name}_output{ext}"
-    output_file_path = os.path.join(output_dir, output_file_name)
 
-    # Extract relative paths from the parent directory for display
-    relative_test_file_path = os.path.relpath(test_file_path, parent_dir)
-    relative_output_file_path = os.path.relpath(output_file_path, parent_dir)
+def run_program(input_path, args, env, masks):
+    """Runs the program on one input and returns its masked output."""
+    run_env = {key: value for key, value in os.environ.items() if not key.startswith("MATRIX_")}
+    run_env.update(env)
+    extra_file = tempfile.NamedTemporaryFile(suffix=".txt", delete=False)
+    extra_file.close()
+    piped = not any("{input}" in arg for arg in args)
+    command = [os.path.join(parent_dir, executable)]
+    command += [arg.replace("{input}", input_path).replace("{file}", extra_file.name) for arg in args]
 
-    # Run the program with the test file as input, redirect output to a file
-    run_command = f"../{executable} < {test_file_path} > {output_file_path}"
-    process = subprocess.run(run_command, shell=True, capture_output=True, text=True, cwd=script_dir)
+    with open(input_path if piped else os.devnull, "rb") as stdin:
+        process = subprocess.run(command, stdin=stdin, capture_output=True, cwd=script_dir, env=run_env)
 
     # Check for errors during execution
     if process.stderr:
         print("Errors:")
-        print(process.stderr)
+        print(process.stderr.decode(errors="replace"))
+
+    output = process.stdout.decode(errors="replace")
+    if any("{file}" in arg for arg in args):
+        with open(extra_file.name) as extra:
+            output += "--- {file} ---\n" + extra.read()
+    os.unlink(extra_file.name)
+    for pattern, replacement in masks:
+        output = re.sub(pattern, replacement, output, flags=re.MULTILINE)
+    return output
+
+
+def session_body(output):
+    """Strips the introduction, prompts, echoed lines and outro of a session on stdin."""
+    intro_end = "Please enter your instructions:\n"
+    outro = ("\nThank you for using the Matrix Calculator Application!\n"
+             "If you have any feedback or suggestions, please let us know.\n"
+             "Goodbye and have a great day!\n\n")
+    if intro_end in output:
+        output = output[output.index(intro_end) + len(intro_end):]
+    output = output.replace(outro, "")
+    return "".join(line for line in output.splitlines(True) if not line.startswith(">> "))
+
+
+# Getting the list of snapshots: those of the manifest, then a plain run of every other input
+manifest = {"snapshots": [], "checks": []}
+if os.path.exists(manifest_path):
+    with open(manifest_path) as manifest_file:
+        manifest.update(json.load(manifest_file))
+
+snapshots = [dict(snapshot) for snapshot in manifest["snapshots"]]
+for snapshot in snapshots:
+    snapshot.setdefault("input", snapshot["name"] + ".txt")
+listed_inputs = {snapshot["input"] for snapshot in snapshots}
+for test_file in sorted(os.listdir(input_dir)):
+    if test_file.endswith(".txt") and test_file not in listed_inputs:
+        snapshots.append({"name": os.path.splitext(test_file)[0], "input": test_file})
+
+runs = [(snapshot, None) for snapshot in snapshots]
+for check in manifest["checks"]:
+    names = check["snapshots"]
+    skipped = check.get("skip", [])
+    runs += [(snapshot, check) for snapshot in snapshots
+             if (names == "*" and snapshot["name"] not in skipped) or snapshot["name"] in names]
+
+total_files = len(runs)
+processed_files = 0
+mismatches = []
+outputs = {}
+bar_length = 50  # Length of the progress bar in characters
 
-    
+start_time = time.time()
+for snapshot, check in runs:
+
+    test_file_path = os.path.join(input_dir, snapshot["input"])
+    args = snapshot.get("args", [])
+    env = dict(snapshot.get("env", {}))
+    if check is not None:
+        args = args + check.get("args", [])
+        env.update(check.get("env", {}))
+
+    # Run the program with the test file as input
+    output = run_program(test_file_path, args, env, snapshot.get("masks", []))
+
+    if check is None:
+        # Modify the output file name by adding '_output' tag before the extension
+        output_file_path = os.path.join(output_dir, f"{snapshot['name']}_output.txt")
+        with open(output_file_path, "w") as output_file:
+            output_file.write(output)
+        outputs[snapshot["name"]] = session_body(output)
+    elif session_body(output) != outputs[snapshot["name"]]:
+        settings = [f"{key}={value}" for key, value in check.get("env", {}).items()] + check.get("args", [])
+        mismatches.append(f"{snapshot['name']} with {' '.join(settings)}")
 
     # Update and print the progress
     processed_files += 1
@@ -57,8 +130,11 @@ for test_file in test_files:
     progress_bar_filled = int(bar_length * processed_files / total_files)
     progress_bar = "##" * progress_bar_filled
     progress_bar += "  " * (bar_length - progress_bar_filled)
-    print(f"Progress: [{processed_files}/{total_files}] \t[{progress_bar}] {progress_percentage:.2f}%", end = '\r')      
+    print(f"Progress: [{processed_files}/{total_files}] \t[{progress_bar}] {progress_percentage:.2f}%", end = '\r')
 
 # After processing all files
 end_time = time.time()
-print(f"\nAll files processed in {end_time-start_time:.4f} seconds")
\ No newline at end of file
+print(f"\nAll files processed in {end_time-start_time:.4f} seconds")
+for mismatch in mismatches:
+    print(f"Mismatch: {mismatch}")
+exit(1 if mismatches else 0)
@@ -7,20 +7,29 @@
  * defined in "mymat.c" and "mymat.h".
  *
  * Implemented Functions:
+ * - parseOptions:                  Parses the command-line options (such as the thread count).
+ * - initLineReader / readLine / freeLineReader:
+ *                                  Buffered line input with read(2): lines of any length, returned in place.
+ * - mapLineReader:                 Line input from a script file mapped with mmap(2), for '--batch'.
+ * - runSession:                    Runs the instructions of one reader on freshly initialized matrices.
+ * - startStats / finishStats:      Enable the statistics of '--stats' and counters of '--perf', and write them
+ *                                  to the '--stats-dump' file.
  * - print_intro:                   Executes the introductory sequence for the Matrix Calculator Application, 
  *                                  displaying a welcoming message and a brief overview of available commands.
  * - print_outro:                   Handles the closing sequence, printing a farewell message when the application exits.
  * - isEmptyLine:                   Evaluates if a given string is empty or contains only whitespace, 
  *                                  aiding in input validation and processing.
- * - isValidCommand:                Checks whether a provided string matches any of the predefined valid commands.
  * - readAndProcessInstructions:    Main loop for reading and processing user instructions, 
- *                                  orchestrating the flow of matrix operations.
- * - processInstruction:            Interprets and executes individual matrix operation commands 
- *                                  based on user input.
- * - commandTypeReturn:             Identifies the CommandType associated with a given command string.
+ *                                  orchestrating the flow of matrix operations, and timing them with '--stats'.
+ * - execute*:                      Command handlers, one per CommandType, gathered in 'commandHandlers'.
+ * - processInstruction:            Executes a parsed instruction by calling the handler of its command, unless
+ *                                  the result cache answers it, and gives the matrix it writes a new version,
+ *                                  which also retires the factorizations of its old contents (see "matfactor.h").
+ * - findCommand:                   Identifies the CommandType associated with a command name.
  * - readCommand:                   Extracts and validates a command from a given string, ensuring correct syntax.
- * - readInstruction:               Analyzes and processes a complete instruction line, 
- *                                  extracting necessary components for matrix operations.
+ * - readInstruction:               Analyzes a complete instruction line in one pass, filling the instruction
+ *                                  record with the command, matrix handles and numbers.
+ * - readExpression:                Recursive-descent parser of the expressions of 'eval'.
  *
  * Usage:
  * This file should be compiled and linked with the main application that includes "mainmat.h". 
@@ -29,24 +38,143 @@
  * defined therein to operate correctly.
  *
  * Note:
- * The functions implemented here are designed to work within the constraints set by the "Matrix Manipulation Library".
- * This includes adhering to predefined matrix sizes, command formats, and error handling procedures.
- * Proper initialization of the 'MatrixContext' and consistent handling of matrices are crucial for 
- * the seamless operation of this program.
+ * Matrices are named by the script: 'new_mat' registers a name (see "matreg.h") and any shape given as a
+ * [<rows>x<cols>] suffix, and 'read_mat' and 'read_sparse' may reshape a matrix. Where the elements live is
+ * left to the library: a matrix is stored sparse when few of its elements are non-zero (see "matsparse.h"),
+ * on disk in tiles when it exceeds the memory budget (see "matdisk.h"), and densely in memory otherwise, so
+ * the command handlers never depend on the storage. They report failures through the 'MatrixStatus' of the
+ * library, and the parser through the error codes of "mainmat.h", neither of which ends the session.
  * 
  */
 
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <limits.h>
 
 #include "mymat.h"
+#include "matreg.h"
+#include "matsimd.h"
+#include "matpool.h"
+#include "matstrassen.h"
+#include "matbatch.h"
+#include "matfmt.h"
+#include "matio.h"
+#include "matdisk.h"
+#include "matexpr.h"
+#include "matcache.h"
+#include "matstats.h"
+#include "matperf.h"
+#include "matsparse.h"
+#include "matfactor.h"
+#include "matqr.h"
+#include "mateig.h"
 #include "mainmat.h"
 
 
+/* Names of the matrices every session starts with; 'new_mat' registers more */
+static const char *const initialMatrices[] = {"MAT_A", "MAT_B", "MAT_C", "MAT_D", "MAT_E", "MAT_F"};
+
+/* Names of the batches of 4x4 matrices */
+static const BatchProfile validBatches[NUM_BATCHES] = {
+    {BAT_A, "BAT_A"},
+    {BAT_B, "BAT_B"},
+    {BAT_C, "BAT_C"},
+    {BAT_D, "BAT_D"}
+};
+
+/* Names of the commands, indexed by CommandType, for the statistics */
+static const char *commandNames[NUM_COMMANDS];
+
+
+static void startStats(const ProgramOptions *options) {
+    /*
+     * Short Description:
+     * Enables the timing statistics of '--stats' and the hardware counters of '--perf' for every command
+     * of 'validCommands'. The counters must be opened before the thread pool starts, to cover its workers.
+     */
+    int command_idx;    /* Variable for iterating over the commands */
+
+    for (command_idx = 0; command_idx < NUM_COMMANDS; ++command_idx) {
+        commandNames[command_idx] = validCommands[command_idx].commandName;
+    }
+    if (options->stats && !initStats(commandNames, NUM_COMMANDS)) {
+        printf("Error: %s\n", InstructionErrors[OUT_OF_MEMORY].errorName);
+    }
+    if (options->perf) {
+        openPerfCounters(commandNames, NUM_COMMANDS);
+    }
+}
+
+
+static void finishStats(const char *dumpPath) {
+    /*
+     * Short Description:
+     * Writes the statistics and hardware counters to the file of '--stats-dump', if any, and releases them.
+     */
+    FILE *dump;     /* Stream of the dump */
+
+    if (dumpPath != NULL && isStatsEnabled()) {
+        dump = fopen(dumpPath, "w");
+        if (dump == NULL) {
+            printf("Error: Cannot write statistics to '%s': %s\n", dumpPath, strerror(errno));
+        } else {
+            printStats(dump);
+            printPerf(dump);
+            if (fclose(dump) != 0) {
+                printf("Error: Cannot write statistics to '%s': %s\n", dumpPath, strerror(errno));
+            }
+        }
+    }
+    freeStats();
+    closePerfCounters();
+}
+
+
+static bool runSession(LineReader *reader, bool intro) {
+    /*
+     * Short Description:
+     * Sets up the matrices, optionally prints the introduction, and processes the instructions of
+     * the reader. Returns true if they ended with a 'stop' command.
+     */
+    MatrixContext ctx;  /* Matrices of the session */
+    bool isStopped;     /* Whether the instructions ended with a 'stop' command */
+
+    /* Set up the matrices in the context */
+    if (initMatrices(&ctx, initialMatrices, (int)(sizeof(initialMatrices) / sizeof(initialMatrices[0])),
+                     validBatches) != MATRIX_OK) {
+        printf("Error: %s\n", MatrixStatuses[MATRIX_ALLOCATION_FAILED].statusName);
+        freeMatrices(&ctx);
+        return false;
+    }
+
+    if (intro) {
+        print_intro(&ctx);  /* Display introductory information and instructions */
+    }
+
+    /* Results are only valid for the matrices of this session */
+    ctx.cache = createResultCache();
+    ctx.factors = createFactorCache();
+
+    /* Read and process user instructions */
+    isStopped = readAndProcessInstructions(&ctx, reader);
+    freeFactorCache(ctx.factors);
+    freeResultCache(ctx.cache);
+    freeMatrices(&ctx);
+    return isStopped;
+}
+
+
 /*
  * Function: main
  * Purpose: Entry point of the program.
@@ -56,32 +184,67 @@
  *   user instructions. Depending on the success of processing instructions, it prints an outro
  *   message and exits with a status code indicating success (ERROR_NONE) or failure (ERROR_INVALID_INPUT).
  *
+ *   With '--batch', every script file is mapped and run in turn as a session of its own, with fresh
+ *   matrices and without the introduction, prompt, echo or outro. The program succeeds if every
+ *   script could be opened and ended with 'stop'.
+ *
  * Returns: 
  *   ERROR_NONE on successful execution of instructions, ERROR_INVALID_INPUT otherwise.
  */
-int main() {
-    MatrixContext ctx;  /* Initialize the main matrix context */
-    /* 
-     * An array of MatrixProfile structures representing valid matrices.
-     * This constant array is initialized with predefined matrix
-     * identifiers and their corresponding string names.
-     */
-    const MatrixProfile validMatrices[NUM_MATRICES] = {
-        {MAT_A, "MAT_A"},
-        {MAT_B, "MAT_B"},
-        {MAT_C, "MAT_C"},
-        {MAT_D, "MAT_D"},
-        {MAT_E, "MAT_E"},
-        {MAT_F, "MAT_F"}
-    };
-
-    initMatrices(&ctx, validMatrices); /* Set up the matrices in the context */
-
-    print_intro(&ctx);  /* Display introductory information and instructions */
-
-    /* Read and process user instructions; this function likely involves
-     * interaction with the user and performs various matrix operations */
-    if (readAndProcessInstructions(&ctx)) {
+int main(int argc, char *argv[]) {
+    ProgramOptions options;     /* Parsed command-line options */
+    bool isStopped = true;      /* Whether the instructions (of every script) ended with a 'stop' command */
+    LineReader reader;          /* Reader of standard input or of the current script */
+    int script_idx;             /* Index for iterating over the scripts */
+
+    if (!parseOptions(argc, argv, &options)) {
+        return (int)ERROR_INVALID_INPUT;
+    }
+
+    initSimdKernels();  /* Select the element-wise kernels for this processor */
+    if (options.stats || options.perf) {
+        startStats(&options);
+    }
+    initThreadPool(options.threads);    /* Start the workers shared by every parallel kernel */
+    setMultiplyAlgorithm(options.multiply);
+    setStrassenCutoff(options.strassenCutoff);
+    setPrintFormat(&options.print);
+    setVerifyLoads(options.verifyLoads);
+    initMemoryBudget(options.memoryBudget);
+    setCacheLimit(options.cacheLimit);
+    setFactorCacheLimit(options.cacheLimit);
+    setSparseThreshold(options.sparseThreshold);
+
+    if (options.scripts != NULL) {
+        /* Batch mode: one session per script, all in this process */
+        for (script_idx = 0; script_idx < options.scriptCount; ++script_idx) {
+            if (!mapLineReader(&reader, options.scripts[script_idx])) {
+                printf("Error: Cannot open script '%s': %s\n", options.scripts[script_idx], strerror(errno));
+                isStopped = false;
+                continue;
+            }
+            if (!runSession(&reader, false)) {
+                isStopped = false;
+            }
+            freeLineReader(&reader);
+        }
+        finishStats(options.statsDump);
+        shutdownThreadPool();
+        return isStopped ? (int)ERROR_NONE : (int)ERROR_INVALID_INPUT;
+    }
+
+    if (!initLineReader(&reader, STDIN_FILENO, options.echo)) {
+        printf("Error: %s\n", InstructionErrors[OUT_OF_MEMORY].errorName);
+        finishStats(options.statsDump);
+        shutdownThreadPool();
+        return (int)ERROR_INVALID_INPUT;
+    }
+    isStopped = runSession(&reader, true);
+    freeLineReader(&reader);
+    finishStats(options.statsDump);
+    shutdownThreadPool();
+
+    if (isStopped) {
         print_outro();  /* If instructions processed successfully, print the outro message */
         return (int)ERROR_NONE;             /* Return 0 indicating successful execution */
     } else {
@@ -89,6 +252,118 @@ int main() {
     }
 }
 
+bool parseOptions(int argc, char *argv[], ProgramOptions *options) {
+    int arg_index;      /* Index for iterating over the arguments */
+    int algorithm;      /* Index for iterating over the multiplication algorithms */
+    char *end;          /* End of the parsed numeric value */
+    long value;         /* Parsed numeric value */
+    double density;     /* Parsed share of non-zero elements */
+
+    /* Defaults */
+    options->threads = 0;
+    options->multiply = MULTIPLY_AUTO;
+    options->strassenCutoff = STRASSEN_DEFAULT_CUTOFF;
+    options->echo = true;
+    options->scripts = NULL;
+    options->scriptCount = 0;
+    options->print.fullPrecision = false;
+    options->print.csv = false;
+    options->print.edgeItems = 0;
+    options->verifyLoads = false;
+    options->memoryBudget = 0;
+    options->cacheLimit = DEFAULT_CACHE_LIMIT;
+    options->stats = false;
+    options->statsDump = NULL;
+    options->perf = false;
+    options->sparseThreshold = DEFAULT_SPARSE_THRESHOLD;
+
+    for (arg_index = 1; arg_index < argc; arg_index++) {
+        if (!strcmp(argv[arg_index], "--threads") && arg_index + 1 < argc) {
+            value = strtol(argv[++arg_index], &end, 10);
+            if (*end != '\0' || value < 1 || value > MAX_POOL_THREADS) {
+                printf("Error: --threads expects a number between 1 and %d\n", MAX_POOL_THREADS);
+                return false;
+            }
+            options->threads = (int)value;
+        } else if (!strcmp(argv[arg_index], "--multiply") && arg_index + 1 < argc) {
+            arg_index++;
+            for (algorithm = 0; algorithm < NUM_MULTIPLY_ALGORITHMS; algorithm++) {
+                if (!strcmp(argv[arg_index], MultiplyAlgorithms[algorithm].algorithmName)) {
+                    break;
+                }
+            }
+            if (algorithm == NUM_MULTIPLY_ALGORITHMS) {
+                printf("Error: --multiply expects auto, classic or strassen\n");
+                return false;
+            }
+            options->multiply = MultiplyAlgorithms[algorithm].algorithm;
+        } else if (!strcmp(argv[arg_index], "--strassen-cutoff") && arg_index + 1 < argc) {
+            value = strtol(argv[++arg_index], &end, 10);
+            if (*end != '\0' || value < 1 || value > INT_MAX) {
+                printf("Error: --strassen-cutoff expects a positive number\n");
+                return false;
+            }
+            options->strassenCutoff = (int)value;
+        } else if (!strcmp(argv[arg_index], "--no-echo")) {
+            options->echo = false;
+        } else if (!strcmp(argv[arg_index], "--full-precision")) {
+            options->print.fullPrecision = true;
+        } else if (!strcmp(argv[arg_index], "--csv")) {
+            options->print.csv = true;
+        } else if (!strcmp(argv[arg_index], "--verify-loads")) {
+            options->verifyLoads = true;
+        } else if (!strcmp(argv[arg_index], "--print-edge") && arg_index + 1 < argc) {
+            value = strtol(argv[++arg_index], &end, 10);
+            if (*end != '\0' || value < 0 || value > INT_MAX / 2) {
+                printf("Error: --print-edge expects a non-negative number\n");
+                return false;
+            }
+            options->print.edgeItems = (int)value;
+        } else if (!strcmp(argv[arg_index], "--memory-budget") && arg_index + 1 < argc) {
+            value = strtol(argv[++arg_index], &end, 10);
+            if (*end != '\0' || value < 1 || (unsigned long)value > ((size_t)-1 >> 20)) {
+                printf("Error: --memory-budget expects a positive number of MiB\n");
+                return false;
+            }
+            options->memoryBudget = (size_t)value << 20;
+        } else if (!strcmp(argv[arg_index], "--cache-limit") && arg_index + 1 < argc) {
+            value = strtol(argv[++arg_index], &end, 10);
+            if (*end != '\0' || value < 0 || (unsigned long)value > ((size_t)-1 >> 20)) {
+                printf("Error: --cache-limit expects a number of MiB (0 disables the cache)\n");
+                return false;
+            }
+            options->cacheLimit = (size_t)value << 20;
+        } else if (!strcmp(argv[arg_index], "--stats")) {
+            options->stats = true;
+        } else if (!strcmp(argv[arg_index], "--stats-dump") && arg_index + 1 < argc) {
+            options->stats = true;
+            options->statsDump = argv[++arg_index];
+        } else if (!strcmp(argv[arg_index], "--perf")) {
+            options->perf = true;
+        } else if (!strcmp(argv[arg_index], "--sparse-threshold") && arg_index + 1 < argc) {
+            density = strtod(argv[++arg_index], &end);
+            if (*end != '\0' || end == argv[arg_index] || !(density >= 0.0 && density <= 1.0)) {
+                printf("Error: --sparse-threshold expects a share between 0 and 1 (0 stores every matrix dense)\n");
+                return false;
+            }
+            options->sparseThreshold = density;
+        } else if (!strcmp(argv[arg_index], "--batch") && arg_index + 1 < argc) {
+            /* Every remaining argument is a script */
+            options->scripts = &argv[arg_index + 1];
+            options->scriptCount = argc - arg_index - 1;
+            break;
+        } else {
+            printf("Usage: %s [--threads N] [--multiply auto|classic|strassen] [--strassen-cutoff N] [--no-echo]"
+                   " [--full-precision] [--csv] [--print-edge N] [--verify-loads] [--memory-budget MIB]"
+                   " [--cache-limit MIB] [--stats] [--stats-dump FILE] [--perf] [--sparse-threshold F]"
+                   " [--batch FILE...]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+
 void print_intro(const MatrixContext *ctx) {
     int command_idx; /* Variable for iterating over the command list */
 
@@ -138,149 +413,699 @@ bool isEmptyLine(const char *buffer) {
 }
 
 
-bool readLine(char *buffer) {
-    /*
-    * readLine - Reads a line of text from standard input into a buffer.
-    */
-    int i = 0;  /* Index for placing characters into the buffer */
-    char ch;    /* Variable to store each character read */
+bool initLineReader(LineReader *reader, int fd, bool echo) {
+    reader->fd = fd;
+    reader->buffer = malloc(LINE_READER_BLOCK);
+    reader->capacity = reader->buffer ? LINE_READER_BLOCK : 0;
+    reader->start = 0;
+    reader->end = 0;
+    reader->eof = false;
+    reader->echo = echo;
+    reader->prompt = true;
+    reader->mapped = false;
+    reader->tail = NULL;
+    return reader->buffer != NULL;
+}
 
-    /* Return false if the buffer pointer is NULL */
-    if (buffer == NULL) 
+
+bool mapLineReader(LineReader *reader, const char *path) {
+    struct stat info;   /* Size of the script */
+    long pageSize;      /* Granularity of the mapping */
+    void *mapping;      /* Mapped script */
+    int fd;             /* Descriptor of the script, closed once it is mapped */
+    int savedErrno;     /* errno of a failure, kept across close(2) */
+
+    reader->fd = -1;
+    reader->buffer = NULL;
+    reader->capacity = 0;
+    reader->start = 0;
+    reader->end = 0;
+    reader->eof = true;
+    reader->echo = false;
+    reader->prompt = false;
+    reader->mapped = false;
+    reader->tail = NULL;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &info) != 0) {
+        savedErrno = errno;
+        close(fd);
+        errno = savedErrno;
         return false;
+    }
+    if (!S_ISREG(info.st_mode)) {
+        close(fd);
+        errno = S_ISDIR(info.st_mode) ? EISDIR : EINVAL;
+        return false;
+    }
+    if (info.st_size == 0) {
+        /* Nothing to map: the script is a single empty last line */
+        close(fd);
+        return true;
+    }
 
-    /* Prompt for input */
-    printf(">> ");
+    /* Private and writable, so lines can be terminated in copy-on-write pages */
+    mapping = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    savedErrno = errno;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        errno = savedErrno;
+        return false;
+    }
+    posix_madvise(mapping, (size_t)info.st_size, POSIX_MADV_SEQUENTIAL);
+
+    /* The mapping extends to the end of the last page, zero-filled past the end of the file */
+    pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize <= 0) {
+        pageSize = 1;
+    }
+    reader->buffer = mapping;
+    reader->end = (size_t)info.st_size;
+    reader->capacity = (reader->end + (size_t)pageSize - 1) / (size_t)pageSize * (size_t)pageSize;
+    reader->mapped = true;
+    return true;
+}
+
+
+static bool fillLineReader(LineReader *reader) {
+    /*
+     * Short Description:
+     * Moves the unreturned bytes to the front of the buffer, grows it if less than a block is free,
+     * and appends what one read(2) returns. Returns false if the buffer could not grow.
+     */
+    size_t pending = reader->end - reader->start;   /* Bytes of the line being assembled */
+    size_t capacity;                                /* Grown size of the buffer */
+    char *grown;                                    /* Grown buffer */
+    ssize_t count;                                  /* Bytes returned by read(2) */
+
+    if (reader->start > 0) {
+        memmove(reader->buffer, reader->buffer + reader->start, pending);
+        reader->start = 0;
+        reader->end = pending;
+    }
 
-    /* Read characters until newline or EOF */
-    while ((ch = getchar()) != '\n' && ch != EOF) {
-        /* Store the character in the buffer if there's space (leave room for null terminator) */
-        if (i < MAX_LINE_LENGTH - 1) {
-            buffer[i++] = ch;
+    /* Keep one byte for the terminator of a last line without a newline */
+    if (reader->capacity - reader->end <= LINE_READER_BLOCK / 2) {
+        if (reader->capacity > ((size_t)-1) / 2) {
+            return false;
         }
+        capacity = reader->capacity * 2;
+        grown = realloc(reader->buffer, capacity);
+        if (grown == NULL) {
+            return false;
+        }
+        reader->buffer = grown;
+        reader->capacity = capacity;
     }
 
-    buffer[i] = '\0';  /* Null-terminate the string in the buffer */
+    fflush(stdout);     /* Show the prompt before blocking */
+    do {
+        count = read(reader->fd, reader->buffer + reader->end, reader->capacity - 1 - reader->end);
+    } while (count < 0 && errno == EINTR);
 
-    /* Print the buffer content for redirection */
-    printf("%s\n", buffer); 
-    
-    /* Return true if EOF is encountered, false otherwise */
-    return (ch == EOF) ? true : false;
+    if (count <= 0) {
+        reader->eof = true;
+    } else {
+        reader->end += (size_t)count;
+    }
+    return true;
 }
 
-bool isValidCommand(const char *command) {
-    int command_index; /* Variable for iterating over the command list */
 
-    /* Loop through each valid command */
-    for (command_index = 0; command_index < NUM_COMMANDS; command_index++) {
-        /* Compare the current valid command with the provided command */
-        if (!strcmp(validCommands[command_index].commandName, command)) {
-            return true; /* Return true if a match is found */
+bool readLine(LineReader *reader, char **line) {
+    /*
+    * readLine - Returns the next line of the reader, terminated in place.
+    */
+    size_t scanned = reader->start;     /* Bytes of the pending line already searched for a newline */
+    char *newline;                      /* Newline ending the line */
+    bool isEOF = false;                 /* Whether the line is the last one */
+
+    /* Prompt for input */
+    if (reader->prompt) {
+        printf(">> ");
+    }
+
+    for (;;) {
+        newline = (reader->end > scanned) ? memchr(reader->buffer + scanned, '\n', reader->end - scanned) : NULL;
+        if (newline != NULL) {
+            *newline = '\0';
+            *line = reader->buffer + reader->start;
+            reader->start = (size_t)(newline - reader->buffer) + 1;
+            break;
+        }
+        if (reader->eof) {
+            /* The last line ends at the end of the input */
+            if (reader->end < reader->capacity) {
+                reader->buffer[reader->end] = '\0';
+                *line = reader->buffer + reader->start;
+            } else {
+                /* Only a mapping that ends on a page boundary leaves no room for the terminator */
+                free(reader->tail);
+                reader->tail = malloc(reader->end - reader->start + 1);
+                if (reader->tail == NULL) {
+                    printf("Error: %s\n", InstructionErrors[OUT_OF_MEMORY].errorName);
+                    *line = "";
+                    reader->start = reader->end;
+                    return true;
+                }
+                if (reader->end > reader->start) {
+                    memcpy(reader->tail, reader->buffer + reader->start, reader->end - reader->start);
+                }
+                reader->tail[reader->end - reader->start] = '\0';
+                *line = reader->tail;
+            }
+            reader->start = reader->end;
+            isEOF = true;
+            break;
+        }
+        scanned = reader->end - reader->start;
+        if (!fillLineReader(reader)) {
+            printf("\nError: %s\n", InstructionErrors[OUT_OF_MEMORY].errorName);
+            reader->buffer[0] = '\0';
+            *line = reader->buffer;
+            reader->start = reader->end = 0;
+            reader->eof = true;
+            return true;
         }
     }
-    return false; /* Return false if no match is found after checking all valid commands */
+
+    /* Print the line for redirection */
+    if (reader->echo) {
+        printf("%s\n", *line);
+    }
+    return isEOF;
 }
 
 
-CommandType commandTypeReturn(const char *command) {
+void freeLineReader(LineReader *reader) {
+    if (reader->mapped) {
+        munmap(reader->buffer, reader->end);
+    } else {
+        free(reader->buffer);
+    }
+    free(reader->tail);
+    reader->tail = NULL;
+    reader->mapped = false;
+    reader->buffer = NULL;
+    reader->capacity = 0;
+    reader->start = 0;
+    reader->end = 0;
+}
+
+
+CommandType findCommand(const char *name, size_t length) {
     CommandType command_index; /* Variable for iterating over the command list */
 
     /* Loop through each valid command */
     for (command_index = 0; command_index < NUM_COMMANDS; command_index++) {
-        /* Compare the current valid command with the provided command */
-        if (!strcmp(validCommands[command_index].commandName, command)) {
+        /* Compare the current valid command with the provided name, including its length */
+        if (!strncmp(validCommands[command_index].commandName, name, length) &&
+            validCommands[command_index].commandName[length] == '\0') {
             return command_index; /* Return the CommandType if a match is found */
         }
     }
-
-    /* Print an error message if the command is not found */
-    printf("Command not found");
     return -1; /* Return -1 indicating that the command was not found */
 }
 
 
 
-bool processInstruction(const char *command, 
-                        char matrixNames[MAX_INPUT_MATRICES][MAX_MATRIX_NAME_LENGTH], 
-                        double matrix_elements[ROWS * COLS], 
-                        double *scalar,
-                        MatrixContext *ctx) {
-    /* Determine the CommandType from the command string */
-    CommandType cmd = commandTypeReturn(command);
+bool appendElement(ElementBuffer *elements, double value) {
+    size_t newCapacity;     /* Capacity after growing the buffer */
+    double *newValues;      /* Grown value array */
 
-    /* Retrieve matrix enum values for the matrices involved */
-    MatrixEnum mat1 = getMatrixEnumByName(matrixNames[FIRST_MATRIX], ctx);
-    MatrixEnum mat2 = getMatrixEnumByName(matrixNames[SECOND_MATRIX], ctx);
-    MatrixEnum mat3 = getMatrixEnumByName(matrixNames[THIRD_MATRIX], ctx);
+    /* Double the capacity when the buffer is full */
+    if (elements->count == elements->capacity) {
+        newCapacity = elements->capacity ? elements->capacity * 2 : ELEMENT_BUFFER_INITIAL_CAPACITY;
+        newValues = realloc(elements->values, newCapacity * sizeof(double));
+        if (newValues == NULL) {
+            return false;
+        }
+        elements->values = newValues;
+        elements->capacity = newCapacity;
+    }
+    elements->values[elements->count++] = value;
+    return true;
+}
 
-    /* Process the command based on its type */
-    switch (cmd) {
-        case STOP: /* Stop the process */
-            return true; 
-            break;
 
-        case READ_MAT: /* Read matrix data */
-            readMatrix(ctx, matrixNames[FIRST_MATRIX], matrix_elements); 
-            break;
+void freeElementBuffer(ElementBuffer *elements) {
+    free(elements->values);
+    elements->values = NULL;
+    elements->count = 0;
+    elements->capacity = 0;
+}
 
-        case PRINT_MAT: /* Print matrix */
-            printMatrix(ctx, matrixNames[FIRST_MATRIX]); 
-            break;
 
-        case ADD_MAT: /* Add matrices */
-            addMatrices(&ctx->matrices[mat1], &ctx->matrices[mat2], &ctx->matrices[mat3]);
-            break;
 
-        case SUB_MAT: /* Subtract matrices */
-            subMatrices(&ctx->matrices[mat1], &ctx->matrices[mat2], &ctx->matrices[mat3]);
-            break;
+/*
+ * Command handlers. Each executes one command on the operands resolved by 'readInstruction';
+ * batch commands find BatchEnum values in the operands instead of matrix handles.
+ */
 
-        case MUL_MAT: /* Perform matrix multiplication */
-            if (mat2 != mat3 && mat1 != mat3) {
-                multiplyMatrices(&ctx->matrices[mat1], &ctx->matrices[mat2], &ctx->matrices[mat3]);
-            } else { /* Handle in-place multiplication */
-                if (mat1 == mat3) {
-                    multiplyMatricesInPlace(&ctx->matrices[mat2], &ctx->matrices[mat3]);
-                    break;
-                }  
-                if (mat2 == mat3) {
-                    multiplyMatricesInPlace(&ctx->matrices[mat1], &ctx->matrices[mat3]);
-                    break;
-                }
-            }
-            break;
+static MatrixStatus executeReadMat(const Instruction *instruction, MatrixContext *ctx) {
+    const ElementBuffer *elements = &instruction->elements;    /* Values and shape to read */
 
-        case MUL_SCALAR: /* Multiply matrix by scalar */
-            multiplyScalar(&ctx->matrices[mat1], *scalar, &ctx->matrices[mat2]);
-            break;
+    return readMatrix(&ctx->matrices[instruction->operands[FIRST_MATRIX]], elements->rows, elements->cols,
+                      elements->values, elements->count);
+}
 
-        case TRANS_MAT: /* Transpose matrix, either in-place or to another matrix */
-            (mat1 == mat2) ?   
-            transposeMatrixInPlace(&ctx->matrices[mat1]) : 
-            transposeMatrix(&ctx->matrices[mat1], &ctx->matrices[mat2]);
-            break;
 
-        default:
-            printf("Error: command not exist");
+static MatrixStatus executeReadSparse(const Instruction *instruction, MatrixContext *ctx) {
+    const ElementBuffer *elements = &instruction->elements;    /* Triples and shape to read */
+
+    return readSparseMatrix(&ctx->matrices[instruction->operands[FIRST_MATRIX]], elements->rows, elements->cols,
+                            elements->values, elements->count);
+}
+
+
+static MatrixStatus executePrintMat(const Instruction *instruction, MatrixContext *ctx) {
+    return printMatrix(&ctx->matrices[instruction->operands[FIRST_MATRIX]]);
+}
+
+
+static MatrixStatus executeAddMat(const Instruction *instruction, MatrixContext *ctx) {
+    return addMatrices(&ctx->matrices[instruction->operands[FIRST_MATRIX]],
+                       &ctx->matrices[instruction->operands[SECOND_MATRIX]],
+                       &ctx->matrices[instruction->operands[THIRD_MATRIX]]);
+}
+
+
+static MatrixStatus executeSubMat(const Instruction *instruction, MatrixContext *ctx) {
+    return subMatrices(&ctx->matrices[instruction->operands[FIRST_MATRIX]],
+                       &ctx->matrices[instruction->operands[SECOND_MATRIX]],
+                       &ctx->matrices[instruction->operands[THIRD_MATRIX]]);
+}
+
+
+static MatrixStatus executeMulMat(const Instruction *instruction, MatrixContext *ctx) {
+    MatrixHandle mat1 = instruction->operands[FIRST_MATRIX];
+    MatrixHandle mat2 = instruction->operands[SECOND_MATRIX];
+    MatrixHandle mat3 = instruction->operands[THIRD_MATRIX];
+
+    if (mat2 != mat3 && mat1 != mat3) {
+        return multiplyMatrices(&ctx->matrices[mat1], &ctx->matrices[mat2], &ctx->matrices[mat3]);
+    }
+    /* Handle in-place multiplication */
+    return multiplyMatricesInPlace(&ctx->matrices[mat1], &ctx->matrices[mat2], &ctx->matrices[mat3]);
+}
+
+
+static MatrixStatus executeMulScalar(const Instruction *instruction, MatrixContext *ctx) {
+    return multiplyScalar(&ctx->matrices[instruction->operands[FIRST_MATRIX]], instruction->scalar,
+                          &ctx->matrices[instruction->operands[SECOND_MATRIX]]);
+}
+
+
+static MatrixStatus executeTransMat(const Instruction *instruction, MatrixContext *ctx) {
+    MatrixHandle mat1 = instruction->operands[FIRST_MATRIX];
+    MatrixHandle mat2 = instruction->operands[SECOND_MATRIX];
+
+    /* Transpose matrix, either in-place or to another matrix */
+    return (mat1 == mat2) ? transposeMatrixInPlace(&ctx->matrices[mat1])
+                          : transposeMatrix(&ctx->matrices[mat1], &ctx->matrices[mat2]);
+}
+
+
+static MatrixStatus executeDetMat(const Instruction *instruction, MatrixContext *ctx) {
+    double det;     /* Determinant of the matrix */
+    MatrixStatus status = determinantMatrix(ctx, instruction->operands[FIRST_MATRIX], &det);
+
+    if (status == MATRIX_OK) {
+        printElements(&det, 1, 1, 1);
+    }
+    return status;
+}
+
+
+static MatrixStatus executeInvMat(const Instruction *instruction, MatrixContext *ctx) {
+    /* The inverse is computed in a buffer, so the result may be the matrix itself */
+    return invertMatrix(ctx, instruction->operands[FIRST_MATRIX], instruction->operands[SECOND_MATRIX]);
+}
+
+
+static MatrixStatus executeSolveMat(const Instruction *instruction, MatrixContext *ctx) {
+    return solveMatrix(ctx, instruction->operands[FIRST_MATRIX], instruction->operands[SECOND_MATRIX],
+                       instruction->operands[THIRD_MATRIX]);
+}
+
+
+static MatrixStatus executeCholMat(const Instruction *instruction, MatrixContext *ctx) {
+    return choleskyMatrix(ctx, instruction->operands[FIRST_MATRIX], instruction->operands[SECOND_MATRIX]);
+}
+
+
+static MatrixStatus executeQrMat(const Instruction *instruction, MatrixContext *ctx) {
+    MatrixHandle q = instruction->operands[SECOND_MATRIX];  /* Matrix receiving Q */
+    MatrixStatus status = qrMatrix(&ctx->matrices[instruction->operands[FIRST_MATRIX]], &ctx->matrices[q],
+                                   &ctx->matrices[instruction->operands[THIRD_MATRIX]]);
+
+    /* R is the result operand; Q is written too, so its version must change as well */
+    touchMatrix(ctx, q);
+    return status;
+}
+
+
+static MatrixStatus executeLstsqMat(const Instruction *instruction, MatrixContext *ctx) {
+    return leastSquaresMatrix(&ctx->matrices[instruction->operands[FIRST_MATRIX]],
+                              &ctx->matrices[instruction->operands[SECOND_MATRIX]],
+                              &ctx->matrices[instruction->operands[THIRD_MATRIX]]);
+}
+
+
+static MatrixStatus executeEigSym(const Instruction *instruction, MatrixContext *ctx) {
+    MatrixHandle values = instruction->operands[SECOND_MATRIX];    /* Matrix receiving the eigenvalues */
+    MatrixStatus status = eigenSymmetricMatrix(&ctx->matrices[instruction->operands[FIRST_MATRIX]],
+                                               &ctx->matrices[values],
+                                               &ctx->matrices[instruction->operands[THIRD_MATRIX]]);
+
+    touchMatrix(ctx, values);
+    return status;
+}
+
+
+static MatrixStatus executeSvdMat(const Instruction *instruction, MatrixContext *ctx) {
+    MatrixHandle u = instruction->operands[SECOND_MATRIX];     /* Matrix receiving U */
+    MatrixHandle s = instruction->operands[THIRD_MATRIX];      /* Matrix receiving the singular values */
+    MatrixStatus status = svdMatrix(&ctx->matrices[instruction->operands[FIRST_MATRIX]], &ctx->matrices[u],
+                                    &ctx->matrices[s], &ctx->matrices[instruction->operands[FOURTH_MATRIX]]);
+
+    touchMatrix(ctx, u);
+    touchMatrix(ctx, s);
+    return status;
+}
+
+
+static MatrixStatus executeNewMat(const Instruction *instruction, MatrixContext *ctx) {
+    const ElementBuffer *elements = &instruction->elements;    /* Requested shape */
+    MatrixHandle handle;                                        /* Matrix of the name */
+    MatrixStatus status;                                        /* Outcome of the registration */
+
+    /* Register the name (or reuse its matrix), then fill the matrix with zeros */
+    status = registerMatrix(ctx, instruction->name, instruction->nameLength, &handle);
+    if (status != MATRIX_OK)
+        return status;
+    return readMatrix(&ctx->matrices[handle],
+                      elements->rows ? elements->rows : DEFAULT_ROWS,
+                      elements->cols ? elements->cols : DEFAULT_COLS, NULL, 0);
+}
+
+
+static MatrixStatus executeSaveMat(const Instruction *instruction, MatrixContext *ctx) {
+    return saveMatrix(&ctx->matrices[instruction->operands[FIRST_MATRIX]], instruction->path);
+}
+
+
+static MatrixStatus executeLoadMat(const Instruction *instruction, MatrixContext *ctx) {
+    return loadMatrix(&ctx->matrices[instruction->operands[FIRST_MATRIX]], instruction->path);
+}
+
+
+static MatrixStatus executeEval(const Instruction *instruction, MatrixContext *ctx) {
+    /* The evaluator handles a result that also appears in the expression */
+    return evaluateExpression(&instruction->expression, ctx, instruction->operands[FIRST_MATRIX]);
+}
+
+
+static MatrixStatus executeCacheStats(const Instruction *instruction, MatrixContext *ctx) {
+    CacheStats stats;   /* Counters of the cache */
+    (void)instruction;
+
+    if (ctx->cache == NULL) {
+        printf("Result cache: disabled\n");
+    } else {
+        getCacheStats(ctx->cache, &stats);
+        printf("Result cache: %lu hits, %lu misses, %lu evictions\n", stats.hits, stats.misses, stats.evictions);
+        printf("%lu entries, %lu of %lu bytes of results kept\n", (unsigned long)stats.entries,
+               (unsigned long)stats.bytes, (unsigned long)stats.limit);
+    }
+
+    /* The factorization cache exists even with a limit of 0, since every solve holds its factors there */
+    if (ctx->factors != NULL) {
+        getFactorCacheStats(ctx->factors, &stats);
+        printf("Factorizations: %lu reused, %lu computed, %lu evicted\n", stats.hits, stats.misses,
+               stats.evictions);
+        printf("%lu entries, %lu of %lu bytes of factors kept\n", (unsigned long)stats.entries,
+               (unsigned long)stats.bytes, (unsigned long)stats.limit);
+    }
+    return MATRIX_OK;
+}
+
+
+static MatrixStatus executeStats(const Instruction *instruction, MatrixContext *ctx) {
+    (void)instruction;
+    (void)ctx;
+
+    printStats(stdout);
+    printPerf(stdout);
+    return MATRIX_OK;
+}
+
+
+static MatrixStatus executeReadBatch(const Instruction *instruction, MatrixContext *ctx) {
+    const ElementBuffer *elements = &instruction->elements;    /* Values and size to read */
+
+    return readBatch(&ctx->batches[instruction->operands[FIRST_MATRIX]], elements->batchSize,
+                     elements->values, elements->count);
+}
+
+
+static MatrixStatus executePrintBatch(const Instruction *instruction, MatrixContext *ctx) {
+    printBatch(&ctx->batches[instruction->operands[FIRST_MATRIX]]);
+    return MATRIX_OK;
+}
+
+
+static MatrixStatus executeBmulMat(const Instruction *instruction, MatrixContext *ctx) {
+    /* The batch kernels allow any aliasing */
+    return multiplyBatches(&ctx->batches[instruction->operands[FIRST_MATRIX]],
+                           &ctx->batches[instruction->operands[SECOND_MATRIX]],
+                           &ctx->batches[instruction->operands[THIRD_MATRIX]]);
+}
+
+
+static MatrixStatus executeBmulScalar(const Instruction *instruction, MatrixContext *ctx) {
+    return multiplyBatchScalar(&ctx->batches[instruction->operands[FIRST_MATRIX]], instruction->scalar,
+                               &ctx->batches[instruction->operands[SECOND_MATRIX]]);
+}
+
+
+static MatrixStatus executeBtransMat(const Instruction *instruction, MatrixContext *ctx) {
+    return transposeBatch(&ctx->batches[instruction->operands[FIRST_MATRIX]],
+                          &ctx->batches[instruction->operands[SECOND_MATRIX]]);
+}
+
+
+/* Handler of every command, in CommandType order; 'stop' is handled by the caller */
+static const CommandHandler commandHandlers[NUM_COMMANDS] = {
+    NULL,               /* STOP */
+    executeReadMat,     /* READ_MAT */
+    executeReadSparse,  /* READ_SPARSE */
+    executePrintMat,    /* PRINT_MAT */
+    executeAddMat,      /* ADD_MAT */
+    executeSubMat,      /* SUB_MAT */
+    executeMulMat,      /* MUL_MAT */
+    executeMulScalar,   /* MUL_SCALAR */
+    executeTransMat,    /* TRANS_MAT */
+    executeDetMat,      /* DET_MAT */
+    executeInvMat,      /* INV_MAT */
+    executeSolveMat,    /* SOLVE_MAT */
+    executeCholMat,     /* CHOL_MAT */
+    executeQrMat,       /* QR_MAT */
+    executeLstsqMat,    /* LSTSQ_MAT */
+    executeEigSym,      /* EIG_SYM */
+    executeSvdMat,      /* SVD_MAT */
+    executeNewMat,      /* NEW_MAT */
+    executeSaveMat,     /* SAVE_MAT */
+    executeLoadMat,     /* LOAD_MAT */
+    executeEval,        /* EVAL */
+    executeCacheStats,  /* CACHE_STATS */
+    executeStats,       /* STATS */
+    executeReadBatch,   /* READ_BATCH */
+    executePrintBatch,  /* PRINT_BATCH */
+    executeBmulMat,     /* BMUL_MAT */
+    executeBmulScalar,  /* BMUL_SCALAR */
+    executeBtransMat    /* BTRANS_MAT */
+};
+
+
+/* Argument position of the matrix every command writes, in CommandType order; -1 if it writes none */
+static const int resultOperands[NUM_COMMANDS] = {
+    -1,                 /* STOP */
+    FIRST_MATRIX,       /* READ_MAT */
+    FIRST_MATRIX,       /* READ_SPARSE */
+    -1,                 /* PRINT_MAT */
+    THIRD_MATRIX,       /* ADD_MAT */
+    THIRD_MATRIX,       /* SUB_MAT */
+    THIRD_MATRIX,       /* MUL_MAT */
+    SECOND_MATRIX,      /* MUL_SCALAR */
+    SECOND_MATRIX,      /* TRANS_MAT */
+    -1,                 /* DET_MAT */
+    SECOND_MATRIX,      /* INV_MAT */
+    THIRD_MATRIX,       /* SOLVE_MAT */
+    SECOND_MATRIX,      /* CHOL_MAT */
+    THIRD_MATRIX,       /* QR_MAT (also writes its second matrix) */
+    THIRD_MATRIX,       /* LSTSQ_MAT */
+    THIRD_MATRIX,       /* EIG_SYM (also writes its second matrix) */
+    FOURTH_MATRIX,      /* SVD_MAT (also writes its second and third matrices) */
+    FIRST_MATRIX,       /* NEW_MAT */
+    -1,                 /* SAVE_MAT */
+    FIRST_MATRIX,       /* LOAD_MAT */
+    FIRST_MATRIX,       /* EVAL */
+    -1,                 /* CACHE_STATS */
+    -1,                 /* STATS */
+    -1,                 /* READ_BATCH (batches are not versioned) */
+    -1,                 /* PRINT_BATCH */
+    -1,                 /* BMUL_MAT */
+    -1,                 /* BMUL_SCALAR */
+    -1                  /* BTRANS_MAT */
+};
+
+
+static bool makeResultKey(const Instruction *instruction, const MatrixContext *ctx, ResultKey *key) {
+    /*
+     * Short Description:
+     * Fills the cache key of an arithmetic instruction from the current versions of its operands.
+     * Returns false for the commands whose results are not cached.
+     */
+    key->operation = (int)instruction->command;
+    key->versions[1] = 0;
+    key->scalar = 0.0;
+
+    switch (instruction->command) {
+        case ADD_MAT:
+        case SUB_MAT:
+        case MUL_MAT:
+        case SOLVE_MAT:
+            key->versions[1] = ctx->versions[instruction->operands[SECOND_MATRIX]];
             break;
+        case MUL_SCALAR:
+            key->scalar = instruction->scalar;
+            break;
+        case TRANS_MAT:
+        case INV_MAT:
+        case CHOL_MAT:
+            break;
+        default:
+            return false;
+    }
+    key->versions[0] = ctx->versions[instruction->operands[FIRST_MATRIX]];
+    return true;
+}
+
+
+bool processInstruction(const Instruction *instruction, MatrixContext *ctx) {
+    MatrixStatus status;    /* Outcome of the matrix operation */
+    ResultKey key;          /* Cache key of an arithmetic instruction */
+    bool cached;            /* Whether the result of the instruction is looked up in the cache */
+    PerfSample before;      /* Hardware counters before the kernel call */
+    PerfSample after;       /* Hardware counters after the kernel call */
+    MatrixHandle result = NO_MATRIX;    /* Matrix written by the instruction */
+
+    if (instruction->command == STOP) {
+        return true;
+    }
+
+    if (resultOperands[instruction->command] >= 0) {
+        result = instruction->operands[resultOperands[instruction->command]];
+    }
+    cached = makeResultKey(instruction, ctx, &key);
+
+    if (!cached || !fetchResult(ctx, &key, result, &status)) {
+        if (isPerfEnabled()) {
+            readPerfCounters(&before);
+            status = commandHandlers[instruction->command](instruction, ctx);
+            readPerfCounters(&after);
+            recordPerf((int)instruction->command, &before, &after);
+        } else {
+            status = commandHandlers[instruction->command](instruction, ctx);
+        }
+        if (instruction->command == NEW_MAT) {
+            result = findMatrix(ctx, instruction->name, instruction->nameLength);   /* Registered by the handler */
+        }
+        if (result != NO_MATRIX) {
+            touchMatrix(ctx, result);   /* Even a failed operation may have changed its result */
+        }
+        /* Products, inverses, solutions and factors are worth a copy; the others are only reused while in place */
+        if (cached && status == MATRIX_OK) {
+            storeResult(ctx, &key, result, instruction->command == MUL_MAT || instruction->command == INV_MAT ||
+                                           instruction->command == SOLVE_MAT || instruction->command == CHOL_MAT);
+        }
+    }
+
+    /* Report a failed matrix operation */
+    if (status != MATRIX_OK) {
+        printf("Error: %s\n", MatrixStatuses[status].statusName);
     }
     return false;
 }
 
-bool readAndProcessInstructions(MatrixContext *ctx) {
-    char line[MAX_LINE_LENGTH];                                         /* Buffer to store each line read */
-    char command[MAX_COMMAND_LENGTH];                                   /* Buffer to store parsed command */
-    char matrixNames[MAX_INPUT_MATRICES][MAX_MATRIX_NAME_LENGTH] = {0}; /* Array to store matrix names */
-    double matrix_elements[ROWS * COLS] = {0};                          /* Array to store matrix elements for 'read' command */
+
+static size_t instructionBytes(const Instruction *instruction, const MatrixContext *ctx) {
+    /*
+     * Short Description:
+     * Returns the bytes of the matrices or batches an instruction names, including the matrices of the
+     * expression of 'eval', in their shapes after the instruction ran.
+     */
+    const CommandProfile *profile = &validCommands[instruction->command];  /* Profile of the command */
+    const Matrix *mat;      /* Matrix named by the instruction */
+    MatrixHandle handle;    /* Handle of the matrix named by the instruction */
+    size_t elements = 0;    /* Elements named */
+    int operand_idx;        /* Variable for iterating over the operands and expression nodes */
+
+    for (operand_idx = 0; operand_idx < profile->numMatrices; ++operand_idx) {
+        if (profile->batched) {
+            elements += ctx->batches[instruction->operands[operand_idx]].count * BATCH_ELEMENTS;
+        } else {
+            /* The matrix of 'new_mat' is only known once the instruction registered its name */
+            handle = (instruction->command == NEW_MAT)
+                     ? findMatrix(ctx, instruction->name, instruction->nameLength)
+                     : instruction->operands[operand_idx];
+            if (handle == NO_MATRIX)
+                continue;
+            mat = &ctx->matrices[handle];
+            elements += (size_t)mat->rows * (size_t)mat->cols;
+        }
+    }
+    if (instruction->command == EVAL) {
+        for (operand_idx = 0; operand_idx < instruction->expression.count; ++operand_idx) {
+            if (instruction->expression.nodes[operand_idx].op == EXPR_MATRIX) {
+                mat = &ctx->matrices[instruction->expression.nodes[operand_idx].matrix];
+                elements += (size_t)mat->rows * (size_t)mat->cols;
+            }
+        }
+    }
+    return elements * sizeof(double);
+}
+
+
+bool readAndProcessInstructions(MatrixContext *ctx, LineReader *reader) {
+    char *line;                                                         /* Line read, inside the reader's buffer */
+    Instruction instruction;                                            /* Record of the parsed instruction */
     bool isEOF = false;                                                 /* Flag to indicate end of file */
     bool isStop = false;                                                /* Flag to indicate 'stop' command */
-    double scalar;                                                      /* Variable to store scalar value */
     InstructionError readInstructionResult;                             /* Variable to store the result of instruction reading */
+    bool timed = isStatsEnabled();                                      /* Whether the instructions are timed */
+    unsigned long start = 0;                                            /* Clock when the timed step started */
+    unsigned long end;                                                  /* Clock when the timed step ended */
     
+    /* The element buffer and expression of the record are reused by every instruction */
+    instruction.elements.values = NULL;
+    instruction.elements.capacity = 0;
+    initExpression(&instruction.expression);
+
     /* Main loop to read and process instructions */
     while (!isEOF) {
-        isEOF = readLine(line); /* Reads a line from input and checks for EOF */
+        if (timed) {
+            start = readStatsClock();
+        }
+        isEOF = readLine(reader, &line); /* Reads a line from input and checks for EOF */
+        if (timed) {
+            end = readStatsClock();
+            recordInput(end - start, strlen(line) + !isEOF);
+        }
 
         /* Skip processing for empty lines */
         if (isEmptyLine(line)) {
@@ -288,14 +1113,36 @@ bool readAndProcessInstructions(MatrixContext *ctx) {
         }
 
         /* Read and parse the instruction */
-        readInstructionResult = readInstruction(line, command, matrixNames, matrix_elements, &scalar, ctx);
+        if (timed) {
+            start = readStatsClock();
+        }
+        readInstructionResult = readInstruction(line, &instruction, ctx);
+        if (timed) {
+            end = readStatsClock();
+            if (readInstructionResult == NO_ERROR) {
+                recordCommand((int)instruction.command, STATS_PARSE, end - start);
+            } else {
+                recordRejected(end - start);
+            }
+        }
 
         /* Process the instruction if no error occurred */
         if (readInstructionResult == NO_ERROR) {
             /* Process the instruction and check if it's a 'stop' command */
-            isStop = processInstruction(command, matrixNames, matrix_elements, &scalar, ctx);
-            if (isStop)
+            if (timed) {
+                start = readStatsClock();
+            }
+            isStop = processInstruction(&instruction, ctx);
+            if (timed) {
+                end = readStatsClock();
+                recordCommand((int)instruction.command, STATS_EXECUTE, end - start);
+                recordBytes((int)instruction.command, instructionBytes(&instruction, ctx));
+            }
+            if (isStop) {
+                freeElementBuffer(&instruction.elements);
+                freeExpression(&instruction.expression);
                 return true;    /* Return true if 'stop' command is encountered */
+            }
         } else {
             /* Print error message if an error occurred while reading the instruction */
             printf("Error: %s\n", InstructionErrors[readInstructionResult].errorName);
@@ -307,26 +1154,26 @@ bool readAndProcessInstructions(MatrixContext *ctx) {
     if (isEOF && !isStop) {
         printf("Error: Unexpected End Of File. No 'stop' command found.\n");
     }
+    freeElementBuffer(&instruction.elements);
+    freeExpression(&instruction.expression);
     return false; /* Return false if EOF is reached without 'stop' */
 }
 
 
-InstructionError readCommand(char **charPtr, char *command) {
-    int index = 0;
+InstructionError readCommand(char **charPtr, CommandType *command) {
+    char *start;            /* First character of the command */
     char *ptr = *charPtr;   /* Working pointer to the string */
     
     /* Skip initial white spaces */
     while (isspace(*ptr)) ptr++;    
 
-    /* Read the command from the string */
-    index = 0;
-    while (!isspace(*ptr) && *ptr != '\0' && *ptr != ',') {
-        command[index++] = *ptr++;  /* Copy characters to 'command' */
-    }
-    command[index] = '\0';          /* Null-terminate the command */
+    /* Find the end of the command */
+    start = ptr;
+    while (!isspace(*ptr) && *ptr != '\0' && *ptr != ',') ptr++;
 
     /* Check if the command is valid */
-    if (!isValidCommand(command)) {
+    *command = findCommand(start, (size_t)(ptr - start));
+    if ((int)*command < 0) {
         return UNDEFINED_COMMAND_NAME; /* Return error if command is not valid */
     }
 
@@ -342,19 +1189,81 @@ InstructionError readCommand(char **charPtr, char *command) {
 }
 
 
-InstructionError readInstruction(char *line, 
-                                 char *command, 
-                                 char matrixNames[MAX_INPUT_MATRICES][MAX_MATRIX_NAME_LENGTH], 
-                                 double matrix_elements[ROWS * COLS],
-                                 double *scalar,
-                                 MatrixContext *ctx) {
+InstructionError readMatrixShape(const char *start, const char *end, ElementBuffer *elements) {
+    const char *ptr = start;    /* Working pointer into the suffix */
+    long dims[2] = {0, 0};      /* Parsed rows and columns */
+    int dim_index;              /* Index of the dimension being parsed */
+
+    /* The suffix has to be enclosed in brackets */
+    if (end - start < 2 || *ptr != '[' || *(end - 1) != ']') {
+        return INVALID_MATRIX_SHAPE;
+    }
+    ptr++;
+
+    /* Parse '<rows>x<cols>' */
+    for (dim_index = 0; dim_index < 2; dim_index++) {
+        if (!isdigit((unsigned char)*ptr)) {
+            return INVALID_MATRIX_SHAPE;
+        }
+        while (isdigit((unsigned char)*ptr)) {
+            dims[dim_index] = dims[dim_index] * 10 + (*ptr++ - '0');
+            if (dims[dim_index] > INT_MAX) {
+                return INVALID_MATRIX_SHAPE;
+            }
+        }
+        /* Dimensions are separated by an 'x' and followed by the closing bracket */
+        if (*ptr != ((dim_index == 0) ? 'x' : ']')) {
+            return INVALID_MATRIX_SHAPE;
+        }
+        ptr++;
+    }
+
+    if (ptr != end || dims[0] == 0 || dims[1] == 0) {
+        return INVALID_MATRIX_SHAPE;
+    }
+    elements->rows = (int)dims[0];
+    elements->cols = (int)dims[1];
+    return NO_ERROR;
+}
+
+
+InstructionError readBatchSize(const char *start, const char *end, ElementBuffer *elements) {
+    const char *ptr = start;    /* Working pointer into the suffix */
+    size_t count = 0;           /* Parsed number of matrices */
+
+    /* The suffix has to be '[<count>]' */
+    if (end - start < 3 || *ptr != '[' || *(end - 1) != ']') {
+        return INVALID_MATRIX_SHAPE;
+    }
+    for (ptr++; ptr < end - 1; ptr++) {
+        if (!isdigit((unsigned char)*ptr) || count > ((size_t)-1 - 9) / 10) {
+            return INVALID_MATRIX_SHAPE;
+        }
+        count = count * 10 + (size_t)(*ptr - '0');
+    }
+
+    if (count == 0) {
+        return INVALID_MATRIX_SHAPE;
+    }
+    elements->batchSize = count;
+    return NO_ERROR;
+}
+
+
+InstructionError readInstruction(char *line, Instruction *instruction, MatrixContext *ctx) {
     char *charPtr;
-    int index = 0;
+    char *nameStart;        /* Start of the matrix name token being read */
+    char *tokenEnd;         /* End of the matrix name token being read */
+    char *shapeStart;       /* Start of the '[<rows>x<cols>]' suffix of a 'read_mat' matrix name */
+    char *numberStart;      /* Start of the number being read */
+    size_t nameLength;      /* Length of the matrix name, without its suffix */
+    double value;           /* Number converted from the line */
     int matrix_name_saved = 0;
-    char scalar_buffer[SCALAR_LENGTH] = {0};
     int scalar_index = 0;
     State currentState = ReadingMatrixName;
     CommandType cmd;
+    MatrixHandle *operands = instruction->operands;     /* Handles of the matrix arguments */
+    ElementBuffer *elements = &instruction->elements;   /* Values and shape of the 'read' commands */
     InstructionError err;
 
     /* Return error if line is NULL */
@@ -364,20 +1273,23 @@ InstructionError readInstruction(char *line,
     charPtr = line;
 
     /* Initialize scalar and matrix elements */
-    *scalar = 0;
-    for(index = 0; index < (ROWS * COLS); index++) {
-        matrix_elements[index] = 0;
-    }
+    instruction->scalar = 0;
+    instruction->path = NULL;
+    instruction->name = NULL;
+    instruction->nameLength = 0;
+    elements->count = 0;
+    elements->rows = 0;
+    elements->cols = 0;
+    elements->batchSize = 0;
 
     /* Read and validate the command */
-    err = readCommand(&charPtr, command);
+    err = readCommand(&charPtr, &cmd);
     if (err != NO_ERROR)
         return err;
+    instruction->command = cmd;
 
-    cmd = commandTypeReturn(command);   /* Determine the CommandType of the command */
-
-    /* Special handling for STOP command */
-    if (cmd == STOP)
+    /* Commands without arguments, such as 'stop', end after their name */
+    if (validCommands[cmd].numMatrices == 0)
         return (*charPtr == '\0') ? NO_ERROR : EXTRANEOUS_TEXT_AFTER_COMMAND;
     
     /* Main loop for parsing the instruction */
@@ -385,46 +1297,107 @@ InstructionError readInstruction(char *line,
         switch (currentState) {
 
             case ReadingMatrixName: /* Reading matrix names */
-                index = 0;
-
-                /* Read characters from charPtr until a space, comma, or end of string is reached */
-                while (!isspace(*charPtr) && *charPtr != ',' && *charPtr != '\0') {
-                    /* Store each character into the current matrix name */
-                    matrixNames[matrix_name_saved][index++] = *charPtr++;
+                /* Find the end of the token; 'read_mat', 'read_sparse', 'new_mat' and 'read_batch' names may carry a shape suffix */
+                nameStart = charPtr;
+                tokenEnd = charPtr;
+                while (!isspace(*tokenEnd) && *tokenEnd != ',' && *tokenEnd != '\0'
+                       && !(cmd == EVAL && *tokenEnd == '=')) tokenEnd++;
+                shapeStart = tokenEnd;
+                if (cmd == READ_MAT || cmd == READ_SPARSE || cmd == NEW_MAT || cmd == READ_BATCH) {
+                    shapeStart = charPtr;
+                    while (shapeStart < tokenEnd && *shapeStart != '[') shapeStart++;
                 }
-
-                /* Null-terminate the current matrix name */
-                matrixNames[matrix_name_saved][index] = '\0';
+                nameLength = (size_t)(shapeStart - nameStart);
+                charPtr = tokenEnd;
 
                 /* Skip any white space after the matrix name */
                 while (isspace(*charPtr)) charPtr++;
 
-                /* Check if the matrix name is valid within the given context */
-                if (!isValidMatrixName(ctx, matrixNames[matrix_name_saved]))
-                    return UNDEFINED_MATRIX_NAME;   /* Return error if matrix name is not valid */
+                /* Resolve the name in place to the handle of its matrix (or batch) */
+                if (cmd == NEW_MAT) {
+                    /* The name is registered when the instruction runs, so only its spelling is checked here */
+                    if (!isMatrixIdentifier(nameStart, nameLength, MAX_MATRIX_NAME_LENGTH))
+                        return INVALID_MATRIX_NAME;
+                    instruction->name = nameStart;
+                    instruction->nameLength = nameLength;
+                    operands[matrix_name_saved] = NO_MATRIX;
+                } else {
+                    operands[matrix_name_saved] = validCommands[cmd].batched
+                                                ? (MatrixHandle)getBatchEnumByName(nameStart, nameLength, ctx)
+                                                : findMatrix(ctx, nameStart, nameLength);
+                    if (operands[matrix_name_saved] == NO_MATRIX)
+                        return UNDEFINED_MATRIX_NAME;   /* Return error if matrix name is not valid */
+                }
+
+                /* Parse the shape suffix, if present */
+                if (shapeStart != tokenEnd) {
+                    err = (cmd == READ_BATCH) ? readBatchSize(shapeStart, tokenEnd, elements)
+                                              : readMatrixShape(shapeStart, tokenEnd, elements);
+                    if (err != NO_ERROR)
+                        return err;
+                }
                 
                 matrix_name_saved++;    /* Increment the count of matrix names saved */
 
                 /* Handle different command types that require matrix names */
                 switch (cmd) {
                     case PRINT_MAT: 
+                    case DET_MAT:
+                    case PRINT_BATCH:
                         /* For the 'print' command, there should be no extra text after the matrix name */
                         return (*charPtr == '\0') ? NO_ERROR : EXTRANEOUS_TEXT_AFTER_COMMAND;
                         break;
+                    case NEW_MAT:
+                        /* Nothing may follow the name of a new matrix */
+                        return (*charPtr == '\0') ? NO_ERROR : EXTRANEOUS_TEXT_AFTER_COMMAND;
+                    case EVAL:
+                        /* The rest of the line is '= <expression>' */
+                        if (*charPtr == ',')
+                            return ILLEGAL_COMMA;
+                        if (*charPtr != '=')
+                            return (*charPtr == '\0') ? MISSING_ARGUMENT : INVALID_EXPRESSION;
+                        return readExpression(charPtr + 1, &instruction->expression, ctx);
                     case TRANS_MAT:
+                    case INV_MAT:
+                    case CHOL_MAT:
                     case MUL_SCALAR:
+                    case BTRANS_MAT:
+                    case BMUL_SCALAR:
                         /* For 'transpose' and 'multiply scalar', check if the required number of matrix names are read */
                         if (matrix_name_saved == 2) {
                             return (*charPtr == '\0') ? NO_ERROR : EXTRANEOUS_TEXT_AFTER_COMMAND;
                         }
                         break;
+                    case QR_MAT:
+                    case EIG_SYM:
+                        /* 'qr_mat' and 'eig_sym' write two factors, which must be different matrices */
+                        if (matrix_name_saved == 3) {
+                            if (*charPtr != '\0')
+                                return EXTRANEOUS_TEXT_AFTER_COMMAND;
+                            return (operands[SECOND_MATRIX] == operands[THIRD_MATRIX]) ? DUPLICATE_OUTPUT_MATRIX : NO_ERROR;
+                        }
+                        break;
                     case ADD_MAT:
                     case SUB_MAT:
                     case MUL_MAT:
+                    case SOLVE_MAT:
+                    case LSTSQ_MAT:
+                    case BMUL_MAT:
                         /* For 'add', 'subtract', and 'multiply', check if three matrix names are read */
                         if (matrix_name_saved == 3) {
                             return (*charPtr == '\0') ? NO_ERROR : EXTRANEOUS_TEXT_AFTER_COMMAND;
                         }  
+                        break;
+                    case SVD_MAT:
+                        /* 'svd_mat' names the matrix and its three factors, which must be different matrices */
+                        if (matrix_name_saved == 4) {
+                            if (*charPtr != '\0')
+                                return EXTRANEOUS_TEXT_AFTER_COMMAND;
+                            return (operands[SECOND_MATRIX] == operands[THIRD_MATRIX]
+                                    || operands[SECOND_MATRIX] == operands[FOURTH_MATRIX]
+                                    || operands[THIRD_MATRIX] == operands[FOURTH_MATRIX]) ? DUPLICATE_OUTPUT_MATRIX : NO_ERROR;
+                        }
+                        break;
                     default:
                         break;
                 }
@@ -461,11 +1434,18 @@ InstructionError readInstruction(char *line,
                     /* Determine the next state based on the command type */
                     switch (cmd) {
                         case READ_MAT:  /* or the 'read matrix' command, expect scalar values next */
+                        case READ_SPARSE:
+                        case READ_BATCH:
                             currentState = ReadingScalar;
                             break;
                         case MUL_SCALAR: /* For 'multiply by scalar', transition based on whether a scalar value has been read */
+                        case BMUL_SCALAR:
                             currentState = scalar_index ? ReadingMatrixName : ReadingScalar;
                             break;
+                        case SAVE_MAT:  /* For 'save' and 'load', the file path follows the matrix name */
+                        case LOAD_MAT:
+                            currentState = ReadingPath;
+                            break;
                         default:
                             /* For other commands, expect another matrix name */
                             currentState = ReadingMatrixName;
@@ -473,42 +1453,51 @@ InstructionError readInstruction(char *line,
                     }
                 } else {
                     if (*charPtr == '\0') {
-                        return (cmd == READ_MAT) ? NO_ERROR : MISSING_ARGUMENT;
+                        return (cmd == READ_MAT || cmd == READ_SPARSE || cmd == READ_BATCH) ? NO_ERROR : MISSING_ARGUMENT;
                     }
                     /* If a comma is missing where expected, return an error */
                     return MISSING_COMMA;
                 }
                 break;
 
+            case ReadingPath:   /* The path is the rest of the line, without trailing white space */
+                tokenEnd = charPtr + strlen(charPtr);
+                while (isspace(*(tokenEnd - 1))) tokenEnd--;
+                *tokenEnd = '\0';
+                instruction->path = charPtr;
+                return NO_ERROR;
+
             case ReadingScalar: /* Reading a scalar value or matrix elements */
-                index = 0;
+                numberStart = charPtr;
                 /* Read characters until a space, comma, or end of string is reached */
                 while (!isspace(*charPtr) && *charPtr != ',' && *charPtr != '\0') {
                     /* Validate if the character is part of a valid number (digit, decimal point, or minus sign) */
                     if (isdigit(*charPtr) || *charPtr == '.' || *charPtr == '-') {
-                        scalar_buffer[index++] = *charPtr++;    /* Store the valid character in the buffer */
+                        charPtr++;
                     } else {
                         /* If an invalid character is found, return an error indicating it's not a real number */
-                        return (cmd == READ_MAT) ? ARGUMENT_NOT_REAL_NUMBER : ARGUMENT_NOT_SCALAR;
+                        return (cmd == READ_MAT || cmd == READ_SPARSE || cmd == READ_BATCH) ? ARGUMENT_NOT_REAL_NUMBER
+                                                                                            : ARGUMENT_NOT_SCALAR;
                     }
                 }
 
-                /* Null-terminate the scalar buffer and convert it to a double */
-                scalar_buffer[index] = '\0';
-                *scalar = atof(scalar_buffer);
+                /* Convert the number in place; it ends where the validated characters end */
+                value = strtod(numberStart, NULL);
 
                 /* Handle commands that require scalar values */
-                if ((cmd == READ_MAT)) {
-                    /* If reading matrix elements, store the scalar value in the matrix_elements array */
-                    if (scalar_index < (ROWS * COLS)) {
-                        matrix_elements[scalar_index++] = *scalar;
+                if (cmd == READ_MAT || cmd == READ_SPARSE || cmd == READ_BATCH) {
+                    /* If reading matrix elements, store the scalar value in the element buffer */
+                    if (!appendElement(elements, value)) {
+                        return OUT_OF_MEMORY;
                     }
+                    scalar_index++;
                     /* Prepare for the next argument or end of command */
                     currentState = AvaitingArgument;
                 }
 
                 /*  If command is 'multiply by scalar', increment the scalar index and wait for the next argument */
-                if (cmd == MUL_SCALAR) {
+                if (cmd == MUL_SCALAR || cmd == BMUL_SCALAR) {
+                    instruction->scalar = value;
                     scalar_index++;
                     currentState = AvaitingArgument; 
                     if (*charPtr == '\0') {
@@ -528,4 +1517,217 @@ InstructionError readInstruction(char *line,
         }
     }
     return MISSING_ARGUMENT; /* If the end of the string is reached without completing the instruction */
+}
+
+/*
+ * Expression parser of 'eval'. Each level of the grammar (see 'readExpression' in "mainmat.h") is one
+ * function returning a ParsedTerm: the root node of the subexpression it read, or the value of a
+ * subexpression made of numbers alone, which never becomes a node.
+ */
+
+/* Value of a parsed subexpression */
+typedef struct {
+    int node;       /* Index of the root node, or -1 for a scalar */
+    double scalar;  /* Value of a scalar subexpression */
+} ParsedTerm;
+
+/* State shared by the functions of the parser */
+typedef struct {
+    const char *ptr;            /* Next character to read */
+    Expression *expr;           /* Tree being built */
+    const MatrixContext *ctx;   /* Matrices the names are looked up in */
+    int nesting;                /* Number of open parentheses */
+} ExpressionParser;
+
+static InstructionError parseSum(ExpressionParser *parser, ParsedTerm *term);
+
+
+static void skipExpressionSpace(ExpressionParser *parser) {
+    while (isspace((unsigned char)*parser->ptr)) parser->ptr++;
+}
+
+
+static InstructionError addParsedNode(ExpressionParser *parser, ExprOp op, int left, int right,
+                                      MatrixHandle matrix, double scalar, ParsedTerm *term) {
+    int node = addExprNode(parser->expr, op, left, right, matrix, scalar);    /* Index of the new node */
+
+    if (node < 0) {
+        return (node == -1) ? OUT_OF_MEMORY : INVALID_EXPRESSION;
+    }
+    term->node = node;
+    return NO_ERROR;
+}
+
+
+static InstructionError parsePrimary(ExpressionParser *parser, ParsedTerm *term) {
+    const char *start = parser->ptr;    /* First character of the token */
+    char *end;                          /* End of a number */
+    MatrixHandle matrix;                /* Handle of a matrix name */
+    InstructionError err;
+
+    /* Parenthesized subexpression */
+    if (*start == '(') {
+        if (parser->nesting >= MAX_EXPRESSION_DEPTH) {
+            return INVALID_EXPRESSION;
+        }
+        parser->nesting++;
+        parser->ptr++;
+        err = parseSum(parser, term);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        if (*parser->ptr != ')') {
+            return INVALID_EXPRESSION;
+        }
+        parser->nesting--;
+        parser->ptr++;
+        return NO_ERROR;
+    }
+
+    /* Matrix name, resolved in place */
+    if (isalpha((unsigned char)*start) || *start == '_') {
+        while (isalnum((unsigned char)*parser->ptr) || *parser->ptr == '_') parser->ptr++;
+        matrix = findMatrix(parser->ctx, start, (size_t)(parser->ptr - start));
+        if (matrix == NO_MATRIX) {
+            return UNDEFINED_MATRIX_NAME;
+        }
+        return addParsedNode(parser, EXPR_MATRIX, -1, -1, matrix, 0, term);
+    }
+
+    /* Unsigned number; signs are read as unary minus */
+    if (isdigit((unsigned char)*start) || *start == '.') {
+        term->node = -1;
+        term->scalar = strtod(start, &end);
+        if (end == start) {
+            return INVALID_EXPRESSION;
+        }
+        parser->ptr = end;
+        return NO_ERROR;
+    }
+
+    return (*start == ',') ? ILLEGAL_COMMA : INVALID_EXPRESSION;
+}
+
+
+static InstructionError parsePostfix(ExpressionParser *parser, ParsedTerm *term) {
+    InstructionError err = parsePrimary(parser, term);
+
+    skipExpressionSpace(parser);
+    while (err == NO_ERROR && *parser->ptr == '\'') {
+        /* The transpose of a scalar is the scalar */
+        if (term->node >= 0) {
+            err = addParsedNode(parser, EXPR_TRANSPOSE, term->node, -1, NO_MATRIX, 0, term);
+        }
+        parser->ptr++;
+        skipExpressionSpace(parser);
+    }
+    return err;
+}
+
+
+static InstructionError parseUnary(ExpressionParser *parser, ParsedTerm *term) {
+    bool negative = false;  /* Whether an odd number of minus signs precedes the operand */
+    InstructionError err;
+
+    while (*parser->ptr == '-') {
+        negative = !negative;
+        parser->ptr++;
+        skipExpressionSpace(parser);
+    }
+
+    err = parsePostfix(parser, term);
+    if (err != NO_ERROR || !negative) {
+        return err;
+    }
+    if (term->node < 0) {
+        term->scalar = -term->scalar;
+        return NO_ERROR;
+    }
+    return addParsedNode(parser, EXPR_NEGATE, term->node, -1, NO_MATRIX, 0, term);
+}
+
+
+static InstructionError parseProduct(ExpressionParser *parser, ParsedTerm *term) {
+    ParsedTerm factor;  /* Right operand of a '*' */
+    InstructionError err = parseUnary(parser, term);
+
+    while (err == NO_ERROR && *parser->ptr == '*') {
+        parser->ptr++;
+        skipExpressionSpace(parser);
+        err = parseUnary(parser, &factor);
+        if (err != NO_ERROR) {
+            break;
+        }
+
+        if (term->node < 0 && factor.node < 0) {
+            term->scalar *= factor.scalar;
+        } else if (term->node < 0) {
+            err = addParsedNode(parser, EXPR_SCALE, factor.node, -1, NO_MATRIX, term->scalar, term);
+        } else if (factor.node < 0) {
+            err = addParsedNode(parser, EXPR_SCALE, term->node, -1, NO_MATRIX, factor.scalar, term);
+        } else {
+            err = addParsedNode(parser, EXPR_MULTIPLY, term->node, factor.node, NO_MATRIX, 0, term);
+        }
+    }
+    return err;
+}
+
+
+static InstructionError parseSum(ExpressionParser *parser, ParsedTerm *term) {
+    ParsedTerm operand;     /* Right operand of a '+' or '-' */
+    char operator;          /* The '+' or '-' being applied */
+    InstructionError err;
+
+    skipExpressionSpace(parser);
+    err = parseProduct(parser, term);
+
+    while (err == NO_ERROR && (*parser->ptr == '+' || *parser->ptr == '-')) {
+        operator = *parser->ptr++;
+        skipExpressionSpace(parser);
+        err = parseProduct(parser, &operand);
+        if (err != NO_ERROR) {
+            break;
+        }
+
+        /* Scalars only combine with scalars */
+        if ((term->node < 0) != (operand.node < 0)) {
+            return INVALID_EXPRESSION;
+        }
+        if (term->node < 0) {
+            term->scalar += (operator == '+') ? operand.scalar : -operand.scalar;
+        } else {
+            err = addParsedNode(parser, (operator == '+') ? EXPR_ADD : EXPR_SUB,
+                                term->node, operand.node, NO_MATRIX, 0, term);
+        }
+    }
+    return err;
+}
+
+
+InstructionError readExpression(const char *text, Expression *expr, const MatrixContext *ctx) {
+    ExpressionParser parser;    /* State of the parser */
+    ParsedTerm value;           /* Value of the whole expression */
+    InstructionError err;
+
+    parser.ptr = text;
+    parser.expr = expr;
+    parser.ctx = ctx;
+    parser.nesting = 0;
+    expr->count = 0;
+
+    skipExpressionSpace(&parser);
+    if (*parser.ptr == '\0') {
+        return MISSING_ARGUMENT;
+    }
+
+    err = parseSum(&parser, &value);
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    /* The whole line must be one expression, and its value a matrix */
+    if (*parser.ptr != '\0' || value.node < 0) {
+        return INVALID_EXPRESSION;
+    }
+    return NO_ERROR;
 }
\ No newline at end of file
@@ -7,11 +7,9 @@
  * within a predefined context, 'MatrixContext'.
  *
  * Constants:
- * - MAX_COMMAND_LENGTH:        Maximum length for a command string.
  * - MAX_INPUT_MATRICES:        Maximum number of input matrices allowed.
- * - MAX_LINE_LENGTH:           Maximum length for an input line.
- * - SCALAR_LENGTH:             Maximum length for a scalar value string.
- * - MAX_MATRIX_NAME_LENGTH:    Maximum length for a matrix name string.
+ * - LINE_READER_BLOCK:         Initial size of the input buffer, and smallest amount requested from read(2).
+ * - MAX_MATRIX_NAME_LENGTH:    Bound on the length of a matrix name.
  * 
  * Enumerations:
  * - State:                     Enumeration to represent different states during command parsing.
@@ -22,18 +20,31 @@
  *
  * Structures:
  * - CommandProfile:            Structure to define the profile of a command.
+ * - ElementBuffer:             Growable array of the values and shape parsed from a 'read_mat', 'read_sparse' or 'read_batch' instruction.
+ * - LineReader:                Reader returning the lines of a file descriptor or of a memory-mapped script.
+ * - Instruction:               Record of a parsed instruction: command, matrix handles, scalar and values.
+ * - ProgramOptions:            Command-line options of the program.
  * - InstructionErrorProfile:   Structure to define the profile of an instruction error.
  *
  * Core Functions:
+ * - parseOptions:                  Parses the command-line options of the program.
+ * - initLineReader:                Prepares a LineReader on a file descriptor.
+ * - mapLineReader:                 Prepares a LineReader on a memory-mapped script file.
+ * - readLine:                      Returns the next line of a LineReader, printing the prompt and optionally the line.
+ * - freeLineReader:                Releases the buffer or mapping of a LineReader.
  * - print_intro:                   Prints the introductory message and available commands for the Matrix Calculator Application.
  * - print_outro:                   Prints the closing message for the Matrix Calculator Application.
  * - isEmptyLine:                   Checks if a given string (line) contains only white-space characters or is empty.
- * - isValidCommand:                Checks if a given string is a valid command.
  * - readAndProcessInstructions:    Reads and processes user instructions for matrix operations.
- * - processInstruction:            Processes a matrix operation command and executes the corresponding action.
- * - commandTypeReturn:             Determines the CommandType of a given command string.
+ * - processInstruction:            Executes a parsed instruction through the table of command handlers.
+ * - findCommand:                   Determines the CommandType of a command name.
  * - readCommand:                   Reads and validates a command from a string.
  * - readInstruction:               Parses and validates a matrix operation instruction from a string.
+ * - readMatrixShape:               Parses the optional '[<rows>x<cols>]' suffix of a 'read_mat' or 'read_sparse' matrix name.
+ * - readBatchSize:                 Parses the optional '[<count>]' suffix of a 'read_batch' batch name.
+ * - readExpression:                Parses the expression of an 'eval' instruction into an expression tree.
+ * - appendElement:                 Appends a value to an ElementBuffer, growing it as needed.
+ * - freeElementBuffer:             Releases the storage of an ElementBuffer.
  * 
  * 
  * 
@@ -49,20 +60,48 @@
  */
 
 
-/* Maximum length for a command string */
-#define MAX_COMMAND_LENGTH 16
-
 /* Maximum number of input matrices allowed */
-#define MAX_INPUT_MATRICES 3
+#define MAX_INPUT_MATRICES 4
+
+/* Initial size of the input buffer, and smallest amount requested from read(2) */
+#define LINE_READER_BLOCK 65536
 
-/* Maximum length for an input line */
-#define MAX_LINE_LENGTH 256
+/* Bound on the length of a matrix name; names defined with 'new_mat' are shorter */
+#define MAX_MATRIX_NAME_LENGTH 32
 
-/* Maximum length for a scalar value string */
-#define SCALAR_LENGTH 32
+/* Structure holding the command-line options of the program */
+typedef struct {
+    int threads;                    /* Number of threads for the matrix kernels, 0 for the default */
+    MultiplyAlgorithm multiply;     /* Algorithm used by 'mul_mat' */
+    int strassenCutoff;             /* Crossover dimension between Strassen-Winograd and the classic kernel */
+    bool echo;                      /* Whether every input line is printed back after the prompt */
+    char **scripts;                 /* Script files run by '--batch', NULL for standard input */
+    int scriptCount;                /* Number of entries in 'scripts' */
+    PrintFormat print;              /* Format of 'print_mat' and 'print_batch' */
+    bool verifyLoads;               /* Whether 'load_mat' checks the checksum of the elements */
+    size_t memoryBudget;            /* Bytes of matrices kept in memory before spilling to disk, 0 for the default */
+    size_t cacheLimit;              /* Bytes of results, and of factorizations, the caches may keep, 0 to disable them */
+    bool stats;                     /* Whether instructions are timed for 'stats' */
+    const char *statsDump;          /* File receiving the statistics when the program exits, NULL for none */
+    bool perf;                      /* Whether kernel calls are measured with hardware counters */
+    double sparseThreshold;         /* Largest share of non-zero elements of a sparse matrix, 0 to store all dense */
+} ProgramOptions;
+
+
+/* Structure holding the state of a buffered line reader */
+typedef struct {
+    int fd;             /* File descriptor the input is read from, -1 for a mapped script */
+    char *buffer;       /* Block of input, or the mapped script; lines are null-terminated in place */
+    size_t capacity;    /* Number of bytes allocated (or mapped) in 'buffer' */
+    size_t start;       /* Offset of the first byte not yet returned */
+    size_t end;         /* Offset one past the last byte read */
+    bool eof;           /* Whether read(2) has reported the end of the input; always set for a mapped script */
+    bool echo;          /* Whether every line is printed back after the prompt */
+    bool prompt;        /* Whether the '>> ' prompt is printed before every line */
+    bool mapped;        /* Whether 'buffer' is a mapping to release with munmap(2) */
+    char *tail;         /* Copy of a last line that has no room for its terminator in the mapping */
+} LineReader;
 
-/* Maximum length for a matrix name string */
-#define MAX_MATRIX_NAME_LENGTH 16
 
 /* Enumeration to represent different error codes for the OS */
 typedef enum {
@@ -75,19 +114,40 @@ typedef enum {
 typedef enum {
     AvaitingArgument,   /* Waiting for an argument in the input command */
     ReadingMatrixName,  /* Reading the name of a matrix in the input command */
-    ReadingScalar       /* Reading a scalar value in the input command */
+    ReadingScalar,      /* Reading a scalar value in the input command */
+    ReadingPath         /* Reading the file path that ends the input command */
 } State;
 
 /* Enumeration to represent different command types */
 typedef enum {
     STOP,            /* Stop the program */
     READ_MAT,        /* Read a matrix from user input */
+    READ_SPARSE,     /* Read a matrix from (row, column, value) triples */
     PRINT_MAT,       /* Print a matrix */
     ADD_MAT,         /* Add two matrices */
     SUB_MAT,         /* Subtract two matrices */
     MUL_MAT,         /* Multiply two matrices */
     MUL_SCALAR,      /* Multiply a matrix by a scalar */
     TRANS_MAT,       /* Transpose a matrix */
+    DET_MAT,         /* Print the determinant of a matrix */
+    INV_MAT,         /* Invert a matrix */
+    SOLVE_MAT,       /* Solve a linear system */
+    CHOL_MAT,        /* Compute the Cholesky factor of a matrix */
+    QR_MAT,          /* Compute the QR factorization of a matrix */
+    LSTSQ_MAT,       /* Solve a linear least-squares problem */
+    EIG_SYM,         /* Compute the eigenvalues and eigenvectors of a symmetric matrix */
+    SVD_MAT,         /* Compute the singular value decomposition of a matrix */
+    NEW_MAT,         /* Define a new matrix */
+    SAVE_MAT,        /* Write a matrix to a binary file */
+    LOAD_MAT,        /* Map a matrix from a binary file */
+    EVAL,            /* Evaluate a matrix expression */
+    CACHE_STATS,     /* Print the counters of the result cache */
+    STATS,           /* Print the timing statistics of the instructions */
+    READ_BATCH,      /* Read a batch of 4x4 matrices from user input */
+    PRINT_BATCH,     /* Print a batch */
+    BMUL_MAT,        /* Multiply two batches matrix by matrix */
+    BMUL_SCALAR,     /* Multiply every matrix of a batch by a scalar */
+    BTRANS_MAT,      /* Transpose every matrix of a batch */
     NUM_COMMANDS     /* Sentinel value for the number of commands */
 } CommandType;
 
@@ -99,6 +159,7 @@ typedef struct {
     const char *commandDescription; /* Description of the command's purpose */
     const char *commandSyntax;      /* Syntax for using the command */
     int numMatrices;                /* Number of matrices needed */
+    bool batched;                   /* Whether the matrix arguments name batches rather than matrices */
 } CommandProfile;
 
 
@@ -106,7 +167,8 @@ typedef struct {
 typedef enum {
     FIRST_MATRIX,   /* First matrix in the command */
     SECOND_MATRIX,  /* Second matrix in the command */
-    THIRD_MATRIX    /* Third matrix in the command */
+    THIRD_MATRIX,   /* Third matrix in the command */
+    FOURTH_MATRIX   /* Fourth matrix in the command */
 } CommandMatrixArguments;
 
 /* Array of valid commands and their expected number of matrix arguments */
@@ -114,43 +176,143 @@ const CommandProfile validCommands[NUM_COMMANDS] = {
     {STOP, "stop", 
     "Description: Exit the application.", 
     "Syntax: stop",
-    0},
+    0, false},
     
     {READ_MAT, "read_mat", 
-    "Description: Read a matrix and store its values.",
-    "Syntax: read_mat <matrix_name>, <arg1>, <arg2>, ...",
-    1},
+    "Description: Read a matrix and store its values. An optional [<rows>x<cols>] suffix sets its shape.",
+    "Syntax: read_mat <matrix_name>[<rows>x<cols>], <arg1>, <arg2>, ...",
+    1, false},
+
+    {READ_SPARSE, "read_sparse",
+    "Description: Read a matrix as (row, column, value) triples, counted from 0; other elements are zero. An optional [<rows>x<cols>] suffix sets its shape.",
+    "Syntax: read_sparse <matrix_name>[<rows>x<cols>], <row1>, <col1>, <value1>, <row2>, ...",
+    1, false},
 
     {PRINT_MAT, "print_mat", 
     "Description: Print the contents of a matrix.",
     "Syntax: print_mat <matrix_name>",
-    1},
+    1, false},
 
     {ADD_MAT, "add_mat", 
     "Description: Add two matrices.",
     "Syntax: add_mat <matrix1_name>, <matrix2_name>, <result_matrix_name>", 
-    3},
+    3, false},
 
     {SUB_MAT, "sub_mat", 
     "Description: Subtract one matrix from another.",
     "Syntax: sub_mat <matrix1_name>, <matrix2_name>, <result_matrix_name>", 
-    3},
+    3, false},
 
     {MUL_MAT, "mul_mat", 
     "Description: Multiply two matrices.",
     "Syntax: mul_mat <matrix1_name>, <matrix2_name>, <result_matrix_name>", 
-    3},
+    3, false},
 
     {MUL_SCALAR, "mul_scalar", 
     "Description: Multiply a matrix by a scalar value.",
     "Syntax: mul_scalar <matrix_name>, <scalar>, <result_matrix_name>", 
-    2},
+    2, false},
 
 
     {TRANS_MAT, "trans_mat", 
     "Description: Transpose a matrix.",
     "Syntax: trans_mat <matrix_name>, <result_matrix_name>", 
-    2}
+    2, false},
+
+    {DET_MAT, "det_mat",
+    "Description: Print the determinant of a square matrix.",
+    "Syntax: det_mat <matrix_name>",
+    1, false},
+
+    {INV_MAT, "inv_mat",
+    "Description: Invert a square matrix.",
+    "Syntax: inv_mat <matrix_name>, <result_matrix_name>",
+    2, false},
+
+    {SOLVE_MAT, "solve_mat",
+    "Description: Solve A X = B for X, with one column of B per system. The factorization of A is kept, so solving again with the same A is fast. A symmetric A is factored in half the time.",
+    "Syntax: solve_mat <matrix_A_name>, <matrix_B_name>, <result_matrix_name>",
+    3, false},
+
+    {CHOL_MAT, "chol_mat",
+    "Description: Compute the lower triangular L with A = L L^T of a symmetric positive definite matrix.",
+    "Syntax: chol_mat <matrix_name>, <result_matrix_name>",
+    2, false},
+
+    {QR_MAT, "qr_mat",
+    "Description: Compute A = Q R, with Q of orthonormal columns and R upper triangular. Q has min(rows, cols) columns, so a tall A gets a Q of its own size.",
+    "Syntax: qr_mat <matrix_name>, <Q_matrix_name>, <R_matrix_name>",
+    3, false},
+
+    {LSTSQ_MAT, "lstsq_mat",
+    "Description: Compute the X minimizing ||A X - B|| for an A with at least as many rows as columns. A is read a block of rows at a time, so it may be far larger than memory.",
+    "Syntax: lstsq_mat <matrix_A_name>, <matrix_B_name>, <result_matrix_name>",
+    3, false},
+
+    {EIG_SYM, "eig_sym",
+    "Description: Compute the eigenvalues of a symmetric matrix, in ascending order as one column, and its orthonormal eigenvectors as the columns of a matrix in the same order.",
+    "Syntax: eig_sym <matrix_name>, <values_matrix_name>, <vectors_matrix_name>",
+    3, false},
+
+    {SVD_MAT, "svd_mat",
+    "Description: Compute A = U S V^T, with the singular values in descending order as one column and U and V of orthonormal columns, min(rows, cols) of each.",
+    "Syntax: svd_mat <matrix_name>, <U_matrix_name>, <S_matrix_name>, <V_matrix_name>",
+    4, false},
+
+    {NEW_MAT, "new_mat",
+    "Description: Define a matrix named by letters, digits and underscores, filled with zeros. An optional [<rows>x<cols>] suffix sets its shape (default 4x4); an existing matrix is reset.",
+    "Syntax: new_mat <matrix_name>[<rows>x<cols>]",
+    1, false},
+
+    {SAVE_MAT, "save_mat",
+    "Description: Save a matrix to a binary file. The path is the rest of the line.",
+    "Syntax: save_mat <matrix_name>, <file_path>",
+    1, false},
+
+    {LOAD_MAT, "load_mat",
+    "Description: Load a matrix saved with save_mat. The file is memory-mapped, not read, so loading is immediate at any size.",
+    "Syntax: load_mat <matrix_name>, <file_path>",
+    1, false},
+
+    {EVAL, "eval",
+    "Description: Evaluate an expression of matrices and scalars with +, -, *, ' (transpose) and parentheses in one pass, without intermediate matrices.",
+    "Syntax: eval <result_matrix_name> = <expression>",
+    1, false},
+
+    {CACHE_STATS, "cache_stats",
+    "Description: Print the hits, misses and size of the cache that lets repeated operations on unchanged matrices skip recomputation.",
+    "Syntax: cache_stats",
+    0, false},
+
+    {STATS, "stats",
+    "Description: Print the count, parse and execute time, latency histogram and bytes touched of every command run so far (needs --stats; --perf adds hardware counters).",
+    "Syntax: stats",
+    0, false},
+
+    {READ_BATCH, "read_batch",
+    "Description: Read a batch of 4x4 matrices, 16 row-major values per matrix. An optional [<count>] suffix sets the number of matrices.",
+    "Syntax: read_batch <batch_name>[<count>], <arg1>, <arg2>, ...",
+    1, true},
+
+    {PRINT_BATCH, "print_batch",
+    "Description: Print every matrix of a batch.",
+    "Syntax: print_batch <batch_name>",
+    1, true},
+
+    {BMUL_MAT, "bmul_mat",
+    "Description: Multiply two batches of the same size, matrix by matrix.",
+    "Syntax: bmul_mat <batch1_name>, <batch2_name>, <result_batch_name>",
+    3, true},
+
+    {BMUL_SCALAR, "bmul_scalar",
+    "Description: Multiply every matrix of a batch by a scalar value.",
+    "Syntax: bmul_scalar <batch_name>, <scalar>, <result_batch_name>",
+    2, true},
+
+    {BTRANS_MAT, "btrans_mat",
+    "Description: Transpose every matrix of a batch.",
+    "Syntax: btrans_mat <batch_name>, <result_batch_name>",
+    2, true}
 };
 
 
@@ -166,6 +328,11 @@ typedef enum {
     MISSING_COMMA,                      /* A required comma is missing in the instruction */
     MULTIPLE_CONSECUTIVE_COMMAS,        /* Multiple consecutive commas found in the instruction */
     ARGUMENT_NOT_SCALAR,                /* An argument in the instruction is not a scalar value */
+    INVALID_MATRIX_SHAPE,               /* A '[<rows>x<cols>]' shape suffix is malformed or out of range */
+    INVALID_MATRIX_NAME,                /* The name given to 'new_mat' is not an identifier */
+    OUT_OF_MEMORY,                      /* The instruction arguments could not be stored */
+    INVALID_EXPRESSION,                 /* The expression of 'eval' is malformed */
+    DUPLICATE_OUTPUT_MATRIX,            /* Two results of a factorization are written to the same matrix */
     NUM_ERRORS                          /* Sentinel value for the number of Errors */
 } InstructionError;
 
@@ -187,26 +354,149 @@ const InstructionErrorProfile InstructionErrors[NUM_ERRORS] = {
     {ILLEGAL_COMMA, "Illegal comma"},                                           /* An illegal comma was encountered in the instruction */
     {MISSING_COMMA, "Missing comma"},                                           /* A required comma is missing in the instruction */
     {MULTIPLE_CONSECUTIVE_COMMAS, "Multiple consecutive commas"},               /* Multiple consecutive commas found in the instruction */
-    {ARGUMENT_NOT_SCALAR, "Argument is not a scalar"}                           /* An argument in the instruction is not a scalar value */
+    {ARGUMENT_NOT_SCALAR, "Argument is not a scalar"},                          /* An argument in the instruction is not a scalar value */
+    {INVALID_MATRIX_SHAPE, "Invalid matrix shape"},                             /* A shape suffix is malformed or out of range */
+    {INVALID_MATRIX_NAME, "Invalid matrix name"},                               /* The name given to 'new_mat' is not an identifier */
+    {OUT_OF_MEMORY, "Out of memory"},                                           /* The instruction arguments could not be stored */
+    {INVALID_EXPRESSION, "Invalid expression"},                                 /* The expression of 'eval' is malformed */
+    {DUPLICATE_OUTPUT_MATRIX, "Duplicate output matrix"}                        /* Two results are written to the same matrix */
 };
 
 
+/* Initial number of values an ElementBuffer allocates room for */
+#define ELEMENT_BUFFER_INITIAL_CAPACITY 64
+
+/* Structure holding the values and optional shape parsed from a 'read_mat' or 'new_mat' instruction */
+typedef struct {
+    double *values;     /* Parsed element values, in row-major order */
+    size_t count;       /* Number of parsed values */
+    size_t capacity;    /* Number of values 'values' can hold before it has to grow */
+    int rows;           /* Requested number of rows, or 0 to keep the current shape */
+    int cols;           /* Requested number of columns, or 0 to keep the current shape */
+    size_t batchSize;   /* Requested number of matrices of a 'read_batch' batch, or 0 to keep it */
+} ElementBuffer;
+
+
+/* Record of a parsed instruction, filled by 'readInstruction' and executed by 'processInstruction' */
+typedef struct {
+    CommandType command;                        /* Command of the instruction */
+    MatrixHandle operands[MAX_INPUT_MATRICES];  /* Handles of the matrix arguments (BatchEnum values for batch commands) */
+    double scalar;                              /* Scalar argument of 'mul_scalar' and 'bmul_scalar' */
+    ElementBuffer elements;                     /* Values and shape of 'read_mat', 'new_mat' and 'read_batch' */
+    const char *path;                           /* File of 'save_mat' and 'load_mat', terminated in the line */
+    const char *name;                           /* Name 'new_mat' registers, in the line */
+    size_t nameLength;                          /* Length of 'name', without its shape suffix */
+    Expression expression;                      /* Expression tree of 'eval' */
+} Instruction;
+
+
+/* Function executing a parsed instruction on the context; one per command, indexed by CommandType */
+typedef MatrixStatus (*CommandHandler)(const Instruction *instruction, MatrixContext *ctx);
+
+
+/*
+ * Function: initLineReader
+ * Purpose: Prepares a LineReader on a file descriptor.
+ *
+ * Parameters:
+ *   reader - Pointer to the LineReader to prepare.
+ *   fd - File descriptor to read from.
+ *   echo - Whether 'readLine' prints every line back after the prompt.
+ *
+ * Returns:
+ *   true on success; false if the buffer could not be allocated.
+ */
+bool initLineReader(LineReader *reader, int fd, bool echo);
+
+
+/*
+ * Function: mapLineReader
+ * Purpose: Prepares a LineReader on a script file mapped into memory.
+ * Detailed Description:
+ *   The whole file is mapped privately with mmap(2), so lines are terminated in place in copy-on-write
+ *   pages and the file itself is never modified. No read(2) is made and no line is copied, except a
+ *   last line without a newline that ends exactly on a page boundary. The reader neither prompts nor
+ *   echoes, as nothing is typed at a terminal.
+ *
+ * Parameters:
+ *   reader - Pointer to the LineReader to prepare.
+ *   path - Path of the script file.
+ *
+ * Returns:
+ *   true on success; false if the file could not be opened or mapped, with 'errno' describing why.
+ */
+bool mapLineReader(LineReader *reader, const char *path);
+
+
 /*
  * Function: readLine
- * Purpose: Reads a line of text from standard input into a buffer.
+ * Purpose: Returns the next line of input.
  * Detailed Description:
- *   This function reads characters from standard input (usually the console) until it encounters
- *   a newline character ('\n') or EOF (End Of File). It stores the characters in a provided buffer,
- *   ensuring not to exceed the buffer's capacity. The function null-terminates the string in the buffer
- *   and also handles the case where the buffer pointer is NULL.
+ *   This function prints the '>> ' prompt (unless the reader is a mapped script) and returns the characters up to the next newline character
+ *   ('\n') or EOF (End Of File). Input is read with read(2) in blocks of at least LINE_READER_BLOCK / 2 bytes
+ *   into a buffer that doubles whenever a line does not fit, so lines have no length limit and no call is
+ *   made per character. The newline is replaced by a null character in the buffer itself and the line is
+ *   returned in place; it stays valid until the next call. If the reader echoes, the line is printed back
+ *   so that the output of redirected input shows the instructions. Standard output is flushed before the
+ *   reader blocks on more input, so the prompt is visible in interactive use.
+ *
+ *   If the buffer cannot grow, the error is reported and the input is treated as ended.
  *
  * Parameters:
- *   buffer - Pointer to a character array where the input line will be stored.
+ *   reader - Pointer to the LineReader to read from.
+ *   line - Receives a pointer to the null-terminated line.
  *
  * Returns:
  *   true if EOF is encountered; false otherwise.
  */
-bool readLine(char *buffer);
+bool readLine(LineReader *reader, char **line);
+
+
+/*
+ * Function: freeLineReader
+ * Purpose: Releases the buffer or the mapping of a LineReader.
+ *
+ * Parameters:
+ *   reader - Pointer to the LineReader to release.
+ *
+ * Returns: None (void function).
+ */
+void freeLineReader(LineReader *reader);
+
+
+/*
+ * Function: parseOptions
+ * Purpose: Parses the command-line options of the program.
+ * Detailed Description:
+ *   Recognized options:
+ *     --threads N              Run the matrix kernels on N threads (default: MATRIX_THREADS or the number of processors).
+ *     --multiply ALGORITHM     Force the 'mul_mat' algorithm: auto (default), classic or strassen.
+ *     --strassen-cutoff N      Smallest dimension above which Strassen-Winograd is used (default: STRASSEN_DEFAULT_CUTOFF).
+ *     --no-echo                Do not print input lines back, e.g. when a terminal already shows them.
+ *     --full-precision         Print elements with 17 significant digits instead of two decimals.
+ *     --csv                    Print the rows of matrices as comma-separated values.
+ *     --print-edge N           Summarize matrices longer or wider than 2N to their first and last N rows and columns.
+ *     --verify-loads           Check the checksum of the elements of every file loaded with 'load_mat'.
+ *     --memory-budget MIB      Store matrices larger than MIB MiB on disk (default: MATRIX_MEMORY_BUDGET or half the memory).
+ *     --cache-limit MIB        Let the result cache copy up to MIB MiB of results, and keep as many MiB of
+ *                              factorizations (default: 64; 0 disables both caches).
+ *     --stats                  Time every instruction for the 'stats' command.
+ *     --stats-dump FILE        Time every instruction and write the statistics to FILE when the program exits.
+ *     --perf                   Count cycles, instructions and cache and branch misses of every kernel call by command.
+ *     --sparse-threshold F     Store matrices with at most a share F of non-zero elements sparse (default: 0.05; 0 disables).
+ *     --batch FILE...          Run the script files instead of standard input; every argument after it is a file.
+ *   Options that are not recognized, or that lack a valid value, make the function print a usage message.
+ *
+ * Parameters:
+ *   argc - Number of command-line arguments.
+ *   argv - Command-line arguments.
+ *   options - Pointer to the ProgramOptions structure receiving the parsed options.
+ *
+ * Returns:
+ *   true if every argument was understood; false otherwise.
+ */
+bool parseOptions(int argc, char *argv[], ProgramOptions *options);
+
 
 /*
  * Function: print_intro
@@ -258,26 +548,6 @@ void print_outro();
 bool isEmptyLine(const char *buffer);
 
 
-/*
- * Function: isValidCommand
- * Purpose: Checks if a given string is a valid command.
- * Detailed Description:
- *   This function iterates through a predefined list of valid commands and compares each
- *   with the provided string (command). If a match is found, it returns true, indicating
- *   the command is valid. If no match is found after checking all the predefined commands,
- *   it returns false, indicating the command is invalid. The function assumes that the list
- *   of valid commands is stored in an array validCommands and that NUM_COMMANDS accurately
- *   represents the number of valid commands.
- *
- * Parameters:
- *   command - Pointer to a character array (string) representing the command to be validated.
- *
- * Returns:
- *   true if the command is valid; false otherwise.
- */
-bool isValidCommand(const char *command);
-
-
 /*
  * Function: readAndProcessInstructions
  * Purpose: Reads and processes user instructions for matrix operations.
@@ -288,109 +558,197 @@ bool isValidCommand(const char *command);
  *   The function assumes that the provided MatrixContext (ctx) is properly initialized and ready for
  *   matrix operations.
  *
+ *   With '--stats', reading every line, parsing and executing every instruction are timed with a
+ *   monotonic clock and recorded by command in "matstats.h", along with the bytes of the matrices the
+ *   instruction names. Without it no clock is read.
+ *
  * Parameters:
  *   ctx - Pointer to the MatrixContext structure containing matrix data and profiles.
+ *   reader - Pointer to the LineReader the instructions are read from.
  *
  * Returns:
  *   true if the 'stop' command is processed; false if EOF is reached without encountering 'stop'.
  */
-bool readAndProcessInstructions(MatrixContext *ctx);
+bool readAndProcessInstructions(MatrixContext *ctx, LineReader *reader);
+
+
+/*
+ * Function: appendElement
+ * Purpose: Appends a value to an ElementBuffer, doubling its capacity when it is full.
+ *
+ * Parameters:
+ *   elements - Pointer to the ElementBuffer to append to.
+ *   value - The value to append.
+ *
+ * Returns:
+ *   true on success; false if the buffer could not grow.
+ */
+bool appendElement(ElementBuffer *elements, double value);
+
+
+/*
+ * Function: freeElementBuffer
+ * Purpose: Releases the storage of an ElementBuffer and leaves it empty.
+ *
+ * Parameters:
+ *   elements - Pointer to the ElementBuffer to release.
+ *
+ * Returns: None (void function).
+ */
+void freeElementBuffer(ElementBuffer *elements);
 
 
 /*
  * Function: processInstruction
- * Purpose: Processes a matrix operation command and executes the corresponding action.
+ * Purpose: Executes a parsed instruction.
  * Detailed Description:
- *   This function takes a command string and processes it by executing the corresponding matrix operation.
- *   It identifies the command type and matrix names involved, then performs the operation specified by the 
- *   command. Operations include reading, printing, and various arithmetic operations on matrices.
+ *   This function performs the operation of an instruction record filled by 'readInstruction' on the
+ *   matrices whose handles it resolved. The command indexes a table of handlers, one per CommandType,
+ *   so executing an instruction costs one indirect call. Operations include reading, printing, and
+ *   various arithmetic operations on matrices. If the operation fails, for example because the operand
+ *   shapes do not match, an error message is printed.
+ *
+ *   The matrix an instruction writes gets a new version. Arithmetic instructions are first looked up
+ *   in the result cache of the context by the versions of their operands (see "matcache.h"), so an
+ *   instruction repeated on unchanged matrices is answered without being computed again.
+ *
+ *   With '--perf', the hardware counters of "matperf.h" are read around the call of the handler and
+ *   added to the command.
  *
- *   The function assumes that the command and matrix names are valid, and that the matrix elements and scalar
- *   values provided are correct for the operation. It handles different commands through a switch statement,
- *   calling appropriate functions for each command.
+ *   The function assumes that the instruction was parsed without error.
  *
  * Parameters:
- *   command - Pointer to a string representing the command to be processed.
- *   matrixNames - Array of strings representing the names of matrices involved in the operation.
- *   matrix_elements - Array of doubles representing matrix elements (for reading matrix data).
- *   scalar - Pointer to a double representing a scalar value (for scalar multiplication).
+ *   instruction - Pointer to the parsed instruction.
  *   ctx - Pointer to the MatrixContext structure containing matrix data.
  *
  * Returns:
  *   true if the command is STOP; false otherwise.
  */
-bool processInstruction(const char *command, 
-                        char matrixNames[MAX_INPUT_MATRICES][MAX_MATRIX_NAME_LENGTH], 
-                        double matrix_elements[ROWS * COLS], 
-                        double *scalar,
-                        MatrixContext *ctx);
+bool processInstruction(const Instruction *instruction, MatrixContext *ctx);
 
 
 /*
- * Function: commandTypeReturn
- * Purpose: Determines the CommandType of a given command string.
+ * Function: findCommand
+ * Purpose: Determines the CommandType of a command name.
  * Detailed Description:
- *   This function searches through a list of valid commands and matches the provided command string.
- *   If a match is found, it returns the CommandType (typically an enum or integer representing the command).
- *   If the command is not found, it prints an error message and returns a special value (-1 in this case),
- *   indicating that the command is invalid or not found.
- *
- *   The function assumes that validCommands is an array of structures containing command names and their
- *   corresponding CommandType, and that NUM_COMMANDS accurately represents the number of available commands.
+ *   This function compares the name with the names in validCommands, checking the length first,
+ *   so a name is matched without being copied or null-terminated.
  *
  * Parameters:
- *   command - Pointer to a character array (string) representing the command whose CommandType is to be determined.
+ *   name - Pointer to the first character of the command name.
+ *   length - Number of characters in the name.
  *
  * Returns:
  *   CommandType corresponding to the command if found; -1 if the command is not found.
  */
-CommandType commandTypeReturn(const char *command);
+CommandType findCommand(const char *name, size_t length);
 
 
 /*
  * Function: readCommand
  * Purpose: Reads and validates a command from a string.
  * Detailed Description:
- *   This function extracts a command from the provided string, skipping leading white spaces.
- *   It reads characters until it encounters a space, a null character, or a comma, indicating the end of the command.
- *   After reading the command, it checks its validity. If the command is not valid, it returns an error.
- *   If the command is valid but followed directly by a comma, it also returns an error.
+ *   This function finds the command at the start of the provided string, skipping leading white spaces.
+ *   The command ends at a space, a null character, or a comma, and is looked up in place. If the command
+ *   is not valid, it returns an error. If the command is valid but followed directly by a comma, it also
+ *   returns an error.
  *
  * Parameters:
  *   charPtr - Pointer to a pointer to the string from which the command is read.
- *   command - Pointer to a character array where the read command will be stored.
+ *   command - Pointer to the CommandType receiving the command.
  *
  * Returns:
  *   NO_ERROR if the command is read and validated successfully,
  *   UNDEFINED_COMMAND_NAME if the command is not valid,
  *   ILLEGAL_COMMA if a comma is improperly placed after the command.
  */
-InstructionError readCommand(char **charPtr, char *command);
+InstructionError readCommand(char **charPtr, CommandType *command);
 
 
 /*
  * Function: readInstruction
  * Purpose: Parses and validates a matrix operation instruction from a string.
  * Detailed Description:
- *   This function takes a line of text and extracts the command, matrix names, scalar value, and matrix elements
- *   based on the command type. It handles different commands and checks for various errors like invalid matrix names,
+ *   This function takes a line of text and, in a single pass over it, fills an instruction record with the
+ *   command, matrix handles, scalar value, and matrix elements based on the command type. It handles different commands and checks for various errors like invalid matrix names,
  *   incorrect argument types, missing commas, and more. The function uses a state machine approach for parsing,
  *   transitioning between different states based on the input received and the command being processed.
  *
+ *   The command, every matrix name and every number is read in place, without being copied: names are replaced
+ *   by their handles and numbers converted straight from the line. The name of a 'new_mat' instruction is only
+ *   checked and kept in the record; it is registered when the instruction runs. The element buffer of the record
+ *   keeps its storage from one instruction to the next.
+ *
  * Parameters:
  *   line - Pointer to a string containing the instruction to be parsed.
- *   command - Pointer to a char array where the parsed command will be stored.
- *   matrixNames - 2D array of chars to store the names of matrices involved in the operation.
- *   matrix_elements - Array of doubles to store matrix elements if needed for the command.
- *   scalar - Pointer to a double to store the scalar value if needed for the command.
+ *   instruction - Pointer to the instruction record to fill.
  *   ctx - Pointer to the MatrixContext structure containing matrix data and profiles.
  *
  * Returns:
  *   An InstructionError enum indicating the status of the instruction reading process.
  */
-InstructionError readInstruction(char *line, 
-                                 char *command, 
-                                 char matrixNames[MAX_INPUT_MATRICES][MAX_MATRIX_NAME_LENGTH], 
-                                 double matrix_elements[ROWS * COLS], 
-                                 double *scalar, 
-                                 MatrixContext *ctx);
\ No newline at end of file
+InstructionError readInstruction(char *line, Instruction *instruction, MatrixContext *ctx);
+
+
+/*
+ * Function: readMatrixShape
+ * Purpose: Parses the optional shape suffix of a matrix name in a 'read_mat' instruction.
+ * Detailed Description:
+ *   The text between 'start' and 'end' must have the form '[<rows>x<cols>]' where both dimensions
+ *   are positive decimal integers. On success the dimensions are stored in the ElementBuffer.
+ *
+ * Parameters:
+ *   start - Pointer to the opening bracket of the suffix.
+ *   end - Pointer one past the last character of the suffix.
+ *   elements - Pointer to the ElementBuffer receiving the shape.
+ *
+ * Returns:
+ *   NO_ERROR if the shape is well formed, INVALID_MATRIX_SHAPE otherwise.
+ */
+InstructionError readMatrixShape(const char *start, const char *end, ElementBuffer *elements);
+
+
+/*
+ * Function: readBatchSize
+ * Purpose: Parses the optional size suffix of a batch name in a 'read_batch' instruction.
+ * Detailed Description:
+ *   The text between 'start' and 'end' must have the form '[<count>]' where the count is a positive
+ *   decimal integer. On success the count is stored in the ElementBuffer.
+ *
+ * Parameters:
+ *   start - Pointer to the opening bracket of the suffix.
+ *   end - Pointer one past the last character of the suffix.
+ *   elements - Pointer to the ElementBuffer receiving the count.
+ *
+ * Returns:
+ *   NO_ERROR if the count is well formed, INVALID_MATRIX_SHAPE otherwise.
+ */
+InstructionError readBatchSize(const char *start, const char *end, ElementBuffer *elements);
+
+
+/*
+ * Function: readExpression
+ * Purpose: Parses the expression of an 'eval' instruction into an expression tree.
+ * Detailed Description:
+ *   The expression is read in one pass by recursive descent, with the tokens of the other instructions:
+ *   matrix names are looked up in place and numbers converted where they stand. From the lowest
+ *   precedence to the highest:
+ *     sum      = product { ('+' | '-') product }
+ *     product  = unary { '*' unary }
+ *     unary    = { '-' } postfix
+ *     postfix  = primary { "'" }
+ *     primary  = <matrix_name> | <number> | '(' sum ')'
+ *   Products of a scalar and a matrix scale the matrix, products of two matrices multiply them, and
+ *   operations on scalars alone are computed while parsing. The whole expression must be a matrix, and
+ *   scalars cannot be added to matrices.
+ *
+ * Parameters:
+ *   text - The expression, up to the end of the line.
+ *   expr - Pointer to the Expression receiving the tree; its previous nodes are discarded.
+ *   ctx - Pointer to the MatrixContext the names are looked up in.
+ *
+ * Returns:
+ *   NO_ERROR on success, MISSING_ARGUMENT for an empty expression, UNDEFINED_MATRIX_NAME for an unknown
+ *   name, OUT_OF_MEMORY if the tree could not grow, INVALID_EXPRESSION for anything else.
+ */
+InstructionError readExpression(const char *text, Expression *expr, const MatrixContext *ctx);
\ No newline at end of file
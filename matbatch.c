@@ -0,0 +1,401 @@
+/*
+ * Batched 4x4 Matrix Engine
+ * -------------------------
+ * This C source file implements the batched transform engine declared in "matbatch.h".
+ *
+ * Core Functionalities:
+ * 1.   resizeBatch / freeBatch:        Manage the aligned group storage of a batch.
+ * 2.   readBatch / printBatch:         Convert between row-major values and the interleaved layout.
+ * 3.   getBatchEnumByName:             Looks batches up by name in the context.
+ * 4.   multiplyGroups* / transposeGroups*:     Group kernels; a scalar variant and, on x86, SSE2, AVX2 and
+ *                                              AVX-512 variants compiled from one vector body.
+ * 5.   multiplyBatches / transposeBatch / multiplyBatchScalar: Entry points; pick the kernel of the
+ *                                              selected SIMD level and split the groups across the pool.
+ *
+ * The vector kernels use a GCC vector as wide as one register of their instruction set as element type,
+ * so one operation on it covers the same element of 8 (AVX-512), 4 (AVX2) or 2 (SSE2) matrices; a group
+ * is processed in as many such slices as it takes. Each slice is computed into a local tile of registers
+ * before it is stored, so a result may be the same batch as an operand.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "matbatch.h"
+#include "matsimd.h"
+#include "matpool.h"
+#include "matfmt.h"
+
+
+/* Number of doubles in one group of a batch */
+#define GROUP_SIZE (BATCH_ELEMENTS * BATCH_LANES)
+
+/* Largest number of groups a batch may hold */
+#define MAX_BATCH_GROUPS ((size_t)-1 / (GROUP_SIZE * sizeof(double)))
+
+/* Kernel computing result = a * b for 'groups' consecutive groups */
+typedef void (*BatchMultiplyKernel)(const double *a, const double *b, double *result, size_t groups);
+
+/* Kernel computing result = transpose(a) for 'groups' consecutive groups */
+typedef void (*BatchTransposeKernel)(const double *a, double *result, size_t groups);
+
+/* Kernels of one SIMD level */
+typedef struct {
+    BatchMultiplyKernel multiply;   /* Group-wise product */
+    BatchTransposeKernel transpose; /* Group-wise transpose */
+} BatchKernels;
+
+/* Enumeration of the operations a BatchTask can run */
+typedef enum {
+    BATCH_MULTIPLY,     /* result = batch1 * batch2 */
+    BATCH_TRANSPOSE,    /* result = transpose(batch1) */
+    BATCH_SCALE         /* result = scalar * batch1 */
+} BatchOperation;
+
+/* Operands of a batch operation split across the thread pool by groups */
+typedef struct {
+    BatchOperation operation;       /* Operation to run */
+    const BatchKernels *kernels;    /* Kernels of the selected SIMD level */
+    const double *a;                /* First operand */
+    const double *b;                /* Second operand (multiply only) */
+    double *result;                 /* Result */
+    double scalar;                  /* Scale factor (scale only) */
+} BatchTask;
+
+
+static void multiplyGroupsScalar(const double *a, const double *b, double *result, size_t groups) {
+    /*
+     * Short Description:
+     * Plain C product of every matrix of the groups, one lane at a time.
+     */
+    double tile[GROUP_SIZE];    /* Products of the current group */
+    size_t group;               /* Index of the current group */
+    int row, col, inner, lane;  /* Element and lane indices */
+    double sum;                 /* Running dot product */
+
+    for (group = 0; group < groups; ++group, a += GROUP_SIZE, b += GROUP_SIZE, result += GROUP_SIZE) {
+        for (lane = 0; lane < BATCH_LANES; ++lane) {
+            for (row = 0; row < BATCH_DIM; ++row) {
+                for (col = 0; col < BATCH_DIM; ++col) {
+                    sum = 0.0;
+                    for (inner = 0; inner < BATCH_DIM; ++inner) {
+                        sum += a[(row * BATCH_DIM + inner) * BATCH_LANES + lane]
+                             * b[(inner * BATCH_DIM + col) * BATCH_LANES + lane];
+                    }
+                    tile[(row * BATCH_DIM + col) * BATCH_LANES + lane] = sum;
+                }
+            }
+        }
+        memcpy(result, tile, sizeof(tile));
+    }
+}
+
+
+static void transposeGroupsScalar(const double *a, double *result, size_t groups) {
+    /*
+     * Short Description:
+     * Plain C transpose of every matrix of the groups.
+     */
+    double tile[GROUP_SIZE];    /* Transposes of the current group */
+    size_t group;               /* Index of the current group */
+    int row, col, lane;         /* Element and lane indices */
+
+    for (group = 0; group < groups; ++group, a += GROUP_SIZE, result += GROUP_SIZE) {
+        for (row = 0; row < BATCH_DIM; ++row) {
+            for (col = 0; col < BATCH_DIM; ++col) {
+                for (lane = 0; lane < BATCH_LANES; ++lane) {
+                    tile[(col * BATCH_DIM + row) * BATCH_LANES + lane] = a[(row * BATCH_DIM + col) * BATCH_LANES + lane];
+                }
+            }
+        }
+        memcpy(result, tile, sizeof(tile));
+    }
+}
+
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/*
+ * Defines the vector multiply and transpose group kernels for one instruction set.
+ * 'name' is the kernel name suffix, 'isa' the target attribute string and 'width' the number of
+ * doubles in one register; each group is processed as BATCH_LANES / 'width' slices of registers.
+ */
+#define DEFINE_BATCH_KERNELS(name, isa, width)                                          \
+typedef double BatchVector##name __attribute__((vector_size((width) * sizeof(double)), may_alias)); \
+                                                                                        \
+__attribute__((target(isa)))                                                            \
+static void multiplyGroups##name(const double *a, const double *b, double *result, size_t groups) { \
+    BatchVector##name tile[BATCH_ELEMENTS]; /* Products of the current slice */         \
+    const double *sliceA, *sliceB;      /* Current slice of the operands */             \
+    double *sliceResult;                /* Current slice of the result */               \
+    size_t group;                       /* Index of the current group */                \
+    int slice, row, col, inner;         /* Slice and element indices */                 \
+    for (group = 0; group < groups; ++group) {                                          \
+        for (slice = 0; slice < BATCH_LANES; slice += (width)) {                        \
+            sliceA = a + group * GROUP_SIZE + slice;                                    \
+            sliceB = b + group * GROUP_SIZE + slice;                                    \
+            sliceResult = result + group * GROUP_SIZE + slice;                          \
+            for (row = 0; row < BATCH_DIM; ++row) {                                     \
+                for (col = 0; col < BATCH_DIM; ++col) {                                 \
+                    tile[row * BATCH_DIM + col] =                                       \
+                        *(const BatchVector##name *)(sliceA + row * BATCH_DIM * BATCH_LANES) \
+                        * *(const BatchVector##name *)(sliceB + col * BATCH_LANES);     \
+                    for (inner = 1; inner < BATCH_DIM; ++inner) {                       \
+                        tile[row * BATCH_DIM + col] +=                                  \
+                            *(const BatchVector##name *)(sliceA + (row * BATCH_DIM + inner) * BATCH_LANES) \
+                            * *(const BatchVector##name *)(sliceB + (inner * BATCH_DIM + col) * BATCH_LANES); \
+                    }                                                                   \
+                }                                                                       \
+            }                                                                           \
+            for (row = 0; row < BATCH_ELEMENTS; ++row) {                                \
+                *(BatchVector##name *)(sliceResult + row * BATCH_LANES) = tile[row];    \
+            }                                                                           \
+        }                                                                               \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+__attribute__((target(isa)))                                                            \
+static void transposeGroups##name(const double *a, double *result, size_t groups) {     \
+    BatchVector##name tile[BATCH_ELEMENTS]; /* Transposes of the current slice */       \
+    const double *sliceA;               /* Current slice of the operand */              \
+    double *sliceResult;                /* Current slice of the result */               \
+    size_t group;                       /* Index of the current group */                \
+    int slice, row, col;                /* Slice and element indices */                 \
+    for (group = 0; group < groups; ++group) {                                          \
+        for (slice = 0; slice < BATCH_LANES; slice += (width)) {                        \
+            sliceA = a + group * GROUP_SIZE + slice;                                    \
+            sliceResult = result + group * GROUP_SIZE + slice;                          \
+            for (row = 0; row < BATCH_DIM; ++row) {                                     \
+                for (col = 0; col < BATCH_DIM; ++col) {                                 \
+                    tile[col * BATCH_DIM + row] =                                       \
+                        *(const BatchVector##name *)(sliceA + (row * BATCH_DIM + col) * BATCH_LANES); \
+                }                                                                       \
+            }                                                                           \
+            for (row = 0; row < BATCH_ELEMENTS; ++row) {                                \
+                *(BatchVector##name *)(sliceResult + row * BATCH_LANES) = tile[row];    \
+            }                                                                           \
+        }                                                                               \
+    }                                                                                   \
+}
+
+DEFINE_BATCH_KERNELS(Sse2, "sse2", 2)
+DEFINE_BATCH_KERNELS(Avx2, "avx2", 4)
+DEFINE_BATCH_KERNELS(Avx512, "avx512f", 8)
+
+#endif
+
+
+/* Kernel tables, indexed by SimdLevel; levels unavailable on this architecture fall back to scalar */
+static const BatchKernels batchKernelTables[NUM_SIMD_LEVELS] = {
+    {multiplyGroupsScalar, transposeGroupsScalar},
+#if defined(__x86_64__) || defined(__i386__)
+    {multiplyGroupsSse2, transposeGroupsSse2},
+    {multiplyGroupsAvx2, transposeGroupsAvx2},
+    {multiplyGroupsAvx512, transposeGroupsAvx512}
+#else
+    {multiplyGroupsScalar, transposeGroupsScalar},
+    {multiplyGroupsScalar, transposeGroupsScalar},
+    {multiplyGroupsScalar, transposeGroupsScalar}
+#endif
+};
+
+
+MatrixStatus resizeBatch(MatrixBatch *batch, size_t count) {
+    /*
+     * Short Description:
+     * Grows the group storage if needed, records the count and clears the padding lanes.
+     */
+    size_t groups = (count + BATCH_LANES - 1) / BATCH_LANES;   /* Groups needed for 'count' matrices */
+    size_t padding;         /* Index of the current padding lane */
+    int element;            /* Index of the current element */
+    double *data;           /* Newly allocated storage */
+
+    if (count == 0 || groups > MAX_BATCH_GROUPS) {
+        return MATRIX_INVALID_DIMENSIONS;
+    }
+    if (groups > batch->capacity) {
+        data = allocElements(groups * GROUP_SIZE);
+        if (data == NULL) {
+            return MATRIX_ALLOCATION_FAILED;
+        }
+        free(batch->data);
+        batch->data = data;
+        batch->capacity = groups;
+    }
+    batch->count = count;
+
+    for (padding = count; padding < groups * BATCH_LANES; ++padding) {
+        for (element = 0; element < BATCH_ELEMENTS; ++element) {
+            BATCH_AT(batch, padding, element / BATCH_DIM, element % BATCH_DIM) = 0.0;
+        }
+    }
+    return MATRIX_OK;
+}
+
+
+void freeBatch(MatrixBatch *batch) {
+    free(batch->data);
+    batch->data = NULL;
+    batch->count = 0;
+    batch->capacity = 0;
+}
+
+
+MatrixStatus readBatch(MatrixBatch *batch, size_t count, const double *values, size_t valueCount) {
+    /*
+     * Short Description:
+     * Scatters the row-major values of each matrix into its lane, padding with zeros.
+     */
+    size_t index;       /* Index of the current matrix */
+    size_t position;    /* Index of the current value */
+    int element;        /* Index of the current element within the matrix */
+    MatrixStatus status;
+
+    if (count > 0) {
+        status = resizeBatch(batch, count);
+        if (status != MATRIX_OK) {
+            return status;
+        }
+    }
+
+    for (index = 0; index < batch->count; ++index) {
+        for (element = 0; element < BATCH_ELEMENTS; ++element) {
+            position = index * BATCH_ELEMENTS + (size_t)element;
+            BATCH_AT(batch, index, element / BATCH_DIM, element % BATCH_DIM) =
+                (position < valueCount) ? values[position] : 0.0;
+        }
+    }
+    return MATRIX_OK;
+}
+
+
+void printBatch(const MatrixBatch *batch) {
+    /*
+     * Short Description:
+     * Prints each matrix under its index, in the same format as 'printMatrix'.
+     */
+    size_t index;                       /* Index of the current matrix */
+    int row, column;                    /* Variables for row and column indices */
+    double elements[BATCH_ELEMENTS];    /* Current matrix, gathered in row-major order */
+
+    for (index = 0; index < batch->count; ++index) {
+        printf("[%lu]\n", (unsigned long)index);
+        for (row = 0; row < BATCH_DIM; ++row) {
+            for (column = 0; column < BATCH_DIM; ++column) {
+                elements[row * BATCH_DIM + column] = BATCH_AT(batch, index, row, column);
+            }
+        }
+        printElements(elements, BATCH_DIM, BATCH_DIM, BATCH_DIM);
+    }
+}
+
+
+BatchEnum getBatchEnumByName(const char *batchName, size_t length, const MatrixContext *ctx) {
+    /*
+     * Short Description:
+     * Finds and returns the enum value of a batch based on its name, or -1 if it is not found.
+     */
+    BatchEnum batch;    /* Variable for iterating over batch profiles */
+
+    for (batch = 0; batch < NUM_BATCHES; ++batch) {
+        if (!strncmp(ctx->batchProfiles[batch].nameString, batchName, length) &&
+            ctx->batchProfiles[batch].nameString[length] == '\0') {
+            return ctx->batchProfiles[batch].name;
+        }
+    }
+    return -1;
+}
+
+
+static void runBatchTask(size_t begin, size_t end, int worker, void *arg) {
+    /*
+     * Short Description:
+     * Runs the task's operation on the groups [begin, end).
+     */
+    const BatchTask *task = arg;
+    size_t offset = begin * GROUP_SIZE;     /* First double of the share */
+    (void)worker;
+
+    switch (task->operation) {
+        case BATCH_MULTIPLY:
+            task->kernels->multiply(task->a + offset, task->b + offset, task->result + offset, end - begin);
+            break;
+        case BATCH_TRANSPOSE:
+            task->kernels->transpose(task->a + offset, task->result + offset, end - begin);
+            break;
+        case BATCH_SCALE:
+            getSimdKernels()->scale(task->a + offset, task->scalar, task->result + offset,
+                                    (end - begin) * GROUP_SIZE);
+            break;
+    }
+}
+
+
+static void runBatchOperation(BatchTask *task, const MatrixBatch *result) {
+    /*
+     * Short Description:
+     * Selects the kernels of the current SIMD level and splits the groups of 'result' across the pool.
+     */
+    size_t groups = (result->count + BATCH_LANES - 1) / BATCH_LANES;   /* Groups holding matrices */
+
+    task->kernels = &batchKernelTables[getSimdLevel()];
+    parallelFor(groups, PARALLEL_MIN_ELEMENTS / GROUP_SIZE, runBatchTask, task);
+}
+
+
+MatrixStatus multiplyBatches(const MatrixBatch *batch1, const MatrixBatch *batch2, MatrixBatch *result) {
+    BatchTask task;         /* Operands of the product */
+    MatrixStatus status;
+
+    if (batch1->count != batch2->count) {
+        return MATRIX_DIMENSION_MISMATCH;
+    }
+    status = resizeBatch(result, batch1->count);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    task.operation = BATCH_MULTIPLY;
+    task.a = batch1->data;
+    task.b = batch2->data;
+    task.result = result->data;
+    runBatchOperation(&task, result);
+    return MATRIX_OK;
+}
+
+
+MatrixStatus transposeBatch(const MatrixBatch *batch, MatrixBatch *result) {
+    BatchTask task;         /* Operand of the transpose */
+    MatrixStatus status;
+
+    status = resizeBatch(result, batch->count);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    task.operation = BATCH_TRANSPOSE;
+    task.a = batch->data;
+    task.result = result->data;
+    runBatchOperation(&task, result);
+    return MATRIX_OK;
+}
+
+
+MatrixStatus multiplyBatchScalar(const MatrixBatch *batch, double scalar, MatrixBatch *result) {
+    BatchTask task;         /* Operand of the scaling */
+    MatrixStatus status;
+
+    status = resizeBatch(result, batch->count);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    task.operation = BATCH_SCALE;
+    task.a = batch->data;
+    task.result = result->data;
+    task.scalar = scalar;
+    runBatchOperation(&task, result);
+    return MATRIX_OK;
+}
@@ -0,0 +1,156 @@
+/*
+ * Batched 4x4 Matrix Header
+ * -------------------------
+ * This C header file declares the batched transform engine implemented in "matbatch.c". A MatrixBatch
+ * (defined in "mymat.h") holds any number of BATCH_DIM x BATCH_DIM matrices, the size of graphics and
+ * robotics transforms, in an array-of-structures-of-arrays layout: matrices are grouped BATCH_LANES
+ * at a time and each element of a group is one contiguous vector of BATCH_LANES doubles.
+ *
+ * Core Functions:
+ * - resizeBatch:           Sets the number of matrices of a batch, growing its storage when needed.
+ * - freeBatch:             Releases the storage of a batch.
+ * - readBatch:             Fills a batch from row-major values, matrix after matrix.
+ * - printBatch:            Prints every matrix of a batch.
+ * - getBatchEnumByName:    Retrieves the enum value of a batch based on its name.
+ * - multiplyBatches:       Multiplies two batches matrix by matrix.
+ * - transposeBatch:        Transposes every matrix of a batch.
+ * - multiplyBatchScalar:   Scales every matrix of a batch.
+ *
+ * Note:
+ * In this layout an operation on a whole group is the scalar algorithm written with vectors, so one
+ * instruction processes the same step for 8 matrices (AVX-512), 4 (AVX2) or 2 (SSE2) at once, and the
+ * cost of dispatching an operation is paid once per batch. The kernel variant follows the level chosen
+ * in "matsimd.h". Large batches are split by groups across the thread pool.
+ */
+
+#ifndef MATBATCH_H
+#define MATBATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "mymat.h"
+
+
+/*
+ * Function: resizeBatch
+ * Purpose: Sets the number of matrices of a batch.
+ * Detailed Description:
+ *   Storage is reallocated only when the batch needs more groups than it has; the contents are
+ *   not preserved in that case. The padding lanes of the last group are cleared.
+ *
+ * Parameters:
+ *   batch - Pointer to the batch to resize.
+ *   count - New number of matrices; must be positive.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_INVALID_DIMENSIONS if 'count' is zero or too large,
+ *   MATRIX_ALLOCATION_FAILED if the storage could not be allocated.
+ */
+MatrixStatus resizeBatch(MatrixBatch *batch, size_t count);
+
+
+/*
+ * Function: freeBatch
+ * Purpose: Releases the storage of a batch and leaves it empty.
+ *
+ * Parameters:
+ *   batch - Pointer to the batch to release.
+ *
+ * Returns: None (void function).
+ */
+void freeBatch(MatrixBatch *batch);
+
+
+/*
+ * Function: readBatch
+ * Purpose: Fills a batch from an array of values.
+ * Detailed Description:
+ *   The values are the BATCH_ELEMENTS row-major elements of the first matrix, then of the second,
+ *   and so on. If 'count' is positive the batch is resized to 'count' matrices first; a 'count' of 0
+ *   keeps the current size. Missing values are set to zero and extra values are ignored, as in
+ *   'readMatrix'.
+ *
+ * Parameters:
+ *   batch - Pointer to the batch to fill.
+ *   count - Number of matrices, or 0 to keep the current number.
+ *   values - Array of values; may be NULL when 'valueCount' is 0.
+ *   valueCount - Number of values in the array.
+ *
+ * Returns:
+ *   MATRIX_OK on success, or the status of 'resizeBatch'.
+ */
+MatrixStatus readBatch(MatrixBatch *batch, size_t count, const double *values, size_t valueCount);
+
+
+/*
+ * Function: printBatch
+ * Purpose: Prints every matrix of a batch, each under a '[<index>]' header line.
+ *
+ * Parameters:
+ *   batch - Pointer to the batch to print.
+ *
+ * Returns: None (void function).
+ */
+void printBatch(const MatrixBatch *batch);
+
+
+/*
+ * Function: getBatchEnumByName
+ * Purpose: Retrieves the enum value of a batch based on its name.
+ *
+ * Parameters:
+ *   batchName - The name of the batch; it need not be null-terminated.
+ *   length - Number of characters in 'batchName'.
+ *   ctx - Pointer to the MatrixContext structure containing the batch profiles.
+ *
+ * Returns:
+ *   The BatchEnum of the batch, or -1 if the name is not found.
+ */
+BatchEnum getBatchEnumByName(const char *batchName, size_t length, const MatrixContext *ctx);
+
+
+/*
+ * Function: multiplyBatches
+ * Purpose: Computes result[i] = batch1[i] * batch2[i] for every matrix of the batches.
+ *
+ * Parameters:
+ *   batch1 - Pointer to the batch of left operands.
+ *   batch2 - Pointer to the batch of right operands.
+ *   result - Pointer to the batch receiving the products; may be either operand.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_DIMENSION_MISMATCH if the batches hold different numbers of
+ *   matrices, MATRIX_ALLOCATION_FAILED if the result could not be allocated.
+ */
+MatrixStatus multiplyBatches(const MatrixBatch *batch1, const MatrixBatch *batch2, MatrixBatch *result);
+
+
+/*
+ * Function: transposeBatch
+ * Purpose: Computes result[i] = transpose(batch[i]) for every matrix of the batch.
+ *
+ * Parameters:
+ *   batch - Pointer to the batch to transpose.
+ *   result - Pointer to the batch receiving the transposes; may be 'batch' itself.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the result could not be allocated.
+ */
+MatrixStatus transposeBatch(const MatrixBatch *batch, MatrixBatch *result);
+
+
+/*
+ * Function: multiplyBatchScalar
+ * Purpose: Computes result[i] = scalar * batch[i] for every matrix of the batch.
+ *
+ * Parameters:
+ *   batch - Pointer to the batch to scale.
+ *   scalar - The scale factor.
+ *   result - Pointer to the batch receiving the scaled matrices; may be 'batch' itself.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the result could not be allocated.
+ */
+MatrixStatus multiplyBatchScalar(const MatrixBatch *batch, double scalar, MatrixBatch *result);
+
+#endif /* MATBATCH_H */
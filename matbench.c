@@ -0,0 +1,932 @@
+/*
+ * Microbenchmark Driver Source File
+ * ---------------------------------
+ * This C source file implements the benchmark driver declared in "matbench.h". It links against every
+ * module of the calculator except "mainmat.c" and times the library functions directly, without parsing.
+ *
+ * Implemented Functions:
+ * - main:              Runs every selected kernel at every size and prints the report.
+ * - parseBenchOptions: Parses the command-line options.
+ * - prepareOperands:   Fills the operands of one size with values from a fixed-seed generator.
+ * - run*:              One call of each kernel, gathered with its work model in 'benchKernels'.
+ * - *Work:             Operations and traffic of the sparse products, from their stored elements.
+ * - runBenchmark:      Warms a kernel up, calibrates the calls per sample and takes the samples.
+ * - printBenchTable / writeBenchJson:
+ *                      Report the results.
+ *
+ * Usage:
+ *   make bench                                 Builds 'matbench' and runs the default sweep.
+ *   ./matbench --sizes 512,2048 --kernel mul_mat --json before.json
+ *
+ * Note:
+ * Times come from CLOCK_MONOTONIC. The thread pool, SIMD level and multiplication algorithm are set up
+ * as in "mainmat.c", and the JSON report records them so that results of different builds or machines
+ * are only compared like with like.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include "mymat.h"
+#include "matsimd.h"
+#include "matpool.h"
+#include "matstrassen.h"
+#include "matbatch.h"
+#include "matexpr.h"
+#include "matlu.h"
+#include "matchol.h"
+#include "matqr.h"
+#include "mateig.h"
+#include "matsparse.h"
+#include "matdisk.h"
+#include "matreg.h"
+#include "matbench.h"
+
+
+/* Names of the matrices of the benchmark context, by handle */
+static const char *const benchMatrices[] = {"A", "B", "C", "SAVED", "SPD", "SA", "SB", "X", "DA", "DB", "DC", "T",
+                                            "Y"};
+
+/* Profiles of the batches of the benchmark context */
+static const BatchProfile benchBatches[NUM_BATCHES] = {
+    {BAT_A, "BAT_A"},
+    {BAT_B, "BAT_B"},
+    {BAT_C, "BAT_C"},
+    {BAT_D, "BAT_D"}
+};
+
+/* Sizes swept when '--sizes' is not given; 8 takes the size-specialized kernels of "matsmall.h" */
+static const int defaultSizes[] = {8, 64, 256, 1024};
+
+
+static MatrixStatus runAdd(BenchOperands *ops) {
+    return addMatrices(ops->a, ops->b, ops->c);
+}
+
+
+static MatrixStatus runSub(BenchOperands *ops) {
+    return subMatrices(ops->a, ops->b, ops->c);
+}
+
+
+static MatrixStatus runMul(BenchOperands *ops) {
+    return multiplyMatrices(ops->a, ops->b, ops->c);
+}
+
+
+static MatrixStatus runMulInPlace(BenchOperands *ops) {
+    return multiplyMatricesInPlace(ops->a, ops->b, ops->a);
+}
+
+
+static MatrixStatus runScalar(BenchOperands *ops) {
+    return multiplyScalar(ops->a, 1.5, ops->c);
+}
+
+
+static MatrixStatus runTrans(BenchOperands *ops) {
+    return transposeMatrix(ops->a, ops->c);
+}
+
+
+static MatrixStatus runTransInPlace(BenchOperands *ops) {
+    return transposeMatrixInPlace(ops->a);
+}
+
+
+static MatrixStatus runCopy(BenchOperands *ops) {
+    return copyMatrix(ops->a, ops->c);
+}
+
+
+static MatrixStatus runEval(BenchOperands *ops) {
+    return evaluateExpression(&ops->expr, &ops->ctx, 2);
+}
+
+
+static MatrixStatus runFactor(const Matrix *mat, FactorKind kind) {
+    /*
+     * Short Description:
+     * Copies the matrix into the buffer a factorization takes over, as "matfactor.c" does, factors it and
+     * releases the factors at once.
+     */
+    Factorization factors;  /* Factors of the matrix */
+    double *elements = allocElements((size_t)mat->rows * (size_t)mat->cols);   /* Copy factored in place */
+    MatrixStatus status;
+
+    if (elements == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    status = exportMatrix(mat, elements, (size_t)mat->cols);
+    if (status != MATRIX_OK) {
+        free(elements);
+        return status;
+    }
+    status = (kind == FACTOR_LU) ? factorLU(elements, mat->rows, &factors)
+                                 : factorCholesky(elements, mat->rows, &factors);
+    if (status == MATRIX_OK) {
+        free(factors.elements);
+        free(factors.pivots);
+    }
+    return status;
+}
+
+
+static MatrixStatus runLU(BenchOperands *ops) {
+    return runFactor(ops->a, FACTOR_LU);
+}
+
+
+static MatrixStatus runCholesky(BenchOperands *ops) {
+    return runFactor(ops->spd, FACTOR_CHOLESKY);
+}
+
+
+static MatrixStatus runQR(BenchOperands *ops) {
+    /*
+     * Short Description:
+     * Computes the reflectors and R of a copy of A, as 'qr_mat' does before it forms Q.
+     */
+    int n = ops->a->rows;   /* Order of the matrix */
+    double *elements = allocElements((size_t)n * (size_t)n);    /* Copy factored in place */
+    double *t = allocElements((size_t)n * QR_BLOCK);            /* Triangular factors of the panels */
+    MatrixStatus status = MATRIX_ALLOCATION_FAILED;
+
+    if (elements != NULL && t != NULL) {
+        status = exportMatrix(ops->a, elements, (size_t)n);
+    }
+    if (status == MATRIX_OK) {
+        status = factorQR(elements, n, n, n, n, t);
+    }
+    free(elements);
+    free(t);
+    return status;
+}
+
+
+static MatrixStatus runEigen(BenchOperands *ops) {
+    /* The eigenvectors are stored over the eigenvalues */
+    return eigenSymmetricMatrix(ops->spd, ops->c, ops->c);
+}
+
+
+static MatrixStatus runSvd(BenchOperands *ops) {
+    /* V is stored over U and the singular values */
+    return svdMatrix(ops->a, ops->c, ops->c, ops->c);
+}
+
+
+static MatrixStatus runDet(BenchOperands *ops) {
+    double det;     /* Determinant of A */
+
+    return determinantMatrix(&ops->ctx, 0, &det);
+}
+
+
+static MatrixStatus runInv(BenchOperands *ops) {
+    /* A is handle 0 and C handle 2 */
+    return invertMatrix(&ops->ctx, 0, 2);
+}
+
+
+static MatrixStatus runSolve(BenchOperands *ops) {
+    /* A X = B, A being handle 0, B handle 1 and C, receiving X, handle 2 */
+    return solveMatrix(&ops->ctx, 0, 1, 2);
+}
+
+
+static MatrixStatus runLstsq(BenchOperands *ops) {
+    return leastSquaresMatrix(ops->tall, ops->tallRhs, ops->c);
+}
+
+
+static MatrixStatus runDiskKernel(BenchOperands *ops, bool product) {
+    /*
+     * Short Description:
+     * Runs the tiled sum or product of DA and DB under the budget of the tiled kernels, then lifts the
+     * budget again for the kernels in memory.
+     */
+    MatrixStatus status;
+
+    initMemoryBudget(ops->diskBudget);
+    status = product ? multiplyMatrices(ops->diskA, ops->diskB, ops->diskC)
+                     : addMatrices(ops->diskA, ops->diskB, ops->diskC);
+    initMemoryBudget((size_t)-1);
+    return status;
+}
+
+
+static MatrixStatus runDiskAdd(BenchOperands *ops) {
+    return runDiskKernel(ops, false);
+}
+
+
+static MatrixStatus runDiskMul(BenchOperands *ops) {
+    return runDiskKernel(ops, true);
+}
+
+
+static MatrixStatus runBatchMul(BenchOperands *ops) {
+    return multiplyBatches(ops->batchA, ops->batchB, ops->batchC);
+}
+
+
+static MatrixStatus runBatchScalar(BenchOperands *ops) {
+    return multiplyBatchScalar(ops->batchA, 1.5, ops->batchC);
+}
+
+
+static MatrixStatus runBatchTrans(BenchOperands *ops) {
+    return transposeBatch(ops->batchA, ops->batchC);
+}
+
+
+static MatrixStatus runSpmv(BenchOperands *ops) {
+    return multiplyMatrices(ops->sparseA, ops->vector, ops->c);
+}
+
+
+static MatrixStatus runSpmm(BenchOperands *ops) {
+    return multiplyMatrices(ops->sparseA, ops->b, ops->c);
+}
+
+
+static MatrixStatus runSpgemm(BenchOperands *ops) {
+    return multiplyMatrices(ops->sparseA, ops->sparseB, ops->c);
+}
+
+
+static MatrixStatus runSparseAdd(BenchOperands *ops) {
+    return addMatrices(ops->sparseA, ops->sparseB, ops->c);
+}
+
+
+static MatrixStatus runSparseSub(BenchOperands *ops) {
+    return subMatrices(ops->sparseA, ops->sparseB, ops->c);
+}
+
+
+static MatrixStatus runSparseScale(BenchOperands *ops) {
+    return multiplyScalar(ops->sparseA, 1.5, ops->c);
+}
+
+
+static MatrixStatus runSparseTrans(BenchOperands *ops) {
+    return transposeMatrix(ops->sparseA, ops->c);
+}
+
+
+static double matrixBytes(const Matrix *mat, size_t nonzeros) {
+    /*
+     * Short Description:
+     * Returns the bytes of a matrix with the given non-zero elements as it is stored: the value and column
+     * of every element and the row starts when it is sparse, every element when it is dense.
+     */
+    if (mat->sparse == NULL) {
+        return (double)mat->rows * (double)mat->cols * sizeof(double);
+    }
+    return (double)nonzeros * (sizeof(double) + sizeof(int)) + (double)(mat->rows + 1) * sizeof(size_t);
+}
+
+
+static void spmvWork(const BenchOperands *ops, double *flops, double *bytes) {
+    /* A multiply-add per stored element; the vector is read and the result written once */
+    *flops = 2.0 * (double)ops->nonzeros[0];
+    *bytes = matrixBytes(ops->sparseA, ops->nonzeros[0]) + 2.0 * ops->n * sizeof(double);
+}
+
+
+static void spmmWork(const BenchOperands *ops, double *flops, double *bytes) {
+    /* A multiply-add per stored element and per column of B */
+    *flops = 2.0 * (double)ops->nonzeros[0] * ops->n;
+    *bytes = matrixBytes(ops->sparseA, ops->nonzeros[0]) + 2.0 * ops->n * ops->n * sizeof(double);
+}
+
+
+static double resultBytes(const BenchOperands *ops) {
+    return matrixBytes(ops->c, (ops->c->sparse != NULL) ? countStored(ops->c->sparse) : 0);
+}
+
+
+static void sparseAddWork(const BenchOperands *ops, double *flops, double *bytes) {
+    /* At most one operation per stored element of either operand, as the rows are merged */
+    *flops = (double)(ops->nonzeros[0] + ops->nonzeros[1]);
+    *bytes = matrixBytes(ops->sparseA, ops->nonzeros[0]) + matrixBytes(ops->sparseB, ops->nonzeros[1]) +
+             resultBytes(ops);
+}
+
+
+static void sparseScaleWork(const BenchOperands *ops, double *flops, double *bytes) {
+    *flops = (double)ops->nonzeros[0];
+    *bytes = matrixBytes(ops->sparseA, ops->nonzeros[0]) + resultBytes(ops);
+}
+
+
+static void sparseTransWork(const BenchOperands *ops, double *flops, double *bytes) {
+    *flops = 0.0;
+    *bytes = matrixBytes(ops->sparseA, ops->nonzeros[0]) + resultBytes(ops);
+}
+
+
+static void detWork(const BenchOperands *ops, double *flops, double *bytes) {
+    /* The product of the n pivots, read from the cached factors */
+    *flops = (double)ops->n;
+    *bytes = (double)ops->n * sizeof(double);
+}
+
+
+static void lstsqWork(const BenchOperands *ops, double *flops, double *bytes) {
+    /*
+     * Householder QR of the m x n operand costs 2mn^2 - 2n^3/3; the right-hand side and the stacked
+     * triangles of the reduction add lower-order terms, which are not counted. T and Y are read once.
+     */
+    double m = (double)ops->tall->rows;     /* Rows of T */
+    double n = (double)ops->n;              /* Columns of T */
+
+    *flops = 2.0 * m * n * n - 2.0 * n * n * n / 3.0;
+    *bytes = (m * n + m + n) * sizeof(double);
+}
+
+
+static void spgemmWork(const BenchOperands *ops, double *flops, double *bytes) {
+    /*
+     * Every stored element of SA meets the row of SB it picks, which holds nonzeros(SB)/n elements for
+     * uniformly placed elements. The result is counted as it is stored after the call.
+     */
+    *flops = 2.0 * (double)ops->nonzeros[0] * (double)ops->nonzeros[1] / ops->n;
+    *bytes = matrixBytes(ops->sparseA, ops->nonzeros[0]) + matrixBytes(ops->sparseB, ops->nonzeros[1]) +
+             resultBytes(ops);
+}
+
+
+/*
+ * Kernels in report order, named after the commands that call them. A batch holds n*n/16 matrices of
+ * 4x4, as many elements as one n x n matrix, and a product of two 4x4 matrices costs 8 operations per
+ * element. A product counts its three matrices as traffic although blocking reads the operands more, and an
+ * LU factorization (2n^3/3 operations), Cholesky factorization (n^3/3) or QR factorization (4n^3/3) its one
+ * matrix. The decompositions with vectors count the nominal 9n^3 (symmetric QR) and 21n^3 (Golub-Reinsch SVD)
+ * of Golub and Van Loan, and their operand and vectors. With the factors of A cached, the inverse and the
+ * solve against B run 2n^3 operations of triangular solves. The tiled sum and product of DA and DB count
+ * their matrices once although tiles may be read again. The least squares of T and Y, the sparse operations
+ * on SA and SB and the sparse products of SA by the vector X (SpMV), by B (SpMM) and by SB (SpGEMM) count
+ * their actual operands and stored elements instead (see the *Work functions).
+ */
+static const BenchKernel benchKernels[] = {
+    {"add_mat",         runAdd,             1.0, 0.0, 3, false, NULL},
+    {"sub_mat",         runSub,             1.0, 0.0, 3, false, NULL},
+    {"mul_mat",         runMul,             0.0, 2.0, 3, false, NULL},
+    {"mul_mat_inplace", runMulInPlace,      0.0, 2.0, 3, true, NULL},
+    {"mul_scalar",      runScalar,          1.0, 0.0, 2, false, NULL},
+    {"trans_mat",       runTrans,           0.0, 0.0, 2, false, NULL},
+    {"trans_inplace",   runTransInPlace,    0.0, 0.0, 2, false, NULL},
+    {"copy_mat",        runCopy,            0.0, 0.0, 2, false, NULL},
+    {"eval_2a_plus_b",  runEval,            2.0, 0.0, 3, false, NULL},
+    {"lu_factor",       runLU,              0.0, 2.0 / 3.0, 1, false, NULL},
+    {"chol_factor",     runCholesky,        0.0, 1.0 / 3.0, 1, false, NULL},
+    {"qr_factor",       runQR,              0.0, 4.0 / 3.0, 1, false, NULL},
+    {"eig_sym",         runEigen,           0.0, 9.0, 2, false, NULL},
+    {"svd_mat",         runSvd,             0.0, 21.0, 3, false, NULL},
+    {"det_mat",         runDet,             0.0, 0.0, 0, false, detWork},
+    {"inv_mat",         runInv,             0.0, 2.0, 2, false, NULL},
+    {"solve_mat",       runSolve,           0.0, 2.0, 3, false, NULL},
+    {"lstsq_mat",       runLstsq,           0.0, 0.0, 0, false, lstsqWork},
+    {"add_mat_disk",    runDiskAdd,         1.0, 0.0, 3, false, NULL},
+    {"mul_mat_disk",    runDiskMul,         0.0, 2.0, 3, false, NULL},
+    {"bmul_mat",        runBatchMul,        8.0, 0.0, 3, false, NULL},
+    {"bmul_scalar",     runBatchScalar,     1.0, 0.0, 2, false, NULL},
+    {"btrans_mat",      runBatchTrans,      0.0, 0.0, 2, false, NULL},
+    {"sp_add",          runSparseAdd,       0.0, 0.0, 0, false, sparseAddWork},
+    {"sp_sub",          runSparseSub,       0.0, 0.0, 0, false, sparseAddWork},
+    {"sp_scalar",       runSparseScale,     0.0, 0.0, 0, false, sparseScaleWork},
+    {"sp_trans",        runSparseTrans,     0.0, 0.0, 0, false, sparseTransWork},
+    {"spmv",            runSpmv,            0.0, 0.0, 0, false, spmvWork},
+    {"spmm",            runSpmm,            0.0, 0.0, 0, false, spmmWork},
+    {"spgemm",          runSpgemm,          0.0, 0.0, 0, false, spgemmWork}
+};
+
+/* Number of entries in 'benchKernels' */
+#define NUM_BENCH_KERNELS ((int)(sizeof(benchKernels) / sizeof(benchKernels[0])))
+
+
+static double now(void) {
+    /*
+     * Short Description:
+     * Returns the time of the monotonic clock in seconds.
+     */
+    struct timespec ts;     /* Time of the clock */
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+
+static int compareDoubles(const void *left, const void *right) {
+    double a = *(const double *)left;   /* First value */
+    double b = *(const double *)right;  /* Second value */
+
+    return (a > b) - (a < b);
+}
+
+
+static bool isSelected(const char *list, const char *name) {
+    /*
+     * Short Description:
+     * Tells whether 'name' appears in a comma-separated list; every name is selected without a list.
+     */
+    size_t length = strlen(name);   /* Length of the name */
+    const char *item;               /* Current item of the list */
+    size_t itemLength;              /* Length of the current item */
+
+    if (list == NULL) {
+        return true;
+    }
+    for (item = list; *item != '\0'; item += itemLength + (item[itemLength] == ',')) {
+        itemLength = strcspn(item, ",");
+        if (itemLength == length && !strncmp(item, name, length)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static const char *findUnknownKernel(const char *list, size_t *length) {
+    /*
+     * Short Description:
+     * Returns the first item of a comma-separated list that names no kernel, with its length, or NULL if
+     * every item names one. An empty list, or an empty item, names none.
+     */
+    const char *item;   /* Current item of the list */
+    int kernel_idx;     /* Index for iterating over the kernels */
+
+    if (list == NULL) {
+        return NULL;
+    }
+    item = list;
+    do {
+        *length = strcspn(item, ",");
+        for (kernel_idx = 0; kernel_idx < NUM_BENCH_KERNELS; ++kernel_idx) {
+            if (strlen(benchKernels[kernel_idx].name) == *length &&
+                !strncmp(item, benchKernels[kernel_idx].name, *length)) {
+                break;
+            }
+        }
+        if (kernel_idx == NUM_BENCH_KERNELS) {
+            return item;
+        }
+        item += *length + (item[*length] == ',');
+    } while (*item != '\0');
+    return NULL;
+}
+
+
+static void printUsage(const char *program) {
+    printf("Usage: %s [--sizes N,N,...] [--reps N] [--warmup N] [--threads N]"
+           " [--multiply auto|classic|strassen] [--density F] [--kernel NAME,NAME,...] [--json FILE]\n", program);
+}
+
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;           /* Parsed command-line options */
+    BenchOperands ops;              /* Operands shared by the kernels */
+    BenchResult *results;           /* Results in measurement order */
+    double *samples;                /* Scratch array of the samples of one case */
+    int count = 0;                  /* Results measured */
+    int size_idx;                   /* Index for iterating over the sizes */
+    int kernel_idx;                 /* Index for iterating over the kernels */
+    MatrixStatus status;            /* Status of the last step */
+    FILE *json;                     /* Stream of the JSON report */
+    int exitCode = EXIT_SUCCESS;    /* Status returned to the shell */
+
+    if (!parseBenchOptions(argc, argv, &options)) {
+        return EXIT_FAILURE;
+    }
+
+    initSimdKernels();
+    initThreadPool(options.threads);
+    setMultiplyAlgorithm(options.multiply);
+    setSparseThreshold(options.density);
+    initMemoryBudget((size_t)-1);   /* Only the tiled kernels lower it */
+
+    results = malloc((size_t)options.sizeCount * NUM_BENCH_KERNELS * sizeof(*results));
+    samples = malloc((size_t)options.reps * sizeof(*samples));
+    memset(&ops, 0, sizeof(ops));
+    ops.density = options.density;
+    initExpression(&ops.expr);
+    status = initMatrices(&ops.ctx, benchMatrices, (int)(sizeof(benchMatrices) / sizeof(benchMatrices[0])),
+                          benchBatches);
+    ops.ctx.factors = createFactorCache();
+    if (ops.ctx.factors == NULL) {
+        status = MATRIX_ALLOCATION_FAILED;
+    }
+    /* expr = 2*A + B, A and B being handles 0 and 1 */
+    if (status == MATRIX_OK && (addExprNode(&ops.expr, EXPR_MATRIX, -1, -1, 0, 0.0) < 0 ||
+                                addExprNode(&ops.expr, EXPR_SCALE, 0, -1, NO_MATRIX, 2.0) < 0 ||
+                                addExprNode(&ops.expr, EXPR_MATRIX, -1, -1, 1, 0.0) < 0 ||
+                                addExprNode(&ops.expr, EXPR_ADD, 1, 2, NO_MATRIX, 0.0) < 0)) {
+        status = MATRIX_ALLOCATION_FAILED;
+    }
+    if (results == NULL || samples == NULL) {
+        status = MATRIX_ALLOCATION_FAILED;
+    }
+
+    printf("SIMD level: %s, threads: %d, multiply: %s, sparse density: %g, %d samples after %d warmup calls\n\n",
+           getSimdKernels()->levelName, getThreadCount(), MultiplyAlgorithms[options.multiply].algorithmName,
+           options.density, options.reps, options.warmup);
+    for (size_idx = 0; size_idx < options.sizeCount && status == MATRIX_OK; ++size_idx) {
+        status = prepareOperands(&ops, options.sizes[size_idx]);
+        for (kernel_idx = 0; kernel_idx < NUM_BENCH_KERNELS && status == MATRIX_OK; ++kernel_idx) {
+            if (!isSelected(options.kernels, benchKernels[kernel_idx].name)) {
+                continue;
+            }
+            status = runBenchmark(&benchKernels[kernel_idx], &ops, &options, samples, &results[count]);
+            if (status == MATRIX_OK) {
+                count++;
+            } else {
+                printf("Error: %s failed at n = %d: %s\n", benchKernels[kernel_idx].name,
+                       options.sizes[size_idx], MatrixStatuses[status].statusName);
+            }
+        }
+    }
+    if (status != MATRIX_OK) {
+        printf("Error: %s\n", MatrixStatuses[status].statusName);
+        exitCode = EXIT_FAILURE;
+    }
+
+    printBenchTable(results, count);
+    if (options.jsonPath != NULL) {
+        json = fopen(options.jsonPath, "w");
+        if (json == NULL) {
+            printf("Error: Cannot write '%s'\n", options.jsonPath);
+            exitCode = EXIT_FAILURE;
+        } else {
+            writeBenchJson(json, results, count, &options);
+            if (fclose(json) != 0) {
+                printf("Error: Cannot write '%s'\n", options.jsonPath);
+                exitCode = EXIT_FAILURE;
+            }
+        }
+    }
+
+    freeExpression(&ops.expr);
+    freeFactorCache(ops.ctx.factors);
+    freeMatrices(&ops.ctx);
+    free(samples);
+    free(results);
+    shutdownThreadPool();
+    return exitCode;
+}
+
+
+bool parseBenchOptions(int argc, char *argv[], BenchOptions *options) {
+    int arg_index;          /* Index for iterating over the arguments */
+    int algorithm;          /* Index for iterating over the multiplication algorithms */
+    char *end;              /* End of the parsed numeric value */
+    long value;             /* Parsed numeric value */
+    double density;         /* Parsed share of non-zero elements */
+    const char *unknown;    /* Item of '--kernel' naming no kernel */
+    size_t length;          /* Length of that item */
+
+    /* Defaults */
+    memcpy(options->sizes, defaultSizes, sizeof(defaultSizes));
+    options->sizeCount = (int)(sizeof(defaultSizes) / sizeof(defaultSizes[0]));
+    options->reps = BENCH_DEFAULT_REPS;
+    options->warmup = BENCH_DEFAULT_WARMUP;
+    options->threads = 0;
+    options->multiply = MULTIPLY_AUTO;
+    options->density = BENCH_DEFAULT_DENSITY;
+    options->kernels = NULL;
+    options->jsonPath = NULL;
+
+    for (arg_index = 1; arg_index < argc; arg_index++) {
+        if (!strcmp(argv[arg_index], "--sizes") && arg_index + 1 < argc) {
+            end = argv[++arg_index];
+            options->sizeCount = 0;
+            do {
+                value = strtol(end + (*end == ','), &end, 10);
+                if (value < 1 || value > 1L << 15 || options->sizeCount == BENCH_MAX_SIZES ||
+                    (*end != ',' && *end != '\0')) {
+                    printf("Error: --sizes expects at most %d positive numbers separated by commas\n",
+                           BENCH_MAX_SIZES);
+                    return false;
+                }
+                options->sizes[options->sizeCount++] = (int)value;
+            } while (*end != '\0');
+        } else if (!strcmp(argv[arg_index], "--reps") && arg_index + 1 < argc) {
+            value = strtol(argv[++arg_index], &end, 10);
+            if (*end != '\0' || value < 1 || value > INT_MAX) {
+                printf("Error: --reps expects a positive number\n");
+                return false;
+            }
+            options->reps = (int)value;
+        } else if (!strcmp(argv[arg_index], "--warmup") && arg_index + 1 < argc) {
+            value = strtol(argv[++arg_index], &end, 10);
+            if (*end != '\0' || value < 0 || value > INT_MAX) {
+                printf("Error: --warmup expects a non-negative number\n");
+                return false;
+            }
+            options->warmup = (int)value;
+        } else if (!strcmp(argv[arg_index], "--threads") && arg_index + 1 < argc) {
+            value = strtol(argv[++arg_index], &end, 10);
+            if (*end != '\0' || value < 1 || value > MAX_POOL_THREADS) {
+                printf("Error: --threads expects a number between 1 and %d\n", MAX_POOL_THREADS);
+                return false;
+            }
+            options->threads = (int)value;
+        } else if (!strcmp(argv[arg_index], "--multiply") && arg_index + 1 < argc) {
+            arg_index++;
+            for (algorithm = 0; algorithm < NUM_MULTIPLY_ALGORITHMS; algorithm++) {
+                if (!strcmp(argv[arg_index], MultiplyAlgorithms[algorithm].algorithmName)) {
+                    break;
+                }
+            }
+            if (algorithm == NUM_MULTIPLY_ALGORITHMS) {
+                printf("Error: --multiply expects auto, classic or strassen\n");
+                return false;
+            }
+            options->multiply = MultiplyAlgorithms[algorithm].algorithm;
+        } else if (!strcmp(argv[arg_index], "--density") && arg_index + 1 < argc) {
+            density = strtod(argv[++arg_index], &end);
+            if (*end != '\0' || end == argv[arg_index] || !(density > 0.0 && density <= 1.0)) {
+                printf("Error: --density expects a share above 0 and at most 1\n");
+                return false;
+            }
+            options->density = density;
+        } else if (!strcmp(argv[arg_index], "--kernel") && arg_index + 1 < argc) {
+            options->kernels = argv[++arg_index];
+        } else if (!strcmp(argv[arg_index], "--json") && arg_index + 1 < argc) {
+            options->jsonPath = argv[++arg_index];
+        } else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    /* A misspelled kernel would otherwise leave a comparison without the kernel it was run for */
+    unknown = findUnknownKernel(options->kernels, &length);
+    if (unknown != NULL) {
+        printf("Error: --kernel names no kernel '%.*s'\n", (int)length, unknown);
+        printUsage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+
+MatrixStatus prepareOperands(BenchOperands *ops, int n) {
+    /*
+     * Short Description:
+     * Sizes every operand for n and fills A, B and the batches from a linear congruential generator, so
+     * the values do not depend on the C library; the result matrices are sized by the kernels themselves.
+     * SPD is A + A^T + 2n I, whose diagonal dominates its rows, so it is positive definite. SA and SB
+     * get exactly density * n*n non-zero values in [-1, 1], so they stay within the sparse threshold, and
+     * are built by 'readMatrix', which packs them without keeping the dense buffer.
+     */
+    unsigned long state = BENCH_SEED;   /* State of the generator */
+    double *values;                     /* Dense values of a sparse operand */
+    size_t elements;                    /* Elements of a sparse operand */
+    size_t wanted;                      /* Non-zero elements of a sparse operand */
+    int tallRows;                       /* Rows of T */
+    size_t count;                       /* Matrices of a batch */
+    size_t index;                       /* Index for iterating over the elements */
+    int matrix_idx;                     /* Index for iterating over the filled matrices */
+    int row, col;                       /* Variables for iterating over the elements of a matrix */
+    MatrixStatus status = MATRIX_OK;    /* Status of the last allocation */
+    Matrix *filled[2];                  /* Matrices receiving values */
+    Matrix *sparse[2];                  /* Sparse operands */
+    MatrixBatch *batches[2];            /* Batches receiving values */
+
+    ops->n = n;
+    ops->a = &ops->ctx.matrices[0];
+    ops->b = &ops->ctx.matrices[1];
+    ops->c = &ops->ctx.matrices[2];
+    ops->saved = &ops->ctx.matrices[3];
+    ops->spd = &ops->ctx.matrices[4];
+    ops->sparseA = &ops->ctx.matrices[5];
+    ops->sparseB = &ops->ctx.matrices[6];
+    ops->vector = &ops->ctx.matrices[7];
+    ops->diskA = &ops->ctx.matrices[8];
+    ops->diskB = &ops->ctx.matrices[9];
+    ops->diskC = &ops->ctx.matrices[10];
+    ops->tall = &ops->ctx.matrices[11];
+    ops->tallRhs = &ops->ctx.matrices[12];
+    ops->diskBudget = (size_t)n * (size_t)n * sizeof(double) / 2;
+    ops->batchA = &ops->ctx.batches[BAT_A];
+    ops->batchB = &ops->ctx.batches[BAT_B];
+    ops->batchC = &ops->ctx.batches[BAT_C];
+    filled[0] = ops->a;
+    filled[1] = ops->b;
+    batches[0] = ops->batchA;
+    batches[1] = ops->batchB;
+    sparse[0] = ops->sparseA;
+    sparse[1] = ops->sparseB;
+    count = (size_t)n * (size_t)n / BATCH_ELEMENTS;
+    if (count == 0) {
+        count = 1;
+    }
+
+    for (matrix_idx = 0; matrix_idx < 2 && status == MATRIX_OK; ++matrix_idx) {
+        status = resizeMatrix(filled[matrix_idx], n, n);
+        for (row = 0; row < n && status == MATRIX_OK; ++row) {
+            for (col = 0; col < n; ++col) {
+                state = (state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+                MATRIX_AT(filled[matrix_idx], row, col) = (double)state / (double)0x3fffffffUL - 1.0;
+            }
+        }
+        if (status == MATRIX_OK) {
+            status = resizeBatch(batches[matrix_idx], count);
+        }
+        for (index = 0; index < count * BATCH_ELEMENTS && status == MATRIX_OK; ++index) {
+            state = (state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+            BATCH_AT(batches[matrix_idx], index / BATCH_ELEMENTS, index % BATCH_ELEMENTS / BATCH_DIM,
+                     index % BATCH_DIM) = (double)state / (double)0x3fffffffUL - 1.0;
+        }
+    }
+    if (status == MATRIX_OK) {
+        status = copyMatrix(ops->a, ops->saved);
+    }
+    if (status == MATRIX_OK) {
+        status = resizeMatrix(ops->spd, n, n);
+    }
+    for (row = 0; row < n && status == MATRIX_OK; ++row) {
+        for (col = 0; col < n; ++col) {
+            MATRIX_AT(ops->spd, row, col) = MATRIX_AT(ops->a, row, col) + MATRIX_AT(ops->a, col, row)
+                                            + ((row == col) ? 2.0 * n : 0.0);
+        }
+    }
+
+    values = (status == MATRIX_OK) ? allocElements((size_t)n * (size_t)n) : NULL;
+    if (status == MATRIX_OK && values == NULL) {
+        status = MATRIX_ALLOCATION_FAILED;
+    }
+    for (matrix_idx = 0; matrix_idx < 2 && status == MATRIX_OK; ++matrix_idx) {
+        /* Selection sampling: every element is kept with probability (still to keep) / (still to visit) */
+        elements = (size_t)n * (size_t)n;
+        wanted = (size_t)(ops->density * (double)elements);
+        ops->nonzeros[matrix_idx] = 0;
+        for (index = 0; index < elements; ++index) {
+            state = (state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+            values[index] = 0.0;
+            if ((double)state / (double)0x80000000UL * (double)(elements - index) <
+                (double)(wanted - ops->nonzeros[matrix_idx])) {
+                state = (state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+                values[index] = ((state & 1UL) ? 1.0 : -1.0) * ((double)(state >> 1) + 1.0) / (double)0x40000000UL;
+                ops->nonzeros[matrix_idx]++;
+            }
+        }
+        status = readMatrix(sparse[matrix_idx], n, n, values, elements);
+    }
+    free(values);
+    if (status == MATRIX_OK) {
+        status = resizeMatrix(ops->vector, n, 1);
+    }
+    for (row = 0; row < n && status == MATRIX_OK; ++row) {
+        state = (state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+        MATRIX_AT(ops->vector, row, 0) = (double)state / (double)0x3fffffffUL - 1.0;
+    }
+
+    tallRows = (n < BENCH_TALL_MIN_ROWS / 4) ? BENCH_TALL_MIN_ROWS : 4 * n;
+    if (status == MATRIX_OK) {
+        status = resizeMatrix(ops->tall, tallRows, n);
+    }
+    if (status == MATRIX_OK) {
+        status = resizeMatrix(ops->tallRhs, tallRows, 1);
+    }
+    for (row = 0; row < tallRows && status == MATRIX_OK; ++row) {
+        for (col = 0; col <= n; ++col) {
+            state = (state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+            *((col < n) ? &MATRIX_AT(ops->tall, row, col) : &MATRIX_AT(ops->tallRhs, row, 0)) =
+                (double)state / (double)0x3fffffffUL - 1.0;
+        }
+    }
+
+    /* The copies go to disk under the budget of the tiled kernels */
+    initMemoryBudget(ops->diskBudget);
+    if (status == MATRIX_OK) {
+        status = copyMatrix(ops->a, ops->diskA);
+    }
+    if (status == MATRIX_OK) {
+        status = copyMatrix(ops->b, ops->diskB);
+    }
+    initMemoryBudget((size_t)-1);
+
+    /* New versions, so no factorization of the previous size is taken for A */
+    for (matrix_idx = 0; matrix_idx < ops->ctx.count; ++matrix_idx) {
+        touchMatrix(&ops->ctx, matrix_idx);
+    }
+    return status;
+}
+
+
+MatrixStatus runBenchmark(const BenchKernel *kernel, BenchOperands *ops, const BenchOptions *options,
+                          double *samples, BenchResult *result) {
+    /*
+     * Short Description:
+     * Runs the warmup calls, then picks how many calls one sample holds from the time of a single call,
+     * so a sample lasts at least BENCH_MIN_SAMPLE. A kernel restoring its operand makes one call per
+     * sample, the restore running before the clock starts.
+     */
+    double n = (double)ops->n;          /* Dimension, as a double */
+    double elements = n * n;            /* Elements of one matrix */
+    double start;                       /* Time the sample started */
+    double single = 0.0;                /* Seconds of one calibration call */
+    double flops;                       /* Operations of one call */
+    double bytes;                       /* Compulsory traffic of one call */
+    int calls = 1;                      /* Calls per sample */
+    int call_idx;                       /* Index for iterating over the calls of a sample */
+    int rep_idx;                        /* Index for iterating over the samples and warmup calls */
+    int p99Rank;                        /* Nearest rank of the 99th percentile */
+    MatrixStatus status = MATRIX_OK;    /* Status of the last call */
+
+    for (rep_idx = 0; rep_idx <= options->warmup && status == MATRIX_OK; ++rep_idx) {
+        if (kernel->restoresOperand) {
+            status = copyMatrix(ops->saved, ops->a);
+        }
+        start = now();
+        if (status == MATRIX_OK) {
+            status = kernel->run(ops);
+        }
+        single = now() - start;
+    }
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    if (!kernel->restoresOperand && single < BENCH_MIN_SAMPLE) {
+        calls = (single > 0.0) ? (int)(BENCH_MIN_SAMPLE / single) + 1 : 1000;
+    }
+
+    for (rep_idx = 0; rep_idx < options->reps && status == MATRIX_OK; ++rep_idx) {
+        if (kernel->restoresOperand) {
+            status = copyMatrix(ops->saved, ops->a);
+        }
+        start = now();
+        for (call_idx = 0; call_idx < calls && status == MATRIX_OK; ++call_idx) {
+            status = kernel->run(ops);
+        }
+        samples[rep_idx] = (now() - start) / calls;
+    }
+    if (kernel->restoresOperand && status == MATRIX_OK) {
+        status = copyMatrix(ops->saved, ops->a);    /* Leave the operand as the other kernels expect it */
+    }
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    qsort(samples, (size_t)options->reps, sizeof(*samples), compareDoubles);
+    p99Rank = (options->reps * 99 + 99) / 100;
+    result->kernel = kernel->name;
+    result->n = ops->n;
+    result->calls = calls;
+    result->min = samples[0];
+    result->median = (samples[(options->reps - 1) / 2] + samples[options->reps / 2]) / 2.0;
+    result->p99 = samples[p99Rank - 1];
+    if (kernel->work != NULL) {
+        kernel->work(ops, &flops, &bytes);
+    } else {
+        flops = elements * (kernel->flopsPerElement + kernel->flopsPerElementDim * n);
+        bytes = elements * sizeof(double) * kernel->matricesMoved;
+    }
+    result->gflops = flops / result->median * 1e-9;
+    result->gbps = bytes / result->median * 1e-9;
+    return MATRIX_OK;
+}
+
+
+void printBenchTable(const BenchResult *results, int count) {
+    int result_idx;     /* Index for iterating over the results */
+
+    printf("%-16s %6s %12s %12s %12s %9s %9s\n", "kernel", "n", "median (us)", "p99 (us)", "min (us)",
+           "GFLOP/s", "GB/s");
+    for (result_idx = 0; result_idx < count; ++result_idx) {
+        printf("%-16s %6d %12.2f %12.2f %12.2f ", results[result_idx].kernel, results[result_idx].n,
+               results[result_idx].median * 1e6, results[result_idx].p99 * 1e6, results[result_idx].min * 1e6);
+        if (results[result_idx].gflops > 0.0) {
+            printf("%9.2f", results[result_idx].gflops);
+        } else {
+            printf("%9s", "-");
+        }
+        printf(" %9.2f\n", results[result_idx].gbps);
+    }
+}
+
+
+void writeBenchJson(FILE *file, const BenchResult *results, int count, const BenchOptions *options) {
+    int result_idx;     /* Index for iterating over the results */
+
+    fprintf(file, "{\n  \"simd\": \"%s\",\n  \"threads\": %d,\n  \"multiply\": \"%s\",\n",
+            getSimdKernels()->levelName, getThreadCount(), MultiplyAlgorithms[options->multiply].algorithmName);
+    fprintf(file, "  \"reps\": %d,\n  \"warmup\": %d,\n  \"results\": [", options->reps, options->warmup);
+    for (result_idx = 0; result_idx < count; ++result_idx) {
+        fprintf(file, "%s\n    {\"kernel\": \"%s\", \"n\": %d, \"calls_per_sample\": %d, \"median_s\": %.6e,"
+                " \"p99_s\": %.6e, \"min_s\": %.6e, \"gflops\": %.4f, \"gbps\": %.4f}",
+                (result_idx > 0) ? "," : "", results[result_idx].kernel, results[result_idx].n,
+                results[result_idx].calls, results[result_idx].median, results[result_idx].p99,
+                results[result_idx].min, results[result_idx].gflops, results[result_idx].gbps);
+    }
+    fprintf(file, "\n  ]\n}\n");
+}
@@ -0,0 +1,214 @@
+/*
+ * Microbenchmark Driver Header
+ * ----------------------------
+ * This C header file declares the benchmark driver implemented in "matbench.c", a separate program built
+ * by 'make bench'. Where the validation scripts time whole sessions, the driver times the library
+ * functions themselves: every kernel of "mymat.h" (addMatrices, subMatrices, multiplyMatrices,
+ * multiplyMatricesInPlace, multiplyScalar, transposeMatrix, transposeMatrixInPlace, copyMatrix), the
+ * fused evaluation of "matexpr.h", the factorizations and decompositions with the solves of
+ * "matfactor.h" and the least squares of "matqr.h", the batch kernels of "matbatch.h", the sparse
+ * operations of "matsparse.h" and the tiled operations of "matdisk.h", on square matrices over a sweep of
+ * sizes that includes one handled by the size-specialized kernels of "matsmall.h".
+ *
+ * Every case runs a few untimed warmup calls, then a number of timed samples. Calls too fast for the
+ * clock are repeated within a sample, and the sample is divided by the repetitions. The median and the
+ * 99th percentile (nearest rank) of the samples are reported with the GFLOP/s and GB/s of the median.
+ * GB/s counts the compulsory traffic of the kernel only: each operand read once and the result written
+ * once. The sparse products count the operations and traffic of their stored elements instead, for
+ * operands of a chosen density. The report is a table on standard output and, optionally, a JSON file
+ * meant for comparing builds.
+ *
+ * Core Structures:
+ * - BenchOptions:      Command-line options of the driver.
+ * - BenchOperands:     Matrices, batches and expression shared by the kernels of one size.
+ * - BenchKernel:       A timed kernel with its work model.
+ * - BenchResult:       Statistics of one kernel at one size.
+ *
+ * Core Functions:
+ * - parseBenchOptions: Parses the command-line options.
+ * - prepareOperands:   Fills the operands of one size with reproducible values.
+ * - runBenchmark:      Times one kernel at one size.
+ * - printBenchTable:   Prints the results as a table.
+ * - writeBenchJson:    Writes the results and the configuration as JSON.
+ *
+ * Note:
+ * Kernels that overwrite one of their operands (multiplyMatricesInPlace) get the operand restored
+ * before every call, outside the timed region, so every sample measures the same computation. The
+ * driver sets no memory budget, so no matrix goes to disk but those of the tiled kernels, which lower
+ * the budget to half a matrix for the length of a call. The factorization of A is computed once and
+ * kept in the factorization cache, so 'det_mat', 'inv_mat' and 'solve_mat' time what repeated calls
+ * cost: the determinant of the factors and the triangular solves.
+ */
+
+#ifndef MATBENCH_H
+#define MATBENCH_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "mymat.h"
+#include "matexpr.h"
+#include "matstrassen.h"
+#include "matqr.h"
+
+/* Most sizes one sweep may contain */
+#define BENCH_MAX_SIZES 32
+
+/* Default number of timed samples and of untimed warmup calls per case */
+#define BENCH_DEFAULT_REPS 30
+#define BENCH_DEFAULT_WARMUP 3
+
+/* Shortest sample, in seconds; faster calls are repeated within a sample */
+#define BENCH_MIN_SAMPLE 1e-4
+
+/* Seed of the values of the operands, so every run times the same data */
+#define BENCH_SEED 12345UL
+
+/* Default share of non-zero elements of the sparse operands */
+#define BENCH_DEFAULT_DENSITY 0.01
+
+/* Fewest rows of the tall operand of the least-squares kernel: two blocks of the TSQR reduction */
+#define BENCH_TALL_MIN_ROWS (2 * TSQR_BLOCK_ROWS)
+
+/* Command-line options of the driver */
+typedef struct {
+    int sizes[BENCH_MAX_SIZES];     /* Dimensions of the square matrices, in sweep order */
+    int sizeCount;                  /* Number of entries in 'sizes' */
+    int reps;                       /* Timed samples per case */
+    int warmup;                     /* Untimed calls per case */
+    int threads;                    /* Worker threads, 0 for one per online processor */
+    MultiplyAlgorithm multiply;     /* Algorithm of the products */
+    double density;                 /* Share of non-zero elements of the sparse operands */
+    const char *kernels;            /* Comma-separated names of the kernels to run, NULL for all */
+    const char *jsonPath;           /* File receiving the JSON report, NULL for none */
+} BenchOptions;
+
+/* Operands of one size, shared by every kernel */
+typedef struct {
+    MatrixContext ctx;          /* Holds A, B, C, the saved copy of A, SPD, SA, SB, X, DA, DB, DC, T and Y,
+                                   by handle, and the factorization of A */
+    Matrix *a, *b, *c;          /* Operands and result */
+    Matrix *saved;              /* Copy of 'a', restored before a kernel that overwrites it */
+    Matrix *spd;                /* Symmetric positive definite matrix of the Cholesky factorization */
+    Matrix *sparseA, *sparseB;  /* Sparse operands of the sparse products */
+    Matrix *vector;             /* Dense n x 1 operand of the sparse matrix-vector product */
+    Matrix *diskA, *diskB, *diskC;  /* Copies of A and B on disk, and the result of the tiled kernels */
+    Matrix *tall, *tallRhs;     /* Tall m x n operand T and m x 1 right-hand side Y of the least squares */
+    size_t diskBudget;          /* Memory budget of the tiled kernels: half a matrix */
+    double density;             /* Share of non-zero elements of the sparse operands */
+    size_t nonzeros[2];         /* Non-zero elements of 'sparseA' and 'sparseB' */
+    MatrixBatch *batchA, *batchB, *batchC;      /* Batches with as many elements as a matrix */
+    Expression expr;            /* 2*A + B, for the fused evaluation */
+    int n;                      /* Dimension of the matrices */
+} BenchOperands;
+
+/* A timed kernel and its work model */
+typedef struct {
+    const char *name;                               /* Name in the report and in '--kernel' */
+    MatrixStatus (*run)(BenchOperands *ops);        /* Performs one call */
+    double flopsPerElement;                         /* Floating-point operations per element of a matrix */
+    double flopsPerElementDim;                      /* Further operations per element and per unit of n */
+    int matricesMoved;                              /* Matrices of n*n doubles read or written once */
+    bool restoresOperand;                           /* Whether 'a' is restored from 'saved' before each call */
+    void (*work)(const BenchOperands *ops, double *flops, double *bytes);
+                                                    /* Operations and traffic of a call, NULL to use the
+                                                       coefficients above */
+} BenchKernel;
+
+/* Statistics of one kernel at one size */
+typedef struct {
+    const char *kernel;     /* Name of the kernel */
+    int n;                  /* Dimension of the matrices */
+    int calls;              /* Calls per sample */
+    double median;          /* Median seconds per call */
+    double p99;             /* 99th percentile of the seconds per call */
+    double min;             /* Fastest sample, in seconds per call */
+    double gflops;          /* GFLOP/s at the median, 0 for a kernel without arithmetic */
+    double gbps;            /* GB/s of compulsory traffic at the median */
+} BenchResult;
+
+
+/*
+ * Function: parseBenchOptions
+ * Purpose: Parses the command-line options of the driver.
+ * Detailed Description:
+ *   Accepts --sizes N,N,..., --reps N, --warmup N, --threads N, --multiply auto|classic|strassen,
+ *   --density F, --kernel NAME,NAME,... and --json FILE. Options not given keep their defaults. Every
+ *   name given to --kernel must be that of a kernel, so a misspelled one is not silently left out.
+ *
+ * Parameters:
+ *   argc, argv - The arguments of 'main'.
+ *   options - Receives the parsed options.
+ *
+ * Returns:
+ *   true on success; false after printing an error or the usage line.
+ */
+bool parseBenchOptions(int argc, char *argv[], BenchOptions *options);
+
+
+/*
+ * Function: prepareOperands
+ * Purpose: Gives the operands of a benchmark the dimension n and reproducible values in [-1, 1].
+ * Detailed Description:
+ *   The sparse operands get density * n*n non-zero values at uniformly chosen elements. They are
+ *   stored sparse when the sparse threshold allows it, which 'main' sets to the density, and n*n is at
+ *   least SPARSE_MIN_ELEMENTS; smaller operands are dense, as in the calculator. DA and DB are copied
+ *   from A and B under the budget of the tiled kernels, so they are on disk, and T has 4n rows, but at
+ *   least BENCH_TALL_MIN_ROWS.
+ *
+ * Parameters:
+ *   ops - The operands, initialized once with 'initMatrices', the expression and the density.
+ *   n - Dimension of the matrices.
+ *
+ * Returns:
+ *   MATRIX_OK on success, or the status of a failed allocation.
+ */
+MatrixStatus prepareOperands(BenchOperands *ops, int n);
+
+
+/*
+ * Function: runBenchmark
+ * Purpose: Times one kernel on prepared operands.
+ *
+ * Parameters:
+ *   kernel - The kernel.
+ *   ops - The operands, prepared for the size to time.
+ *   options - Number of samples and warmup calls.
+ *   samples - Scratch array of at least 'options->reps' entries.
+ *   result - Receives the statistics.
+ *
+ * Returns:
+ *   MATRIX_OK on success, or the status of the first failed call.
+ */
+MatrixStatus runBenchmark(const BenchKernel *kernel, BenchOperands *ops, const BenchOptions *options,
+                          double *samples, BenchResult *result);
+
+
+/*
+ * Function: printBenchTable
+ * Purpose: Prints results as an aligned table.
+ *
+ * Parameters:
+ *   results - The results, in the order they were measured.
+ *   count - Number of results.
+ *
+ * Returns: None (void function).
+ */
+void printBenchTable(const BenchResult *results, int count);
+
+
+/*
+ * Function: writeBenchJson
+ * Purpose: Writes results and the configuration that produced them as one JSON object.
+ *
+ * Parameters:
+ *   file - The stream to write to.
+ *   results - The results.
+ *   count - Number of results.
+ *   options - The options of the run.
+ *
+ * Returns: None (void function).
+ */
+void writeBenchJson(FILE *file, const BenchResult *results, int count, const BenchOptions *options);
+
+#endif /* MATBENCH_H */
@@ -0,0 +1,380 @@
+/*
+ * Result Cache
+ * ------------
+ * This C source file implements the cache of operation results declared in "matcache.h".
+ *
+ * Core Functionalities:
+ * 1.   Lookup:             Entries are chained in CACHE_BUCKETS hash buckets by the hash of their key, and
+ *                          linked from the most to the least recently used.
+ * 2.   fetchResult:        Finds the entry of a key, drops it if its result is lost, and otherwise gives the
+ *                          result to the matrix: in place, from one of the CACHE_HOLDERS matrices that last
+ *                          received it, or from the copy kept in the entry.
+ * 3.   storeResult:        Adds the matrix just written to the holders of the entry, keeps a copy of the result
+ *                          if asked and the limit allows, then frees the least recently used copies until
+ *                          the copies fit in the limit, and the least recently used entries until they fit
+ *                          in MAX_CACHE_ENTRIES.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "matcache.h"
+#include "matreg.h"
+#include "matdisk.h"
+
+
+/* Number of hash buckets of a cache, a power of two */
+#define CACHE_BUCKETS 1024
+
+/* Matrices an entry remembers as holding its result */
+#define CACHE_HOLDERS 4
+
+/* Cached result of one operation */
+typedef struct ResultEntry {
+    ResultKey key;                  /* Operation whose result this is */
+    size_t bucket;                  /* Bucket of the key */
+    MatrixHandle holders[CACHE_HOLDERS];            /* Matrices that received the result, NO_MATRIX if unused */
+    unsigned long holderVersions[CACHE_HOLDERS];    /* Version each got then; it holds the result while it keeps it */
+    Matrix copy;                    /* Copy of the result, or an empty matrix if none is kept */
+    size_t bytes;                   /* Bytes of 'copy' */
+    struct ResultEntry *next;       /* Next entry of the same bucket */
+    struct ResultEntry *newer;      /* Entry used just after this one, NULL for the most recent */
+    struct ResultEntry *older;      /* Entry used just before this one, NULL for the least recent */
+} ResultEntry;
+
+/* Entries and counters of the cache of one session */
+struct ResultCache {
+    ResultEntry *buckets[CACHE_BUCKETS];    /* Chains of entries by hash of the key */
+    ResultEntry *newest;                    /* Most recently used entry */
+    ResultEntry *oldest;                    /* Least recently used entry, the next one evicted */
+    size_t entries;                         /* Number of entries */
+    size_t bytes;                           /* Bytes of the copies kept */
+    size_t limit;                           /* Limit on 'bytes' */
+    unsigned long hits;                     /* Operations answered */
+    unsigned long misses;                   /* Operations computed */
+    unsigned long evictions;                /* Copies and entries evicted */
+};
+
+
+static size_t cacheLimit = DEFAULT_CACHE_LIMIT;    /* Limit given to the caches created next */
+static const Matrix emptyMatrix = {NULL, 0, 0, 0, 0, NULL, 0, NULL, NULL};   /* Copy of an entry keeping none */
+
+
+static size_t hashKey(const ResultKey *key) {
+    /*
+     * Short Description:
+     * Mixes the operation, the versions and the bits of the scalar into a bucket index.
+     */
+    unsigned char bytes[sizeof(double)];    /* Representation of the scalar */
+    unsigned long hash = (unsigned long)key->operation;     /* Running hash */
+    size_t index;                           /* Variable for iterating over versions and bytes */
+
+    for (index = 0; index < CACHE_KEY_OPERANDS; ++index) {
+        hash = hash * 31 + key->versions[index];
+    }
+    memcpy(bytes, &key->scalar, sizeof(double));
+    for (index = 0; index < sizeof(double); ++index) {
+        hash = hash * 31 + bytes[index];
+    }
+    hash ^= hash >> 16;
+    return (size_t)hash & (CACHE_BUCKETS - 1);
+}
+
+
+static bool sameKey(const ResultKey *key1, const ResultKey *key2) {
+    /*
+     * Short Description:
+     * Compares two keys; scalars are compared bit for bit, since scaling by 0 and by -0 differ.
+     */
+    int index;  /* Variable for iterating over the versions */
+
+    if (key1->operation != key2->operation || memcmp(&key1->scalar, &key2->scalar, sizeof(double)) != 0) {
+        return false;
+    }
+    for (index = 0; index < CACHE_KEY_OPERANDS; ++index) {
+        if (key1->versions[index] != key2->versions[index]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static ResultEntry *findEntry(const struct ResultCache *cache, const ResultKey *key, size_t bucket) {
+    ResultEntry *entry; /* Entry being compared */
+
+    for (entry = cache->buckets[bucket]; entry != NULL; entry = entry->next) {
+        if (sameKey(&entry->key, key)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+
+static void unlinkEntry(struct ResultCache *cache, ResultEntry *entry) {
+    /*
+     * Short Description:
+     * Takes an entry out of the recency list.
+     */
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+}
+
+
+static void markUsed(struct ResultCache *cache, ResultEntry *entry) {
+    /*
+     * Short Description:
+     * Moves an entry (already in the list) to the most recently used end.
+     */
+    if (cache->newest == entry) {
+        return;
+    }
+    unlinkEntry(cache, entry);
+    entry->older = cache->newest;
+    entry->newer = NULL;
+    cache->newest->newer = entry;
+    cache->newest = entry;
+}
+
+
+static void removeEntry(struct ResultCache *cache, ResultEntry *entry) {
+    /*
+     * Short Description:
+     * Unlinks an entry from its bucket and the recency list and frees it with its copy.
+     */
+    ResultEntry **link = &cache->buckets[entry->bucket];   /* Pointer to the entry in its chain */
+
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    unlinkEntry(cache, entry);
+
+    cache->bytes -= entry->bytes;
+    cache->entries--;
+    freeMatrix(&entry->copy);
+    free(entry);
+}
+
+
+static int findHolder(const MatrixContext *ctx, const ResultEntry *entry, MatrixHandle handle) {
+    /*
+     * Short Description:
+     * Returns the slot of a matrix that still holds the result of an entry: 'handle' itself, or any
+     * matrix if 'handle' is NO_MATRIX. Returns -1 if there is none.
+     */
+    int slot;   /* Variable for iterating over the holders */
+
+    for (slot = 0; slot < CACHE_HOLDERS; ++slot) {
+        if (entry->holders[slot] != NO_MATRIX && (handle == NO_MATRIX || entry->holders[slot] == handle) &&
+            ctx->versions[entry->holders[slot]] == entry->holderVersions[slot]) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+
+static void addHolder(const MatrixContext *ctx, ResultEntry *entry, MatrixHandle handle) {
+    /*
+     * Short Description:
+     * Records that a matrix has just received the result of an entry, in the slot it had before or in
+     * the first slot whose matrix no longer holds the result; with none, the oldest holder is forgotten.
+     */
+    int slot;   /* Slot given to the matrix */
+
+    for (slot = 0; slot < CACHE_HOLDERS; ++slot) {
+        if (entry->holders[slot] == NO_MATRIX || entry->holders[slot] == handle ||
+            ctx->versions[entry->holders[slot]] != entry->holderVersions[slot]) {
+            break;
+        }
+    }
+    if (slot == CACHE_HOLDERS) {
+        for (slot = 0; slot < CACHE_HOLDERS - 1; ++slot) {
+            entry->holders[slot] = entry->holders[slot + 1];
+            entry->holderVersions[slot] = entry->holderVersions[slot + 1];
+        }
+    }
+    entry->holders[slot] = handle;
+    entry->holderVersions[slot] = ctx->versions[handle];
+}
+
+
+void setCacheLimit(size_t bytes) {
+    cacheLimit = bytes;
+}
+
+
+struct ResultCache *createResultCache(void) {
+    struct ResultCache *cache;  /* New cache */
+    size_t bucket;              /* Variable for iterating over the buckets */
+
+    if (cacheLimit == 0) {
+        return NULL;
+    }
+    cache = malloc(sizeof(struct ResultCache));
+    if (cache == NULL) {
+        return NULL;
+    }
+    for (bucket = 0; bucket < CACHE_BUCKETS; ++bucket) {
+        cache->buckets[bucket] = NULL;
+    }
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->entries = 0;
+    cache->bytes = 0;
+    cache->limit = cacheLimit;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    return cache;
+}
+
+
+void freeResultCache(struct ResultCache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    while (cache->oldest != NULL) {
+        removeEntry(cache, cache->oldest);
+    }
+    free(cache);
+}
+
+
+bool fetchResult(MatrixContext *ctx, const ResultKey *key, MatrixHandle result, MatrixStatus *status) {
+    /*
+     * Short Description:
+     * Answers an operation from its entry. The result is copied from a matrix that still holds it, and
+     * from the copy of the entry otherwise. The matrix receiving a copy becomes one of the holders.
+     */
+    struct ResultCache *cache = ctx->cache;     /* Cache of the session */
+    ResultEntry *entry;                         /* Entry of the key */
+    const Matrix *source;                       /* Matrix the result is copied from */
+    int slot;                                   /* Slot of a holder of the result */
+
+    if (cache == NULL) {
+        return false;
+    }
+    entry = findEntry(cache, key, hashKey(key));
+    if (entry != NULL && findHolder(ctx, entry, NO_MATRIX) < 0 && entry->copy.data == NULL) {
+        removeEntry(cache, entry);  /* The result is lost */
+        entry = NULL;
+    }
+    if (entry == NULL) {
+        cache->misses++;
+        return false;
+    }
+
+    cache->hits++;
+    markUsed(cache, entry);
+    *status = MATRIX_OK;
+    if (findHolder(ctx, entry, result) >= 0) {
+        return true;    /* Already in place */
+    }
+
+    slot = findHolder(ctx, entry, NO_MATRIX);
+    source = (slot >= 0) ? &ctx->matrices[entry->holders[slot]] : &entry->copy;
+    *status = copyMatrix(source, &ctx->matrices[result]);
+    touchMatrix(ctx, result);
+    if (*status == MATRIX_OK) {
+        addHolder(ctx, entry, result);
+    }
+    return true;
+}
+
+
+void storeResult(MatrixContext *ctx, const ResultKey *key, MatrixHandle result, bool keepCopy) {
+    /*
+     * Short Description:
+     * Creates or updates the entry of the key. A copy is kept only for a result in memory that fits in
+     * the limit on its own and in the memory budget, so the copies evicted to make room for it are always
+     * older ones; the entry just stored is the most recent, so it is never evicted either. A copy counts
+     * the elements it allocated.
+     */
+    struct ResultCache *cache = ctx->cache;     /* Cache of the session */
+    const Matrix *mat = &ctx->matrices[result]; /* Result just written */
+    size_t bucket = hashKey(key);               /* Bucket of the key */
+    size_t bytes;                               /* Bytes of a copy of the result */
+    ResultEntry *entry;                         /* Entry of the key */
+    ResultEntry *victim;                        /* Entry losing its copy */
+    int slot;                                   /* Variable for iterating over the holders */
+
+    if (cache == NULL) {
+        return;
+    }
+    entry = findEntry(cache, key, bucket);
+    if (entry == NULL) {
+        entry = malloc(sizeof(ResultEntry));
+        if (entry == NULL) {
+            return;
+        }
+        entry->key = *key;
+        entry->bucket = bucket;
+        entry->copy = emptyMatrix;
+        entry->bytes = 0;
+        for (slot = 0; slot < CACHE_HOLDERS; ++slot) {
+            entry->holders[slot] = NO_MATRIX;
+        }
+        entry->next = cache->buckets[bucket];
+        cache->buckets[bucket] = entry;
+        entry->newer = NULL;
+        entry->older = cache->newest;
+        if (cache->newest != NULL) {
+            cache->newest->newer = entry;
+        } else {
+            cache->oldest = entry;
+        }
+        cache->newest = entry;
+        cache->entries++;
+    } else {
+        markUsed(cache, entry);
+    }
+    addHolder(ctx, entry, result);
+
+    /* A copy over the memory budget would go to disk, where 'fetchResult' cannot use it */
+    bytes = (size_t)mat->rows * (size_t)mat->cols * sizeof(double);
+    if (keepCopy && entry->copy.data == NULL && mat->disk == NULL && mat->sparse == NULL && bytes <= cache->limit &&
+        !shouldSpill(mat->rows, mat->cols)) {
+        if (copyMatrix(mat, &entry->copy) == MATRIX_OK && entry->copy.data != NULL) {
+            entry->bytes = entry->copy.capacity * sizeof(double);
+            cache->bytes += entry->bytes;
+        } else {
+            freeMatrix(&entry->copy);
+        }
+    }
+
+    /* Over the limit, the oldest copies go; their entries stay valid while their holders keep the result */
+    while (cache->bytes > cache->limit) {
+        victim = cache->oldest;
+        while (victim->bytes == 0) {
+            victim = victim->newer;
+        }
+        cache->bytes -= victim->bytes;
+        victim->bytes = 0;
+        freeMatrix(&victim->copy);
+        cache->evictions++;
+    }
+    while (cache->entries > MAX_CACHE_ENTRIES) {
+        removeEntry(cache, cache->oldest);
+        cache->evictions++;
+    }
+}
+
+
+void getCacheStats(const struct ResultCache *cache, CacheStats *stats) {
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->entries = cache->entries;
+    stats->bytes = cache->bytes;
+    stats->limit = cache->limit;
+}
@@ -0,0 +1,148 @@
+/*
+ * Result Cache Header
+ * -------------------
+ * This C header file declares the cache of operation results implemented in "matcache.c". Generated
+ * scripts often repeat an operation, such as 'mul_mat X, Y, Z', whose operands have not changed since
+ * it last ran. Every matrix carries a version that changes on every write (see "matreg.h"), so an
+ * operation is identified by a ResultKey: the operation, the versions of its operands and its scalar.
+ *
+ * An entry remembers the last few matrices that received its result, with the versions they got then.
+ * While such a matrix still has that version it still holds the result, so repeating the operation into
+ * it costs nothing, and repeating it into another matrix is a copy. Products, which cost much more than
+ * a copy, also keep a copy of their result in the entry, so they are not recomputed even after the
+ * matrix that received them has been overwritten. Entries whose result is lost are dropped.
+ *
+ * Core Structures:
+ * - ResultKey:         Operation, operand versions and scalar identifying a result.
+ * - CacheStats:        Counters of the cache, for 'cache_stats'.
+ *
+ * Core Functions:
+ * - setCacheLimit:     Sets the bytes of result copies a cache may keep.
+ * - createResultCache / freeResultCache:
+ *                      Create and release the cache of a session.
+ * - fetchResult:       Gives a matrix a cached result.
+ * - storeResult:       Records the result an operation has just written.
+ * - getCacheStats:     Reads the counters of a cache.
+ *
+ * Note:
+ * The copies kept by the entries count against the limit; when it is exceeded, the copies of the least
+ * recently used entries are evicted, and the number of entries is bounded by MAX_CACHE_ENTRIES. Results
+ * stored on disk (see "matdisk.h"), or larger than the memory budget, are never copied into the cache, so
+ * every copy counted is resident.
+ */
+
+#ifndef MATCACHE_H
+#define MATCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "mymat.h"
+
+/* Default bytes of result copies a cache may keep */
+#define DEFAULT_CACHE_LIMIT ((size_t)64 << 20)
+
+/* Entries a cache holds at most, whether or not they keep a copy */
+#define MAX_CACHE_ENTRIES 4096
+
+/* Number of operand versions in a ResultKey */
+#define CACHE_KEY_OPERANDS 2
+
+/* Identity of the result of an operation */
+typedef struct {
+    int operation;                                  /* Operation, as a CommandType of "mainmat.h" */
+    unsigned long versions[CACHE_KEY_OPERANDS];     /* Versions of the operands, 0 for a missing one */
+    double scalar;                                  /* Scalar operand, 0 for none */
+} ResultKey;
+
+/* Counters of a result cache */
+typedef struct {
+    unsigned long hits;         /* Operations answered by the cache */
+    unsigned long misses;       /* Operations computed */
+    unsigned long evictions;    /* Copies and entries evicted to respect the limits */
+    size_t entries;             /* Entries held */
+    size_t bytes;               /* Bytes of the result copies held */
+    size_t limit;               /* Limit on 'bytes' */
+} CacheStats;
+
+
+/*
+ * Function: setCacheLimit
+ * Purpose: Sets the bytes of result copies every cache created afterwards may keep.
+ *
+ * Parameters:
+ *   bytes - The limit; 0 disables the cache.
+ *
+ * Returns: None (void function).
+ */
+void setCacheLimit(size_t bytes);
+
+
+/*
+ * Function: createResultCache
+ * Purpose: Creates an empty result cache.
+ *
+ * Returns:
+ *   The cache, or NULL if the cache is disabled or could not be allocated; operations then always run.
+ */
+struct ResultCache *createResultCache(void);
+
+
+/*
+ * Function: freeResultCache
+ * Purpose: Releases a result cache and the copies it keeps.
+ *
+ * Parameters:
+ *   cache - The cache, or NULL.
+ *
+ * Returns: None (void function).
+ */
+void freeResultCache(struct ResultCache *cache);
+
+
+/*
+ * Function: fetchResult
+ * Purpose: Gives a matrix the cached result of an operation.
+ * Detailed Description:
+ *   If the result of 'key' is known, 'result' receives it: nothing is done if 'result' already holds
+ *   it, otherwise it is copied and 'result' gets a new version. The counters record a hit or a miss.
+ *
+ * Parameters:
+ *   ctx - Pointer to the MatrixContext holding the matrices and the cache.
+ *   key - The operation about to be computed.
+ *   result - Handle of the matrix the operation writes.
+ *   status - Receives the status of the copy on a hit.
+ *
+ * Returns:
+ *   true if the cache answered the operation; false if it has to be computed.
+ */
+bool fetchResult(MatrixContext *ctx, const ResultKey *key, MatrixHandle result, MatrixStatus *status);
+
+
+/*
+ * Function: storeResult
+ * Purpose: Records the result an operation has just written, after its matrix got its new version.
+ *
+ * Parameters:
+ *   ctx - Pointer to the MatrixContext holding the matrices and the cache.
+ *   key - The operation, with the versions its operands had before it ran.
+ *   result - Handle of the matrix holding the result.
+ *   keepCopy - Whether the entry keeps a copy of the result, for results dearer to compute than to copy.
+ *
+ * Returns: None (void function). A result that cannot be recorded is simply not cached.
+ */
+void storeResult(MatrixContext *ctx, const ResultKey *key, MatrixHandle result, bool keepCopy);
+
+
+/*
+ * Function: getCacheStats
+ * Purpose: Reads the counters of a result cache.
+ *
+ * Parameters:
+ *   cache - The cache; must not be NULL.
+ *   stats - Receives the counters.
+ *
+ * Returns: None (void function).
+ */
+void getCacheStats(const struct ResultCache *cache, CacheStats *stats);
+
+#endif /* MATCACHE_H */
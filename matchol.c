@@ -0,0 +1,502 @@
+/*
+ * Symmetric Factorizations
+ * ------------------------
+ * This C source file implements the Cholesky and LDL^T factorizations declared in "matchol.h".
+ *
+ * Core Functionalities:
+ * 1.   factorCholesky:     Computes every block of CHOL_BLOCK rows of U by halves ('factorRows'), then
+ *                          subtracts it from the later blocks of rows with one 'gemm' each, so only the
+ *                          diagonal blocks compute elements below the diagonal that are never read.
+ * 2.   factorLDLT:         Bunch-Kaufman pivoting on the rows of the upper triangle, which are contiguous:
+ *                          the pivot search, the row exchanges and the updates all run along rows.
+ * 3.   packFactors:        Copies the upper triangle into the packed blocks and releases the matrix.
+ * 4.   solveSymmetric:     Solves U^T Y = B and U X = Y a block of rows at a time, with a small triangular
+ *                          solve within the block and a 'gemm' for the rows it affects, and D Z = Y in
+ *                          between for LDL^T. A single right-hand side is solved along the rows of U.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "matchol.h"
+#include "matgemm.h"
+#include "matsimd.h"
+
+/* Bunch-Kaufman threshold (1 + sqrt(17)) / 8, which bounds the growth of the elements of D and U */
+#define BUNCH_KAUFMAN_ALPHA 0.6403882032022076
+
+
+static size_t blockOffset(int n, int start) {
+    /*
+     * Short Description:
+     * Returns the position in the packed factors of the block of rows beginning at 'start', a multiple of
+     * CHOL_BLOCK: every block before it holds CHOL_BLOCK rows of n - (its first row) elements.
+     */
+    size_t blocks = (size_t)(start / CHOL_BLOCK);   /* Blocks before this one */
+
+    if (blocks == 0) {
+        return 0;
+    }
+    return (size_t)CHOL_BLOCK * (blocks * (size_t)n - (size_t)CHOL_BLOCK * (blocks * (blocks - 1) / 2));
+}
+
+
+size_t packedTriangleSize(int n) {
+    int last = (n - 1) / CHOL_BLOCK * CHOL_BLOCK;   /* First row of the last block */
+
+    return blockOffset(n, last) + (size_t)(n - last) * (size_t)(n - last);
+}
+
+
+double *packedRow(const Factorization *factors, int row) {
+    int start = row / CHOL_BLOCK * CHOL_BLOCK;      /* First row of the block holding the row */
+
+    return factors->elements + blockOffset(factors->n, start) + (size_t)(row - start) * (size_t)(factors->n - start)
+           + (size_t)(row - start);
+}
+
+
+static MatrixStatus packFactors(double *a, int n, Factorization *factors) {
+    /*
+     * Short Description:
+     * Moves the upper triangle of the n x n matrix 'a' into newly allocated packed factors, and releases
+     * 'a' whatever the outcome.
+     */
+    int row;    /* Variable for iterating over the rows */
+
+    factors->n = n;
+    factors->elements = allocElements(packedTriangleSize(n));
+    if (factors->elements != NULL) {
+        for (row = 0; row < n; ++row) {
+            memcpy(packedRow(factors, row), &a[(size_t)row * n + row], (size_t)(n - row) * sizeof(double));
+        }
+    }
+    free(a);
+    return (factors->elements != NULL) ? MATRIX_OK : MATRIX_ALLOCATION_FAILED;
+}
+
+
+static MatrixStatus factorRowsByOne(double *a, int n, int start, int end) {
+    /*
+     * Short Description:
+     * Computes rows start .. end - 1 of U one at a time, updating the rows of the range only.
+     */
+    const SimdKernels *simd = getSimdKernels();     /* Element-wise kernels */
+    double pivot;           /* Diagonal element of U */
+    double *pivotRow;       /* Row of U being computed */
+    int row, col;           /* Row of U being computed, and row it updates */
+
+    for (row = start; row < end; ++row) {
+        pivotRow = &a[(size_t)row * n];
+        pivot = pivotRow[row];
+        if (!(pivot > 0.0)) {
+            return MATRIX_NOT_POSITIVE_DEFINITE;
+        }
+        pivot = sqrt(pivot);
+        pivotRow[row] = pivot;
+        simd->scale(&pivotRow[row + 1], 1.0 / pivot, &pivotRow[row + 1], (size_t)(n - row - 1));
+        for (col = row + 1; col < end; ++col) {
+            if (pivotRow[col] != 0.0) {
+                simd->axpy(&pivotRow[col], -pivotRow[col], &a[(size_t)col * n + col], (size_t)(n - col));
+            }
+        }
+    }
+    return MATRIX_OK;
+}
+
+
+static MatrixStatus factorRows(double *a, int n, int start, int end) {
+    /*
+     * Short Description:
+     * Computes rows start .. end - 1 of U by halves: the first half, its product subtracted from the
+     * second half right of the diagonal with 'gemm', then the second half.
+     */
+    int mid = start + (end - start) / 2;    /* First row of the second half */
+    MatrixStatus status;
+
+    if (end - start <= CHOL_PANEL_MIN) {
+        return factorRowsByOne(a, n, start, end);
+    }
+    status = factorRows(a, n, start, mid);
+    if (status == MATRIX_OK) {
+        status = gemm(GEMM_TRANS, GEMM_NO_TRANS, end - mid, n - mid, mid - start,
+                      -1.0, &a[(size_t)start * n + mid], n, &a[(size_t)start * n + mid], n,
+                      1.0, &a[(size_t)mid * n + mid], n);
+    }
+    if (status == MATRIX_OK) {
+        status = factorRows(a, n, mid, end);
+    }
+    return status;
+}
+
+
+MatrixStatus factorCholesky(double *elements, int n, Factorization *factors) {
+    int start, end;         /* Rows of the current block */
+    int first, last;        /* Rows of a later block being updated */
+    MatrixStatus status = MATRIX_OK;
+
+    factors->kind = FACTOR_CHOLESKY;
+    factors->n = n;
+    factors->elements = NULL;
+    factors->pivots = NULL;
+    factors->offDiagonal = NULL;
+    factors->sign = 1;
+    factors->singular = false;
+
+    /* A_22 -= U_12^T U_12, one later block of rows at a time to stay right of the diagonal */
+    for (start = 0; start < n && status == MATRIX_OK; start = end) {
+        end = (n - start < CHOL_BLOCK) ? n : start + CHOL_BLOCK;
+        status = factorRows(elements, n, start, end);
+        for (first = end; first < n && status == MATRIX_OK; first = last) {
+            last = (n - first < CHOL_BLOCK) ? n : first + CHOL_BLOCK;
+            status = gemm(GEMM_TRANS, GEMM_NO_TRANS, last - first, n - first, end - start,
+                          -1.0, &elements[(size_t)start * n + first], n, &elements[(size_t)start * n + first], n,
+                          1.0, &elements[(size_t)first * n + first], n);
+        }
+    }
+
+    if (status != MATRIX_OK) {
+        free(elements);
+        return status;
+    }
+    return packFactors(elements, n, factors);
+}
+
+
+static void swapElements(double *first, double *second) {
+    double value = *first;  /* Element being exchanged */
+
+    *first = *second;
+    *second = value;
+}
+
+
+static void exchangeSymmetric(double *a, int n, int step, int kk, int kp, int kstep) {
+    /*
+     * Short Description:
+     * Exchanges rows and columns kk and kp > kk of the symmetric matrix left from 'step' on, of which
+     * only the upper triangle is stored, and columns kk and kp of the rows of U already computed, so the
+     * factorization ends with a single permutation.
+     */
+    int index;      /* Variable for iterating over the rows and columns */
+
+    for (index = kp + 1; index < n; ++index) {
+        swapElements(&a[(size_t)kk * n + index], &a[(size_t)kp * n + index]);
+    }
+    for (index = kk + 1; index < kp; ++index) {
+        swapElements(&a[(size_t)kk * n + index], &a[(size_t)index * n + kp]);
+    }
+    swapElements(&a[(size_t)kk * n + kk], &a[(size_t)kp * n + kp]);
+    if (kstep == 2) {
+        swapElements(&a[(size_t)step * n + step + 1], &a[(size_t)step * n + kp]);
+    }
+    for (index = 0; index < step; ++index) {
+        swapElements(&a[(size_t)index * n + kk], &a[(size_t)index * n + kp]);
+    }
+}
+
+
+static int choosePivot(const double *a, int n, int step, int *kstep) {
+    /*
+     * Short Description:
+     * Applies the Bunch-Kaufman test at 'step' and returns the row brought to the pivot position: 'step'
+     * itself, or the row 'largest' of the largest element of row 'step', alone or with 'step' as a
+     * block of order 2 ('*kstep' 2). Returns -1 when the row is zero.
+     */
+    const double *row = &a[(size_t)step * n];   /* Row of the step */
+    double diagonal = (row[step] < 0.0) ? -row[step] : row[step];     /* Magnitude of the diagonal element */
+    double colmax = 0.0;        /* Largest magnitude beside the diagonal in row 'step' */
+    double rowmax = 0.0;        /* Largest magnitude beside the diagonal in row 'largest' */
+    double magnitude;           /* Magnitude of a candidate */
+    int largest = step;         /* Row of 'colmax' */
+    int index;                  /* Variable for iterating over the elements */
+
+    *kstep = 1;
+    for (index = step + 1; index < n; ++index) {
+        magnitude = (row[index] < 0.0) ? -row[index] : row[index];
+        if (magnitude > colmax) {
+            colmax = magnitude;
+            largest = index;
+        }
+    }
+    if (diagonal == 0.0 && colmax == 0.0) {
+        return -1;
+    }
+    if (diagonal >= BUNCH_KAUFMAN_ALPHA * colmax) {
+        return step;
+    }
+
+    for (index = step; index < n; ++index) {
+        if (index != largest) {
+            magnitude = (index < largest) ? a[(size_t)index * n + largest] : a[(size_t)largest * n + index];
+            magnitude = (magnitude < 0.0) ? -magnitude : magnitude;
+            rowmax = (magnitude > rowmax) ? magnitude : rowmax;
+        }
+    }
+    magnitude = a[(size_t)largest * n + largest];
+    magnitude = (magnitude < 0.0) ? -magnitude : magnitude;
+    if (diagonal >= BUNCH_KAUFMAN_ALPHA * colmax * (colmax / rowmax)) {
+        return step;
+    }
+    if (magnitude < BUNCH_KAUFMAN_ALPHA * rowmax) {
+        *kstep = 2;
+    }
+    return largest;
+}
+
+
+MatrixStatus factorLDLT(double *elements, int n, Factorization *factors) {
+    const SimdKernels *simd = getSimdKernels();     /* Element-wise kernels */
+    double *a = elements;   /* Matrix being factored */
+    double *pivotRow;       /* Row of U being computed */
+    double d11, d22, d21;   /* Block of order 2 of D, scaled by its element beside the diagonal */
+    double scale;           /* Inverse of the determinant of the scaled block */
+    double u1, u2;          /* Elements of the two rows of U of a block of order 2 */
+    int step;               /* First row of the current pivot */
+    int kstep;              /* Order of the current pivot */
+    int kp;                 /* Row brought to the pivot position */
+    int col;                /* Variable for iterating over the rows being updated */
+
+    factors->kind = FACTOR_LDLT;
+    factors->n = n;
+    factors->elements = NULL;
+    factors->sign = 1;
+    factors->singular = false;
+    factors->pivots = malloc((size_t)n * sizeof(int));
+    factors->offDiagonal = calloc((size_t)n, sizeof(double));
+    if (factors->pivots == NULL || factors->offDiagonal == NULL) {
+        free(factors->pivots);
+        free(factors->offDiagonal);
+        free(elements);
+        return MATRIX_ALLOCATION_FAILED;
+    }
+
+    for (step = 0; step < n; step += kstep) {
+        kp = choosePivot(a, n, step, &kstep);
+        if (kp < 0) {
+            factors->pivots[step] = step;
+            factors->singular = true;   /* Nothing to eliminate in this row */
+            continue;
+        }
+        if (kp != step + kstep - 1) {
+            exchangeSymmetric(a, n, step, step + kstep - 1, kp, kstep);
+        }
+        pivotRow = &a[(size_t)step * n];
+
+        if (kstep == 1) {
+            /* A_22 -= u u^T / d, then u /= d */
+            factors->pivots[step] = kp;
+            for (col = step + 1; col < n; ++col) {
+                if (pivotRow[col] != 0.0) {
+                    simd->axpy(&pivotRow[col], -pivotRow[col] / pivotRow[step], &a[(size_t)col * n + col],
+                               (size_t)(n - col));
+                }
+            }
+            simd->scale(&pivotRow[step + 1], 1.0 / pivotRow[step], &pivotRow[step + 1], (size_t)(n - step - 1));
+            continue;
+        }
+
+        /* A_22 -= W D^-1 W^T for the two rows W of the block, which then become W D^-1 */
+        factors->pivots[step] = step;
+        factors->pivots[step + 1] = kp;
+        d21 = pivotRow[step + 1];
+        d11 = a[(size_t)(step + 1) * n + step + 1] / d21;
+        d22 = pivotRow[step] / d21;
+        scale = 1.0 / (d11 * d22 - 1.0);
+        d21 = scale / d21;
+        for (col = step + 2; col < n; ++col) {
+            u1 = d21 * (d11 * pivotRow[col] - pivotRow[n + col]);
+            u2 = d21 * (d22 * pivotRow[n + col] - pivotRow[col]);
+            simd->axpy(&pivotRow[col], -u1, &a[(size_t)col * n + col], (size_t)(n - col));
+            simd->axpy(&pivotRow[n + col], -u2, &a[(size_t)col * n + col], (size_t)(n - col));
+            pivotRow[col] = u1;
+            pivotRow[n + col] = u2;
+        }
+        factors->offDiagonal[step] = pivotRow[step + 1];
+        pivotRow[step + 1] = 0.0;   /* U is unit upper triangular within the block */
+    }
+
+    if (packFactors(elements, n, factors) != MATRIX_OK) {
+        free(factors->pivots);
+        free(factors->offDiagonal);
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    return MATRIX_OK;
+}
+
+
+static void solveVector(const Factorization *factors, double *b, int ldb, bool unit, bool transposed) {
+    /*
+     * Short Description:
+     * Solves U^T Y = B ('transposed') or U X = Y for a single right-hand side, whose elements are 'ldb'
+     * apart, along the contiguous rows of U; a unit diagonal is not divided by.
+     */
+    const double *factorRow;    /* Row of U, from its diagonal element */
+    double value;               /* Element being solved */
+    int n = factors->n;         /* Order of the matrix */
+    int row, col;               /* Variables for iterating over the rows and the columns */
+
+    for (row = 0; row < n && transposed; ++row) {
+        factorRow = packedRow(factors, row);
+        if (!unit) {
+            b[(size_t)row * ldb] /= factorRow[0];
+        }
+        value = b[(size_t)row * ldb];
+        if (value != 0.0) {
+            for (col = row + 1; col < n; ++col) {
+                b[(size_t)col * ldb] -= factorRow[col - row] * value;
+            }
+        }
+    }
+    for (row = n - 1; row >= 0 && !transposed; --row) {
+        factorRow = packedRow(factors, row);
+        value = b[(size_t)row * ldb];
+        for (col = row + 1; col < n; ++col) {
+            value -= factorRow[col - row] * b[(size_t)col * ldb];
+        }
+        b[(size_t)row * ldb] = unit ? value : value / factorRow[0];
+    }
+}
+
+
+static MatrixStatus solveBlocks(const Factorization *factors, double *b, int ldb, int m, bool unit,
+                                bool transposed) {
+    /*
+     * Short Description:
+     * Solves U^T Y = B going down the blocks of rows ('transposed'), or U X = Y going up: once a block
+     * of the solution is known, its contribution is removed from every row still to solve by one 'gemm'.
+     */
+    const SimdKernels *simd = getSimdKernels();     /* Element-wise kernels */
+    int n = factors->n;     /* Order of the matrix */
+    const double *block;    /* First row of the block of U */
+    size_t ld;              /* Distance between the rows of the block */
+    double *target;         /* Row of B being solved */
+    int start, end;         /* Rows of the current block */
+    int row, col;           /* Variables for iterating over the rows of the block */
+    int index;              /* Index of the current block, counted in the direction of the solve */
+    MatrixStatus status = MATRIX_OK;
+
+    for (index = 0; index * CHOL_BLOCK < n && status == MATRIX_OK; ++index) {
+        start = transposed ? index * CHOL_BLOCK : (n - 1) / CHOL_BLOCK * CHOL_BLOCK - index * CHOL_BLOCK;
+        end = (n - start < CHOL_BLOCK) ? n : start + CHOL_BLOCK;
+        block = factors->elements + blockOffset(n, start);
+        ld = (size_t)(n - start);
+
+        if (transposed) {
+            for (row = start; row < end; ++row) {
+                target = &b[(size_t)row * ldb];
+                if (!unit) {
+                    simd->scale(target, 1.0 / block[(size_t)(row - start) * ld + (row - start)], target, (size_t)m);
+                }
+                for (col = row + 1; col < end; ++col) {
+                    if (block[(size_t)(row - start) * ld + (col - start)] != 0.0) {
+                        simd->axpy(target, -block[(size_t)(row - start) * ld + (col - start)],
+                                   &b[(size_t)col * ldb], (size_t)m);
+                    }
+                }
+            }
+            if (end < n) {
+                status = gemm(GEMM_TRANS, GEMM_NO_TRANS, n - end, m, end - start,
+                              -1.0, block + (end - start), (int)ld, &b[(size_t)start * ldb], ldb,
+                              1.0, &b[(size_t)end * ldb], ldb);
+            }
+            continue;
+        }
+
+        if (end < n) {
+            status = gemm(GEMM_NO_TRANS, GEMM_NO_TRANS, end - start, m, n - end,
+                          -1.0, block + (end - start), (int)ld, &b[(size_t)end * ldb], ldb,
+                          1.0, &b[(size_t)start * ldb], ldb);
+        }
+        for (row = end - 1; row >= start; --row) {
+            target = &b[(size_t)row * ldb];
+            for (col = row + 1; col < end; ++col) {
+                if (block[(size_t)(row - start) * ld + (col - start)] != 0.0) {
+                    simd->axpy(&b[(size_t)col * ldb], -block[(size_t)(row - start) * ld + (col - start)],
+                               target, (size_t)m);
+                }
+            }
+            if (!unit) {
+                simd->scale(target, 1.0 / block[(size_t)(row - start) * ld + (row - start)], target, (size_t)m);
+            }
+        }
+    }
+    return status;
+}
+
+
+static void solveDiagonal(const Factorization *factors, double *b, int ldb, int m) {
+    /*
+     * Short Description:
+     * Solves D Z = Y. A block of order 2 is scaled by its element beside the diagonal first, as in LAPACK,
+     * so its determinant neither overflows nor underflows.
+     */
+    double *first, *second;     /* Rows of B of a pivot */
+    double d11, d22, d21;       /* Elements of a block of order 2, scaled */
+    double denominator;         /* Determinant of the scaled block */
+    double b1, b2;              /* Elements of the two rows of B, scaled */
+    int row, col;               /* Variables for iterating over the rows and the columns */
+
+    for (row = 0; row < factors->n; ++row) {
+        first = &b[(size_t)row * ldb];
+        if (factors->offDiagonal[row] == 0.0) {
+            d11 = *packedRow(factors, row);
+            for (col = 0; col < m; ++col) {
+                first[col] /= d11;
+            }
+            continue;
+        }
+        second = first + ldb;
+        d21 = factors->offDiagonal[row];
+        d11 = *packedRow(factors, row) / d21;
+        d22 = *packedRow(factors, row + 1) / d21;
+        denominator = d11 * d22 - 1.0;
+        for (col = 0; col < m; ++col) {
+            b1 = first[col] / d21;
+            b2 = second[col] / d21;
+            first[col] = (d22 * b1 - b2) / denominator;
+            second[col] = (d11 * b2 - b1) / denominator;
+        }
+        ++row;
+    }
+}
+
+
+MatrixStatus solveSymmetric(const Factorization *factors, double *b, int ldb, int m) {
+    bool unit = (factors->kind == FACTOR_LDLT);     /* Whether U has a unit diagonal, that of D */
+    int n = factors->n;     /* Order of the matrix */
+    int row;                /* Variable for iterating over the row exchanges */
+    MatrixStatus status = MATRIX_OK;
+
+    if (unit) {
+        for (row = 0; row < n; ++row) {
+            if (factors->pivots[row] != row) {
+                swapRows(&b[(size_t)row * ldb], &b[(size_t)factors->pivots[row] * ldb], m);
+            }
+        }
+    }
+
+    /* A single right-hand side gains nothing from 'gemm' */
+    if (m == 1) {
+        solveVector(factors, b, ldb, unit, true);
+    } else {
+        status = solveBlocks(factors, b, ldb, m, unit, true);
+    }
+    if (unit && status == MATRIX_OK) {
+        solveDiagonal(factors, b, ldb, m);
+    }
+    if (m == 1) {
+        solveVector(factors, b, ldb, unit, false);
+    } else if (status == MATRIX_OK) {
+        status = solveBlocks(factors, b, ldb, m, unit, false);
+    }
+
+    if (unit) {
+        for (row = n - 1; row >= 0; --row) {
+            if (factors->pivots[row] != row) {
+                swapRows(&b[(size_t)row * ldb], &b[(size_t)factors->pivots[row] * ldb], m);
+            }
+        }
+    }
+    return status;
+}
@@ -0,0 +1,124 @@
+/*
+ * Symmetric Factorization Header
+ * ------------------------------
+ * This C header file declares the factorizations of symmetric matrices implemented in "matchol.c": the
+ * Cholesky factorization A = U^T U of a positive definite matrix, and the factorization P A P^T = U^T D U
+ * with Bunch-Kaufman pivoting of any other symmetric matrix, where U is unit upper triangular and D block
+ * diagonal with blocks of order 1 and 2. Both read and write the upper triangle only, so they move half
+ * the elements of an LU factorization, and Cholesky does half its operations (n^3/3).
+ *
+ * Core Functions:
+ * - factorCholesky:        Computes A = U^T U, blocked like "matlu.h".
+ * - factorLDLT:            Computes P A P^T = U^T D U.
+ * - solveSymmetric:        Solves A X = B with either factorization.
+ * - packedRow:             Locates a row of the packed factors.
+ * - packedTriangleSize:    Number of elements of packed factors.
+ *
+ * Note:
+ * The factors are kept packed by blocks of CHOL_BLOCK rows: the rows of a block hold their elements from
+ * the first column of the block to the last column of the matrix, one row after the other, so that the
+ * part of a block right of its diagonal block is an ordinary row-major matrix for the GEMM engine, and
+ * the factors take n(n + CHOL_BLOCK)/2 elements instead of n^2.
+ */
+
+#ifndef MATCHOL_H
+#define MATCHOL_H
+
+#include <stddef.h>
+#include "mymat.h"
+#include "matfactor.h"
+
+/* Rows of a block of the packed factors, of the blocked factorization and of the triangular solves */
+#define CHOL_BLOCK 128
+/* Rows of a block below which it is factored one row at a time rather than by halves */
+#define CHOL_PANEL_MIN 16
+
+
+/*
+ * Function: factorCholesky
+ * Purpose: Computes the Cholesky factorization A = U^T U of a symmetric positive definite matrix.
+ * Detailed Description:
+ *   A block of CHOL_BLOCK rows of U is computed from the rows above it, then subtracted from every later
+ *   block of rows with 'gemm', right of their diagonal. Within a block the rows are computed by halves
+ *   the same way, down to CHOL_PANEL_MIN rows computed one at a time.
+ *
+ * Parameters:
+ *   elements - n x n row-major matrix, of which only the upper triangle is read; it is overwritten and
+ *              released in every case.
+ *   n - Order of the matrix.
+ *   factors - Receives the packed factor U, to be released with 'free' of 'elements'.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_NOT_POSITIVE_DEFINITE when a pivot is not positive,
+ *   MATRIX_ALLOCATION_FAILED if the factors could not be allocated.
+ */
+MatrixStatus factorCholesky(double *elements, int n, Factorization *factors);
+
+
+/*
+ * Function: factorLDLT
+ * Purpose: Computes the factorization P A P^T = U^T D U of a symmetric matrix.
+ * Detailed Description:
+ *   At every step the diagonal element is the pivot if it is large enough against its row (the
+ *   Bunch-Kaufman test), otherwise the largest element of the row brings its own diagonal element or
+ *   a block of order 2 to the pivot position. A row without any non-zero element marks the matrix
+ *   singular and is skipped. Every step is a rank-1 or rank-2 update of the rows below, one 'axpy' per
+ *   row and per rank.
+ *
+ * Parameters:
+ *   elements - n x n row-major matrix, of which only the upper triangle is read; it is overwritten and
+ *              released in every case.
+ *   n - Order of the matrix.
+ *   factors - Receives the packed factor U, whose diagonal holds that of D, the elements of D beside its
+ *             diagonal and the row exchanges, to be released with 'free' of 'elements', 'offDiagonal' and
+ *             'pivots'.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the factors could not be allocated.
+ */
+MatrixStatus factorLDLT(double *elements, int n, Factorization *factors);
+
+
+/*
+ * Function: solveSymmetric
+ * Purpose: Overwrites B with the solution X of A X = B, given the Cholesky or LDL^T factors of A.
+ *
+ * Parameters:
+ *   factors - Factors of the n x n matrix A, of kind FACTOR_CHOLESKY or FACTOR_LDLT; not singular.
+ *   b - n x m row-major right-hand sides.
+ *   ldb - Distance in elements between consecutive rows of 'b'.
+ *   m - Number of right-hand sides.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the GEMM engine could not allocate its buffers.
+ */
+MatrixStatus solveSymmetric(const Factorization *factors, double *b, int ldb, int m);
+
+
+/*
+ * Function: packedRow
+ * Purpose: Locates the diagonal element of a row of packed factors.
+ *
+ * Parameters:
+ *   factors - Factors of kind FACTOR_CHOLESKY or FACTOR_LDLT.
+ *   row - Row of U.
+ *
+ * Returns:
+ *   A pointer to U(row, row), followed by U(row, row + 1) to U(row, n - 1).
+ */
+double *packedRow(const Factorization *factors, int row);
+
+
+/*
+ * Function: packedTriangleSize
+ * Purpose: Counts the elements of the packed factors of a matrix of order n.
+ *
+ * Parameters:
+ *   n - Order of the matrix, at least 1.
+ *
+ * Returns:
+ *   The number of elements, including the unused ones left of the diagonal within the diagonal blocks.
+ */
+size_t packedTriangleSize(int n);
+
+#endif /* MATCHOL_H */
@@ -0,0 +1,584 @@
+/*
+ * Out-of-Core Matrices
+ * --------------------
+ * This C source file implements the disk-backed matrices declared in "matdisk.h".
+ *
+ * Core Functionalities:
+ * 1.   Tile cache:         A fixed number of tile buffers (the memory budget divided by the size of a tile)
+ *                          shared by all disk matrices. Every store maps each of its tiles to the cache entry
+ *                          holding it, so a lookup is one load; a miss evicts the least recently used entry
+ *                          that no operation has pinned, writing it back first if it was modified.
+ * 2.   acquireTile / releaseTile:
+ *                          Present a tile of any matrix as a pointer and a leading dimension: a view into the
+ *                          buffer of a matrix in memory, or a pinned cache entry of a disk matrix. A tile that
+ *                          is about to be overwritten entirely is not read from disk.
+ * 3.   Tiled operations:   Loops over the tiles of the result, pinning at most three tiles at a time and running
+ *                          the SIMD element-wise kernels, a tile transpose or the GEMM engine on them.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "matdisk.h"
+#include "matgemm.h"
+#include "matsimd.h"
+#include "mattrans.h"
+
+
+/* Number of elements and bytes of one tile; edge tiles occupy a whole tile on disk too */
+#define TILE_ELEMENTS ((size_t)DISK_TILE_DIM * DISK_TILE_DIM)
+#define TILE_BYTES (TILE_ELEMENTS * sizeof(double))
+
+/* Tiles the cache holds whatever the budget: the most any operation pins, plus one */
+#define MIN_RESIDENT_TILES 4
+
+/* Directory of the tile files when neither MATRIX_SPILL_DIR nor TMPDIR is set, and the file name pattern */
+#define DEFAULT_SPILL_DIR "/tmp"
+#define SPILL_FILE_TEMPLATE "/mymat-tiles-XXXXXX"
+
+/* Cache entry index of a tile that is not resident */
+#define NO_ENTRY (-1)
+
+/* Number of tiles covering 'n' rows or columns */
+#define TILE_COUNT(n) (((n) + DISK_TILE_DIM - 1) / DISK_TILE_DIM)
+
+
+/* Tiles of one disk matrix */
+struct DiskStore {
+    int fd;                 /* Unlinked file holding the tiles, row of tiles after row of tiles */
+    int tileRows;           /* Number of tiles down the matrix */
+    int tileCols;           /* Number of tiles across the matrix */
+    size_t tileCount;       /* tileRows * tileCols */
+    int *entries;           /* Cache entry holding each tile, or NO_ENTRY */
+};
+
+/* One buffer of the tile cache */
+typedef struct {
+    struct DiskStore *owner;    /* Store of the tile held, or NULL if the entry is free */
+    size_t tile;                /* Index of the tile in its store */
+    double *data;               /* Buffer of TILE_ELEMENTS doubles, kept when the entry is reused */
+    bool dirty;                 /* Whether the buffer differs from the file */
+    int pins;                   /* Number of operations using the tile; pinned entries are not evicted */
+    unsigned long lastUse;      /* Value of the use counter when the tile was last acquired */
+} CacheEntry;
+
+/* Tile of a matrix, presented as a block with a leading dimension */
+typedef struct {
+    double *data;       /* Element (0, 0) of the tile */
+    int ld;             /* Distance in elements between rows of the tile */
+    int rows, cols;     /* Dimensions of the tile; smaller than DISK_TILE_DIM at the bottom and right edges */
+} TileView;
+
+
+static size_t memoryBudget = (size_t)-1;    /* Largest matrix kept in memory, and the size of the cache */
+static CacheEntry *cacheEntries = NULL;     /* Entries of the tile cache */
+static int cacheCount = 0;                  /* Entries in use or holding a buffer */
+static int cacheCapacity = 0;               /* Entries allocated in 'cacheEntries' */
+static int cacheLimit = MIN_RESIDENT_TILES; /* Most entries the budget allows */
+static unsigned long useCounter = 0;        /* Clock of the least-recently-used policy */
+
+
+void initMemoryBudget(size_t bytes) {
+    const char *env;        /* Value of MATRIX_MEMORY_BUDGET */
+    long pages, pageSize;   /* Physical memory */
+    long megabytes;         /* Budget read from the environment */
+
+    if (bytes == 0) {
+        env = getenv(MEMORY_BUDGET_ENV);
+        megabytes = (env != NULL) ? atol(env) : 0;
+        if (megabytes > 0 && (unsigned long)megabytes <= ((size_t)-1 >> 20)) {
+            bytes = (size_t)megabytes << 20;
+        }
+    }
+    if (bytes == 0) {
+        pages = sysconf(_SC_PHYS_PAGES);
+        pageSize = sysconf(_SC_PAGESIZE);
+        bytes = (pages > 0 && pageSize > 0 && (unsigned long)pages <= (size_t)-1 / 2 / (unsigned long)pageSize)
+              ? (size_t)pages * (size_t)pageSize / 2 : (size_t)-1;
+    }
+
+    memoryBudget = bytes;
+    cacheLimit = (bytes / TILE_BYTES > (size_t)MIN_RESIDENT_TILES) ?
+                 ((bytes / TILE_BYTES > (size_t)(INT_MAX / 2)) ? INT_MAX / 2 : (int)(bytes / TILE_BYTES)) :
+                 MIN_RESIDENT_TILES;
+}
+
+
+bool shouldSpill(int rows, int cols) {
+    return rows > 0 && cols > 0 && (size_t)rows > memoryBudget / sizeof(double) / (size_t)cols;
+}
+
+
+static bool transferTile(struct DiskStore *store, size_t tile, double *data, bool write) {
+    /*
+     * Short Description:
+     * Reads or writes one whole tile at its offset in the file, retrying short transfers. Reading past
+     * the end of the file yields zeros.
+     */
+    char *bytes = (char *)data;             /* Position in the buffer */
+    off_t offset = (off_t)tile * (off_t)TILE_BYTES;     /* Position in the file */
+    size_t remaining = TILE_BYTES;          /* Bytes still to transfer */
+    ssize_t count;                          /* Bytes transferred by one call */
+
+    while (remaining > 0) {
+        count = write ? pwrite(store->fd, bytes, remaining, offset) : pread(store->fd, bytes, remaining, offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0 || (count == 0 && write)) {
+            return false;
+        }
+        if (count == 0) {
+            memset(bytes, 0, remaining);
+            break;
+        }
+        bytes += count;
+        offset += count;
+        remaining -= (size_t)count;
+    }
+    return true;
+}
+
+
+static MatrixStatus claimEntry(int *index) {
+    /*
+     * Short Description:
+     * Finds an entry for a new tile: a free one, a newly allocated one while under the limit, or the
+     * least recently used unpinned one, written back if dirty.
+     */
+    CacheEntry *grown;      /* Grown array of entries */
+    CacheEntry *entry;      /* Entry being examined */
+    int capacity;           /* New number of entries */
+    int victim = NO_ENTRY;  /* Least recently used unpinned entry */
+    int candidate;          /* Index for iterating over the entries */
+
+    for (candidate = 0; candidate < cacheCount; ++candidate) {
+        entry = &cacheEntries[candidate];
+        if (entry->owner == NULL) {
+            *index = candidate;
+            return MATRIX_OK;
+        }
+        if (entry->pins == 0 && (victim == NO_ENTRY || entry->lastUse < cacheEntries[victim].lastUse)) {
+            victim = candidate;
+        }
+    }
+
+    if (cacheCount < cacheLimit) {
+        if (cacheCount == cacheCapacity) {
+            capacity = cacheCapacity ? cacheCapacity * 2 : MIN_RESIDENT_TILES;
+            grown = realloc(cacheEntries, (size_t)capacity * sizeof(CacheEntry));
+            if (grown == NULL) {
+                return MATRIX_ALLOCATION_FAILED;
+            }
+            cacheEntries = grown;
+            cacheCapacity = capacity;
+        }
+        entry = &cacheEntries[cacheCount];
+        entry->data = allocElements(TILE_ELEMENTS);
+        if (entry->data == NULL) {
+            return MATRIX_ALLOCATION_FAILED;
+        }
+        entry->owner = NULL;
+        entry->pins = 0;
+        *index = cacheCount++;
+        return MATRIX_OK;
+    }
+
+    if (victim == NO_ENTRY) {
+        return MATRIX_ALLOCATION_FAILED;    /* Every entry is pinned */
+    }
+    entry = &cacheEntries[victim];
+    if (entry->dirty && !transferTile(entry->owner, entry->tile, entry->data, true)) {
+        return MATRIX_FILE_ERROR;
+    }
+    entry->owner->entries[entry->tile] = NO_ENTRY;
+    entry->owner = NULL;
+    *index = victim;
+    return MATRIX_OK;
+}
+
+
+static MatrixStatus acquireTile(const Matrix *mat, int tileRow, int tileCol, bool overwrite, TileView *view) {
+    /*
+     * Short Description:
+     * Presents tile (tileRow, tileCol) of a matrix and pins it if it is on disk. With 'overwrite', the
+     * caller writes every element of the tile, so a tile that is not resident is not read.
+     */
+    struct DiskStore *store = mat->disk;    /* Tiles of a disk matrix */
+    size_t tile;                            /* Index of the tile in the store */
+    CacheEntry *entry;                      /* Entry holding the tile */
+    int index;                              /* Index of the entry */
+    MatrixStatus status;
+
+    view->rows = mat->rows - tileRow * DISK_TILE_DIM;
+    view->cols = mat->cols - tileCol * DISK_TILE_DIM;
+    view->rows = (view->rows < DISK_TILE_DIM) ? view->rows : DISK_TILE_DIM;
+    view->cols = (view->cols < DISK_TILE_DIM) ? view->cols : DISK_TILE_DIM;
+
+    if (store == NULL) {
+        view->data = &MATRIX_AT(mat, tileRow * DISK_TILE_DIM, tileCol * DISK_TILE_DIM);
+        view->ld = mat->ld;
+        return MATRIX_OK;
+    }
+
+    tile = (size_t)tileRow * (size_t)store->tileCols + (size_t)tileCol;
+    index = store->entries[tile];
+    if (index == NO_ENTRY) {
+        status = claimEntry(&index);
+        if (status != MATRIX_OK) {
+            return status;
+        }
+        entry = &cacheEntries[index];
+        if (!overwrite && !transferTile(store, tile, entry->data, false)) {
+            return MATRIX_FILE_ERROR;
+        }
+        entry->owner = store;
+        entry->tile = tile;
+        entry->dirty = false;
+        store->entries[tile] = index;
+    }
+    entry = &cacheEntries[index];
+    entry->pins++;
+    entry->lastUse = ++useCounter;
+    view->data = entry->data;
+    view->ld = DISK_TILE_DIM;
+    return MATRIX_OK;
+}
+
+
+static void releaseTile(const Matrix *mat, int tileRow, int tileCol, bool modified) {
+    /*
+     * Short Description:
+     * Unpins a tile acquired with 'acquireTile', marking it for write-back if it was modified.
+     */
+    struct DiskStore *store = mat->disk;    /* Tiles of a disk matrix */
+    CacheEntry *entry;                      /* Entry holding the tile */
+
+    if (store == NULL) {
+        return;
+    }
+    entry = &cacheEntries[store->entries[(size_t)tileRow * (size_t)store->tileCols + (size_t)tileCol]];
+    entry->pins--;
+    if (modified) {
+        entry->dirty = true;
+    }
+}
+
+
+static void dropTiles(struct DiskStore *store) {
+    /*
+     * Short Description:
+     * Frees the cache entries of a store without writing them back.
+     */
+    int index;      /* Index for iterating over the entries */
+
+    for (index = 0; index < cacheCount; ++index) {
+        if (cacheEntries[index].owner == store) {
+            store->entries[cacheEntries[index].tile] = NO_ENTRY;
+            cacheEntries[index].owner = NULL;
+        }
+    }
+}
+
+
+MatrixStatus createDiskStore(int rows, int cols, struct DiskStore **store) {
+    const char *dir = getenv(SPILL_DIR_ENV);    /* Directory of the file */
+    struct DiskStore *created;                  /* New store */
+    char *path;                                 /* Name of the file until it is unlinked */
+    size_t tile;                                /* Index for iterating over the tiles */
+
+    if (dir == NULL || *dir == '\0') {
+        dir = getenv("TMPDIR");
+    }
+    if (dir == NULL || *dir == '\0') {
+        dir = DEFAULT_SPILL_DIR;
+    }
+
+    created = malloc(sizeof(struct DiskStore));
+    path = malloc(strlen(dir) + sizeof(SPILL_FILE_TEMPLATE));
+    if (created == NULL || path == NULL) {
+        free(created);
+        free(path);
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    created->tileRows = TILE_COUNT(rows);
+    created->tileCols = TILE_COUNT(cols);
+    created->tileCount = (size_t)created->tileRows * (size_t)created->tileCols;
+    created->entries = malloc(created->tileCount * sizeof(int));
+    if (created->entries == NULL) {
+        free(created);
+        free(path);
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    for (tile = 0; tile < created->tileCount; ++tile) {
+        created->entries[tile] = NO_ENTRY;
+    }
+
+    strcpy(path, dir);
+    strcat(path, SPILL_FILE_TEMPLATE);
+    created->fd = mkstemp(path);
+    if (created->fd >= 0) {
+        unlink(path);
+    }
+    free(path);
+    if (created->fd < 0 || ftruncate(created->fd, (off_t)created->tileCount * (off_t)TILE_BYTES) != 0) {
+        if (created->fd >= 0) {
+            close(created->fd);
+        }
+        free(created->entries);
+        free(created);
+        return MATRIX_FILE_ERROR;
+    }
+
+    *store = created;
+    return MATRIX_OK;
+}
+
+
+void freeDiskStore(struct DiskStore *store) {
+    dropTiles(store);
+    close(store->fd);
+    free(store->entries);
+    free(store);
+}
+
+
+MatrixStatus fillTiled(Matrix *mat, const double *values, size_t count) {
+    /*
+     * Short Description:
+     * Empties the file (truncating it back to its size reads as zeros) and writes only the tiles that
+     * receive values.
+     */
+    struct DiskStore *store = mat->disk;    /* Tiles of the matrix */
+    TileView view;                          /* Tile being filled */
+    int tileRow, tileCol;                   /* Indices of the tile */
+    int row, col;                           /* Indices of the element within the tile */
+    size_t position;                        /* Row-major index of the element in the matrix */
+    MatrixStatus status;
+
+    dropTiles(store);
+    if (ftruncate(store->fd, 0) != 0 ||
+        ftruncate(store->fd, (off_t)store->tileCount * (off_t)TILE_BYTES) != 0) {
+        return MATRIX_FILE_ERROR;
+    }
+
+    for (tileRow = 0; tileRow < store->tileRows; ++tileRow) {
+        if ((size_t)tileRow * DISK_TILE_DIM * (size_t)mat->cols >= count) {
+            break;      /* The remaining rows of tiles stay zero */
+        }
+        for (tileCol = 0; tileCol < store->tileCols; ++tileCol) {
+            status = acquireTile(mat, tileRow, tileCol, true, &view);
+            if (status != MATRIX_OK) {
+                return status;
+            }
+            for (row = 0; row < view.rows; ++row) {
+                position = ((size_t)tileRow * DISK_TILE_DIM + (size_t)row) * (size_t)mat->cols +
+                           (size_t)tileCol * DISK_TILE_DIM;
+                for (col = 0; col < view.cols; ++col, ++position) {
+                    view.data[(size_t)row * DISK_TILE_DIM + (size_t)col] = (position < count) ? values[position] : 0.0;
+                }
+            }
+            releaseTile(mat, tileRow, tileCol, true);
+        }
+    }
+    return MATRIX_OK;
+}
+
+
+MatrixStatus readTiledRow(const Matrix *mat, int row, double *buffer) {
+    TileView view;      /* Tile holding part of the row */
+    int tileCol;        /* Index for iterating over the tiles across */
+    MatrixStatus status;
+
+    for (tileCol = 0; tileCol < mat->disk->tileCols; ++tileCol) {
+        status = acquireTile(mat, row / DISK_TILE_DIM, tileCol, false, &view);
+        if (status != MATRIX_OK) {
+            return status;
+        }
+        memcpy(buffer + (size_t)tileCol * DISK_TILE_DIM, view.data + (size_t)(row % DISK_TILE_DIM) * (size_t)view.ld,
+               (size_t)view.cols * sizeof(double));
+        releaseTile(mat, row / DISK_TILE_DIM, tileCol, false);
+    }
+    return MATRIX_OK;
+}
+
+
+MatrixStatus writeTiledRow(Matrix *mat, int row, const double *buffer) {
+    TileView view;      /* Tile holding part of the row */
+    int tileCol;        /* Index for iterating over the tiles across */
+    MatrixStatus status;
+
+    for (tileCol = 0; tileCol < mat->disk->tileCols; ++tileCol) {
+        status = acquireTile(mat, row / DISK_TILE_DIM, tileCol, false, &view);
+        if (status != MATRIX_OK) {
+            return status;
+        }
+        memcpy(view.data + (size_t)(row % DISK_TILE_DIM) * (size_t)view.ld, buffer + (size_t)tileCol * DISK_TILE_DIM,
+               (size_t)view.cols * sizeof(double));
+        releaseTile(mat, row / DISK_TILE_DIM, tileCol, true);
+    }
+    return MATRIX_OK;
+}
+
+
+static MatrixStatus elementwiseTiled(const Matrix *mat1, const Matrix *mat2, double scalar,
+                                     void (*binary)(const double *, const double *, double *, size_t),
+                                     Matrix *result) {
+    /*
+     * Short Description:
+     * result = binary(mat1, mat2), or scalar * mat1 when 'binary' is NULL, one tile at a time. The
+     * operands are acquired before the result, so a result that is also an operand finds its tile
+     * already read.
+     */
+    TileView a, b, c;           /* Tiles of the operands and of the result */
+    int tileRow, tileCol;       /* Indices of the tile */
+    int tileRows = TILE_COUNT(mat1->rows);  /* Tiles down the matrices */
+    int tileCols = TILE_COUNT(mat1->cols);  /* Tiles across the matrices */
+    int row;                    /* Index for iterating over the rows of a tile */
+    const SimdKernels *kernels = getSimdKernels();  /* Element-wise kernels */
+    MatrixStatus status;
+
+    status = resizeMatrix(result, mat1->rows, mat1->cols);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    for (tileRow = 0; tileRow < tileRows; ++tileRow) {
+        for (tileCol = 0; tileCol < tileCols; ++tileCol) {
+            status = acquireTile(mat1, tileRow, tileCol, false, &a);
+            if (status != MATRIX_OK) {
+                return status;
+            }
+            if (binary != NULL) {
+                status = acquireTile(mat2, tileRow, tileCol, false, &b);
+                if (status != MATRIX_OK) {
+                    releaseTile(mat1, tileRow, tileCol, false);
+                    return status;
+                }
+            }
+            status = acquireTile(result, tileRow, tileCol, true, &c);
+            if (status != MATRIX_OK) {
+                if (binary != NULL) {
+                    releaseTile(mat2, tileRow, tileCol, false);
+                }
+                releaseTile(mat1, tileRow, tileCol, false);
+                return status;
+            }
+
+            for (row = 0; row < c.rows; ++row) {
+                if (binary != NULL) {
+                    binary(a.data + (size_t)row * a.ld, b.data + (size_t)row * b.ld, c.data + (size_t)row * c.ld,
+                           (size_t)c.cols);
+                } else {
+                    kernels->scale(a.data + (size_t)row * a.ld, scalar, c.data + (size_t)row * c.ld, (size_t)c.cols);
+                }
+            }
+
+            releaseTile(result, tileRow, tileCol, true);
+            if (binary != NULL) {
+                releaseTile(mat2, tileRow, tileCol, false);
+            }
+            releaseTile(mat1, tileRow, tileCol, false);
+        }
+    }
+    return MATRIX_OK;
+}
+
+
+MatrixStatus addTiled(const Matrix *mat1, const Matrix *mat2, Matrix *result) {
+    if (mat1->rows != mat2->rows || mat1->cols != mat2->cols) {
+        return MATRIX_DIMENSION_MISMATCH;
+    }
+    return elementwiseTiled(mat1, mat2, 0.0, getSimdKernels()->add, result);
+}
+
+
+MatrixStatus subTiled(const Matrix *mat1, const Matrix *mat2, Matrix *result) {
+    if (mat1->rows != mat2->rows || mat1->cols != mat2->cols) {
+        return MATRIX_DIMENSION_MISMATCH;
+    }
+    return elementwiseTiled(mat1, mat2, 0.0, getSimdKernels()->sub, result);
+}
+
+
+MatrixStatus scaleTiled(const Matrix *mat, double scalar, Matrix *result) {
+    return elementwiseTiled(mat, NULL, scalar, NULL, result);
+}
+
+
+MatrixStatus transposeTiled(const Matrix *mat, Matrix *result) {
+    TileView a, c;              /* Tile of the operand and the mirrored tile of the result */
+    int tileRow, tileCol;       /* Indices of the tile of the operand */
+    MatrixStatus status;
+
+    status = resizeMatrix(result, mat->cols, mat->rows);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    for (tileRow = 0; tileRow < TILE_COUNT(mat->rows); ++tileRow) {
+        for (tileCol = 0; tileCol < TILE_COUNT(mat->cols); ++tileCol) {
+            status = acquireTile(mat, tileRow, tileCol, false, &a);
+            if (status != MATRIX_OK) {
+                return status;
+            }
+            status = acquireTile(result, tileCol, tileRow, true, &c);
+            if (status != MATRIX_OK) {
+                releaseTile(mat, tileRow, tileCol, false);
+                return status;
+            }
+            transposeBuffer(a.rows, a.cols, a.data, a.ld, c.data, c.ld);
+            releaseTile(result, tileCol, tileRow, true);
+            releaseTile(mat, tileRow, tileCol, false);
+        }
+    }
+    return MATRIX_OK;
+}
+
+
+MatrixStatus multiplyTiled(const Matrix *mat1, const Matrix *mat2, Matrix *result) {
+    TileView a, b, c;           /* Tiles of the operands and of the result */
+    int tileRow, tileCol;       /* Indices of the tile of the result */
+    int tileInner;              /* Index of the tile along the inner dimension */
+    MatrixStatus status;
+
+    if (mat1->cols != mat2->rows) {
+        return MATRIX_DIMENSION_MISMATCH;
+    }
+    status = resizeMatrix(result, mat1->rows, mat2->cols);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    for (tileRow = 0; tileRow < TILE_COUNT(mat1->rows); ++tileRow) {
+        for (tileCol = 0; tileCol < TILE_COUNT(mat2->cols); ++tileCol) {
+            status = acquireTile(result, tileRow, tileCol, true, &c);
+            if (status != MATRIX_OK) {
+                return status;
+            }
+            for (tileInner = 0; tileInner < TILE_COUNT(mat1->cols) && status == MATRIX_OK; ++tileInner) {
+                status = acquireTile(mat1, tileRow, tileInner, false, &a);
+                if (status != MATRIX_OK) {
+                    break;
+                }
+                status = acquireTile(mat2, tileInner, tileCol, false, &b);
+                if (status == MATRIX_OK) {
+                    /* The first product overwrites the tile of the result, the others accumulate */
+                    status = gemm(GEMM_NO_TRANS, GEMM_NO_TRANS, c.rows, c.cols, a.cols, 1.0, a.data, a.ld,
+                                  b.data, b.ld, (tileInner == 0) ? 0.0 : 1.0, c.data, c.ld);
+                    releaseTile(mat2, tileInner, tileCol, false);
+                }
+                releaseTile(mat1, tileRow, tileInner, false);
+            }
+            releaseTile(result, tileRow, tileCol, true);
+            if (status != MATRIX_OK) {
+                return status;
+            }
+        }
+    }
+    return MATRIX_OK;
+}
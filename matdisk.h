@@ -0,0 +1,214 @@
+/*
+ * Out-of-Core Matrices Header
+ * ---------------------------
+ * This C header file declares the disk-backed matrices implemented in "matdisk.c". A matrix whose elements
+ * would take more than the memory budget is stored in an unlinked temporary file as square tiles of
+ * DISK_TILE_DIM x DISK_TILE_DIM elements, each tile contiguous on disk. Tiles are read with pread(2) into a
+ * cache shared by every disk matrix; the cache holds at most the memory budget and writes modified tiles
+ * back with pwrite(2) when it evicts the least recently used one.
+ *
+ * The element-wise operations, transposes and products of "mymat.c" hand any operation that involves a
+ * disk matrix (as an operand or as a result too large for memory) to the tiled versions declared here.
+ * They stream the operands tile by tile, so only a few tiles per operand need to be resident at a time;
+ * operands in memory take part through views of their tiles, without copies. Scripts do not change:
+ * whether a matrix lives in memory or on disk is decided by its size alone.
+ *
+ * Core Functions:
+ * - initMemoryBudget:  Sets the budget (default: MATRIX_MEMORY_BUDGET or half of the physical memory).
+ * - shouldSpill:       Tells whether a matrix of a given shape is stored on disk.
+ * - createDiskStore / freeDiskStore:
+ *                      Give a matrix zero-filled tiles on disk, and release them.
+ * - fillTiled:         Implements 'readMatrix' for disk matrices.
+ * - readTiledRow:      Gathers one row of a disk matrix, for printing and saving.
+ * - writeTiledRow:     Scatters one row into a disk matrix, for expanding a sparse matrix.
+ * - addTiled / subTiled / scaleTiled / transposeTiled / multiplyTiled:
+ *                      Tiled versions of the operations of "mymat.c".
+ *
+ * Note:
+ * The tiled operations require that a result whose shape differs from its operands (transpose, product)
+ * is not also one of them; the callers in "mymat.c" go through a temporary matrix in that case.
+ */
+
+#ifndef MATDISK_H
+#define MATDISK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "mymat.h"
+
+/* Dimension of the square tiles of disk matrices: 2 MiB of doubles */
+#define DISK_TILE_DIM 512
+
+/* Environment variable giving the memory budget in MiB when no option sets it */
+#define MEMORY_BUDGET_ENV "MATRIX_MEMORY_BUDGET"
+
+/* Environment variable naming the directory of the tile files (default: TMPDIR, then /tmp) */
+#define SPILL_DIR_ENV "MATRIX_SPILL_DIR"
+
+
+/*
+ * Function: initMemoryBudget
+ * Purpose: Sets the memory budget of matrices.
+ * Detailed Description:
+ *   Matrices larger than the budget are stored on disk, and the tile cache of disk matrices holds at most
+ *   the budget (but always the few tiles one operation works on). A budget of 0 selects the value of the
+ *   MATRIX_MEMORY_BUDGET environment variable (in MiB) or, without it, half of the physical memory.
+ *
+ * Parameters:
+ *   bytes - The budget in bytes, or 0 for the default.
+ *
+ * Returns: None (void function).
+ */
+void initMemoryBudget(size_t bytes);
+
+
+/*
+ * Function: shouldSpill
+ * Purpose: Tells whether a rows x cols matrix exceeds the memory budget and belongs on disk.
+ *
+ * Parameters:
+ *   rows, cols - Shape of the matrix.
+ *
+ * Returns:
+ *   true if the matrix is stored on disk; false if it is kept in memory.
+ */
+bool shouldSpill(int rows, int cols);
+
+
+/*
+ * Function: createDiskStore
+ * Purpose: Creates the zero-filled tile file of a rows x cols disk matrix.
+ * Detailed Description:
+ *   The file is created in MATRIX_SPILL_DIR (or TMPDIR, or /tmp) and unlinked at once, so it disappears
+ *   when it is closed, even if the program is killed. Its size is set with ftruncate(2) without writing,
+ *   so a new disk matrix costs no I/O and tiles that are never written take no disk space.
+ *
+ * Parameters:
+ *   rows, cols - Shape of the matrix.
+ *   store - Receives the new store.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_FILE_ERROR if the file could not be created or sized,
+ *   MATRIX_ALLOCATION_FAILED if its bookkeeping could not be allocated.
+ */
+MatrixStatus createDiskStore(int rows, int cols, struct DiskStore **store);
+
+
+/*
+ * Function: freeDiskStore
+ * Purpose: Drops the cached tiles of a disk matrix and closes (thereby deletes) its file.
+ *
+ * Parameters:
+ *   store - The store to release.
+ *
+ * Returns: None (void function).
+ */
+void freeDiskStore(struct DiskStore *store);
+
+
+/*
+ * Function: fillTiled
+ * Purpose: Assigns row-major values to a disk matrix, padding with zeros.
+ *
+ * Parameters:
+ *   mat - Pointer to the disk Matrix.
+ *   values - The values, or NULL if 'count' is 0.
+ *   count - Number of values.
+ *
+ * Returns:
+ *   MATRIX_OK on success, or the status of a failed tile access.
+ */
+MatrixStatus fillTiled(Matrix *mat, const double *values, size_t count);
+
+
+/*
+ * Function: readTiledRow
+ * Purpose: Copies one row of a disk matrix into a buffer.
+ *
+ * Parameters:
+ *   mat - Pointer to the disk Matrix.
+ *   row - Index of the row.
+ *   buffer - Receives the 'mat->cols' elements of the row.
+ *
+ * Returns:
+ *   MATRIX_OK on success, or the status of a failed tile access.
+ */
+MatrixStatus readTiledRow(const Matrix *mat, int row, double *buffer);
+
+
+/*
+ * Function: writeTiledRow
+ * Purpose: Copies a buffer into one row of a disk matrix.
+ *
+ * Parameters:
+ *   mat - Pointer to the disk Matrix.
+ *   row - Index of the row.
+ *   buffer - The 'mat->cols' elements of the row.
+ *
+ * Returns:
+ *   MATRIX_OK on success, or the status of a failed tile access.
+ */
+MatrixStatus writeTiledRow(Matrix *mat, int row, const double *buffer);
+
+
+/*
+ * Function: addTiled / subTiled
+ * Purpose: result = mat1 + mat2 and result = mat1 - mat2, tile by tile.
+ *
+ * Parameters:
+ *   mat1, mat2 - Operands of equal shape, in memory or on disk.
+ *   result - Receives the result; it may be one of the operands.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_DIMENSION_MISMATCH if the shapes differ, or the status of a failed
+ *   allocation or tile access.
+ */
+MatrixStatus addTiled(const Matrix *mat1, const Matrix *mat2, Matrix *result);
+MatrixStatus subTiled(const Matrix *mat1, const Matrix *mat2, Matrix *result);
+
+
+/*
+ * Function: scaleTiled
+ * Purpose: result = scalar * mat, tile by tile.
+ *
+ * Parameters:
+ *   mat - The operand, in memory or on disk.
+ *   scalar - The factor.
+ *   result - Receives the result; it may be the operand.
+ *
+ * Returns:
+ *   MATRIX_OK on success, or the status of a failed allocation or tile access.
+ */
+MatrixStatus scaleTiled(const Matrix *mat, double scalar, Matrix *result);
+
+
+/*
+ * Function: transposeTiled
+ * Purpose: result = transpose(mat): tile (i, j) of the operand becomes tile (j, i) of the result.
+ *
+ * Parameters:
+ *   mat - The operand, in memory or on disk.
+ *   result - Receives the result; it must not be the operand.
+ *
+ * Returns:
+ *   MATRIX_OK on success, or the status of a failed allocation or tile access.
+ */
+MatrixStatus transposeTiled(const Matrix *mat, Matrix *result);
+
+
+/*
+ * Function: multiplyTiled
+ * Purpose: result = mat1 * mat2 by tiles: every tile of the result accumulates the GEMM products of a
+ *          tile row of 'mat1' and a tile column of 'mat2', so three tiles are worked on at a time.
+ *
+ * Parameters:
+ *   mat1, mat2 - Operands with mat1->cols == mat2->rows, in memory or on disk.
+ *   result - Receives the result; it must be neither operand.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_DIMENSION_MISMATCH if the inner dimensions differ, or the status of
+ *   a failed allocation or tile access.
+ */
+MatrixStatus multiplyTiled(const Matrix *mat1, const Matrix *mat2, Matrix *result);
+
+#endif /* MATDISK_H */
@@ -0,0 +1,687 @@
+/*
+ * Eigenvalue Decomposition
+ * ------------------------
+ * This C source file implements the symmetric eigenvalue decomposition and the singular value
+ * decomposition declared in "mateig.h".
+ *
+ * Core Functionalities:
+ * 1.   reduceTridiagonal:      LAPACK's 'dsytrd' and 'dlatrd' on the full matrix. Within a panel, each row
+ *                              is brought up to date from the V and W of the reflectors before it, and
+ *                              w = tau (A v - V W^T v - W V^T v) costs one product with the rest of the
+ *                              matrix ('multiplyRows'). The rest is updated by A -= V W^T + W V^T, two
+ *                              'gemm' calls per panel. Reflector j is kept in column j below the subdiagonal.
+ * 2.   reduceBidiagonal:       LAPACK's 'dgebrd' and 'dlabrd', for at least as many rows as columns. The
+ *                              left reflectors are kept in the columns below the diagonal as by 'factorQR',
+ *                              the right ones in the rows right of the superdiagonal, and the rest of the
+ *                              matrix is updated by A -= U Y^T + X V^T once per panel.
+ * 3.   diagonalizeTridiagonal: Implicit QL iteration with Wilkinson shifts, from 'tql2' of EISPACK.
+ * 4.   diagonalizeBidiagonal:  Golub-Kahan implicit shifted QR iteration, from 'svd' of EISPACK.
+ * 5.   applyStoredReflectors:  Gathers stored reflectors by blocks of QR_BLOCK ('formBlockFactor') and
+ *                              applies the blocks to the vectors from the last one back ('applyReflectors').
+ * 6.   eigenSymmetricMatrix / svdMatrix:
+ *                              Export the matrix, reduce it, diagonalize the reduced matrix, sort the values
+ *                              and bring the vectors back to the basis of the matrix.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "mateig.h"
+#include "matfactor.h"
+#include "matqr.h"
+#include "matgemm.h"
+#include "matsimd.h"
+#include "matpool.h"
+#include "mattrans.h"
+
+
+/* Product of some rows of a matrix with a vector, split across the thread pool */
+typedef struct {
+    const double *a;    /* First row of the matrix */
+    int lda;            /* Distance in elements between consecutive rows */
+    int cols;           /* Elements of every row and of the vector */
+    const double *v;    /* Vector */
+    double *w;          /* Receives one product per row */
+} RowProducts;
+
+
+static double dotProduct(const double *x, const double *y, int count) {
+    double sum = 0.0;   /* Sum of the products */
+    int index;          /* Variable for iterating over the elements */
+
+    for (index = 0; index < count; ++index) {
+        sum += x[index] * y[index];
+    }
+    return sum;
+}
+
+
+static double pythag(double a, double b) {
+    /*
+     * Short Description:
+     * Returns sqrt(a^2 + b^2) without overflow or destructive underflow.
+     */
+    double absA = (a < 0.0) ? -a : a;   /* Magnitude of a */
+    double absB = (b < 0.0) ? -b : b;   /* Magnitude of b */
+    double ratio;                       /* Smaller magnitude over the larger */
+
+    if (absA > absB) {
+        ratio = absB / absA;
+        return absA * sqrt(1.0 + ratio * ratio);
+    }
+    if (absB == 0.0) {
+        return 0.0;
+    }
+    ratio = absA / absB;
+    return absB * sqrt(1.0 + ratio * ratio);
+}
+
+
+static void runRowProducts(size_t begin, size_t end, int worker, void *arg) {
+    const RowProducts *task = (const RowProducts *)arg;     /* Matrix, vector and products */
+    size_t row;                                             /* Variable for iterating over the rows */
+
+    (void)worker;
+    for (row = begin; row < end; ++row) {
+        task->w[row] = dotProduct(&task->a[row * (size_t)task->lda], task->v, task->cols);
+    }
+}
+
+
+static void multiplyRows(const double *a, int lda, int rows, int cols, const double *v, double *w) {
+    /*
+     * Short Description:
+     * w = A v for a rows x cols block of a row-major matrix, one contiguous dot product per row; the
+     * rows are split across the pool once they hold PARALLEL_MIN_ELEMENTS elements.
+     */
+    RowProducts task;   /* Arguments of the parallel loop */
+
+    task.a = a;
+    task.lda = lda;
+    task.cols = cols;
+    task.v = v;
+    task.w = w;
+    parallelFor((size_t)rows, (size_t)(PARALLEL_MIN_ELEMENTS / (cols + 1) + 1), runRowProducts, &task);
+}
+
+
+static MatrixStatus reduceTridiagonal(double *a, int n, double *d, double *e, double *tau) {
+    /*
+     * Short Description:
+     * Reduces the symmetric n x n matrix to T = Q^T A Q, Q = H_0 ... H_n-2, where H_j acts on rows and
+     * columns j + 1 .. n - 1. Both triangles are read and kept up to date, so every product runs along
+     * rows. V and W of the current panel are kept transposed, one contiguous row per reflector.
+     */
+    const SimdKernels *simd = getSimdKernels();     /* Element-wise kernels */
+    double *vt;             /* Reflectors of the panel, by rows of n elements */
+    double *wt;             /* tau (A v - ...) of the panel, by rows of n elements */
+    double *row;            /* Row of the matrix being reduced */
+    double *v, *w;          /* Reflector and its W of the current column */
+    double alpha;           /* Correction making the update symmetric */
+    double y, z;            /* Products of the reflector with earlier W and V */
+    int start, end;         /* Rows of the current panel */
+    int width;              /* Rows of the current panel */
+    int j, i, p, c;         /* Row, its index in the panel, earlier reflector and column */
+    int length;             /* Elements of the reflector, n - j - 1 */
+    MatrixStatus status = MATRIX_OK;
+
+    vt = allocElements(2 * (size_t)QR_BLOCK * (size_t)n);
+    if (vt == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    wt = vt + (size_t)QR_BLOCK * (size_t)n;
+
+    for (start = 0; start < n && status == MATRIX_OK; start = end) {
+        end = (n - start < QR_BLOCK) ? n : start + QR_BLOCK;
+        width = end - start;
+        memset(vt, 0, 2 * (size_t)QR_BLOCK * (size_t)n * sizeof(double));
+
+        for (j = start; j < end; ++j) {
+            i = j - start;
+            row = &a[(size_t)j * n];
+            for (p = 0; p < i; ++p) {
+                simd->axpy(&wt[(size_t)p * n + j], -vt[(size_t)p * n + j], &row[j], (size_t)(n - j));
+                simd->axpy(&vt[(size_t)p * n + j], -wt[(size_t)p * n + j], &row[j], (size_t)(n - j));
+            }
+            d[j] = row[j];
+            if (j == n - 1) {
+                break;
+            }
+
+            length = n - j - 1;
+            tau[j] = generateReflector(&row[j + 1], length, 1);
+            e[j] = row[j + 1];
+            v = &vt[(size_t)i * n + j + 1];
+            v[0] = 1.0;
+            for (c = j + 2; c < n; ++c) {
+                v[c - j - 1] = row[c];
+                a[(size_t)c * n + j] = row[c];
+            }
+            if (tau[j] == 0.0) {
+                continue;   /* H_j = I, and its W stays zero */
+            }
+
+            /* w = tau (A v - V W^T v - W V^T v), then w -= (tau / 2)(w^T v) v */
+            w = &wt[(size_t)i * n + j + 1];
+            multiplyRows(&a[(size_t)(j + 1) * n + j + 1], n, length, length, v, w);
+            for (p = 0; p < i; ++p) {
+                y = dotProduct(&wt[(size_t)p * n + j + 1], v, length);
+                z = dotProduct(&vt[(size_t)p * n + j + 1], v, length);
+                simd->axpy(&vt[(size_t)p * n + j + 1], -y, w, (size_t)length);
+                simd->axpy(&wt[(size_t)p * n + j + 1], -z, w, (size_t)length);
+            }
+            simd->scale(w, tau[j], w, (size_t)length);
+            alpha = -0.5 * tau[j] * dotProduct(w, v, length);
+            simd->axpy(v, alpha, w, (size_t)length);
+        }
+
+        if (end < n) {
+            status = gemm(GEMM_TRANS, GEMM_NO_TRANS, n - end, n - end, width, -1.0, &vt[end], n, &wt[end], n,
+                          1.0, &a[(size_t)end * n + end], n);
+        }
+        if (status == MATRIX_OK && end < n) {
+            status = gemm(GEMM_TRANS, GEMM_NO_TRANS, n - end, n - end, width, -1.0, &wt[end], n, &vt[end], n,
+                          1.0, &a[(size_t)end * n + end], n);
+        }
+    }
+    free(vt);
+    return status;
+}
+
+
+static MatrixStatus reduceBidiagonal(double *a, int m, int n, double *d, double *e, double *tauq, double *taup) {
+    /*
+     * Short Description:
+     * Reduces the m x n matrix, m >= n, to the upper bidiagonal B = Q^T A P, with Q = H_0 ... H_n-1 and
+     * P = G_0 ... G_n-2, where G_j acts on columns j + 1 .. n - 1. The unit elements of the reflectors
+     * of a panel are stored in place while it is reduced, as 'dlabrd' does, so that the products with
+     * them need no special case.
+     */
+    const SimdKernels *simd = getSimdKernels();     /* Element-wise kernels */
+    double *x;              /* X of the panel, m rows of QR_BLOCK elements */
+    double *y;              /* Y of the panel, n rows of QR_BLOCK elements */
+    double *work;           /* Products with the rest of the matrix */
+    double column[QR_BLOCK];    /* Elements of earlier right reflectors in the current column */
+    double sumsU[QR_BLOCK];     /* Earlier left reflectors times the current one */
+    double sumsX[QR_BLOCK];     /* Earlier X times the current left reflector */
+    double sumsY[QR_BLOCK];     /* Y times the current right reflector */
+    double sumsV[QR_BLOCK];     /* Earlier right reflectors times the current one */
+    double *u;              /* Row of the matrix */
+    double *v;              /* Current right reflector */
+    int start, end;         /* Columns of the current panel */
+    int width;              /* Columns of the current panel */
+    int j, i, p, r, c;      /* Column, its index in the panel, earlier reflector, row and column */
+    int length;             /* Elements of the right reflector, n - j - 1 */
+    MatrixStatus status = MATRIX_OK;
+
+    x = allocElements(((size_t)m + (size_t)n) * QR_BLOCK + (size_t)m);
+    if (x == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    y = x + (size_t)m * QR_BLOCK;
+    work = y + (size_t)n * QR_BLOCK;
+
+    for (start = 0; start < n && status == MATRIX_OK; start = end) {
+        end = (n - start < QR_BLOCK) ? n : start + QR_BLOCK;
+        width = end - start;
+
+        for (j = start; j < end; ++j) {
+            i = j - start;
+
+            /* A(j:m, j) -= A(j:m, start:j) Y(j, 0:i)^T + X(j:m, 0:i) A(start:j, j) */
+            for (p = 0; p < i; ++p) {
+                column[p] = a[(size_t)(start + p) * n + j];
+            }
+            for (r = j; r < m && i > 0; ++r) {
+                u = &a[(size_t)r * n];
+                u[j] -= dotProduct(&u[start], &y[(size_t)j * QR_BLOCK], i) + dotProduct(&x[(size_t)r * QR_BLOCK], column, i);
+            }
+            tauq[j] = generateReflector(&a[(size_t)j * n + j], m - j, n);
+            d[j] = a[(size_t)j * n + j];
+            if (j == n - 1) {
+                break;
+            }
+            a[(size_t)j * n + j] = 1.0;
+            length = n - j - 1;
+
+            /* Y(j+1:n, i) = tauq (A(j:m, j+1:n)^T u - Y(j+1:n, 0:i) U^T u - A(start:j, j+1:n)^T X^T u) */
+            memset(work, 0, (size_t)length * sizeof(double));
+            memset(sumsU, 0, sizeof(sumsU));
+            memset(sumsX, 0, sizeof(sumsX));
+            for (r = j; r < m; ++r) {
+                u = &a[(size_t)r * n];
+                if (u[j] != 0.0) {
+                    simd->axpy(&u[j + 1], u[j], work, (size_t)length);
+                    simd->axpy(&u[start], u[j], sumsU, (size_t)i);
+                    simd->axpy(&x[(size_t)r * QR_BLOCK], u[j], sumsX, (size_t)i);
+                }
+            }
+            for (p = 0; p < i; ++p) {
+                simd->axpy(&a[(size_t)(start + p) * n + j + 1], -sumsX[p], work, (size_t)length);
+            }
+            for (c = j + 1; c < n; ++c) {
+                y[(size_t)c * QR_BLOCK + i] = tauq[j] * (work[c - j - 1] - dotProduct(&y[(size_t)c * QR_BLOCK], sumsU, i));
+            }
+
+            /* A(j, j+1:n) -= Y(j+1:n, 0:i+1) A(j, start:j+1)^T + A(start:j, j+1:n)^T X(j, 0:i)^T */
+            u = &a[(size_t)j * n];
+            for (c = j + 1; c < n; ++c) {
+                u[c] -= dotProduct(&y[(size_t)c * QR_BLOCK], &u[start], i + 1);
+            }
+            for (p = 0; p < i; ++p) {
+                simd->axpy(&a[(size_t)(start + p) * n + j + 1], -x[(size_t)j * QR_BLOCK + p], &u[j + 1], (size_t)length);
+            }
+            taup[j] = generateReflector(&u[j + 1], length, 1);
+            e[j] = u[j + 1];
+            u[j + 1] = 1.0;
+            v = &u[j + 1];
+
+            /* X(j+1:m, i) = taup (A(j+1:m, j+1:n) v - A(j+1:m, start:j+1) Y^T v - X(j+1:m, 0:i) A(start:j, j+1:n) v) */
+            memset(sumsY, 0, sizeof(sumsY));
+            for (c = j + 1; c < n; ++c) {
+                simd->axpy(&y[(size_t)c * QR_BLOCK], v[c - j - 1], sumsY, (size_t)(i + 1));
+            }
+            for (p = 0; p < i; ++p) {
+                sumsV[p] = dotProduct(&a[(size_t)(start + p) * n + j + 1], v, length);
+            }
+            multiplyRows(&a[(size_t)(j + 1) * n + j + 1], n, m - j - 1, length, v, work);
+            for (r = j + 1; r < m; ++r) {
+                x[(size_t)r * QR_BLOCK + i] = taup[j] * (work[r - j - 1] - dotProduct(&a[(size_t)r * n + start], sumsY, i + 1)
+                                                         - dotProduct(&x[(size_t)r * QR_BLOCK], sumsV, i));
+            }
+        }
+
+        if (end < n) {
+            status = gemm(GEMM_NO_TRANS, GEMM_TRANS, m - end, n - end, width, -1.0, &a[(size_t)end * n + start], n,
+                          &y[(size_t)end * QR_BLOCK], QR_BLOCK, 1.0, &a[(size_t)end * n + end], n);
+        }
+        if (status == MATRIX_OK && end < n) {
+            status = gemm(GEMM_NO_TRANS, GEMM_NO_TRANS, m - end, n - end, width, -1.0, &x[(size_t)end * QR_BLOCK],
+                          QR_BLOCK, &a[(size_t)start * n + end], n, 1.0, &a[(size_t)end * n + end], n);
+        }
+    }
+    free(x);
+    return status;
+}
+
+
+static MatrixStatus diagonalizeTridiagonal(double *d, double *e, double *zt, int n) {
+    /*
+     * Short Description:
+     * Overwrites d with the eigenvalues of the tridiagonal matrix with diagonal d and e[j] beside (j, j),
+     * e[n - 1] being 0, and applies every rotation to the rows of zt.
+     */
+    const SimdKernels *simd = getSimdKernels();     /* Element-wise kernels */
+    double shift;           /* Wilkinson shift, then the chased element */
+    double radius;          /* Norm of the rotated pair */
+    double s, c, p;         /* Sine, cosine and change of the diagonal element */
+    double f, b;            /* Elements of the chased bulge */
+    double g;               /* Element rotated next */
+    double sum;             /* |d[m]| + |d[m + 1]|, against which e[m] is negligible */
+    int l, m, i;            /* First and last rows of the unreduced block, and row being rotated */
+    int iterations;         /* Iterations spent on the current eigenvalue */
+
+    for (l = 0; l < n; ++l) {
+        iterations = 0;
+        do {
+            for (m = l; m < n - 1; ++m) {
+                sum = fabs(d[m]) + fabs(d[m + 1]);
+                if (fabs(e[m]) <= DBL_EPSILON * sum) {
+                    break;
+                }
+            }
+            if (m == l) {
+                break;
+            }
+            if (iterations++ == EIG_MAX_ITERATIONS) {
+                return MATRIX_NOT_CONVERGED;
+            }
+
+            g = (d[l + 1] - d[l]) / (2.0 * e[l]);
+            radius = pythag(g, 1.0);
+            shift = d[m] - d[l] + e[l] / (g + ((g >= 0.0) ? radius : -radius));
+            s = 1.0;
+            c = 1.0;
+            p = 0.0;
+            g = shift;
+            for (i = m - 1; i >= l; --i) {
+                f = s * e[i];
+                b = c * e[i];
+                radius = pythag(f, g);
+                e[i + 1] = radius;
+                if (radius == 0.0) {
+                    /* The block splits: deflate and restart */
+                    d[i + 1] -= p;
+                    e[m] = 0.0;
+                    break;
+                }
+                s = f / radius;
+                c = g / radius;
+                g = d[i + 1] - p;
+                radius = (d[i] - g) * s + 2.0 * c * b;
+                p = s * radius;
+                d[i + 1] = g + p;
+                g = c * radius - b;
+                simd->rot(&zt[(size_t)i * n], &zt[(size_t)(i + 1) * n], c, -s, (size_t)n);
+            }
+            if (i >= l) {
+                continue;
+            }
+            d[l] -= p;
+            e[l] = g;
+            e[m] = 0.0;
+        } while (true);
+    }
+    return MATRIX_OK;
+}
+
+
+static MatrixStatus diagonalizeBidiagonal(double *w, double *super, double *ut, double *vt, int n) {
+    /*
+     * Short Description:
+     * Overwrites w with the singular values of the upper bidiagonal matrix with diagonal w and super[k]
+     * above (k, k), super[0] being 0, and applies every left rotation to the rows of ut and every right
+     * rotation to those of vt. The singular values are made non-negative by flipping rows of vt.
+     */
+    const SimdKernels *simd = getSimdKernels();     /* Element-wise kernels */
+    double norm = 0.0;      /* Largest |w[k]| + |super[k]|, the scale of negligible elements */
+    double c, s;            /* Cosine and sine of a rotation */
+    double f, g, h;         /* Elements being rotated */
+    double x, y, z;         /* Elements of the trailing 2x2 block, then of the chase */
+    bool cancel;            /* Whether w[l - 1] is negligible rather than super[l] */
+    int k, l, i, j;         /* Value being found, first row of its block and rows being rotated */
+    int iterations;         /* Iterations spent on the current singular value */
+
+    for (k = 0; k < n; ++k) {
+        x = fabs(w[k]) + fabs(super[k]);
+        norm = (x > norm) ? x : norm;
+    }
+
+    for (k = n - 1; k >= 0; --k) {
+        for (iterations = 0; ; ++iterations) {
+            /* Find the unreduced block l .. k; super[0] = 0 stops the search */
+            cancel = true;
+            for (l = k; l >= 0; --l) {
+                if (fabs(super[l]) <= DBL_EPSILON * norm) {
+                    cancel = false;
+                    break;
+                }
+                if (fabs(w[l - 1]) <= DBL_EPSILON * norm) {
+                    break;
+                }
+            }
+            if (cancel) {
+                /* w[l - 1] is zero: rotate super[l] .. away against the rows below */
+                c = 0.0;
+                s = 1.0;
+                for (i = l; i <= k; ++i) {
+                    f = s * super[i];
+                    super[i] = c * super[i];
+                    if (fabs(f) <= DBL_EPSILON * norm) {
+                        break;
+                    }
+                    g = w[i];
+                    h = pythag(f, g);
+                    w[i] = h;
+                    c = g / h;
+                    s = -f / h;
+                    simd->rot(&ut[(size_t)(l - 1) * n], &ut[(size_t)i * n], c, s, (size_t)n);
+                }
+            }
+
+            z = w[k];
+            if (l == k) {
+                if (z < 0.0) {
+                    w[k] = -z;
+                    simd->scale(&vt[(size_t)k * n], -1.0, &vt[(size_t)k * n], (size_t)n);
+                }
+                break;
+            }
+            if (iterations == EIG_MAX_ITERATIONS) {
+                return MATRIX_NOT_CONVERGED;
+            }
+
+            /* Shift from the trailing 2x2 block of B^T B */
+            x = w[l];
+            y = w[k - 1];
+            g = super[k - 1];
+            h = super[k];
+            f = ((y - z) * (y + z) + (g - h) * (g + h)) / (2.0 * h * y);
+            g = pythag(f, 1.0);
+            f = ((x - z) * (x + z) + h * ((y / (f + ((f >= 0.0) ? g : -g))) - h)) / x;
+
+            /* Chase the bulge down the block */
+            c = 1.0;
+            s = 1.0;
+            for (j = l; j < k; ++j) {
+                i = j + 1;
+                g = super[i];
+                y = w[i];
+                h = s * g;
+                g = c * g;
+                z = pythag(f, h);
+                super[j] = z;
+                c = f / z;
+                s = h / z;
+                f = x * c + g * s;
+                g = g * c - x * s;
+                h = y * s;
+                y *= c;
+                simd->rot(&vt[(size_t)j * n], &vt[(size_t)i * n], c, s, (size_t)n);
+                z = pythag(f, h);
+                w[j] = z;
+                if (z != 0.0) {
+                    c = f / z;
+                    s = h / z;
+                }
+                f = c * g + s * y;
+                x = c * y - s * g;
+                simd->rot(&ut[(size_t)j * n], &ut[(size_t)i * n], c, s, (size_t)n);
+            }
+            super[l] = 0.0;
+            super[k] = f;
+            w[k] = x;
+        }
+    }
+    return MATRIX_OK;
+}
+
+
+static void sortValues(double *values, double *rows1, double *rows2, int n, bool descending) {
+    /*
+     * Short Description:
+     * Sorts the values by selection, which moves every row of vectors at most once.
+     */
+    double value;       /* Value being exchanged */
+    int best;           /* Position of the next value in order */
+    int k, i;           /* Position being filled and candidate */
+
+    for (k = 0; k < n - 1; ++k) {
+        best = k;
+        for (i = k + 1; i < n; ++i) {
+            if (descending ? values[i] > values[best] : values[i] < values[best]) {
+                best = i;
+            }
+        }
+        if (best != k) {
+            value = values[k];
+            values[k] = values[best];
+            values[best] = value;
+            swapRows(&rows1[(size_t)k * n], &rows1[(size_t)best * n], n);
+            if (rows2 != NULL) {
+                swapRows(&rows2[(size_t)k * n], &rows2[(size_t)best * n], n);
+            }
+        }
+    }
+}
+
+
+static MatrixStatus applyStoredReflectors(const double *a, int m, int lda, int count, const double *tau,
+                                          double *c, int ldc, int cols) {
+    /*
+     * Short Description:
+     * Overwrites the m rows of C with H_0 ... H_count-1 C, for reflectors stored in the columns of 'a'
+     * as by 'factorQR'.
+     */
+    double t[QR_BLOCK * QR_BLOCK];  /* T of the current block */
+    int start, end;                 /* Reflectors of the current block */
+    MatrixStatus status = MATRIX_OK;
+
+    for (start = (count - 1) / QR_BLOCK * QR_BLOCK; start >= 0 && status == MATRIX_OK; start -= QR_BLOCK) {
+        end = (count - start < QR_BLOCK) ? count : start + QR_BLOCK;
+        status = formBlockFactor(a, m, lda, start, end, tau, t);
+        if (status == MATRIX_OK) {
+            status = applyReflectors(a, m, lda, start, end, t, &c[(size_t)start * ldc], ldc, cols, false);
+        }
+    }
+    return status;
+}
+
+
+MatrixStatus eigenSymmetricMatrix(const Matrix *a, Matrix *values, Matrix *vectors) {
+    int n = a->rows;        /* Order of the matrix */
+    double *elements;       /* Copy of A, then its reflectors */
+    double *diagonal;       /* Diagonal of T, then the eigenvalues */
+    double *offDiagonal;    /* Elements of T beside its diagonal */
+    double *tau;            /* Scales of the reflectors */
+    double *zt;             /* Eigenvectors of T, by rows */
+    double *z;              /* Eigenvectors of T, then of A, by columns */
+    int k;                  /* Variable for iterating over the eigenvectors */
+    MatrixStatus status;
+
+    if (a->rows != a->cols) {
+        return MATRIX_NOT_SQUARE;
+    }
+    elements = allocElements((size_t)n * (size_t)n);
+    diagonal = allocElements(3 * (size_t)n);
+    zt = allocElements((size_t)n * (size_t)n);
+    z = allocElements((size_t)n * (size_t)n);
+    if (elements == NULL || diagonal == NULL || zt == NULL || z == NULL) {
+        status = MATRIX_ALLOCATION_FAILED;
+    } else {
+        status = exportMatrix(a, elements, (size_t)n);
+    }
+    if (status == MATRIX_OK && !isSymmetric(elements, n)) {
+        status = MATRIX_NOT_SYMMETRIC;
+    }
+
+    if (status == MATRIX_OK) {
+        offDiagonal = diagonal + n;
+        tau = offDiagonal + n;
+        offDiagonal[n - 1] = 0.0;
+        status = reduceTridiagonal(elements, n, diagonal, offDiagonal, tau);
+    }
+    if (status == MATRIX_OK) {
+        memset(zt, 0, (size_t)n * (size_t)n * sizeof(double));
+        for (k = 0; k < n; ++k) {
+            zt[(size_t)k * n + k] = 1.0;
+        }
+        status = diagonalizeTridiagonal(diagonal, offDiagonal, zt, n);
+    }
+    if (status == MATRIX_OK) {
+        sortValues(diagonal, zt, NULL, n, false);
+        transposeBuffer(n, n, zt, n, z, n);
+        /* H_j acts on rows j + 1 .., so row 0 of the vectors is left as is */
+        if (n > 1) {
+            status = applyStoredReflectors(elements + n, n - 1, n, n - 1, tau, z + n, n, n);
+        }
+    }
+
+    if (status == MATRIX_OK) {
+        status = readMatrix(values, n, 1, diagonal, (size_t)n);
+    }
+    if (status == MATRIX_OK) {
+        status = readMatrix(vectors, n, n, z, (size_t)n * (size_t)n);
+    }
+    free(elements);
+    free(diagonal);
+    free(zt);
+    free(z);
+    return status;
+}
+
+
+MatrixStatus svdMatrix(const Matrix *a, Matrix *u, Matrix *s, Matrix *v) {
+    bool transposed = a->rows < a->cols;            /* Whether A^T is decomposed instead */
+    int m = transposed ? a->cols : a->rows;         /* Rows of the matrix decomposed */
+    int n = transposed ? a->rows : a->cols;         /* Columns of the matrix decomposed, and k */
+    double *elements;       /* Matrix decomposed, then its reflectors */
+    double *left;           /* Left singular vectors, m x n */
+    double *right;          /* Right singular vectors, n x n */
+    double *ut, *vt;        /* Singular vectors of B, by rows */
+    double *reflectors;     /* Right reflectors, moved to the columns */
+    double *diagonal;       /* Diagonal of B, then the singular values */
+    double *super;          /* super[k] above (k, k) of B, super[0] = 0 */
+    double *tauq, *taup;    /* Scales of the left and right reflectors */
+    int k;                  /* Variable for iterating over the singular vectors */
+    MatrixStatus status;
+
+    elements = allocElements((size_t)m * (size_t)n);
+    left = allocElements((size_t)m * (size_t)n);
+    right = allocElements((size_t)n * (size_t)n);
+    ut = allocElements(3 * (size_t)n * (size_t)n);
+    diagonal = allocElements(4 * (size_t)n);
+    if (elements == NULL || left == NULL || right == NULL || ut == NULL || diagonal == NULL) {
+        status = MATRIX_ALLOCATION_FAILED;
+    } else if (transposed) {
+        status = exportMatrix(a, left, (size_t)a->cols);
+        if (status == MATRIX_OK) {
+            transposeBuffer(a->rows, a->cols, left, a->cols, elements, a->rows);
+        }
+    } else {
+        status = exportMatrix(a, elements, (size_t)n);
+    }
+
+    if (status == MATRIX_OK) {
+        vt = ut + (size_t)n * (size_t)n;
+        reflectors = vt + (size_t)n * (size_t)n;
+        super = diagonal + n;
+        tauq = super + n;
+        taup = tauq + n;
+        status = reduceBidiagonal(elements, m, n, diagonal, super + 1, tauq, taup);
+    }
+    if (status == MATRIX_OK) {
+        super[0] = 0.0;
+        memset(ut, 0, 2 * (size_t)n * (size_t)n * sizeof(double));
+        for (k = 0; k < n; ++k) {
+            ut[(size_t)k * n + k] = 1.0;
+            vt[(size_t)k * n + k] = 1.0;
+        }
+        status = diagonalizeBidiagonal(diagonal, super, ut, vt, n);
+    }
+
+    if (status == MATRIX_OK) {
+        sortValues(diagonal, ut, vt, n, true);
+        /* U = Q [Ub; 0] */
+        transposeBuffer(n, n, ut, n, left, n);
+        memset(&left[(size_t)n * n], 0, (size_t)(m - n) * (size_t)n * sizeof(double));
+        status = applyStoredReflectors(elements, m, n, n, tauq, left, n, n);
+    }
+    if (status == MATRIX_OK) {
+        /* V = P Vb, with G_j moved from row j to column j so that it is stored as by 'factorQR' */
+        transposeBuffer(n, n, vt, n, right, n);
+        transposeBuffer(n, n, elements, n, reflectors, n);
+        if (n > 1) {
+            status = applyStoredReflectors(reflectors + n, n - 1, n, n - 1, taup, right + n, n, n);
+        }
+    }
+
+    if (status == MATRIX_OK) {
+        status = transposed ? readMatrix(u, n, n, right, (size_t)n * (size_t)n)
+                            : readMatrix(u, m, n, left, (size_t)m * (size_t)n);
+    }
+    if (status == MATRIX_OK) {
+        status = readMatrix(s, n, 1, diagonal, (size_t)n);
+    }
+    if (status == MATRIX_OK) {
+        status = transposed ? readMatrix(v, m, n, left, (size_t)m * (size_t)n)
+                            : readMatrix(v, n, n, right, (size_t)n * (size_t)n);
+    }
+    free(elements);
+    free(left);
+    free(right);
+    free(ut);
+    free(diagonal);
+    return status;
+}
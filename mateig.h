@@ -0,0 +1,72 @@
+/*
+ * Eigenvalue Decomposition Header
+ * -------------------------------
+ * This C header file declares the symmetric eigenvalue decomposition and the singular value
+ * decomposition implemented in "mateig.c". Both first reduce the matrix by Householder reflectors, a
+ * panel of QR_BLOCK of them at a time ("matqr.h"): a symmetric matrix to a tridiagonal T = Q^T A Q, any
+ * other to an upper bidiagonal B = Q^T A P. The rest of the matrix is updated once per panel by the GEMM
+ * engine of "matgemm.h", so about half of the operations of the reduction run at its speed, as in
+ * LAPACK's 'dsytrd' and 'dgebrd'.
+ *
+ * Core Functions:
+ * - eigenSymmetricMatrix:  Computes the eigenvalues and eigenvectors of a symmetric matrix.
+ * - svdMatrix:             Computes the thin singular value decomposition of a matrix.
+ *
+ * Note:
+ * T and B are diagonalized by implicit shifted QR iteration, whose plane rotations are accumulated into
+ * the rows of a matrix of order n so that each one runs along contiguous memory. The reflectors are then
+ * applied to those vectors by blocks, again through 'gemm'.
+ */
+
+#ifndef MATEIG_H
+#define MATEIG_H
+
+#include "mymat.h"
+
+/* QR iterations allowed for one eigenvalue or singular value before giving up */
+#define EIG_MAX_ITERATIONS 30
+
+
+/*
+ * Function: eigenSymmetricMatrix
+ * Purpose: Computes A = X diag(values) X^T for a symmetric matrix A.
+ * Detailed Description:
+ *   The eigenvalues are sorted in ascending order, and column k of X is the unit eigenvector of the
+ *   k-th one; the columns are orthonormal.
+ *
+ * Parameters:
+ *   a - Pointer to the symmetric n x n Matrix, in any storage.
+ *   values - Pointer to the Matrix receiving the n x 1 eigenvalues.
+ *   vectors - Pointer to the Matrix receiving the n x n eigenvectors, stored after the eigenvalues; any
+ *             of the three may be the same matrix.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_NOT_SQUARE or MATRIX_NOT_SYMMETRIC for a matrix that is not square or
+ *   whose elements do not equal their transposes exactly, MATRIX_NOT_CONVERGED if an eigenvalue took
+ *   more than EIG_MAX_ITERATIONS iterations, MATRIX_ALLOCATION_FAILED if the work buffers could not be
+ *   allocated, or the status of reading A or storing the results.
+ */
+MatrixStatus eigenSymmetricMatrix(const Matrix *a, Matrix *values, Matrix *vectors);
+
+
+/*
+ * Function: svdMatrix
+ * Purpose: Computes the thin singular value decomposition A = U diag(s) V^T of an m x n matrix.
+ * Detailed Description:
+ *   With k = min(m, n), U is m x k and V is n x k, both with orthonormal columns, and the k singular
+ *   values are sorted in descending order. A wide matrix is decomposed through its transpose.
+ *
+ * Parameters:
+ *   a - Pointer to the Matrix to decompose, in any storage.
+ *   u - Pointer to the Matrix receiving U.
+ *   s - Pointer to the Matrix receiving the k x 1 singular values, stored after U.
+ *   v - Pointer to the Matrix receiving V, stored last; any of the four may be the same matrix.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_NOT_CONVERGED if a singular value took more than EIG_MAX_ITERATIONS
+ *   iterations, MATRIX_ALLOCATION_FAILED if the work buffers could not be allocated, or the status of
+ *   reading A or storing the results.
+ */
+MatrixStatus svdMatrix(const Matrix *a, Matrix *u, Matrix *s, Matrix *v);
+
+#endif /* MATEIG_H */
@@ -0,0 +1,664 @@
+/*
+ * Matrix Expressions
+ * ------------------
+ * This C source file implements the expression trees declared in "matexpr.h".
+ *
+ * Core Functionalities:
+ * 1.   inferShapes:        Checks the shapes of every node of a tree and notes whether any value would
+ *                          live on disk or any operand is sparse.
+ * 2.   collectTerms:       Rewrites a tree as a Combination: a list of terms coefficient * matrix (possibly
+ *                          transposed) or coefficient * product. Transposes are pushed down ((A + B)' is
+ *                          A' + B', (A * B)' is B' * A'), scalars multiply the coefficients and repeated
+ *                          matrices are merged into one term.
+ * 3.   evaluateCombination: Computes the factors of the products that are not plain matrices, sums the
+ *                          matrix terms in one blocked pass (runFusedTask), then adds every product with a
+ *                          GEMM call whose alpha is the coefficient and beta 1.
+ * 4.   evaluateStepwise:   Evaluates a tree one library operation at a time, for matrices on disk and sparse
+ *                          matrices.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include "matexpr.h"
+#include "matdisk.h"
+#include "matgemm.h"
+#include "matpool.h"
+#include "matsimd.h"
+#include "mattrans.h"
+
+
+/* Rows and columns of the blocks of the fused pass: the block of the result stays in L1/L2 while every
+   term is added to it, and a transposed operand is copied one block at a time */
+#define FUSED_BLOCK_ROWS 32
+#define FUSED_BLOCK_COLS 128
+#define FUSED_BLOCK_ELEMENTS (FUSED_BLOCK_ROWS * FUSED_BLOCK_COLS)
+
+/* Initial number of terms a Combination allocates room for */
+#define COMBINATION_INITIAL_CAPACITY 8
+
+
+/* Term of a Combination: coefficient * matrix, or coefficient * left * right */
+typedef struct {
+    double coeff;               /* Coefficient of the term */
+    MatrixHandle matrix;        /* Matrix of a matrix term, NO_MATRIX for a product */
+    bool transposed;            /* Whether the matrix of a matrix term is transposed */
+    int left, right;            /* Nodes of the factors of a product */
+    bool leftTransposed;        /* Whether the left factor is transposed */
+    bool rightTransposed;       /* Whether the right factor is transposed */
+} Term;
+
+/* Sum of terms an expression is rewritten to */
+typedef struct {
+    Term *terms;        /* The terms */
+    int count;          /* Number of terms */
+    int capacity;       /* Number of terms 'terms' can hold before it has to grow */
+} Combination;
+
+/* Operand of a GEMM call: a matrix of the context, or a temporary holding a computed factor */
+typedef struct {
+    const Matrix *mat;      /* Matrix used by the call */
+    GemmTranspose trans;    /* Whether it is used transposed */
+    double scale;           /* Coefficient of the factor, folded into alpha */
+    Matrix temp;            /* Storage of a computed factor */
+} Factor;
+
+/* Arguments of the fused pass split across the thread pool */
+typedef struct {
+    const Matrix **sources;     /* Matrix of every term */
+    const double *coeffs;       /* Coefficient of every term */
+    const bool *transposed;     /* Whether every term is transposed */
+    int count;                  /* Number of terms */
+    bool accumulate;            /* Whether the result already holds a term, so every term is added */
+    bool allTransposed;         /* Whether every term is transposed, so blocks are summed before one transpose */
+    Matrix *target;             /* Result */
+    double *scratch;            /* FUSED_BLOCK_ELEMENTS per thread for transposed blocks, NULL if none */
+} FusedTask;
+
+
+static MatrixStatus evaluateCombination(const Expression *expr, MatrixContext *ctx, const Combination *comb,
+                                        int rows, int cols, Matrix *target);
+
+
+/* Matrix without storage, the initial state of temporaries */
+static const Matrix emptyMatrix = {NULL, 0, 0, 0, 0, NULL, 0, NULL, NULL};
+
+
+void initExpression(Expression *expr) {
+    expr->nodes = NULL;
+    expr->count = 0;
+    expr->capacity = 0;
+    expr->root = -1;
+}
+
+
+void freeExpression(Expression *expr) {
+    free(expr->nodes);
+    initExpression(expr);
+}
+
+
+int addExprNode(Expression *expr, ExprOp op, int left, int right, MatrixHandle matrix, double scalar) {
+    ExprNode *grown;    /* Grown node array */
+    ExprNode *node;     /* New node */
+    int capacity;       /* Capacity after growing */
+    int depth = 0;      /* Height of the deeper child */
+
+    if (left >= 0) {
+        depth = expr->nodes[left].depth;
+    }
+    if (right >= 0 && expr->nodes[right].depth > depth) {
+        depth = expr->nodes[right].depth;
+    }
+    if (depth >= MAX_EXPRESSION_DEPTH) {
+        return -2;
+    }
+
+    if (expr->count == expr->capacity) {
+        capacity = expr->capacity ? expr->capacity * 2 : EXPRESSION_INITIAL_CAPACITY;
+        grown = realloc(expr->nodes, (size_t)capacity * sizeof(ExprNode));
+        if (grown == NULL) {
+            return -1;
+        }
+        expr->nodes = grown;
+        expr->capacity = capacity;
+    }
+
+    node = &expr->nodes[expr->count];
+    node->op = op;
+    node->left = left;
+    node->right = right;
+    node->matrix = matrix;
+    node->scalar = scalar;
+    node->depth = depth + 1;
+    node->rows = 0;
+    node->cols = 0;
+    expr->root = expr->count;
+    return expr->count++;
+}
+
+
+static MatrixStatus inferShapes(const Expression *expr, const MatrixContext *ctx, int index, bool *stepwise) {
+    /*
+     * Short Description:
+     * Records the shape of every node of a subtree and checks the operands of sums and products. Sets
+     * 'stepwise' if a matrix is on disk or sparse, or a value is large enough to be stored on disk.
+     */
+    ExprNode *node = &expr->nodes[index];   /* Node being checked */
+    const ExprNode *left, *right;           /* Its children */
+    const Matrix *mat;                      /* Matrix of a leaf */
+    MatrixStatus status;
+
+    if (node->op == EXPR_MATRIX) {
+        mat = &ctx->matrices[node->matrix];
+        node->rows = mat->rows;
+        node->cols = mat->cols;
+        if (mat->disk != NULL || mat->sparse != NULL) {
+            *stepwise = true;
+        }
+        return MATRIX_OK;
+    }
+
+    status = inferShapes(expr, ctx, node->left, stepwise);
+    if (status == MATRIX_OK && node->right >= 0) {
+        status = inferShapes(expr, ctx, node->right, stepwise);
+    }
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    left = &expr->nodes[node->left];
+    right = (node->right >= 0) ? &expr->nodes[node->right] : NULL;
+    switch (node->op) {
+        case EXPR_ADD:
+        case EXPR_SUB:
+            if (left->rows != right->rows || left->cols != right->cols) {
+                return MATRIX_DIMENSION_MISMATCH;
+            }
+            node->rows = left->rows;
+            node->cols = left->cols;
+            break;
+        case EXPR_MULTIPLY:
+            if (left->cols != right->rows) {
+                return MATRIX_DIMENSION_MISMATCH;
+            }
+            node->rows = left->rows;
+            node->cols = right->cols;
+            break;
+        case EXPR_TRANSPOSE:
+            node->rows = left->cols;
+            node->cols = left->rows;
+            break;
+        default:
+            node->rows = left->rows;
+            node->cols = left->cols;
+            break;
+    }
+    if (shouldSpill(node->rows, node->cols)) {
+        *stepwise = true;
+    }
+    return MATRIX_OK;
+}
+
+
+static Term *appendTerm(Combination *comb) {
+    /*
+     * Short Description:
+     * Returns room for one more term, or NULL if the array could not grow.
+     */
+    Term *grown;        /* Grown term array */
+    int capacity;       /* Capacity after growing */
+
+    if (comb->count == comb->capacity) {
+        capacity = comb->capacity ? comb->capacity * 2 : COMBINATION_INITIAL_CAPACITY;
+        grown = realloc(comb->terms, (size_t)capacity * sizeof(Term));
+        if (grown == NULL) {
+            return NULL;
+        }
+        comb->terms = grown;
+        comb->capacity = capacity;
+    }
+    return &comb->terms[comb->count++];
+}
+
+
+static MatrixStatus collectTerms(const Expression *expr, int index, double coeff, bool transposed,
+                                 Combination *comb) {
+    /*
+     * Short Description:
+     * Adds coeff * (value of the subtree, transposed if 'transposed') to a Combination.
+     */
+    const ExprNode *node = &expr->nodes[index];     /* Node being rewritten */
+    Term *term;                                     /* Term added */
+    MatrixStatus status;
+    int term_index;                                 /* Index for iterating over the terms */
+
+    switch (node->op) {
+        case EXPR_MATRIX:
+            /* A matrix that already has a term only changes its coefficient */
+            for (term_index = 0; term_index < comb->count; ++term_index) {
+                term = &comb->terms[term_index];
+                if (term->matrix == node->matrix && term->transposed == transposed) {
+                    term->coeff += coeff;
+                    return MATRIX_OK;
+                }
+            }
+            term = appendTerm(comb);
+            if (term == NULL) {
+                return MATRIX_ALLOCATION_FAILED;
+            }
+            term->coeff = coeff;
+            term->matrix = node->matrix;
+            term->transposed = transposed;
+            return MATRIX_OK;
+        case EXPR_ADD:
+        case EXPR_SUB:
+            status = collectTerms(expr, node->left, coeff, transposed, comb);
+            if (status != MATRIX_OK) {
+                return status;
+            }
+            return collectTerms(expr, node->right, (node->op == EXPR_SUB) ? -coeff : coeff, transposed, comb);
+        case EXPR_NEGATE:
+            return collectTerms(expr, node->left, -coeff, transposed, comb);
+        case EXPR_SCALE:
+            return collectTerms(expr, node->left, coeff * node->scalar, transposed, comb);
+        case EXPR_TRANSPOSE:
+            return collectTerms(expr, node->left, coeff, !transposed, comb);
+        case EXPR_MULTIPLY:
+            term = appendTerm(comb);
+            if (term == NULL) {
+                return MATRIX_ALLOCATION_FAILED;
+            }
+            /* (L * R)' = R' * L' */
+            term->coeff = coeff;
+            term->matrix = NO_MATRIX;
+            term->left = transposed ? node->right : node->left;
+            term->right = transposed ? node->left : node->right;
+            term->leftTransposed = transposed;
+            term->rightTransposed = transposed;
+            return MATRIX_OK;
+    }
+    return MATRIX_OK;
+}
+
+
+static bool containsMatrix(const Expression *expr, int index, MatrixHandle matrix) {
+    /*
+     * Short Description:
+     * Tells whether a matrix appears in a subtree.
+     */
+    const ExprNode *node = &expr->nodes[index];     /* Root of the subtree */
+
+    if (node->op == EXPR_MATRIX) {
+        return node->matrix == matrix;
+    }
+    return containsMatrix(expr, node->left, matrix) ||
+           (node->right >= 0 && containsMatrix(expr, node->right, matrix));
+}
+
+
+static bool needsTemporary(const Expression *expr, const Combination *comb, MatrixHandle result) {
+    /*
+     * Short Description:
+     * Tells whether the result must be computed in a temporary matrix: it is read transposed, whose
+     * elements the blocked pass would overwrite before reading them, or it takes part in a product,
+     * which GEMM cannot compute in place.
+     */
+    const Term *term;   /* Term being examined */
+    int term_index;     /* Index for iterating over the terms */
+
+    for (term_index = 0; term_index < comb->count; ++term_index) {
+        term = &comb->terms[term_index];
+        if (term->matrix == NO_MATRIX) {
+            if (containsMatrix(expr, term->left, result) || containsMatrix(expr, term->right, result)) {
+                return true;
+            }
+        } else if (term->matrix == result && term->transposed) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static MatrixStatus prepareFactor(const Expression *expr, MatrixContext *ctx, int index, bool transposed,
+                                  Factor *factor) {
+    /*
+     * Short Description:
+     * Makes a GEMM operand of a factor: a scaled, possibly transposed matrix is used directly, any
+     * other factor is evaluated into the temporary matrix of the Factor.
+     */
+    Combination comb = {NULL, 0, 0};    /* The factor rewritten as a sum */
+    const ExprNode *node = &expr->nodes[index];     /* Root of the factor */
+    MatrixStatus status;
+
+    status = collectTerms(expr, index, 1.0, transposed, &comb);
+    if (status == MATRIX_OK && comb.count == 1 && comb.terms[0].matrix != NO_MATRIX) {
+        factor->mat = &ctx->matrices[comb.terms[0].matrix];
+        factor->trans = comb.terms[0].transposed ? GEMM_TRANS : GEMM_NO_TRANS;
+        factor->scale = comb.terms[0].coeff;
+    } else if (status == MATRIX_OK) {
+        status = evaluateCombination(expr, ctx, &comb, transposed ? node->cols : node->rows,
+                                     transposed ? node->rows : node->cols, &factor->temp);
+        factor->mat = &factor->temp;
+        factor->trans = GEMM_NO_TRANS;
+        factor->scale = 1.0;
+    }
+    free(comb.terms);
+    return status;
+}
+
+
+static void runFusedTask(size_t begin, size_t end, int worker, void *arg) {
+    /*
+     * Short Description:
+     * Computes the bands of FUSED_BLOCK_ROWS rows [begin, end) of the result, block by block: the first
+     * term is scaled into the block (unless the result already holds it) and the others are added to it
+     * while it is in cache. A transposed term is transposed block by block into the scratch buffer.
+     * When every term is transposed, as in '(2*A + B)\'', the bands are bands of the sources instead: their
+     * blocks are summed into the scratch buffer along their rows and the sum is transposed into the result
+     * once, so the strided accesses of a transpose are paid once per block rather than once per term.
+     */
+    const FusedTask *task = arg;
+    const SimdKernels *kernels = getSimdKernels();  /* Element-wise kernels */
+    double *scratch = (task->scratch != NULL) ? task->scratch + (size_t)worker * FUSED_BLOCK_ELEMENTS : NULL;
+    Matrix *target = task->target;      /* Result */
+    const Matrix *source;               /* Matrix of the current term */
+    const double *block;                /* Element (0, 0) of the block of the current term */
+    size_t ld;                          /* Leading dimension of 'block' */
+    size_t band;                        /* Index of the band of rows */
+    int rowStart, colStart;             /* Element (0, 0) of the block in the result */
+    int blockRows, blockCols;           /* Shape of the block */
+    int rows = task->allTransposed ? target->cols : target->rows;  /* Shape of the matrices iterated over */
+    int cols = task->allTransposed ? target->rows : target->cols;
+    int term, row;                      /* Term and row of the block being processed */
+
+    for (band = begin; band < end; ++band) {
+        rowStart = (int)band * FUSED_BLOCK_ROWS;
+        blockRows = (rows - rowStart < FUSED_BLOCK_ROWS) ? rows - rowStart : FUSED_BLOCK_ROWS;
+        for (colStart = 0; colStart < cols; colStart += FUSED_BLOCK_COLS) {
+            blockCols = (cols - colStart < FUSED_BLOCK_COLS) ? cols - colStart : FUSED_BLOCK_COLS;
+            if (task->allTransposed) {
+                for (term = 0; term < task->count; ++term) {
+                    source = task->sources[term];
+                    for (row = 0; row < blockRows; ++row) {
+                        if (term == 0) {
+                            kernels->scale(&MATRIX_AT(source, rowStart + row, colStart), task->coeffs[term],
+                                           scratch + (size_t)row * blockCols, (size_t)blockCols);
+                        } else {
+                            kernels->axpy(&MATRIX_AT(source, rowStart + row, colStart), task->coeffs[term],
+                                          scratch + (size_t)row * blockCols, (size_t)blockCols);
+                        }
+                    }
+                }
+                transposeBuffer(blockRows, blockCols, scratch, blockCols,
+                                &MATRIX_AT(target, colStart, rowStart), target->ld);
+                continue;
+            }
+            for (term = 0; term < task->count; ++term) {
+                source = task->sources[term];
+                if (task->transposed[term]) {
+                    transposeBuffer(blockCols, blockRows, &MATRIX_AT(source, colStart, rowStart), source->ld,
+                                    scratch, blockCols);
+                    block = scratch;
+                    ld = (size_t)blockCols;
+                } else {
+                    block = &MATRIX_AT(source, rowStart, colStart);
+                    ld = (size_t)source->ld;
+                }
+                for (row = 0; row < blockRows; ++row) {
+                    if (term == 0 && !task->accumulate) {
+                        kernels->scale(block + (size_t)row * ld, task->coeffs[term],
+                                       &MATRIX_AT(target, rowStart + row, colStart), (size_t)blockCols);
+                    } else {
+                        kernels->axpy(block + (size_t)row * ld, task->coeffs[term],
+                                      &MATRIX_AT(target, rowStart + row, colStart), (size_t)blockCols);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+static MatrixStatus runFusedPass(MatrixContext *ctx, const Combination *comb, Matrix *target, bool *written) {
+    /*
+     * Short Description:
+     * Sums the matrix terms of a Combination into the result in one pass. A term of the result itself
+     * (untransposed, see 'needsTemporary') is handled first, before the result is overwritten; with a
+     * coefficient of 1 it is already in place and skipped. Sets 'written' if the result holds a value.
+     */
+    FusedTask task;             /* Arguments shared with the workers */
+    const Matrix **sources;     /* Matrix of every matrix term */
+    double *coeffs;             /* Coefficient of every matrix term */
+    bool *transposed;           /* Whether every matrix term is transposed */
+    bool anyTransposed = false; /* Whether a scratch buffer is needed */
+    const Term *term;           /* Term being gathered */
+    int term_index;             /* Index for iterating over the terms */
+    int count = 0;              /* Matrix terms gathered */
+    int first;                  /* Slot of the next term */
+    size_t bandRows;            /* Rows split into bands across the workers */
+    size_t bandLength;          /* Length of those rows */
+
+    sources = malloc((size_t)comb->count * sizeof(const Matrix *));
+    coeffs = malloc((size_t)comb->count * sizeof(double));
+    transposed = malloc((size_t)comb->count * sizeof(bool));
+    if (sources == NULL || coeffs == NULL || transposed == NULL) {
+        free(sources);
+        free(coeffs);
+        free(transposed);
+        return MATRIX_ALLOCATION_FAILED;
+    }
+
+    task.accumulate = false;
+    for (term_index = 0; term_index < comb->count; ++term_index) {
+        term = &comb->terms[term_index];
+        if (term->matrix == NO_MATRIX) {
+            continue;
+        }
+        if (&ctx->matrices[term->matrix] == target && term->coeff == 1.0) {
+            task.accumulate = true;     /* Already in place */
+            continue;
+        }
+        /* The term of the result goes first, the others keep their order */
+        first = (&ctx->matrices[term->matrix] == target) ? 0 : count;
+        if (first == 0 && count > 0) {
+            sources[count] = sources[0];
+            coeffs[count] = coeffs[0];
+            transposed[count] = transposed[0];
+        }
+        sources[first] = &ctx->matrices[term->matrix];
+        coeffs[first] = term->coeff;
+        transposed[first] = term->transposed;
+        anyTransposed = anyTransposed || term->transposed;
+        count++;
+    }
+
+    task.sources = sources;
+    task.coeffs = coeffs;
+    task.transposed = transposed;
+    task.count = count;
+    task.target = target;
+    task.scratch = NULL;
+    if (count > 0 && anyTransposed) {
+        task.scratch = allocElements((size_t)getThreadCount() * FUSED_BLOCK_ELEMENTS);
+        if (task.scratch == NULL) {
+            count = -1;
+        }
+    }
+    task.allTransposed = anyTransposed && !task.accumulate;
+    for (term_index = 0; term_index < count; ++term_index) {
+        task.allTransposed = task.allTransposed && transposed[term_index];
+    }
+    bandRows = (size_t)(task.allTransposed ? target->cols : target->rows);
+    bandLength = (size_t)(task.allTransposed ? target->rows : target->cols);
+    if (count > 0) {
+        parallelFor((bandRows + FUSED_BLOCK_ROWS - 1) / FUSED_BLOCK_ROWS,
+                    PARALLEL_MIN_ELEMENTS / ((size_t)FUSED_BLOCK_ROWS * bandLength) + 1, runFusedTask, &task);
+    }
+    *written = count > 0 || task.accumulate;
+
+    free(task.scratch);
+    free(sources);
+    free(coeffs);
+    free(transposed);
+    return (count < 0) ? MATRIX_ALLOCATION_FAILED : MATRIX_OK;
+}
+
+
+static MatrixStatus evaluateCombination(const Expression *expr, MatrixContext *ctx, const Combination *comb,
+                                        int rows, int cols, Matrix *target) {
+    /*
+     * Short Description:
+     * Stores the value of a Combination in a rows x cols matrix: factors first (they may read a
+     * matrix the fused pass is about to overwrite), then the matrix terms, then every product
+     * accumulated by GEMM.
+     */
+    Factor *factors;            /* Left and right factor of every term; only products use theirs */
+    const Term *term;           /* Term being evaluated */
+    Factor *left, *right;       /* Factors of a product */
+    bool written = false;       /* Whether the result holds a partial sum, so products accumulate */
+    int term_index;             /* Index for iterating over the terms */
+    MatrixStatus status = MATRIX_OK;
+
+    factors = malloc((size_t)comb->count * 2 * sizeof(Factor));
+    if (factors == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    for (term_index = 0; term_index < 2 * comb->count; ++term_index) {
+        factors[term_index].temp = emptyMatrix;
+    }
+
+    for (term_index = 0; term_index < comb->count && status == MATRIX_OK; ++term_index) {
+        term = &comb->terms[term_index];
+        if (term->matrix == NO_MATRIX) {
+            status = prepareFactor(expr, ctx, term->left, term->leftTransposed, &factors[2 * term_index]);
+            if (status == MATRIX_OK) {
+                status = prepareFactor(expr, ctx, term->right, term->rightTransposed, &factors[2 * term_index + 1]);
+            }
+        }
+    }
+    if (status == MATRIX_OK) {
+        status = resizeMatrix(target, rows, cols);
+    }
+    if (status == MATRIX_OK) {
+        status = runFusedPass(ctx, comb, target, &written);
+    }
+
+    for (term_index = 0; term_index < comb->count && status == MATRIX_OK; ++term_index) {
+        term = &comb->terms[term_index];
+        if (term->matrix != NO_MATRIX) {
+            continue;
+        }
+        left = &factors[2 * term_index];
+        right = &factors[2 * term_index + 1];
+        status = gemm(left->trans, right->trans, rows, cols, (left->trans == GEMM_TRANS) ? left->mat->rows : left->mat->cols,
+                      term->coeff * left->scale * right->scale, left->mat->data, left->mat->ld,
+                      right->mat->data, right->mat->ld, written ? 1.0 : 0.0, target->data, target->ld);
+        written = true;
+    }
+
+    for (term_index = 0; term_index < 2 * comb->count; ++term_index) {
+        freeMatrix(&factors[term_index].temp);
+    }
+    free(factors);
+    return status;
+}
+
+
+static MatrixStatus evaluateStepwise(const Expression *expr, MatrixContext *ctx, int index, Matrix *out) {
+    /*
+     * Short Description:
+     * Evaluates a subtree with the operations of "mymat.c", one node at a time, into a matrix that
+     * is none of the operands. Used when matrices are on disk or sparse, where the tiled and sparse
+     * operations apply.
+     */
+    const ExprNode *node = &expr->nodes[index];         /* Node being evaluated */
+    Matrix temps[2] = {{NULL, 0, 0, 0, 0, NULL, 0, NULL, NULL}, {NULL, 0, 0, 0, 0, NULL, 0, NULL, NULL}};  /* Operand values */
+    const Matrix *operands[2];                          /* Operands: matrices of the context or 'temps' */
+    int children[2];                                    /* Children of the node */
+    int child;                                          /* Index for iterating over the children */
+    MatrixStatus status = MATRIX_OK;
+
+    if (node->op == EXPR_MATRIX) {
+        return multiplyScalar(&ctx->matrices[node->matrix], 1.0, out);
+    }
+
+    children[0] = node->left;
+    children[1] = node->right;
+    for (child = 0; child < 2 && status == MATRIX_OK; ++child) {
+        if (children[child] < 0) {
+            operands[child] = NULL;
+        } else if (expr->nodes[children[child]].op == EXPR_MATRIX) {
+            operands[child] = &ctx->matrices[expr->nodes[children[child]].matrix];
+        } else {
+            status = evaluateStepwise(expr, ctx, children[child], &temps[child]);
+            operands[child] = &temps[child];
+        }
+    }
+
+    if (status == MATRIX_OK) {
+        switch (node->op) {
+            case EXPR_ADD:
+                status = addMatrices(operands[0], operands[1], out);
+                break;
+            case EXPR_SUB:
+                status = subMatrices(operands[0], operands[1], out);
+                break;
+            case EXPR_NEGATE:
+                status = multiplyScalar(operands[0], -1.0, out);
+                break;
+            case EXPR_SCALE:
+                status = multiplyScalar(operands[0], node->scalar, out);
+                break;
+            case EXPR_MULTIPLY:
+                status = multiplyMatrices(operands[0], operands[1], out);
+                break;
+            case EXPR_TRANSPOSE:
+                status = transposeMatrix(operands[0], out);
+                break;
+            default:
+                break;
+        }
+    }
+    freeMatrix(&temps[0]);
+    freeMatrix(&temps[1]);
+    return status;
+}
+
+
+MatrixStatus evaluateExpression(const Expression *expr, MatrixContext *ctx, MatrixHandle result) {
+    Combination comb = {NULL, 0, 0};    /* The expression rewritten as a sum */
+    Matrix temp = {NULL, 0, 0, 0, 0, NULL, 0, NULL, NULL};   /* Value computed apart from the result */
+    Matrix *target = &ctx->matrices[result];    /* Matrix receiving the value */
+    const ExprNode *root;               /* Root of the tree */
+    bool stepwise = false;              /* Whether a matrix or value lives on disk, or a matrix is sparse */
+    bool apart;                         /* Whether the value is computed in 'temp' */
+    MatrixStatus status;
+
+    status = inferShapes(expr, ctx, expr->root, &stepwise);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    root = &expr->nodes[expr->root];
+
+    if (stepwise) {
+        apart = true;
+        status = evaluateStepwise(expr, ctx, expr->root, &temp);
+    } else {
+        status = collectTerms(expr, expr->root, 1.0, false, &comb);
+        apart = needsTemporary(expr, &comb, result);
+        if (status == MATRIX_OK) {
+            status = evaluateCombination(expr, ctx, &comb, root->rows, root->cols, apart ? &temp : target);
+        }
+        free(comb.terms);
+    }
+
+    /* Hand the storage of the temporary over to the result */
+    if (apart && status == MATRIX_OK) {
+        freeMatrix(target);
+        *target = temp;
+    } else {
+        freeMatrix(&temp);
+    }
+    return status;
+}
@@ -0,0 +1,140 @@
+/*
+ * Matrix Expression Header
+ * ------------------------
+ * This C header file declares the expression trees of the 'eval' command, built by the parser of
+ * "mainmat.c" and evaluated by "matexpr.c". An instruction such as
+ *
+ *     eval MAT_E = (2*MAT_A + MAT_B)'
+ *
+ * is evaluated as a whole instead of one operation at a time. Transposes are pushed down to the matrices
+ * of the tree and scalars gathered into coefficients, which turns an expression into a sum of scaled,
+ * possibly transposed matrices and products. The matrices are then summed in a single pass over memory,
+ * block by block (transposed ones through a transposed copy of the block that stays in cache), and each
+ * product is accumulated into the result by the GEMM engine with its coefficient as alpha and beta = 1,
+ * so no intermediate result is stored. Only a factor of a product that is itself a sum is computed into a
+ * temporary matrix first.
+ *
+ * Core Structures:
+ * - ExprOp:            Enumeration of the node kinds of an expression.
+ * - ExprNode:          One node of an expression tree.
+ * - Expression:        Growable array of nodes holding one tree.
+ *
+ * Core Functions:
+ * - initExpression / freeExpression:
+ *                      Prepare and release the node array.
+ * - addExprNode:       Appends a node, for the parser.
+ * - evaluateExpression: Evaluates a tree into a matrix.
+ *
+ * Note:
+ * The result may appear in its own expression. It is written in place when it only appears untransposed
+ * outside of products; otherwise the expression is evaluated into a temporary matrix that then replaces
+ * the result. Expressions involving matrices stored on disk (see "matdisk.h") are evaluated one operation
+ * at a time with the tiled operations.
+ */
+
+#ifndef MATEXPR_H
+#define MATEXPR_H
+
+#include "mymat.h"
+
+/* Deepest expression tree accepted, so evaluating it cannot exhaust the stack */
+#define MAX_EXPRESSION_DEPTH 1024
+
+/* Initial number of nodes an Expression allocates room for */
+#define EXPRESSION_INITIAL_CAPACITY 16
+
+/* Enumeration of the kinds of expression nodes */
+typedef enum {
+    EXPR_MATRIX,        /* A named matrix */
+    EXPR_ADD,           /* left + right */
+    EXPR_SUB,           /* left - right */
+    EXPR_NEGATE,        /* -left */
+    EXPR_SCALE,         /* scalar * left */
+    EXPR_MULTIPLY,      /* Matrix product left * right */
+    EXPR_TRANSPOSE      /* left' */
+} ExprOp;
+
+/* Node of an expression tree; children are indices into the same Expression */
+typedef struct {
+    ExprOp op;              /* Kind of the node */
+    int left;               /* First (or only) operand, -1 for a matrix */
+    int right;              /* Second operand of a sum, difference or product, else -1 */
+    MatrixHandle matrix;    /* Matrix of an EXPR_MATRIX node */
+    double scalar;          /* Factor of an EXPR_SCALE node */
+    int depth;              /* Height of the subtree rooted here, 1 for a matrix */
+    int rows, cols;         /* Shape of the value of the node, set by 'evaluateExpression' */
+} ExprNode;
+
+/* Expression tree stored as an array of nodes */
+typedef struct {
+    ExprNode *nodes;    /* Nodes, every child before its parent */
+    int count;          /* Number of nodes in use */
+    int capacity;       /* Number of nodes 'nodes' can hold before it has to grow */
+    int root;           /* Index of the root node */
+} Expression;
+
+
+/*
+ * Function: initExpression
+ * Purpose: Prepares an empty Expression.
+ *
+ * Parameters:
+ *   expr - Pointer to the Expression to prepare.
+ *
+ * Returns: None (void function).
+ */
+void initExpression(Expression *expr);
+
+
+/*
+ * Function: freeExpression
+ * Purpose: Releases the nodes of an Expression and leaves it empty.
+ *
+ * Parameters:
+ *   expr - Pointer to the Expression to release.
+ *
+ * Returns: None (void function).
+ */
+void freeExpression(Expression *expr);
+
+
+/*
+ * Function: addExprNode
+ * Purpose: Appends a node to an expression, growing the node array when needed.
+ * Detailed Description:
+ *   The node becomes the root of the expression. Its depth is derived from its children, which must
+ *   already be in the expression.
+ *
+ * Parameters:
+ *   expr - Pointer to the Expression.
+ *   op - Kind of the node.
+ *   left, right - Indices of the children, -1 where there is none.
+ *   matrix - Matrix of an EXPR_MATRIX node (ignored otherwise).
+ *   scalar - Factor of an EXPR_SCALE node (ignored otherwise).
+ *
+ * Returns:
+ *   The index of the new node; -1 if the node array could not grow, -2 if the tree would be deeper
+ *   than MAX_EXPRESSION_DEPTH.
+ */
+int addExprNode(Expression *expr, ExprOp op, int left, int right, MatrixHandle matrix, double scalar);
+
+
+/*
+ * Function: evaluateExpression
+ * Purpose: Evaluates an expression tree and stores its value in a matrix.
+ * Detailed Description:
+ *   The shapes of every node are checked before anything is computed, so a mismatch anywhere in the
+ *   tree leaves the result untouched.
+ *
+ * Parameters:
+ *   expr - Pointer to the Expression; the shapes of its nodes are recorded in the nodes.
+ *   ctx - Pointer to the MatrixContext holding the matrices.
+ *   result - Handle of the matrix receiving the value.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_DIMENSION_MISMATCH if operand shapes are incompatible, or the status
+ *   of a failed allocation.
+ */
+MatrixStatus evaluateExpression(const Expression *expr, MatrixContext *ctx, MatrixHandle result);
+
+#endif /* MATEXPR_H */
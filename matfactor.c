@@ -0,0 +1,424 @@
+/*
+ * Factorizations
+ * --------------
+ * This C source file implements the factorization cache and the operations built on it, declared in
+ * "matfactor.h".
+ *
+ * Core Functionalities:
+ * 1.   getFactorization:   Looks the version of the matrix up among the FACTOR_CACHE_ENTRIES entries of the
+ *                          cache; on a miss, factors the matrix and releases the least recently used entries
+ *                          until the new factors fit.
+ * 2.   computeFactors:     Exports the matrix and picks the factorization: a symmetric matrix is tried with
+ *                          Cholesky, which fails at the first pivot that is not positive, and is then
+ *                          exported again for LDL^T.
+ * 3.   determinantMatrix:  Uses the determinant kernel of a small matrix, or the diagonal of its factors.
+ * 4.   choleskyMatrix:     Transposes the packed factor U into L.
+ * 5.   invertMatrix / solveMatrix:
+ *                          Copy the identity or B into a buffer, solve in place with the factors and store
+ *                          the buffer in the result with 'readMatrix'.
+ * 6.   swapRows / isSymmetric:
+ *                          Helpers of the row-major buffers of the factorizations, shared with "matlu.c",
+ *                          "matchol.c" and "mateig.c".
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "matfactor.h"
+#include "matlu.h"
+#include "matchol.h"
+#include "matsmall.h"
+
+
+/* Factors of one matrix kept by the cache */
+typedef struct {
+    unsigned long version;      /* Version of the matrix the factors belong to */
+    Factorization factors;      /* The factors */
+    size_t bytes;               /* Bytes of the factors */
+    unsigned long lastUse;      /* Value of the use counter when the entry was last returned */
+} FactorEntry;
+
+/* Factorizations and counters of the cache of one session */
+struct FactorCache {
+    FactorEntry entries[FACTOR_CACHE_ENTRIES];  /* Entries in use, first 'count' */
+    int count;                  /* Number of entries */
+    size_t bytes;               /* Bytes of the factors kept */
+    size_t limit;               /* Limit on 'bytes' */
+    unsigned long uses;         /* Counter giving every lookup its order */
+    unsigned long hits;         /* Factorizations found */
+    unsigned long misses;       /* Factorizations computed */
+    unsigned long evictions;    /* Entries released to respect the limits */
+};
+
+
+static size_t factorCacheLimit = DEFAULT_CACHE_LIMIT;  /* Limit given to the caches created next */
+
+
+static void releaseFactors(Factorization *factors) {
+    free(factors->elements);
+    free(factors->offDiagonal);
+    free(factors->pivots);
+}
+
+
+static size_t factorBytes(const Factorization *factors) {
+    size_t n = (size_t)factors->n;  /* Order of the factored matrix */
+
+    switch (factors->kind) {
+        case FACTOR_CHOLESKY:
+            return packedTriangleSize(factors->n) * sizeof(double);
+        case FACTOR_LDLT:
+            return (packedTriangleSize(factors->n) + n) * sizeof(double) + n * sizeof(int);
+        default:
+            return n * n * sizeof(double) + n * sizeof(int);
+    }
+}
+
+
+static MatrixStatus exportSquare(const Matrix *mat, double **elements) {
+    /*
+     * Short Description:
+     * Copies a square matrix of any storage into a new n x n buffer, which the factorizations take over.
+     */
+    MatrixStatus status;
+
+    *elements = allocElements((size_t)mat->rows * (size_t)mat->rows);
+    if (*elements == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    status = exportMatrix(mat, *elements, (size_t)mat->rows);
+    if (status != MATRIX_OK) {
+        free(*elements);
+    }
+    return status;
+}
+
+
+static MatrixStatus computeFactors(const Matrix *mat, FactorKind kind, Factorization *factors) {
+    double *elements;       /* Copy of the matrix, factored in place */
+    int n = mat->rows;      /* Order of the matrix */
+    MatrixStatus status;
+
+    if (mat->rows != mat->cols) {
+        return MATRIX_NOT_SQUARE;
+    }
+    status = exportSquare(mat, &elements);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    switch (kind) {
+        case FACTOR_LU:
+            return factorLU(elements, n, factors);
+        case FACTOR_CHOLESKY:
+            return factorCholesky(elements, n, factors);
+        case FACTOR_LDLT:
+            return factorLDLT(elements, n, factors);
+        default:
+            if (!isSymmetric(elements, n)) {
+                return factorLU(elements, n, factors);
+            }
+            status = factorCholesky(elements, n, factors);
+            if (status != MATRIX_NOT_POSITIVE_DEFINITE) {
+                return status;
+            }
+            status = exportSquare(mat, &elements);
+            return (status == MATRIX_OK) ? factorLDLT(elements, n, factors) : status;
+    }
+}
+
+
+static MatrixStatus solveFactors(const Factorization *factors, double *b, int ldb, int m) {
+    return (factors->kind == FACTOR_LU) ? solveLU(factors, b, ldb, m) : solveSymmetric(factors, b, ldb, m);
+}
+
+
+static void removeEntry(struct FactorCache *cache, int index) {
+    /*
+     * Short Description:
+     * Releases an entry and moves the last entry into its place.
+     */
+    cache->bytes -= cache->entries[index].bytes;
+    releaseFactors(&cache->entries[index].factors);
+    cache->entries[index] = cache->entries[--cache->count];
+}
+
+
+void setFactorCacheLimit(size_t bytes) {
+    factorCacheLimit = bytes;
+}
+
+
+struct FactorCache *createFactorCache(void) {
+    struct FactorCache *cache = malloc(sizeof(struct FactorCache));    /* New cache */
+
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->count = 0;
+    cache->bytes = 0;
+    cache->limit = factorCacheLimit;
+    cache->uses = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    return cache;
+}
+
+
+void freeFactorCache(struct FactorCache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    while (cache->count > 0) {
+        removeEntry(cache, cache->count - 1);
+    }
+    free(cache);
+}
+
+
+MatrixStatus getFactorization(MatrixContext *ctx, MatrixHandle handle, FactorKind kind,
+                              const Factorization **factors) {
+    /*
+     * Short Description:
+     * With a limit of 0 nothing is looked up, and the new factors replace the previous ones.
+     */
+    struct FactorCache *cache = ctx->factors;           /* Cache of the session */
+    unsigned long version = ctx->versions[handle];      /* Version of the matrix */
+    Factorization computed;     /* Factors of a miss */
+    FactorEntry *entry;         /* Entry of the factors */
+    size_t bytes;               /* Bytes of the new factors */
+    int index;                  /* Variable for iterating over the entries */
+    int oldest;                 /* Least recently used entry */
+    MatrixStatus status;
+
+    if (cache == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    for (index = 0; index < cache->count && cache->limit > 0; ++index) {
+        entry = &cache->entries[index];
+        if (entry->version == version && (entry->factors.kind == kind || kind == FACTOR_AUTO)) {
+            cache->hits++;
+            entry->lastUse = ++cache->uses;
+            *factors = &entry->factors;
+            return MATRIX_OK;
+        }
+    }
+
+    cache->misses++;
+    status = computeFactors(&ctx->matrices[handle], kind, &computed);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    bytes = factorBytes(&computed);
+
+    /* The new factors are kept even alone over the limit, until the next miss */
+    while (cache->count > 0 && (cache->count == FACTOR_CACHE_ENTRIES || cache->bytes + bytes > cache->limit)) {
+        oldest = 0;
+        for (index = 1; index < cache->count; ++index) {
+            if (cache->entries[index].lastUse < cache->entries[oldest].lastUse) {
+                oldest = index;
+            }
+        }
+        removeEntry(cache, oldest);
+        cache->evictions++;
+    }
+    entry = &cache->entries[cache->count++];
+    entry->version = version;
+    entry->factors = computed;
+    entry->bytes = bytes;
+    entry->lastUse = ++cache->uses;
+    cache->bytes += bytes;
+    *factors = &entry->factors;
+    return MATRIX_OK;
+}
+
+
+void getFactorCacheStats(const struct FactorCache *cache, CacheStats *stats) {
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->entries = (size_t)cache->count;
+    stats->bytes = cache->bytes;
+    stats->limit = cache->limit;
+}
+
+
+MatrixStatus determinantMatrix(MatrixContext *ctx, MatrixHandle handle, double *det) {
+    const Matrix *mat = &ctx->matrices[handle];     /* Matrix of the determinant */
+    const SmallKernels *small = getSmallKernels(mat->rows, mat->cols);     /* Kernels of a small square */
+    const Factorization *factors;   /* Factors of the matrix */
+    double product;                 /* Product of the pivots */
+    double pivot;                   /* Diagonal element of the factors */
+    int step;                       /* Variable for iterating over the pivots */
+    MatrixStatus status;
+
+    if (mat->rows != mat->cols) {
+        return MATRIX_NOT_SQUARE;
+    }
+    if (small != NULL && mat->data != NULL) {
+        *det = small->determinant(mat->data, mat->ld);
+        return MATRIX_OK;
+    }
+
+    status = getFactorization(ctx, handle, FACTOR_AUTO, &factors);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    if (factors->singular) {
+        *det = 0.0;
+        return MATRIX_OK;
+    }
+
+    /* The symmetric permutation of LDL^T leaves the determinant unchanged */
+    product = (double)factors->sign;
+    for (step = 0; step < factors->n; ++step) {
+        if (factors->kind == FACTOR_LU) {
+            product *= factors->elements[(size_t)step * factors->n + step];
+            continue;
+        }
+        pivot = *packedRow(factors, step);
+        if (factors->kind == FACTOR_CHOLESKY) {
+            product *= pivot * pivot;
+        } else if (factors->offDiagonal[step] != 0.0) {
+            product *= pivot * *packedRow(factors, step + 1) - factors->offDiagonal[step] * factors->offDiagonal[step];
+            ++step;
+        } else {
+            product *= pivot;
+        }
+    }
+    *det = product;
+    return MATRIX_OK;
+}
+
+
+MatrixStatus choleskyMatrix(MatrixContext *ctx, MatrixHandle handle, MatrixHandle result) {
+    const Factorization *factors;   /* Factors of the matrix */
+    const double *factorRow;        /* Row of U from its diagonal, which is a column of L */
+    double *lower;                  /* The factor L */
+    size_t count;                   /* Number of elements of L */
+    int row, col;                   /* Variables for iterating over the rows of U and their elements */
+    MatrixStatus status;
+
+    status = getFactorization(ctx, handle, FACTOR_AUTO, &factors);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    if (factors->kind != FACTOR_CHOLESKY) {
+        return (factors->kind == FACTOR_LU) ? MATRIX_NOT_SYMMETRIC : MATRIX_NOT_POSITIVE_DEFINITE;
+    }
+    count = (size_t)factors->n * (size_t)factors->n;
+    lower = allocElements(count);
+    if (lower == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    memset(lower, 0, count * sizeof(double));
+    for (row = 0; row < factors->n; ++row) {
+        factorRow = packedRow(factors, row);
+        for (col = row; col < factors->n; ++col) {
+            lower[(size_t)col * factors->n + row] = factorRow[col - row];
+        }
+    }
+
+    status = readMatrix(&ctx->matrices[result], factors->n, factors->n, lower, count);
+    free(lower);
+    return status;
+}
+
+
+MatrixStatus invertMatrix(MatrixContext *ctx, MatrixHandle handle, MatrixHandle result) {
+    const Factorization *factors;   /* Factors of the matrix */
+    double *inverse;                /* The identity, then the inverse */
+    size_t count;                   /* Number of elements of the inverse */
+    int step;                       /* Variable for iterating over the diagonal */
+    MatrixStatus status;
+
+    status = getFactorization(ctx, handle, FACTOR_AUTO, &factors);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    if (factors->singular) {
+        return MATRIX_SINGULAR;
+    }
+    count = (size_t)factors->n * (size_t)factors->n;
+    inverse = allocElements(count);
+    if (inverse == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    memset(inverse, 0, count * sizeof(double));
+    for (step = 0; step < factors->n; ++step) {
+        inverse[(size_t)step * factors->n + step] = 1.0;
+    }
+
+    status = solveFactors(factors, inverse, factors->n, factors->n);
+    if (status == MATRIX_OK) {
+        status = readMatrix(&ctx->matrices[result], factors->n, factors->n, inverse, count);
+    }
+    free(inverse);
+    return status;
+}
+
+
+MatrixStatus solveMatrix(MatrixContext *ctx, MatrixHandle a, MatrixHandle b, MatrixHandle x) {
+    const Matrix *rhs = &ctx->matrices[b];  /* Right-hand sides */
+    const Factorization *factors;   /* Factors of A */
+    double *solution;               /* B, then X */
+    size_t count;                   /* Number of elements of X */
+    int rows = rhs->rows;           /* Rows of B and X */
+    int cols = rhs->cols;           /* Columns of B and X */
+    MatrixStatus status;
+
+    if (ctx->matrices[a].rows != ctx->matrices[a].cols) {
+        return MATRIX_NOT_SQUARE;
+    }
+    if (rows != ctx->matrices[a].rows) {
+        return MATRIX_DIMENSION_MISMATCH;
+    }
+    status = getFactorization(ctx, a, FACTOR_AUTO, &factors);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    if (factors->singular) {
+        return MATRIX_SINGULAR;
+    }
+    count = (size_t)rows * (size_t)cols;
+    solution = allocElements(count);
+    if (solution == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+
+    status = exportMatrix(rhs, solution, (size_t)cols);
+    if (status == MATRIX_OK) {
+        status = solveFactors(factors, solution, cols, cols);
+    }
+    if (status == MATRIX_OK) {
+        status = readMatrix(&ctx->matrices[x], rows, cols, solution, count);
+    }
+    free(solution);
+    return status;
+}
+
+
+void swapRows(double *row1, double *row2, int count) {
+    double value;   /* Element being exchanged */
+    int col;        /* Variable for iterating over the columns */
+
+    for (col = 0; col < count; ++col) {
+        value = row1[col];
+        row1[col] = row2[col];
+        row2[col] = value;
+    }
+}
+
+
+bool isSymmetric(const double *a, int n) {
+    int row, col;   /* Variables for iterating over the upper triangle */
+
+    for (row = 0; row < n; ++row) {
+        for (col = row + 1; col < n; ++col) {
+            if (a[(size_t)row * n + col] != a[(size_t)col * n + row]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
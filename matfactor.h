@@ -0,0 +1,236 @@
+/*
+ * Factorization Header
+ * --------------------
+ * This C header file declares the factorization-based operations implemented in "matfactor.c": the
+ * determinant, the inverse and the solution of linear systems. They all start from a factorization of
+ * the matrix, which costs O(n^3), while using one costs O(n^2) per right-hand side. Every session keeps
+ * the factorizations of its most recently used matrices, identified by their versions (see "matreg.h"),
+ * so repeated solves against an unchanged matrix only run the triangular solves. Symmetric matrices are
+ * factored by Cholesky, or LDL^T when they are not positive definite, at half the cost of LU.
+ *
+ * Core Structures:
+ * - FactorKind:        Enumeration of the factorizations.
+ * - Factorization:     Factors of one matrix.
+ *
+ * Core Functions:
+ * - setFactorCacheLimit:   Sets the bytes of factors a cache may keep.
+ * - createFactorCache / freeFactorCache:
+ *                          Create and release the factorization cache of a session.
+ * - getFactorization:      Returns the factors of a matrix, from the cache or computed.
+ * - choleskyMatrix:        Computes the Cholesky factor of a matrix.
+ * - getFactorCacheStats:   Reads the counters of a cache.
+ * - determinantMatrix:     Computes the determinant of a matrix.
+ * - invertMatrix:          Computes the inverse of a matrix.
+ * - solveMatrix:           Solves A X = B.
+ * - swapRows / isSymmetric:
+ *                          Exchange two rows of a buffer, and test a square buffer for symmetry.
+ *
+ * Note:
+ * The factors are computed in memory whatever the storage of the matrix, and the results are stored
+ * like those of the other operations: sparse, dense or on disk according to their density and size.
+ */
+
+#ifndef MATFACTOR_H
+#define MATFACTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "mymat.h"
+#include "matcache.h"
+
+/* Factorizations a cache holds at most */
+#define FACTOR_CACHE_ENTRIES 8
+
+/* Enumeration of the factorizations */
+typedef enum {
+    FACTOR_AUTO,        /* Requests only: the cheapest of the others that the matrix admits */
+    FACTOR_LU,          /* P A = L U with partial pivoting (see "matlu.h") */
+    FACTOR_CHOLESKY,    /* A = U^T U of a symmetric positive definite matrix (see "matchol.h") */
+    FACTOR_LDLT,        /* P A P^T = U^T D U of a symmetric matrix (see "matchol.h") */
+    NUM_FACTOR_KINDS    /* Sentinel value for the number of factorizations */
+} FactorKind;
+
+/* Factors of one square matrix */
+typedef struct {
+    FactorKind kind;    /* Factorization held */
+    int n;              /* Order of the factored matrix */
+    /*  LU: n x n row-major factors, L strictly below the diagonal, whose own diagonal of ones is
+        not stored, and U on and above it. Cholesky and LDL^T: U packed by blocks of rows (see
+        "matchol.h"), whose diagonal holds that of D for LDL^T */
+    double *elements;
+    /*  LDL^T: element of D right of its diagonal element i for a block of order 2 starting at
+        row i, 0 elsewhere. NULL for the other factorizations */
+    double *offDiagonal;
+    int *pivots;        /* Row exchanged with row i at step i; NULL for Cholesky, which exchanges none */
+    int sign;           /* Sign of the row permutation, 1 or -1 */
+    bool singular;      /* Whether a pivot was zero, so the matrix has no inverse */
+} Factorization;
+
+
+/*
+ * Function: setFactorCacheLimit
+ * Purpose: Sets the bytes of factors every cache created afterwards may keep.
+ *
+ * Parameters:
+ *   bytes - The limit; 0 keeps only the factors in use, so every factorization is computed.
+ *
+ * Returns: None (void function).
+ */
+void setFactorCacheLimit(size_t bytes);
+
+
+/*
+ * Function: createFactorCache
+ * Purpose: Creates an empty factorization cache.
+ *
+ * Returns:
+ *   The cache, or NULL if it could not be allocated; the factorization-based operations then fail.
+ */
+struct FactorCache *createFactorCache(void);
+
+
+/*
+ * Function: freeFactorCache
+ * Purpose: Releases a factorization cache and the factors it keeps.
+ *
+ * Parameters:
+ *   cache - The cache, or NULL.
+ *
+ * Returns: None (void function).
+ */
+void freeFactorCache(struct FactorCache *cache);
+
+
+/*
+ * Function: getFactorization
+ * Purpose: Returns the factors of a matrix.
+ * Detailed Description:
+ *   The factors of the current version of the matrix are taken from the cache, or computed and added
+ *   to it, the least recently used factors being released to respect the limits. The factors stay
+ *   valid until the next call. FACTOR_AUTO gives Cholesky factors for a symmetric positive definite
+ *   matrix, LDL^T factors for another symmetric matrix, and LU factors otherwise; a matrix is only
+ *   taken as symmetric when its elements are exactly equal to their transposes.
+ *
+ * Parameters:
+ *   ctx - Pointer to the MatrixContext holding the matrices and the cache.
+ *   handle - Handle of the matrix.
+ *   kind - Factorization wanted.
+ *   factors - Receives the factors.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_NOT_SQUARE for a rectangular matrix, MATRIX_NOT_POSITIVE_DEFINITE when
+ *   FACTOR_CHOLESKY is requested for a matrix that is not, MATRIX_ALLOCATION_FAILED if the factors could
+ *   not be allocated, or the status of a failed read of a matrix stored on disk.
+ */
+MatrixStatus getFactorization(MatrixContext *ctx, MatrixHandle handle, FactorKind kind,
+                              const Factorization **factors);
+
+
+/*
+ * Function: getFactorCacheStats
+ * Purpose: Reads the counters of a factorization cache.
+ *
+ * Parameters:
+ *   cache - The cache; must not be NULL.
+ *   stats - Receives the counters.
+ *
+ * Returns: None (void function).
+ */
+void getFactorCacheStats(const struct FactorCache *cache, CacheStats *stats);
+
+
+/*
+ * Function: determinantMatrix
+ * Purpose: Computes the determinant of a square matrix.
+ * Detailed Description:
+ *   The product of the pivots of the LU factorization with the sign of the row permutation, the square
+ *   of the product of the diagonal of a Cholesky factor, or the determinant of D. Small matrices held in
+ *   memory use the kernels of "matsmall.h" instead.
+ *
+ * Parameters:
+ *   ctx - Pointer to the MatrixContext holding the matrices and the cache.
+ *   handle - Handle of the matrix.
+ *   det - Receives the determinant.
+ *
+ * Returns:
+ *   MATRIX_OK on success, or the status of 'getFactorization'.
+ */
+MatrixStatus determinantMatrix(MatrixContext *ctx, MatrixHandle handle, double *det);
+
+
+/*
+ * Function: choleskyMatrix
+ * Purpose: Computes the lower triangular Cholesky factor L = U^T of a matrix, for which A = L L^T.
+ *
+ * Parameters:
+ *   ctx - Pointer to the MatrixContext holding the matrices and the cache.
+ *   handle - Handle of the symmetric positive definite matrix.
+ *   result - Handle of the matrix receiving L; it may be 'handle'.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_NOT_SYMMETRIC or MATRIX_NOT_POSITIVE_DEFINITE if the matrix has no
+ *   Cholesky factor, or the status of 'getFactorization' or of storing the result.
+ */
+MatrixStatus choleskyMatrix(MatrixContext *ctx, MatrixHandle handle, MatrixHandle result);
+
+
+/*
+ * Function: invertMatrix
+ * Purpose: Computes the inverse of a square matrix, by solving A X = I.
+ *
+ * Parameters:
+ *   ctx - Pointer to the MatrixContext holding the matrices and the cache.
+ *   handle - Handle of the matrix to invert.
+ *   result - Handle of the matrix receiving the inverse; it may be 'handle'.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_SINGULAR if the matrix has no inverse, or the status of
+ *   'getFactorization' or of storing the result.
+ */
+MatrixStatus invertMatrix(MatrixContext *ctx, MatrixHandle handle, MatrixHandle result);
+
+
+/*
+ * Function: solveMatrix
+ * Purpose: Solves A X = B for X, where B has one column per right-hand side.
+ *
+ * Parameters:
+ *   ctx - Pointer to the MatrixContext holding the matrices and the cache.
+ *   a - Handle of the n x n matrix A.
+ *   b - Handle of the n x m matrix B.
+ *   x - Handle of the matrix receiving the n x m solution; it may be 'a' or 'b'.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_DIMENSION_MISMATCH if B has not n rows, MATRIX_SINGULAR if A has no
+ *   inverse, or the status of 'getFactorization' or of storing the result.
+ */
+MatrixStatus solveMatrix(MatrixContext *ctx, MatrixHandle a, MatrixHandle b, MatrixHandle x);
+
+
+/*
+ * Function: swapRows
+ * Purpose: Exchanges the first 'count' elements of two rows of a buffer.
+ *
+ * Parameters:
+ *   row1, row2 - The rows; they must not overlap.
+ *   count - Number of elements to exchange.
+ *
+ * Returns: None (void function).
+ */
+void swapRows(double *row1, double *row2, int count);
+
+
+/*
+ * Function: isSymmetric
+ * Purpose: Tells whether an n x n row-major buffer equals its transpose exactly.
+ *
+ * Parameters:
+ *   a - The elements, rows n apart.
+ *   n - Order of the matrix.
+ *
+ * Returns:
+ *   true if every element equals its transpose.
+ */
+bool isSymmetric(const double *a, int n);
+
+#endif /* MATFACTOR_H */
@@ -0,0 +1,270 @@
+/*
+ * Matrix Output Formatter
+ * -----------------------
+ * This C source file implements the output path declared in "matfmt.h".
+ *
+ * Core Functionalities:
+ * 1.   formatFixed:        Converts a double to the text of "%.2f" without printf. The value is scaled by 100
+ *                          with its exact rounding error (Dekker's product), so the decision to round up is
+ *                          taken on the exact binary value, ties to even, exactly as printf does; values out
+ *                          of range, infinities and NaNs fall back to snprintf.
+ * 2.   formatElement:      Text of one element in the current format, padded in table mode.
+ * 3.   writeOutput / finishOutput:
+ *                          Hand the buffer to write(2) after flushing stdio, or to stdio when it is small.
+ * 4.   printRows:          Walks the rows and columns to print, with the head/tail summary, filling the buffer;
+ *                          printElements supplies it with the rows of a block in memory.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "mymat.h"
+#include "matfmt.h"
+
+
+#if MATRIX_PRINT_PREC != 2
+#error "formatFixed scales by 10^MATRIX_PRINT_PREC = 100"
+#endif
+
+/* 10^MATRIX_PRINT_PREC */
+#define FIXED_SCALE 100.0
+
+/* Magnitudes below this bound are formatted directly: their scaled value fits in 32 bits */
+#define FIXED_FAST_LIMIT 4.0e7
+
+/* Veltkamp splitting constant 2^27 + 1: splits a double into two halves of at most 26 significant bits */
+#define SPLIT_FACTOR 134217729.0
+
+/* Width of an element printed with full precision, and the conversion used for it */
+#define FULL_PRINT_WIDTH 24
+#define FULL_PRINT_DIGITS 17
+
+/* Size of the output buffer */
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+/* Room kept for one element: "%.2f" of the largest double has 309 integer digits */
+#define MAX_ELEMENT_TEXT 512
+
+/* Output smaller than this is passed on to stdio rather than written directly */
+#define DIRECT_WRITE_THRESHOLD 4096
+
+/* Text standing for the rows or columns left out of a summary */
+#define ELLIPSIS "..."
+
+
+static PrintFormat printFormat = {false, false, 0};    /* Current format */
+static char outputBuffer[OUTPUT_BUFFER_SIZE];           /* Text not yet handed over */
+static size_t outputUsed = 0;                           /* Bytes used in 'outputBuffer' */
+
+
+void setPrintFormat(const PrintFormat *format) {
+    printFormat = *format;
+}
+
+
+static size_t formatFixed(char *out, double value, int width) {
+    /*
+     * Short Description:
+     * Writes 'value' as "%*.2f" with the given width (0 for none) and returns the number of characters.
+     */
+    double magnitude = (value < 0.0) ? -value : value;  /* |value| */
+    double scaled;                  /* magnitude * 100, rounded */
+    double error;                   /* Exact magnitude * 100 - scaled */
+    double split, high, low;        /* Veltkamp split of the magnitude */
+    double excess;                  /* Exact (fraction of magnitude * 100) - 0.5, up to its sign */
+    unsigned long units;            /* Hundredths of the rounded result */
+    char digits[16];                /* Text, written backwards from the end */
+    char *text = digits + sizeof(digits);   /* First character of the text */
+    size_t length;                  /* Characters in the text */
+    size_t pad;                     /* Spaces before the text */
+    bool negative;                  /* Whether a sign is printed */
+
+    if (!(magnitude < FIXED_FAST_LIMIT)) {
+        /* Large, infinite or NaN */
+        return (size_t)sprintf(out, "%*.*f", width, MATRIX_PRINT_PREC, value);
+    }
+    /* printf keeps the sign of values that round to zero, negative zero included */
+    negative = value < 0.0 || (value == 0.0 && 1.0 / value < 0.0);
+
+    /* scaled + error == magnitude * 100 exactly; 100 needs no split */
+    scaled = magnitude * FIXED_SCALE;
+    split = magnitude * SPLIT_FACTOR;
+    high = split - (split - magnitude);
+    low = magnitude - high;
+    error = (high * FIXED_SCALE - scaled) + low * FIXED_SCALE;
+
+    /* Round to the nearest hundredth; the sign of a rounded sum is the sign of the exact sum */
+    units = (unsigned long)scaled;
+    excess = ((scaled - (double)units) - 0.5) + error;
+    if (excess > 0.0 || (excess == 0.0 && (units & 1UL))) {
+        units++;
+    }
+
+    *--text = (char)('0' + units % 10);
+    units /= 10;
+    *--text = (char)('0' + units % 10);
+    units /= 10;
+    *--text = '.';
+    do {
+        *--text = (char)('0' + units % 10);
+        units /= 10;
+    } while (units != 0);
+    if (negative) {
+        *--text = '-';
+    }
+
+    length = (size_t)(digits + sizeof(digits) - text);
+    pad = ((size_t)width > length) ? (size_t)width - length : 0;
+    memset(out, ' ', pad);
+    memcpy(out + pad, text, length);
+    return pad + length;
+}
+
+
+static size_t formatElement(char *out, double value) {
+    /*
+     * Short Description:
+     * Writes one element in the current format, without its separator.
+     */
+    if (printFormat.fullPrecision) {
+        return (size_t)sprintf(out, "%*.*g", printFormat.csv ? 0 : FULL_PRINT_WIDTH, FULL_PRINT_DIGITS, value);
+    }
+    return formatFixed(out, value, printFormat.csv ? 0 : MATRIX_PRINT_WIDTH);
+}
+
+
+static size_t formatEllipsis(char *out) {
+    /*
+     * Short Description:
+     * Writes the placeholder of left-out rows or columns, padded like an element.
+     */
+    int width = printFormat.csv ? 0 : (printFormat.fullPrecision ? FULL_PRINT_WIDTH : MATRIX_PRINT_WIDTH);
+
+    return (size_t)sprintf(out, "%*s", width, ELLIPSIS);
+}
+
+
+static void writeOutput(void) {
+    /*
+     * Short Description:
+     * Flushes stdio, so earlier text comes first, then writes the whole buffer to standard output.
+     * Output that cannot be written is dropped, as printf would.
+     */
+    size_t written = 0;     /* Bytes already written */
+    ssize_t count;          /* Bytes written by one call */
+
+    fflush(stdout);
+    while (written < outputUsed) {
+        count = write(STDOUT_FILENO, outputBuffer + written, outputUsed - written);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        written += (size_t)count;
+    }
+    outputUsed = 0;
+}
+
+
+static void finishOutput(void) {
+    /*
+     * Short Description:
+     * Hands over what is left in the buffer: small output joins the stdio stream, which batches it
+     * with the text around it, and larger output is written directly.
+     */
+    if (outputUsed >= DIRECT_WRITE_THRESHOLD) {
+        writeOutput();
+    } else if (outputUsed > 0) {
+        fwrite(outputBuffer, 1, outputUsed, stdout);
+        outputUsed = 0;
+    }
+}
+
+
+static int nextIndex(int index, int count) {
+    /*
+     * Short Description:
+     * Returns the row (or column) printed after 'index' in a summary of 'count' of them. The index
+     * 'edgeItems' stands for the ellipsis, after which the last 'edgeItems' follow.
+     */
+    if (printFormat.edgeItems > 0 && count > 2 * printFormat.edgeItems && index == printFormat.edgeItems) {
+        return count - printFormat.edgeItems;
+    }
+    return index + 1;
+}
+
+
+static bool isEllipsis(int index, int count) {
+    return printFormat.edgeItems > 0 && count > 2 * printFormat.edgeItems && index == printFormat.edgeItems;
+}
+
+
+/* Block of elements in memory, as a source of 'printRows' */
+typedef struct {
+    const double *data;     /* Element (0, 0) */
+    size_t ld;              /* Distance in elements between rows */
+} ElementBlock;
+
+
+static const double *blockRow(void *source, int row) {
+    const ElementBlock *block = source;
+
+    return block->data + (size_t)row * block->ld;
+}
+
+
+void printElements(const double *data, size_t ld, int rows, int cols) {
+    ElementBlock block;     /* The elements as a source of rows */
+
+    block.data = data;
+    block.ld = ld;
+    printRows(blockRow, &block, rows, cols);
+}
+
+
+bool printRows(RowReader read, void *source, int rows, int cols) {
+    /*
+     * Short Description:
+     * Formats the rows into the output buffer, writing it out whenever the next element might not fit.
+     */
+    int row, column;        /* Row and column indices */
+    bool first;             /* Whether the next field is the first of its line */
+    char separator = printFormat.csv ? ',' : ' ';   /* Text between (table: after) fields */
+    const double *values = NULL;                    /* Elements of the current row */
+
+    for (row = 0; row < rows; row = nextIndex(row, rows)) {
+        if (!isEllipsis(row, rows)) {
+            values = read(source, row);
+            if (values == NULL) {
+                finishOutput();
+                return false;
+            }
+        }
+        first = true;
+        for (column = 0; column < cols; column = nextIndex(column, cols)) {
+            if (outputUsed > OUTPUT_BUFFER_SIZE - MAX_ELEMENT_TEXT) {
+                writeOutput();
+            }
+            if (printFormat.csv && !first) {
+                outputBuffer[outputUsed++] = separator;
+            }
+            if (isEllipsis(row, rows) || isEllipsis(column, cols)) {
+                outputUsed += formatEllipsis(outputBuffer + outputUsed);
+            } else {
+                outputUsed += formatElement(outputBuffer + outputUsed, values[column]);
+            }
+            if (!printFormat.csv) {
+                outputBuffer[outputUsed++] = separator;
+            }
+            first = false;
+        }
+        outputBuffer[outputUsed++] = '\n';
+    }
+    finishOutput();
+    return true;
+}
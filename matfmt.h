@@ -0,0 +1,88 @@
+/*
+ * Matrix Output Formatter Header
+ * ------------------------------
+ * This C header file declares the output path of 'print_mat' and 'print_batch', implemented in "matfmt.c".
+ * Elements are converted to text by a dedicated fixed-precision formatter into a large buffer, which is
+ * handed to the operating system with write(2) once it fills, instead of going through one printf per
+ * element. The default output is byte-identical to the "%8.2f " format used since the first release.
+ *
+ * Core Structures:
+ * - PrintFormat:       Selects full precision, CSV rows and head/tail summaries of large matrices.
+ *
+ * Core Functions:
+ * - setPrintFormat:    Sets the format used by every following print.
+ * - printElements:     Prints a row-major block of elements in the current format.
+ * - printRows:         Prints rows supplied one at a time by a callback, for matrices not held in memory.
+ *
+ * Note:
+ * Text that is still in the stdio buffer of 'stdout' is flushed before the formatter writes to the
+ * descriptor, and output too small to be worth a system call of its own is passed on to stdio, so the
+ * formatter and printf can be mixed freely and keep their order.
+ */
+
+#ifndef MATFMT_H
+#define MATFMT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Format of the printed matrices */
+typedef struct {
+    bool fullPrecision;     /* Print 17 significant digits ("%24.17g ") instead of two decimals */
+    bool csv;               /* Separate the elements of a row with commas, without padding */
+    int edgeItems;          /* Rows and columns kept at each end of longer matrices, 0 to print everything */
+} PrintFormat;
+
+/* Supplier of the rows of 'printRows': returns row 'row' of 'source', or NULL if it cannot be read */
+typedef const double *(*RowReader)(void *source, int row);
+
+
+/*
+ * Function: setPrintFormat
+ * Purpose: Sets the format used by 'printElements'.
+ * Detailed Description:
+ *   The default format has two decimals in columns of MATRIX_PRINT_WIDTH characters, no CSV and no
+ *   summary. With a positive 'edgeItems', a matrix with more than twice that many rows (or columns)
+ *   is summarized to its first and last 'edgeItems' rows (or columns), with "..." in place of the rest.
+ *
+ * Parameters:
+ *   format - Pointer to the format to use; it is copied.
+ *
+ * Returns: None (void function).
+ */
+void setPrintFormat(const PrintFormat *format);
+
+
+/*
+ * Function: printElements
+ * Purpose: Prints a block of elements to standard output, one line per row.
+ *
+ * Parameters:
+ *   data - Pointer to the first element; element (row, col) is at data[row * ld + col].
+ *   ld - Distance in elements between consecutive rows.
+ *   rows, cols - Dimensions of the block.
+ *
+ * Returns: None (void function).
+ */
+void printElements(const double *data, size_t ld, int rows, int cols);
+
+
+/*
+ * Function: printRows
+ * Purpose: Prints rows obtained from a callback, one line per row.
+ * Detailed Description:
+ *   The callback is only asked for the rows that are printed, in order, so a summary of a large
+ *   matrix reads no more than its edges. The pointer it returns need only stay valid until the next
+ *   call. Printing stops at the first row the callback fails to supply.
+ *
+ * Parameters:
+ *   read - Callback supplying row 'row' of 'source' ('cols' elements).
+ *   source - Argument passed to the callback.
+ *   rows, cols - Dimensions of the block.
+ *
+ * Returns:
+ *   true if every row was printed; false if the callback failed.
+ */
+bool printRows(RowReader read, void *source, int rows, int cols);
+
+#endif /* MATFMT_H */
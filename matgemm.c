@@ -0,0 +1,448 @@
+/*
+ * Blocked Matrix Multiplication
+ * -----------------------------
+ * This C source file implements the GEMM engine declared in "matgemm.h".
+ *
+ * Core Functionalities:
+ * 1.   gemm:               Entry point; scales C by beta and drives the blocked loops.
+ * 2.   gemmDirect:         Unpacked loop used for products that fit in L1.
+ * 3.   packPanelA:         Packs a GEMM_MC x GEMM_KC panel of op(A) into GEMM_MR-row slivers.
+ * 4.   packPanelB:         Packs a GEMM_KC x GEMM_NC panel of op(B) into GEMM_NR-column slivers.
+ * 5.   gemmMacroKernel:    Walks the packed panels tile by tile.
+ * 6.   gemmMicroKernel*:   Compute one GEMM_MR x GEMM_NR tile of C in registers; an SSE2 variant that
+ *                          runs everywhere and an AVX2/FMA variant chosen at runtime when supported.
+ *
+ * The loop order follows the classic Goto/BLIS scheme: columns of C in steps of GEMM_NC, the inner
+ * dimension in steps of GEMM_KC, rows of C in steps of GEMM_MC, then GEMM_NR x GEMM_MR register tiles.
+ * Packed slivers are zero-padded to full tiles so the micro-kernel never has to handle edges itself.
+ * For every B panel the packing is split across the thread pool by slivers, then the row panels of A are
+ * split across it; each thread packs its A panels into its own buffer.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "matgemm.h"
+#include "matsimd.h"
+#include "matpool.h"
+
+
+/* Two doubles: the vector width every x86-64 processor provides (SSE2) */
+typedef double GemmVector2 __attribute__((vector_size(2 * sizeof(double))));
+
+/* A GEMM_MR x GEMM_NR tile of C, aligned for vector stores */
+typedef struct __attribute__((aligned(32))) {
+    double values[GEMM_MR * GEMM_NR];
+} GemmTile;
+
+/* Signature shared by the micro-kernel variants */
+typedef void (*GemmMicroKernel)(int kc, const double *a, const double *b, double alpha,
+                                double *c, int ldc, int mr, int nr);
+
+
+/* Round 'value' up to the next multiple of 'step' */
+#define ROUND_UP(value, step) ((((value) + (step) - 1) / (step)) * (step))
+
+/* Read element (row, col) of op(X) from a row-major buffer */
+#define OP_AT(x, ld, trans, row, col) \
+    ((trans) == GEMM_NO_TRANS ? (x)[(size_t)(row) * (ld) + (col)] : (x)[(size_t)(col) * (ld) + (row)])
+
+
+static void scaleResult(int m, int n, double beta, double *c, int ldc) {
+    /*
+     * Short Description:
+     * Applies C = beta * C; a zero beta clears C without reading it.
+     */
+    int row, column;    /* Variables for row and column indices */
+    double *rowPtr;     /* Start of the current row of C */
+
+    if (beta == 1.0) {
+        return;
+    }
+    for (row = 0; row < m; ++row) {
+        rowPtr = c + (size_t)row * ldc;
+        if (beta == 0.0) {
+            memset(rowPtr, 0, (size_t)n * sizeof(double));
+        } else {
+            for (column = 0; column < n; ++column) {
+                rowPtr[column] *= beta;
+            }
+        }
+    }
+}
+
+
+static void gemmDirect(GemmTranspose transA, GemmTranspose transB, int m, int n, int k,
+                       double alpha, const double *a, int lda, const double *b, int ldb,
+                       double *c, int ldc) {
+    /*
+     * Short Description:
+     * Accumulates C += alpha * op(A) * op(B) with an i-p-j loop, so the innermost loop walks
+     * rows of C and (untransposed) B contiguously.
+     */
+    int row, column, inner;     /* Variables for row, column, and inner loop indices */
+    double scaled;              /* alpha * op(A)(row, inner) */
+    double *rowPtr;             /* Start of the current row of C */
+
+    for (row = 0; row < m; ++row) {
+        rowPtr = c + (size_t)row * ldc;
+        for (inner = 0; inner < k; ++inner) {
+            scaled = alpha * OP_AT(a, lda, transA, row, inner);
+            for (column = 0; column < n; ++column) {
+                rowPtr[column] += scaled * OP_AT(b, ldb, transB, inner, column);
+            }
+        }
+    }
+}
+
+
+static void packPanelA(GemmTranspose transA, int mc, int kc, const double *a, int lda, double *packed) {
+    /*
+     * Short Description:
+     * Packs an mc x kc block of op(A) (starting at 'a') into GEMM_MR-row slivers. Inside a sliver the
+     * GEMM_MR values of each inner step are consecutive. Rows past 'mc' are zero-filled.
+     */
+    int sliver, inner, r;   /* Sliver, inner-dimension and in-sliver row indices */
+    int row;                /* Row of op(A) being packed */
+
+    for (sliver = 0; sliver < mc; sliver += GEMM_MR) {
+        for (inner = 0; inner < kc; ++inner) {
+            for (r = 0; r < GEMM_MR; ++r) {
+                row = sliver + r;
+                *packed++ = (row < mc) ? OP_AT(a, lda, transA, row, inner) : 0.0;
+            }
+        }
+    }
+}
+
+
+static void packPanelB(GemmTranspose transB, int kc, int nc, const double *b, int ldb, double *packed) {
+    /*
+     * Short Description:
+     * Packs a kc x nc block of op(B) (starting at 'b') into GEMM_NR-column slivers. Inside a sliver
+     * the GEMM_NR values of each inner step are consecutive. Columns past 'nc' are zero-filled.
+     */
+    int sliver, inner, col;     /* Sliver, inner-dimension and in-sliver column indices */
+    int width;                  /* Number of real columns in the current sliver */
+    const double *src;          /* Row of B being copied */
+
+    for (sliver = 0; sliver < nc; sliver += GEMM_NR) {
+        width = (nc - sliver < GEMM_NR) ? nc - sliver : GEMM_NR;
+        for (inner = 0; inner < kc; ++inner) {
+            if (transB == GEMM_NO_TRANS) {
+                /* A row of an untransposed B is contiguous */
+                src = b + (size_t)inner * ldb + sliver;
+                for (col = 0; col < width; ++col) {
+                    packed[col] = src[col];
+                }
+            } else {
+                for (col = 0; col < width; ++col) {
+                    packed[col] = b[(size_t)(sliver + col) * ldb + inner];
+                }
+            }
+            for (col = width; col < GEMM_NR; ++col) {
+                packed[col] = 0.0;
+            }
+            packed += GEMM_NR;
+        }
+    }
+}
+
+
+static void writeTile(const GemmTile *tile, double alpha, double *c, int ldc, int mr, int nr) {
+    /*
+     * Short Description:
+     * Adds alpha times the top-left mr x nr corner of an accumulated tile to C.
+     */
+    int row, column;    /* Variables for row and column indices */
+    double *rowPtr;     /* Start of the current row of C */
+
+    for (row = 0; row < mr; ++row) {
+        rowPtr = c + (size_t)row * ldc;
+        for (column = 0; column < nr; ++column) {
+            rowPtr[column] += alpha * tile->values[row * GEMM_NR + column];
+        }
+    }
+}
+
+
+static void gemmMicroKernelSse2(int kc, const double *a, const double *b, double alpha,
+                                double *c, int ldc, int mr, int nr) {
+    /*
+     * Short Description:
+     * Portable micro-kernel on 2-wide vectors. Sixteen xmm registers cannot hold the whole 4 x 8 tile
+     * plus operands, so the tile is computed as two 2 x 8 halves, each pass re-reading the B sliver
+     * from L1.
+     */
+    static const GemmVector2 zero = {0.0, 0.0};
+    GemmVector2 c00, c01, c02, c03, c10, c11, c12, c13;    /* Accumulators: row, column quarter */
+    GemmVector2 b0, b1, b2, b3;     /* Current row of the B sliver */
+    GemmTile tile;                  /* Accumulated tile spilled for the write-back */
+    const double *aPtr, *bPtr;      /* Walking pointers into the slivers */
+    double *out;                    /* First tile row written by this pass */
+    int half, inner;                /* Pass and inner-dimension indices */
+
+    for (half = 0; half < GEMM_MR; half += 2) {
+        c00 = c01 = c02 = c03 = c10 = c11 = c12 = c13 = zero;
+        aPtr = a + half;
+        bPtr = b;
+        for (inner = 0; inner < kc; ++inner) {
+            b0 = ((const GemmVector2 *)bPtr)[0];
+            b1 = ((const GemmVector2 *)bPtr)[1];
+            b2 = ((const GemmVector2 *)bPtr)[2];
+            b3 = ((const GemmVector2 *)bPtr)[3];
+            c00 += aPtr[0] * b0;
+            c01 += aPtr[0] * b1;
+            c02 += aPtr[0] * b2;
+            c03 += aPtr[0] * b3;
+            c10 += aPtr[1] * b0;
+            c11 += aPtr[1] * b1;
+            c12 += aPtr[1] * b2;
+            c13 += aPtr[1] * b3;
+            aPtr += GEMM_MR;
+            bPtr += GEMM_NR;
+        }
+        out = tile.values + half * GEMM_NR;
+        ((GemmVector2 *)out)[0] = c00;
+        ((GemmVector2 *)out)[1] = c01;
+        ((GemmVector2 *)out)[2] = c02;
+        ((GemmVector2 *)out)[3] = c03;
+        ((GemmVector2 *)out)[4] = c10;
+        ((GemmVector2 *)out)[5] = c11;
+        ((GemmVector2 *)out)[6] = c12;
+        ((GemmVector2 *)out)[7] = c13;
+    }
+    writeTile(&tile, alpha, c, ldc, mr, nr);
+}
+
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma")))
+static void gemmMicroKernelAvx2(int kc, const double *a, const double *b, double alpha,
+                                double *c, int ldc, int mr, int nr) {
+    /*
+     * Short Description:
+     * AVX2/FMA micro-kernel: the whole 4 x 8 tile lives in eight ymm accumulators and every
+     * update is a fused multiply-add.
+     */
+    __m256d c00, c01, c10, c11, c20, c21, c30, c31;    /* Accumulators: row, column half */
+    __m256d b0, b1, av;     /* Current row of the B sliver and a broadcast element of A */
+    GemmTile tile;          /* Accumulated tile spilled for the write-back */
+    int inner;              /* Inner-dimension index */
+
+    c00 = c01 = c10 = c11 = c20 = c21 = c30 = c31 = _mm256_setzero_pd();
+    for (inner = 0; inner < kc; ++inner) {
+        b0 = _mm256_load_pd(b);
+        b1 = _mm256_load_pd(b + 4);
+        av = _mm256_broadcast_sd(a);
+        c00 = _mm256_fmadd_pd(av, b0, c00);
+        c01 = _mm256_fmadd_pd(av, b1, c01);
+        av = _mm256_broadcast_sd(a + 1);
+        c10 = _mm256_fmadd_pd(av, b0, c10);
+        c11 = _mm256_fmadd_pd(av, b1, c11);
+        av = _mm256_broadcast_sd(a + 2);
+        c20 = _mm256_fmadd_pd(av, b0, c20);
+        c21 = _mm256_fmadd_pd(av, b1, c21);
+        av = _mm256_broadcast_sd(a + 3);
+        c30 = _mm256_fmadd_pd(av, b0, c30);
+        c31 = _mm256_fmadd_pd(av, b1, c31);
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    _mm256_store_pd(tile.values + 0, c00);
+    _mm256_store_pd(tile.values + 4, c01);
+    _mm256_store_pd(tile.values + 8, c10);
+    _mm256_store_pd(tile.values + 12, c11);
+    _mm256_store_pd(tile.values + 16, c20);
+    _mm256_store_pd(tile.values + 20, c21);
+    _mm256_store_pd(tile.values + 24, c30);
+    _mm256_store_pd(tile.values + 28, c31);
+    writeTile(&tile, alpha, c, ldc, mr, nr);
+}
+#endif
+
+
+static GemmMicroKernel selectMicroKernel(void) {
+    /*
+     * Short Description:
+     * Picks the widest micro-kernel allowed by the kernel table currently selected in "matsimd.c". It is
+     * looked up on every product, as the element-wise kernels are, so it follows 'initSimdKernels'.
+     */
+#if defined(__x86_64__) || defined(__i386__)
+    if (getSimdLevel() >= SIMD_AVX2) {
+        return gemmMicroKernelAvx2;
+    }
+#endif
+    return gemmMicroKernelSse2;
+}
+
+
+static void gemmMacroKernel(GemmMicroKernel microKernel, int mc, int nc, int kc, double alpha,
+                            const double *aPacked, const double *bPacked, double *c, int ldc) {
+    /*
+     * Short Description:
+     * Multiplies a packed mc x kc panel of A by a packed kc x nc panel of B into C, one register
+     * tile at a time. The B sliver is reused across every A sliver while it is hot in L1.
+     */
+    int jr, ir;     /* Column and row offsets of the current tile */
+
+    for (jr = 0; jr < nc; jr += GEMM_NR) {
+        for (ir = 0; ir < mc; ir += GEMM_MR) {
+            microKernel(kc, aPacked + (size_t)ir * kc, bPacked + (size_t)jr * kc, alpha,
+                        c + (size_t)ir * ldc + jr, ldc,
+                        (mc - ir < GEMM_MR) ? mc - ir : GEMM_MR,
+                        (nc - jr < GEMM_NR) ? nc - jr : GEMM_NR);
+        }
+    }
+}
+
+
+/* State of one gemm call shared with the pool workers */
+typedef struct {
+    GemmMicroKernel microKernel;    /* Micro-kernel chosen for this processor */
+    GemmTranspose transA;           /* Whether A is transposed */
+    GemmTranspose transB;           /* Whether B is transposed */
+    const double *a;                /* First operand */
+    int lda;                        /* Leading dimension of A */
+    const double *b;                /* Second operand */
+    int ldb;                        /* Leading dimension of B */
+    double *c;                      /* Result */
+    int ldc;                        /* Leading dimension of C */
+    double alpha;                   /* Scale applied to the product */
+    int m;                          /* Rows of C */
+    int mcStep;                     /* Rows of A per packed panel (at most GEMM_MC) */
+    int jc, nc;                     /* Offset and width of the current column panel */
+    int pc, kc;                     /* Offset and depth of the current inner panel */
+    double *aPacked;                /* One GEMM_MC x GEMM_KC packing buffer per thread */
+    double *bPacked;                /* Packed GEMM_KC x GEMM_NC panel of B */
+} GemmTask;
+
+
+static void packPanelBTask(size_t begin, size_t end, int worker, void *arg) {
+    /*
+     * Short Description:
+     * Packs the B slivers [begin, end) of the current panel.
+     */
+    const GemmTask *task = arg;
+    int first = (int)begin * GEMM_NR;   /* First column of the share */
+    int last = (int)end * GEMM_NR;      /* One past the last column of the share */
+    (void)worker;
+
+    if (last > task->nc) {
+        last = task->nc;
+    }
+    packPanelB(task->transB, task->kc, last - first,
+               (task->transB == GEMM_NO_TRANS) ?
+                   task->b + (size_t)task->pc * task->ldb + task->jc + first :
+                   task->b + (size_t)(task->jc + first) * task->ldb + task->pc,
+               task->ldb, task->bPacked + (size_t)first * task->kc);
+}
+
+
+static void multiplyRowPanelsTask(size_t begin, size_t end, int worker, void *arg) {
+    /*
+     * Short Description:
+     * Packs and multiplies the row panels [begin, end) of A against the packed B panel, using the
+     * packing buffer that belongs to 'worker'.
+     */
+    const GemmTask *task = arg;
+    double *aPacked = task->aPacked + (size_t)worker * GEMM_MC * GEMM_KC;  /* This thread's buffer */
+    size_t panel;   /* Index of the current row panel */
+    int ic, mc;     /* Offset and height of the current row panel */
+
+    for (panel = begin; panel < end; ++panel) {
+        ic = (int)panel * task->mcStep;
+        mc = (task->m - ic < task->mcStep) ? task->m - ic : task->mcStep;
+        packPanelA(task->transA, mc, task->kc,
+                   (task->transA == GEMM_NO_TRANS) ?
+                       task->a + (size_t)ic * task->lda + task->pc :
+                       task->a + (size_t)task->pc * task->lda + ic,
+                   task->lda, aPacked);
+        gemmMacroKernel(task->microKernel, mc, task->nc, task->kc, task->alpha, aPacked, task->bPacked,
+                        task->c + (size_t)ic * task->ldc + task->jc, task->ldc);
+    }
+}
+
+
+MatrixStatus gemm(GemmTranspose transA, GemmTranspose transB, int m, int n, int k,
+                  double alpha, const double *a, int lda, const double *b, int ldb,
+                  double beta, double *c, int ldc) {
+    /*
+     * Short Description:
+     * Computes C = alpha * op(A) * op(B) + beta * C with cache blocking and packing. Packing of B
+     * and the row panels of A are split across the thread pool when the product is large enough.
+     */
+    GemmTask task;              /* State shared with the workers */
+    int threads = getThreadCount();     /* Threads available for the product */
+    int panels;                 /* Number of row panels of A */
+    size_t sliverGrain;         /* Smallest share of B slivers worth a thread */
+    size_t panelGrain;          /* Smallest share of row panels worth a thread */
+
+    if (m <= 0 || n <= 0) {
+        return MATRIX_OK;
+    }
+    if ((double)m * n * k < GEMM_PARALLEL_WORK) {
+        threads = 1;
+    }
+
+    /* Allocate the packing buffers before touching C so a failure leaves it intact */
+    task.aPacked = NULL;
+    task.bPacked = NULL;
+    if (k > 0 && alpha != 0.0 && (double)m * n * k > GEMM_SMALL_WORK) {
+        task.aPacked = allocElements((size_t)threads * GEMM_MC * GEMM_KC);
+        task.bPacked = allocElements((size_t)GEMM_KC * ROUND_UP(n < GEMM_NC ? n : GEMM_NC, GEMM_NR));
+        if (task.aPacked == NULL || task.bPacked == NULL) {
+            free(task.aPacked);
+            free(task.bPacked);
+            return MATRIX_ALLOCATION_FAILED;
+        }
+    }
+
+    scaleResult(m, n, beta, c, ldc);
+    if (k <= 0 || alpha == 0.0) {
+        return MATRIX_OK;
+    }
+
+    /* Small products: packing would cost more than it saves */
+    if (task.aPacked == NULL) {
+        gemmDirect(transA, transB, m, n, k, alpha, a, lda, b, ldb, c, ldc);
+        return MATRIX_OK;
+    }
+
+    task.microKernel = selectMicroKernel();
+    task.transA = transA;
+    task.transB = transB;
+    task.a = a;
+    task.lda = lda;
+    task.b = b;
+    task.ldb = ldb;
+    task.c = c;
+    task.ldc = ldc;
+    task.alpha = alpha;
+    task.m = m;
+
+    /* Use shorter row panels when there would otherwise be fewer panels than threads */
+    task.mcStep = GEMM_MC;
+    if (threads > 1 && (m + GEMM_MC - 1) / GEMM_MC < threads) {
+        task.mcStep = ROUND_UP((m + threads - 1) / threads, GEMM_MR);
+    }
+    panels = (m + task.mcStep - 1) / task.mcStep;
+    panelGrain = (threads > 1) ? 1 : (size_t)panels;
+
+    for (task.jc = 0; task.jc < n; task.jc += GEMM_NC) {
+        task.nc = (n - task.jc < GEMM_NC) ? n - task.jc : GEMM_NC;
+        sliverGrain = (threads > 1) ? 1 : (size_t)(task.nc + GEMM_NR - 1) / GEMM_NR;
+        for (task.pc = 0; task.pc < k; task.pc += GEMM_KC) {
+            task.kc = (k - task.pc < GEMM_KC) ? k - task.pc : GEMM_KC;
+            parallelFor((size_t)(task.nc + GEMM_NR - 1) / GEMM_NR, sliverGrain, packPanelBTask, &task);
+            parallelFor((size_t)panels, panelGrain, multiplyRowPanelsTask, &task);
+        }
+    }
+
+    free(task.aPacked);
+    free(task.bPacked);
+    return MATRIX_OK;
+}
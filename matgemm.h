@@ -0,0 +1,76 @@
+/*
+ * Blocked Matrix Multiplication Header
+ * ------------------------------------
+ * This C header file declares the general matrix multiplication (GEMM) engine implemented in "matgemm.c".
+ * The engine computes C = alpha * op(A) * op(B) + beta * C on row-major buffers with arbitrary leading
+ * dimensions, where op(X) is X or its transpose.
+ *
+ * Structure of the engine:
+ * - The operands are split into panels sized for the cache hierarchy: GEMM_NC columns of B (L3),
+ *   GEMM_KC steps of the inner dimension (L1/L2 for a B sliver) and GEMM_MC rows of A (L2).
+ * - Each panel is packed into a contiguous, aligned buffer in the exact order the micro-kernel reads it,
+ *   which also absorbs any transposition of the operands.
+ * - A register-blocked micro-kernel computes a GEMM_MR x GEMM_NR tile of C entirely in vector registers.
+ *
+ * Core Functions:
+ * - gemm:  Computes C = alpha * op(A) * op(B) + beta * C.
+ *
+ * Note:
+ * Products small enough to fit in L1 skip the packing stage, since its cost would dominate. Products
+ * below GEMM_PARALLEL_WORK stay on the calling thread; larger ones use the thread pool of "matpool.h".
+ */
+
+#ifndef MATGEMM_H
+#define MATGEMM_H
+
+#include "mymat.h"
+
+/* Rows of C computed by one call of the micro-kernel */
+#define GEMM_MR 4
+/* Columns of C computed by one call of the micro-kernel */
+#define GEMM_NR 8
+/* Rows of A packed at a time; a GEMM_MC x GEMM_KC panel stays resident in L2 */
+#define GEMM_MC 128
+/* Length of the inner dimension handled per packed panel; a GEMM_KC x GEMM_NR sliver of B stays in L1 */
+#define GEMM_KC 256
+/* Columns of B packed at a time; a GEMM_KC x GEMM_NC panel stays resident in L3 */
+#define GEMM_NC 4096
+/* Products with at most this many multiply-adds use the direct loop instead of packing */
+#define GEMM_SMALL_WORK (32 * 32 * 32)
+/* Products with fewer multiply-adds than this run on the calling thread only */
+#define GEMM_PARALLEL_WORK (96.0 * 96.0 * 96.0)
+
+/* Enumeration selecting whether an operand of 'gemm' is used as stored or transposed */
+typedef enum {
+    GEMM_NO_TRANS,  /* Use the operand as stored */
+    GEMM_TRANS      /* Use the transpose of the operand */
+} GemmTranspose;
+
+
+/*
+ * Function: gemm
+ * Purpose: Computes C = alpha * op(A) * op(B) + beta * C.
+ * Detailed Description:
+ *   op(A) is m x k and op(B) is k x n; C is m x n. All buffers are row-major, with leading dimensions
+ *   lda, ldb and ldc. A stored operand is m x k (or k x m when transposed) and likewise for B.
+ *   When beta is zero C is not read, so it may hold uninitialized values. C must not overlap A or B.
+ *
+ * Parameters:
+ *   transA - Whether A is used as stored or transposed.
+ *   transB - Whether B is used as stored or transposed.
+ *   m, n, k - Dimensions of the product.
+ *   alpha - Scale applied to the product.
+ *   a, lda - First operand and its leading dimension.
+ *   b, ldb - Second operand and its leading dimension.
+ *   beta - Scale applied to the existing contents of C.
+ *   c, ldc - Result and its leading dimension.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the packing buffers could not be allocated
+ *   (C is left untouched in that case).
+ */
+MatrixStatus gemm(GemmTranspose transA, GemmTranspose transB, int m, int n, int k,
+                  double alpha, const double *a, int lda, const double *b, int ldb,
+                  double beta, double *c, int ldc);
+
+#endif /* MATGEMM_H */
@@ -0,0 +1,324 @@
+/*
+ * Matrix Files
+ * ------------
+ * This C source file implements the binary matrix files declared in "matio.h".
+ *
+ * Core Functionalities:
+ * 1.   updateCrc:          CRC-32 (the polynomial of zlib and PNG) of the header and elements, by slicing-by-8:
+ *                          eight tables turn eight bytes into eight independent lookups per step.
+ * 2.   storeWord / loadWord:
+ *                          Little-endian 32-bit header fields, independent of the byte order of the machine.
+ * 3.   saveMatrix:         Writes the header and the rows to a temporary file in one pass over the elements,
+ *                          then the checksums into the header, and renames the file over the target.
+ * 4.   loadMatrix:         Maps the whole file privately, validates the header against the size of the file
+ *                          and hands the mapped elements to the matrix.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "matio.h"
+#include "matdisk.h"
+#include "matsparse.h"
+
+
+/* Magic bytes at the start of every matrix file */
+#define MATRIX_FILE_MAGIC "MYMATBIN"
+#define MATRIX_FILE_MAGIC_SIZE 8
+
+/* Offsets of the header fields */
+#define FIELD_VERSION 8
+#define FIELD_DATA_OFFSET 12
+#define FIELD_TYPE 16
+#define FIELD_ROWS 20
+#define FIELD_COLS 24
+#define FIELD_LD 28
+#define FIELD_DATA_CRC 32
+#define FIELD_HEADER_CRC 36
+
+/* Size of the header fields; the header checksum covers the bytes before it */
+#define HEADER_FIELDS_SIZE 40
+
+/* Bytes consumed per step of the CRC, one table each */
+#define CRC_SLICES 8
+
+/* Reflected CRC-32 polynomial, and the initial and final value of the register */
+#define CRC_POLYNOMIAL 0xEDB88320UL
+#define CRC_INITIAL 0xFFFFFFFFUL
+
+/* Suffix of the temporary file written by 'saveMatrix' */
+#define TEMP_SUFFIX ".tmp"
+
+/* Largest value of a 32-bit header field that fits in an int */
+#define MAX_FIELD_VALUE 0x7FFFFFFFUL
+
+
+static bool verifyLoads = false;        /* Whether loads check the checksum of the elements */
+static unsigned long crcTable[CRC_SLICES][256];    /* CRC-32 of every byte followed by 0-7 zero bytes */
+static bool crcTableReady = false;      /* Whether 'crcTable' is filled */
+
+
+void setVerifyLoads(bool verify) {
+    verifyLoads = verify;
+}
+
+
+static unsigned long updateCrc(unsigned long crc, const unsigned char *bytes, size_t count) {
+    /*
+     * Short Description:
+     * Feeds bytes to a CRC-32 register; start from CRC_INITIAL and complement the final value.
+     */
+    unsigned long value;    /* Table entry being computed */
+    size_t index;           /* Index of the current byte or table entry */
+    int bit;                /* Bit of the table entry being computed */
+    int slice;              /* Table being filled */
+
+    if (!crcTableReady) {
+        for (index = 0; index < 256; ++index) {
+            value = (unsigned long)index;
+            for (bit = 0; bit < 8; ++bit) {
+                value = (value & 1UL) ? (value >> 1) ^ CRC_POLYNOMIAL : value >> 1;
+            }
+            crcTable[0][index] = value;
+        }
+        for (index = 0; index < 256; ++index) {
+            for (slice = 1; slice < CRC_SLICES; ++slice) {
+                value = crcTable[slice - 1][index];
+                crcTable[slice][index] = (value >> 8) ^ crcTable[0][value & 0xFFUL];
+            }
+        }
+        crcTableReady = true;
+    }
+
+    /* The bytes are assembled one by one, so the result does not depend on the byte order */
+    for (; count >= CRC_SLICES; count -= CRC_SLICES, bytes += CRC_SLICES) {
+        crc ^= (unsigned long)bytes[0] | ((unsigned long)bytes[1] << 8) |
+               ((unsigned long)bytes[2] << 16) | ((unsigned long)bytes[3] << 24);
+        crc = crcTable[7][crc & 0xFFUL] ^ crcTable[6][(crc >> 8) & 0xFFUL] ^
+              crcTable[5][(crc >> 16) & 0xFFUL] ^ crcTable[4][(crc >> 24) & 0xFFUL] ^
+              crcTable[3][bytes[4]] ^ crcTable[2][bytes[5]] ^ crcTable[1][bytes[6]] ^ crcTable[0][bytes[7]];
+    }
+    for (index = 0; index < count; ++index) {
+        crc = crcTable[0][(crc ^ bytes[index]) & 0xFFUL] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+
+static unsigned long checksum(const void *data, size_t count) {
+    return updateCrc(CRC_INITIAL, data, count) ^ CRC_INITIAL;
+}
+
+
+static void storeWord(unsigned char *field, unsigned long value) {
+    field[0] = (unsigned char)(value & 0xFFUL);
+    field[1] = (unsigned char)((value >> 8) & 0xFFUL);
+    field[2] = (unsigned char)((value >> 16) & 0xFFUL);
+    field[3] = (unsigned char)((value >> 24) & 0xFFUL);
+}
+
+
+static unsigned long loadWord(const unsigned char *field) {
+    return (unsigned long)field[0] | ((unsigned long)field[1] << 8) |
+           ((unsigned long)field[2] << 16) | ((unsigned long)field[3] << 24);
+}
+
+
+static MatrixFileType hostFileType(void) {
+    /*
+     * Short Description:
+     * Element type matching the byte order of this machine: 1.0 ends with its exponent byte 0x3F
+     * when stored little-endian.
+     */
+    double one = 1.0;               /* Value with a known byte pattern */
+    unsigned char bytes[sizeof(double)];
+
+    memcpy(bytes, &one, sizeof(double));
+    return (bytes[sizeof(double) - 1] == 0x3F) ? MATRIX_FILE_F64_LE : MATRIX_FILE_F64_BE;
+}
+
+
+static bool writeRows(const Matrix *mat, FILE *file, unsigned long *dataCrc, MatrixStatus *status) {
+    /*
+     * Short Description:
+     * Writes the rows of a matrix packed, feeding them to the checksum as they go. The rows of a disk
+     * matrix are gathered from its tiles one at a time, those of a sparse matrix expanded.
+     */
+    size_t rowBytes = (size_t)mat->cols * sizeof(double);  /* Bytes of one row */
+    double *buffer = NULL;      /* Row of a disk or sparse matrix */
+    const double *values;       /* Row being written */
+    bool written = true;        /* Whether every write succeeded */
+    int row;                    /* Index for iterating over the rows */
+
+    if (mat->disk != NULL || mat->sparse != NULL) {
+        buffer = allocElements((size_t)mat->cols);
+        if (buffer == NULL) {
+            *status = MATRIX_ALLOCATION_FAILED;
+            return false;
+        }
+    }
+    for (row = 0; written && row < mat->rows; ++row) {
+        values = buffer;
+        if (mat->sparse != NULL) {
+            expandSparseRow(mat, row, buffer);
+        } else if (mat->disk != NULL) {
+            *status = readTiledRow(mat, row, buffer);
+            if (*status != MATRIX_OK) {
+                break;
+            }
+        } else {
+            values = &MATRIX_AT(mat, row, 0);
+        }
+        *dataCrc = updateCrc(*dataCrc, (const unsigned char *)values, rowBytes);
+        written = fwrite(values, rowBytes, 1, file) == 1;
+    }
+    free(buffer);
+    return written && *status == MATRIX_OK;
+}
+
+
+MatrixStatus saveMatrix(const Matrix *mat, const char *path) {
+    unsigned char header[MATRIX_FILE_DATA_OFFSET];  /* Header, zero-padded to the elements */
+    unsigned long dataCrc = CRC_INITIAL;            /* Checksum register of the elements */
+    char *tempPath;                                 /* Name the file is written under */
+    FILE *file;                                     /* Temporary file */
+    bool written;                                   /* Whether every write succeeded */
+    MatrixStatus status = MATRIX_FILE_ERROR;        /* Outcome of a failed save */
+
+    tempPath = malloc(strlen(path) + sizeof(TEMP_SUFFIX));
+    if (tempPath == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    strcpy(tempPath, path);
+    strcat(tempPath, TEMP_SUFFIX);
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, MATRIX_FILE_MAGIC, MATRIX_FILE_MAGIC_SIZE);
+    storeWord(header + FIELD_VERSION, MATRIX_FILE_VERSION);
+    storeWord(header + FIELD_DATA_OFFSET, MATRIX_FILE_DATA_OFFSET);
+    storeWord(header + FIELD_TYPE, (unsigned long)hostFileType());
+    storeWord(header + FIELD_ROWS, (unsigned long)mat->rows);
+    storeWord(header + FIELD_COLS, (unsigned long)mat->cols);
+    storeWord(header + FIELD_LD, (unsigned long)mat->cols);
+
+    /* The elements are read once: the checksums are only known, and written, after the rows */
+    file = fopen(tempPath, "wb");
+    written = file != NULL && fwrite(header, sizeof(header), 1, file) == 1;
+    if (written) {
+        status = MATRIX_OK;
+        written = writeRows(mat, file, &dataCrc, &status);
+        if (!written && status == MATRIX_OK) {
+            status = MATRIX_FILE_ERROR;
+        }
+    }
+    if (written) {
+        storeWord(header + FIELD_DATA_CRC, dataCrc ^ CRC_INITIAL);
+        storeWord(header + FIELD_HEADER_CRC, checksum(header, FIELD_HEADER_CRC));
+        written = fseek(file, 0L, SEEK_SET) == 0 && fwrite(header, HEADER_FIELDS_SIZE, 1, file) == 1;
+        status = written ? MATRIX_OK : MATRIX_FILE_ERROR;
+    }
+    if (file != NULL && fclose(file) != 0 && written) {
+        written = false;
+        status = MATRIX_FILE_ERROR;
+    }
+
+    /* Replace the target only with a complete file */
+    if (written && rename(tempPath, path) != 0) {
+        written = false;
+        status = MATRIX_FILE_ERROR;
+    }
+    if (!written && file != NULL) {
+        remove(tempPath);
+    }
+    free(tempPath);
+    return status;
+}
+
+
+static MatrixStatus checkHeader(const unsigned char *file, size_t size) {
+    /*
+     * Short Description:
+     * Validates the header of a mapped file of 'size' bytes, including that the elements it describes
+     * lie within the file and are aligned.
+     */
+    unsigned long offset, rows, cols, ld;   /* Header fields */
+    size_t elements;                        /* Number of elements described by the header */
+
+    if (size < HEADER_FIELDS_SIZE || memcmp(file, MATRIX_FILE_MAGIC, MATRIX_FILE_MAGIC_SIZE) != 0 ||
+        loadWord(file + FIELD_HEADER_CRC) != checksum(file, FIELD_HEADER_CRC) ||
+        loadWord(file + FIELD_VERSION) != MATRIX_FILE_VERSION ||
+        loadWord(file + FIELD_TYPE) != (unsigned long)hostFileType()) {
+        return MATRIX_FILE_INVALID;
+    }
+
+    offset = loadWord(file + FIELD_DATA_OFFSET);
+    rows = loadWord(file + FIELD_ROWS);
+    cols = loadWord(file + FIELD_COLS);
+    ld = loadWord(file + FIELD_LD);
+    if (offset < HEADER_FIELDS_SIZE || offset % MATRIX_ALIGNMENT != 0 || offset > size ||
+        rows == 0 || cols == 0 || rows > MAX_FIELD_VALUE || ld > MAX_FIELD_VALUE || ld < cols) {
+        return MATRIX_FILE_INVALID;
+    }
+    if (rows > (size - offset) / sizeof(double) / ld) {
+        return MATRIX_FILE_INVALID;     /* Truncated */
+    }
+
+    elements = (size_t)rows * (size_t)ld;
+    if (verifyLoads &&
+        loadWord(file + FIELD_DATA_CRC) != checksum(file + offset, elements * sizeof(double))) {
+        return MATRIX_FILE_INVALID;
+    }
+    return MATRIX_OK;
+}
+
+
+MatrixStatus loadMatrix(Matrix *mat, const char *path) {
+    struct stat info;           /* Size of the file */
+    unsigned char *file;        /* Mapped file */
+    size_t size;                /* Bytes in the file */
+    int fd;                     /* Descriptor of the file, closed once it is mapped */
+    MatrixStatus status;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return MATRIX_FILE_ERROR;
+    }
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return MATRIX_FILE_ERROR;
+    }
+    if ((size_t)info.st_size < HEADER_FIELDS_SIZE) {
+        close(fd);
+        return MATRIX_FILE_INVALID;
+    }
+    size = (size_t)info.st_size;
+
+    /* Private and writable: operations on the matrix copy the pages they modify */
+    file = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        return MATRIX_FILE_ERROR;
+    }
+
+    status = checkHeader(file, size);
+    if (status != MATRIX_OK) {
+        munmap(file, size);
+        return status;
+    }
+
+    freeMatrix(mat);
+    mat->data = (double *)(file + loadWord(file + FIELD_DATA_OFFSET));
+    mat->rows = (int)loadWord(file + FIELD_ROWS);
+    mat->cols = (int)loadWord(file + FIELD_COLS);
+    mat->ld = (int)loadWord(file + FIELD_LD);
+    mat->capacity = (size - loadWord(file + FIELD_DATA_OFFSET)) / sizeof(double);
+    mat->mapping = file;
+    mat->mappingSize = size;
+    return MATRIX_OK;
+}
@@ -0,0 +1,107 @@
+/*
+ * Matrix File Header
+ * ------------------
+ * This C header file declares the binary matrix files implemented in "matio.c", used by 'save_mat' and
+ * 'load_mat'. A file is a fixed header followed by the raw elements, so loading maps the file and uses its
+ * pages as the storage of the matrix: nothing is parsed or copied, and pages are only read when touched.
+ *
+ * File Format (version 1):
+ *   Offset  Size  Field
+ *        0     8  Magic "MYMATBIN"
+ *        8     4  Format version (MATRIX_FILE_VERSION)
+ *       12     4  Offset of the elements from the start of the file (MATRIX_FILE_DATA_OFFSET on save)
+ *       16     4  Element type (MatrixFileType)
+ *       20     4  Rows
+ *       24     4  Columns
+ *       28     4  Leading dimension: elements from the start of one row to the start of the next
+ *       32     4  CRC-32 of the rows * ld elements
+ *       36     4  CRC-32 of bytes 0-35
+ *   Header fields are unsigned little-endian integers; the rest of the header is zero. Elements are
+ *   IEEE-754 doubles in row-major order, in the byte order given by the element type, starting at a
+ *   page-aligned offset.
+ *
+ * Core Functions:
+ * - setVerifyLoads:    Selects whether 'loadMatrix' also checks the checksum of the elements.
+ * - saveMatrix:        Writes a matrix to a file.
+ * - loadMatrix:        Maps a file as the storage of a matrix.
+ *
+ * Note:
+ * A loaded matrix is mapped privately (copy-on-write): later operations may overwrite it without changing
+ * the file. 'saveMatrix' writes a temporary file and renames it over the target, so saving to the file a
+ * matrix was loaded from never alters the pages that matrix still maps.
+ */
+
+#ifndef MATIO_H
+#define MATIO_H
+
+#include <stdbool.h>
+#include "mymat.h"
+
+/* Version written by 'saveMatrix' and the only one 'loadMatrix' accepts */
+#define MATRIX_FILE_VERSION 1
+
+/* Offset of the elements in a saved file: one page, so the mapped elements are page-aligned */
+#define MATRIX_FILE_DATA_OFFSET 4096
+
+/* Element types of a matrix file */
+typedef enum {
+    MATRIX_FILE_F64_LE = 1,     /* Little-endian IEEE-754 doubles */
+    MATRIX_FILE_F64_BE = 2      /* Big-endian IEEE-754 doubles */
+} MatrixFileType;
+
+
+/*
+ * Function: setVerifyLoads
+ * Purpose: Selects whether loaded elements are checked against their checksum.
+ * Detailed Description:
+ *   The header is always checked. Checking the elements reads the whole file, which makes loading
+ *   proportional to its size, so it is off by default.
+ *
+ * Parameters:
+ *   verify - true to check the checksum of the elements on every load.
+ *
+ * Returns: None (void function).
+ */
+void setVerifyLoads(bool verify);
+
+
+/*
+ * Function: saveMatrix
+ * Purpose: Writes a matrix to a binary matrix file.
+ * Detailed Description:
+ *   The elements are written packed (the leading dimension of the file is the number of columns) in
+ *   the byte order of this machine. The file is first written under the name 'path' followed by ".tmp"
+ *   and then renamed to 'path', replacing any previous file. A matrix stored on disk (see "matdisk.h")
+ *   is saved row by row from its tiles.
+ *
+ * Parameters:
+ *   mat - Pointer to the Matrix to save.
+ *   path - Path of the file.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_FILE_ERROR if the file could not be written (or the tiles of a disk
+ *   matrix read), MATRIX_ALLOCATION_FAILED if the temporary name or a row buffer could not be allocated.
+ */
+MatrixStatus saveMatrix(const Matrix *mat, const char *path);
+
+
+/*
+ * Function: loadMatrix
+ * Purpose: Replaces a matrix with the contents of a binary matrix file, without copying them.
+ * Detailed Description:
+ *   The file is mapped privately with read and write access and the matrix takes the mapped elements as
+ *   its storage, with the shape and leading dimension of the file. The mapping is released when the
+ *   matrix is freed or outgrows it. The header (and, with 'setVerifyLoads', the elements) is checked
+ *   before the matrix is touched, so on failure the matrix keeps its previous contents.
+ *
+ * Parameters:
+ *   mat - Pointer to the Matrix to replace.
+ *   path - Path of the file.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_FILE_ERROR if the file could not be opened or mapped, MATRIX_FILE_INVALID
+ *   if it is not a matrix file of this version and byte order, is truncated or fails a checksum.
+ */
+MatrixStatus loadMatrix(Matrix *mat, const char *path);
+
+#endif /* MATIO_H */
@@ -0,0 +1,253 @@
+/*
+ * LU Factorization
+ * ----------------
+ * This C source file implements the blocked LU factorization with partial pivoting declared in "matlu.h".
+ *
+ * Core Functionalities:
+ * 1.   factorPanel:        Factors the LU_BLOCK columns of a panel by halves, recursively, down to LU_PANEL_MIN
+ *                          columns factored one at a time. Whole rows are exchanged, so that every pivot also
+ *                          applies to the columns of L on the left and of A on the right.
+ * 2.   factorLU:           Factors every panel, solves the block row on its right against its unit lower
+ *                          triangle and updates the trailing matrix with one 'gemm' ('updateRight', which also
+ *                          joins the halves of a panel).
+ * 3.   solveLU:            Applies the row exchanges to B, then solves L Y = B and U X = Y a block of rows at a
+ *                          time: a small triangular solve within the block, and a 'gemm' for the rows it affects.
+ *                          A single right-hand side is solved with dot products instead.
+ */
+
+#include <stdlib.h>
+#include "matlu.h"
+#include "matgemm.h"
+#include "matsimd.h"
+
+
+static void factorColumns(Factorization *factors, int start, int end) {
+    /*
+     * Short Description:
+     * Factors columns start .. end - 1 of the rows from 'start' down one column at a time, updating the
+     * columns of the range only.
+     */
+    const SimdKernels *simd = getSimdKernels();     /* Element-wise kernels */
+    double *a = factors->elements;                  /* Matrix being factored */
+    int n = factors->n;                             /* Order of the matrix */
+    double magnitude;       /* Magnitude of a pivot candidate */
+    double largest;         /* Largest magnitude found in the column */
+    double multiplier;      /* Element of L being computed */
+    int best;               /* Row of the pivot */
+    int col, row;           /* Variables for iterating over the columns and rows */
+
+    for (col = start; col < end; ++col) {
+        best = col;
+        largest = 0.0;
+        for (row = col; row < n; ++row) {
+            magnitude = a[(size_t)row * n + col];
+            magnitude = (magnitude < 0.0) ? -magnitude : magnitude;
+            if (magnitude > largest) {
+                largest = magnitude;
+                best = row;
+            }
+        }
+        factors->pivots[col] = best;
+        if (largest == 0.0) {
+            factors->singular = true;   /* Nothing to eliminate in this column */
+            continue;
+        }
+        if (best != col) {
+            swapRows(&a[(size_t)col * n], &a[(size_t)best * n], n);
+            factors->sign = -factors->sign;
+        }
+
+        for (row = col + 1; row < n; ++row) {
+            multiplier = a[(size_t)row * n + col] / a[(size_t)col * n + col];
+            a[(size_t)row * n + col] = multiplier;
+            if (multiplier != 0.0 && col + 1 < end) {
+                simd->axpy(&a[(size_t)col * n + col + 1], -multiplier, &a[(size_t)row * n + col + 1],
+                           (size_t)(end - col - 1));
+            }
+        }
+    }
+}
+
+
+static MatrixStatus updateRight(Factorization *factors, int start, int mid, int end) {
+    /*
+     * Short Description:
+     * Once columns start .. mid - 1 are factored, brings columns mid .. end - 1 up to date: the rows of
+     * the factored block are solved against its unit lower triangle (U12 = inverse(L11) * A12), and the
+     * rows below lose their product with it (A22 -= L21 * U12).
+     */
+    const SimdKernels *simd = getSimdKernels();     /* Element-wise kernels */
+    double *a = factors->elements;                  /* Matrix being factored */
+    int n = factors->n;                             /* Order of the matrix */
+    int row, step;          /* Variables for iterating over the rows of the block and its steps */
+
+    for (row = start + 1; row < mid; ++row) {
+        for (step = start; step < row; ++step) {
+            if (a[(size_t)row * n + step] != 0.0) {
+                simd->axpy(&a[(size_t)step * n + mid], -a[(size_t)row * n + step], &a[(size_t)row * n + mid],
+                           (size_t)(end - mid));
+            }
+        }
+    }
+    if (mid == n) {
+        return MATRIX_OK;
+    }
+    return gemm(GEMM_NO_TRANS, GEMM_NO_TRANS, n - mid, end - mid, mid - start,
+                -1.0, &a[(size_t)mid * n + start], n, &a[(size_t)start * n + mid], n,
+                1.0, &a[(size_t)mid * n + mid], n);
+}
+
+
+static MatrixStatus factorPanel(Factorization *factors, int start, int end) {
+    /*
+     * Short Description:
+     * Factors a panel recursively: its left half, then the right half once updated by 'updateRight', so
+     * most of the work of the panel also goes through 'gemm'. Row exchanges move whole rows, so they
+     * apply to the columns outside the panel as well.
+     */
+    int mid = start + (end - start) / 2;    /* First column of the right half */
+    MatrixStatus status;
+
+    if (end - start <= LU_PANEL_MIN) {
+        factorColumns(factors, start, end);
+        return MATRIX_OK;
+    }
+    status = factorPanel(factors, start, mid);
+    if (status == MATRIX_OK) {
+        status = updateRight(factors, start, mid, end);
+    }
+    if (status == MATRIX_OK) {
+        status = factorPanel(factors, mid, end);
+    }
+    return status;
+}
+
+
+MatrixStatus factorLU(double *elements, int n, Factorization *factors) {
+    int start, end;         /* Columns of the current panel */
+    MatrixStatus status = MATRIX_OK;
+
+    factors->kind = FACTOR_LU;
+    factors->n = n;
+    factors->sign = 1;
+    factors->singular = false;
+    factors->elements = elements;
+    factors->offDiagonal = NULL;
+    factors->pivots = malloc((size_t)n * sizeof(int));
+    if (factors->pivots == NULL) {
+        status = MATRIX_ALLOCATION_FAILED;
+    }
+
+    for (start = 0; start < n && status == MATRIX_OK; start = end) {
+        end = (n - start < LU_BLOCK) ? n : start + LU_BLOCK;
+        status = factorPanel(factors, start, end);
+        if (status == MATRIX_OK && end < n) {
+            status = updateRight(factors, start, end, n);
+        }
+    }
+
+    if (status != MATRIX_OK) {
+        free(factors->elements);
+        free(factors->pivots);
+        factors->elements = NULL;
+        factors->pivots = NULL;
+    }
+    return status;
+}
+
+
+static void solveVector(const Factorization *factors, double *b, int ldb) {
+    /*
+     * Short Description:
+     * Forward and back substitution for a single right-hand side, whose elements are 'ldb' apart: every
+     * element is a dot product with a contiguous row of L or U, which a 'gemm' with one column cannot beat.
+     */
+    const double *a = factors->elements;    /* Factors L and U */
+    int n = factors->n;                     /* Order of the matrix */
+    const double *factorRow;    /* Row of L or U */
+    double sum;                 /* Element being solved */
+    int row, step;              /* Variables for iterating over the rows and the steps */
+
+    for (row = 0; row < n; ++row) {
+        factorRow = &a[(size_t)row * n];
+        sum = b[(size_t)row * ldb];
+        for (step = 0; step < row; ++step) {
+            sum -= factorRow[step] * b[(size_t)step * ldb];
+        }
+        b[(size_t)row * ldb] = sum;
+    }
+    for (row = n - 1; row >= 0; --row) {
+        factorRow = &a[(size_t)row * n];
+        sum = b[(size_t)row * ldb];
+        for (step = row + 1; step < n; ++step) {
+            sum -= factorRow[step] * b[(size_t)step * ldb];
+        }
+        b[(size_t)row * ldb] = sum / factorRow[row];
+    }
+}
+
+
+MatrixStatus solveLU(const Factorization *factors, double *b, int ldb, int m) {
+    /*
+     * Short Description:
+     * Forward substitution goes down the blocks of rows and back substitution up: once a block of X is
+     * known, its contribution is removed from every row still to solve by one 'gemm'.
+     */
+    const SimdKernels *simd = getSimdKernels();     /* Element-wise kernels */
+    const double *a = factors->elements;            /* Factors L and U */
+    int n = factors->n;                             /* Order of the matrix */
+    double *target;         /* Row of B being solved */
+    double pivot;           /* Diagonal element of U */
+    int start, end;         /* Rows of the current block */
+    int row, step, col;     /* Variables for iterating over the rows, the steps and the columns */
+    MatrixStatus status = MATRIX_OK;
+
+    for (row = 0; row < n; ++row) {
+        if (factors->pivots[row] != row) {
+            swapRows(&b[(size_t)row * ldb], &b[(size_t)factors->pivots[row] * ldb], m);
+        }
+    }
+    if (m == 1) {
+        solveVector(factors, b, ldb);
+        return MATRIX_OK;
+    }
+
+    /* L Y = P B */
+    for (start = 0; start < n && status == MATRIX_OK; start = end) {
+        end = (n - start < LU_BLOCK) ? n : start + LU_BLOCK;
+        for (row = start + 1; row < end; ++row) {
+            for (step = start; step < row; ++step) {
+                if (a[(size_t)row * n + step] != 0.0) {
+                    simd->axpy(&b[(size_t)step * ldb], -a[(size_t)row * n + step], &b[(size_t)row * ldb], (size_t)m);
+                }
+            }
+        }
+        if (end < n) {
+            status = gemm(GEMM_NO_TRANS, GEMM_NO_TRANS, n - end, m, end - start,
+                          -1.0, &a[(size_t)end * n + start], n, &b[(size_t)start * ldb], ldb,
+                          1.0, &b[(size_t)end * ldb], ldb);
+        }
+    }
+
+    /* U X = Y, from the last block up */
+    for (start = (n - 1) / LU_BLOCK * LU_BLOCK; start >= 0 && status == MATRIX_OK; start -= LU_BLOCK) {
+        end = (n - start < LU_BLOCK) ? n : start + LU_BLOCK;
+        for (row = end - 1; row >= start; --row) {
+            target = &b[(size_t)row * ldb];
+            for (step = row + 1; step < end; ++step) {
+                if (a[(size_t)row * n + step] != 0.0) {
+                    simd->axpy(&b[(size_t)step * ldb], -a[(size_t)row * n + step], target, (size_t)m);
+                }
+            }
+            pivot = a[(size_t)row * n + row];
+            for (col = 0; col < m; ++col) {
+                target[col] /= pivot;
+            }
+        }
+        if (start > 0) {
+            status = gemm(GEMM_NO_TRANS, GEMM_NO_TRANS, start, m, end - start,
+                          -1.0, &a[start], n, &b[(size_t)start * ldb], ldb, 1.0, b, ldb);
+        }
+    }
+    return status;
+}
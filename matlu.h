@@ -0,0 +1,67 @@
+/*
+ * LU Factorization Header
+ * -----------------------
+ * This C header file declares the LU factorization with partial pivoting implemented in "matlu.c". The
+ * factorization is blocked and right-looking: a panel of LU_BLOCK columns is factored, the block row to
+ * its right is solved against its unit lower triangle, and the trailing matrix is updated by one call of
+ * the GEMM engine of "matgemm.h", which does almost all of the 2n^3/3 operations. Panels are themselves
+ * factored by halves the same way, so that their updates also run on GEMM.
+ *
+ * Core Functions:
+ * - factorLU:      Computes P A = L U.
+ * - solveLU:       Solves A X = B with the factors, by blocked forward and back substitution.
+ *
+ * Note:
+ * The matrices are row-major, so the row exchanges of the pivoting move contiguous rows, and every
+ * update inside a panel or a triangular solve is an 'axpy' on contiguous elements (see "matsimd.h").
+ */
+
+#ifndef MATLU_H
+#define MATLU_H
+
+#include "mymat.h"
+#include "matfactor.h"
+
+/* Columns of a panel, and rows of a block of the triangular solves */
+#define LU_BLOCK 128
+/* Columns of a panel below which it is factored one column at a time rather than by halves */
+#define LU_PANEL_MIN 16
+
+
+/*
+ * Function: factorLU
+ * Purpose: Computes the LU factorization of a square matrix with partial pivoting.
+ * Detailed Description:
+ *   At every step the element of largest magnitude in the pivot column becomes the pivot. A column
+ *   without any non-zero candidate marks the matrix singular and is skipped, so the factorization always
+ *   completes and its determinant is 0.
+ *
+ * Parameters:
+ *   elements - n x n row-major matrix, factored in place; the factors keep it, and it is released on
+ *              failure.
+ *   n - Order of the matrix.
+ *   factors - Receives the factors, to be released with 'free' of 'elements' and 'pivots'.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the pivots could not be allocated or the GEMM
+ *   engine its buffers.
+ */
+MatrixStatus factorLU(double *elements, int n, Factorization *factors);
+
+
+/*
+ * Function: solveLU
+ * Purpose: Overwrites B with the solution X of A X = B, given the LU factors of A.
+ *
+ * Parameters:
+ *   factors - LU factors of the n x n matrix A; it must not be singular.
+ *   b - n x m row-major right-hand sides.
+ *   ldb - Distance in elements between consecutive rows of 'b'.
+ *   m - Number of right-hand sides.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the GEMM engine could not allocate its buffers.
+ */
+MatrixStatus solveLU(const Factorization *factors, double *b, int ldb, int m);
+
+#endif /* MATLU_H */
@@ -0,0 +1,211 @@
+/*
+ * Hardware Counters
+ * -----------------
+ * This C source file implements the per-command hardware counters declared in "matperf.h".
+ *
+ * Core Functionalities:
+ * 1.   Opening:            Every event is opened on its own with perf_event_open(2) for the calling process,
+ *                          any CPU, inheriting into threads created afterwards, and counting user space only.
+ * 2.   Reading:            read(2) on an inherited event returns the sum over the process and its threads,
+ *                          with the time it was enabled and running, used to scale multiplexed counts.
+ * 3.   printPerf:          Writes the totals of every command and the ratios derived from them.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "matperf.h"
+
+
+/* Description of one counted event */
+typedef struct {
+    const char *name;       /* Name in warnings and reports */
+    unsigned int type;      /* perf_event_attr.type */
+    unsigned long config;   /* perf_event_attr.config */
+} PerfEventProfile;
+
+/* Counters of one command */
+typedef struct {
+    unsigned long calls;                /* Kernel calls counted */
+    double totals[NUM_PERF_EVENTS];     /* Sum of every event over the calls */
+} CommandPerf;
+
+
+/* Profiles of the events, indexed by PerfEvent */
+static const PerfEventProfile perfEvents[NUM_PERF_EVENTS] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"L1D read misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {"LLC misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"task clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK}
+};
+
+static int eventFds[NUM_PERF_EVENTS] = {-1, -1, -1, -1, -1, -1};  /* File descriptor of every event, -1 if unavailable */
+static CommandPerf *commandPerf = NULL;         /* Counters by command */
+static const char *const *commandNames = NULL;  /* Names of the commands */
+static int commandCount = 0;                    /* Number of commands */
+
+
+static double readEvent(int fd) {
+    /*
+     * Short Description:
+     * Reads an event and scales its count by the ratio of the time it was enabled to the time it ran.
+     */
+    __u64 values[3];    /* Count, time enabled and time running */
+
+    if (read(fd, values, sizeof(values)) != (ssize_t)sizeof(values)) {
+        return 0.0;
+    }
+    if (values[2] == 0) {
+        return 0.0;     /* Never scheduled on the PMU */
+    }
+    if (values[2] < values[1]) {
+        return (double)values[0] * ((double)values[1] / (double)values[2]);
+    }
+    return (double)values[0];
+}
+
+
+static void printCount(FILE *file, int event, double value) {
+    if (eventFds[event] < 0) {
+        fprintf(file, " %14s", "n/a");
+    } else {
+        fprintf(file, " %14.0f", value);
+    }
+}
+
+
+static void printRatio(FILE *file, bool available, double numerator, double denominator) {
+    if (!available || denominator <= 0.0) {
+        fprintf(file, " %8s", "n/a");
+    } else {
+        fprintf(file, " %8.2f", numerator / denominator);
+    }
+}
+
+
+bool openPerfCounters(const char *const names[], int count) {
+    struct perf_event_attr attr;    /* Attributes of the event being opened */
+    int event;                      /* Variable for iterating over the events */
+    int opened = 0;                 /* Events counting */
+    int failure = 0;                /* errno of the first event that could not be opened */
+    const char *separator = " ";    /* Text printed before the next unavailable event */
+
+    closePerfCounters();
+    for (event = 0; event < NUM_PERF_EVENTS; ++event) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perfEvents[event].type;
+        attr.config = perfEvents[event].config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        eventFds[event] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (eventFds[event] >= 0) {
+            opened++;
+        } else if (failure == 0) {
+            failure = errno;
+        }
+    }
+
+    if (opened < NUM_PERF_EVENTS) {
+        printf("Warning: Performance counters unavailable:");
+        for (event = 0; event < NUM_PERF_EVENTS; ++event) {
+            if (eventFds[event] < 0) {
+                printf("%s%s", separator, perfEvents[event].name);
+                separator = ", ";
+            }
+        }
+        printf(" (%s%s)\n", strerror(failure), (failure == EACCES || failure == EPERM) ?
+               ", see /proc/sys/kernel/perf_event_paranoid" : "");
+    }
+    if (opened > 0) {
+        commandPerf = calloc((size_t)count, sizeof(*commandPerf));
+    }
+    if (commandPerf == NULL) {
+        closePerfCounters();
+        return false;
+    }
+    commandNames = names;
+    commandCount = count;
+    return true;
+}
+
+
+void closePerfCounters(void) {
+    int event;  /* Variable for iterating over the events */
+
+    for (event = 0; event < NUM_PERF_EVENTS; ++event) {
+        if (eventFds[event] >= 0) {
+            close(eventFds[event]);
+        }
+        eventFds[event] = -1;
+    }
+    free(commandPerf);
+    commandPerf = NULL;
+    commandNames = NULL;
+    commandCount = 0;
+}
+
+
+bool isPerfEnabled(void) {
+    return commandPerf != NULL;
+}
+
+
+void readPerfCounters(PerfSample *sample) {
+    int event;  /* Variable for iterating over the events */
+
+    for (event = 0; event < NUM_PERF_EVENTS; ++event) {
+        sample->values[event] = (eventFds[event] >= 0) ? readEvent(eventFds[event]) : 0.0;
+    }
+}
+
+
+void recordPerf(int command, const PerfSample *before, const PerfSample *after) {
+    int event;  /* Variable for iterating over the events */
+
+    commandPerf[command].calls++;
+    for (event = 0; event < NUM_PERF_EVENTS; ++event) {
+        commandPerf[command].totals[event] += after->values[event] - before->values[event];
+    }
+}
+
+
+void printPerf(FILE *file) {
+    const CommandPerf *perf;    /* Counters of the current command */
+    int command;                /* Variable for iterating over the commands */
+    int event;                  /* Variable for iterating over the events */
+
+    if (commandPerf == NULL) {
+        return;
+    }
+    fprintf(file, "%-12s %8s %14s %14s %14s %14s %14s %14s %8s %8s %8s\n", "command", "calls", "cycles",
+            "instructions", "L1D misses", "LLC misses", "branch misses", "cpu us", "IPC", "L1D MPKI", "LLC MPKI");
+    for (command = 0; command < commandCount; ++command) {
+        perf = &commandPerf[command];
+        if (perf->calls == 0) {
+            continue;
+        }
+        fprintf(file, "%-12s %8lu", commandNames[command], perf->calls);
+        for (event = 0; event < PERF_TASK_CLOCK; ++event) {
+            printCount(file, event, perf->totals[event]);
+        }
+        printCount(file, PERF_TASK_CLOCK, perf->totals[PERF_TASK_CLOCK] / 1e3);
+        printRatio(file, eventFds[PERF_CYCLES] >= 0 && eventFds[PERF_INSTRUCTIONS] >= 0,
+                   perf->totals[PERF_INSTRUCTIONS], perf->totals[PERF_CYCLES]);
+        printRatio(file, eventFds[PERF_L1D_MISSES] >= 0 && eventFds[PERF_INSTRUCTIONS] >= 0,
+                   perf->totals[PERF_L1D_MISSES] * 1e3, perf->totals[PERF_INSTRUCTIONS]);
+        printRatio(file, eventFds[PERF_LLC_MISSES] >= 0 && eventFds[PERF_INSTRUCTIONS] >= 0,
+                   perf->totals[PERF_LLC_MISSES] * 1e3, perf->totals[PERF_INSTRUCTIONS]);
+        fprintf(file, "\n");
+    }
+}
@@ -0,0 +1,130 @@
+/*
+ * Hardware Counter Header
+ * -----------------------
+ * This C header file declares the per-command hardware counters implemented in "matperf.c". With '--perf',
+ * Linux perf events are opened once for the process (cycles, instructions, L1 data read misses, last-level
+ * cache misses, branch misses, and the CPU time as a software event), and processInstruction reads them
+ * before and after every kernel call. The differences add up by command type and are printed with the
+ * statistics (see "matstats.h"), to check tiling and SIMD changes against the actual cache behaviour.
+ *
+ * Core Structures:
+ * - PerfEvent:         Enumeration of the counted events.
+ * - PerfSample:        Values of every event at one point in time.
+ *
+ * Core Functions:
+ * - openPerfCounters / closePerfCounters:
+ *                      Open the events that are permitted and supported, and close them.
+ * - isPerfEnabled:     Tells whether any event is counting.
+ * - readPerfCounters:  Reads every open event.
+ * - recordPerf:        Adds the difference of two samples to a command.
+ * - printPerf:         Writes the counters of every command.
+ *
+ * Note:
+ * The events are opened with 'inherit' before the thread pool starts, so they also count the worker
+ * threads; they count user space only, which is what perf_event_paranoid 2 permits. An event that cannot
+ * be opened (no PMU in a virtual machine, a stricter perf_event_paranoid, an event the processor lacks) is
+ * reported as unavailable and shown as "n/a"; the others still count. Values are scaled by the time each
+ * event actually ran when the kernel multiplexes them.
+ */
+
+#ifndef MATPERF_H
+#define MATPERF_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Enumeration of the counted events */
+typedef enum {
+    PERF_CYCLES,            /* CPU cycles */
+    PERF_INSTRUCTIONS,      /* Retired instructions */
+    PERF_L1D_MISSES,        /* Level 1 data cache read misses */
+    PERF_LLC_MISSES,        /* Last-level cache misses */
+    PERF_BRANCH_MISSES,     /* Mispredicted branches */
+    PERF_TASK_CLOCK,        /* CPU time of every thread, in nanoseconds (a software event) */
+    NUM_PERF_EVENTS         /* Sentinel value for the number of events */
+} PerfEvent;
+
+/* Values of every event at one point in time */
+typedef struct {
+    double values[NUM_PERF_EVENTS];     /* Scaled count of each event since it was opened, 0 if unavailable */
+} PerfSample;
+
+
+/*
+ * Function: openPerfCounters
+ * Purpose: Opens every event that the system permits and supports.
+ * Detailed Description:
+ *   Must be called before any thread the counters should cover is created. Events that cannot be opened
+ *   are named in a warning with the reason; if none can, the counters stay disabled.
+ *
+ * Parameters:
+ *   names - Name of every command, indexed by command; the array must outlive the counters.
+ *   count - Number of commands.
+ *
+ * Returns:
+ *   true if at least one event is counting.
+ */
+bool openPerfCounters(const char *const names[], int count);
+
+
+/*
+ * Function: closePerfCounters
+ * Purpose: Closes the events and releases the counters of the commands.
+ *
+ * Returns: None (void function).
+ */
+void closePerfCounters(void);
+
+
+/*
+ * Function: isPerfEnabled
+ * Purpose: Tells whether any event is counting.
+ *
+ * Returns:
+ *   true if 'openPerfCounters' succeeded.
+ */
+bool isPerfEnabled(void);
+
+
+/*
+ * Function: readPerfCounters
+ * Purpose: Reads the current value of every open event.
+ *
+ * Parameters:
+ *   sample - Receives the values.
+ *
+ * Returns: None (void function).
+ */
+void readPerfCounters(PerfSample *sample);
+
+
+/*
+ * Function: recordPerf
+ * Purpose: Adds the events counted between two samples to a command.
+ *
+ * Parameters:
+ *   command - Command of the kernel call, below the count given to 'openPerfCounters'.
+ *   before - Sample read just before the call.
+ *   after - Sample read just after it.
+ *
+ * Returns: None (void function).
+ */
+void recordPerf(int command, const PerfSample *before, const PerfSample *after);
+
+
+/*
+ * Function: printPerf
+ * Purpose: Writes the counters of every command that made a kernel call.
+ * Detailed Description:
+ *   Writes a row per command with its calls, the totals of every event, the instructions per cycle and
+ *   the misses per thousand instructions of both caches. Nothing is written while the counters are
+ *   disabled.
+ *
+ * Parameters:
+ *   file - The stream to write to.
+ *
+ * Returns: None (void function).
+ */
+void printPerf(FILE *file);
+
+#endif /* MATPERF_H */
@@ -0,0 +1,197 @@
+/*
+ * Worker Thread Pool
+ * ------------------
+ * This C source file implements the persistent worker pool declared in "matpool.h".
+ *
+ * Core Functionalities:
+ * 1.   initThreadPool / shutdownThreadPool:    Start and join the workers.
+ * 2.   parallelFor:                            Publishes a loop to the workers, runs the caller's share
+ *                                              and waits for the rest.
+ * 3.   workerMain:                             Loop of a worker: sleep until a new loop is published,
+ *                                              run its share, report completion.
+ *
+ * Each loop is split statically: share 'i' always goes to thread 'i', so no work queue or per-chunk
+ * locking is needed. A generation counter tells sleeping workers that a new loop has been published.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "matpool.h"
+
+
+/* State shared between the caller of parallelFor and the workers, protected by 'lock' */
+typedef struct {
+    pthread_t workers[MAX_POOL_THREADS];    /* Worker threads; thread 0 is the caller */
+    int threadCount;                        /* Threads taking part in a loop, including the caller */
+    pthread_mutex_t lock;                   /* Protects every field below */
+    pthread_cond_t wake;                    /* Signalled when a loop is published or the pool stops */
+    pthread_cond_t finished;                /* Signalled when the last worker share completes */
+    unsigned long generation;               /* Incremented for every published loop */
+    unsigned long startGeneration;          /* Generation when the workers were started */
+    int pending;                            /* Worker shares of the current loop not yet completed */
+    int shares;                             /* Number of shares of the current loop */
+    bool busy;                              /* A loop is running */
+    bool stopping;                          /* Workers should exit */
+    ParallelBody body;                      /* Body of the current loop */
+    void *arg;                              /* Argument of the current loop */
+    size_t count;                           /* Index range of the current loop */
+    size_t shareSize;                       /* Indices per share of the current loop */
+} ThreadPool;
+
+static ThreadPool pool = {
+    {0}, 1, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    0, 0, 0, 0, false, false, NULL, NULL, 0, 0
+};
+
+
+static void runShare(int worker) {
+    /*
+     * Short Description:
+     * Runs share 'worker' of the current loop, if the loop has that many shares.
+     */
+    size_t begin = (size_t)worker * pool.shareSize;     /* First index of the share */
+    size_t end = begin + pool.shareSize;                /* One past the last index of the share */
+
+    if (worker >= pool.shares || begin >= pool.count) {
+        return;
+    }
+    if (end > pool.count) {
+        end = pool.count;
+    }
+    pool.body(begin, end, worker, pool.arg);
+}
+
+
+static void *workerMain(void *arg) {
+    int worker = (int)(size_t)arg;      /* Share index served by this thread */
+    unsigned long seen;                 /* Generation of the last loop this worker ran */
+
+    pthread_mutex_lock(&pool.lock);
+    seen = pool.startGeneration;
+    for (;;) {
+        /* Sleep until a new loop is published or the pool stops */
+        while (!pool.stopping && pool.generation == seen) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+        if (pool.stopping) {
+            break;
+        }
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+
+        runShare(worker);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.pending == 0) {
+            pthread_cond_signal(&pool.finished);
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+
+bool initThreadPool(int threads) {
+    const char *env;    /* Value of the MATRIX_THREADS environment variable */
+    long online;        /* Number of online processors */
+    int worker;         /* Index for iterating over the workers */
+
+    if (threads <= 0) {
+        env = getenv(THREADS_ENV);
+        threads = (env != NULL) ? atoi(env) : 0;
+    }
+    if (threads <= 0) {
+        online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (online > 0) ? (int)online : 1;
+    }
+    if (threads > MAX_POOL_THREADS) {
+        threads = MAX_POOL_THREADS;
+    }
+
+    shutdownThreadPool();
+    pool.stopping = false;
+    pool.startGeneration = pool.generation;
+    for (worker = 1; worker < threads; worker++) {
+        if (pthread_create(&pool.workers[worker], NULL, workerMain, (void *)(size_t)worker) != 0) {
+            break;
+        }
+        pool.threadCount = worker + 1;
+    }
+    return pool.threadCount == threads;
+}
+
+
+void shutdownThreadPool(void) {
+    int worker;     /* Index for iterating over the workers */
+
+    pthread_mutex_lock(&pool.lock);
+    pool.stopping = true;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (worker = 1; worker < pool.threadCount; worker++) {
+        pthread_join(pool.workers[worker], NULL);
+    }
+    pool.threadCount = 1;
+}
+
+
+int getThreadCount(void) {
+    return pool.threadCount;
+}
+
+
+void parallelFor(size_t count, size_t grain, ParallelBody body, void *arg) {
+    size_t shares;      /* Number of shares the range is cut into */
+    size_t shareSize;   /* Indices per share, a multiple of 'grain' */
+
+    if (count == 0) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    /* Do not wake more threads than there are grains of work */
+    shares = (count + grain - 1) / grain;
+    if (shares > (size_t)pool.threadCount) {
+        shares = (size_t)pool.threadCount;
+    }
+    if (shares <= 1) {
+        body(0, count, 0, arg);
+        return;
+    }
+    shareSize = (count + shares - 1) / shares;
+    shareSize = ((shareSize + grain - 1) / grain) * grain;
+
+    pthread_mutex_lock(&pool.lock);
+    if (pool.busy) {
+        /* A loop started from inside another loop runs on its own thread */
+        pthread_mutex_unlock(&pool.lock);
+        body(0, count, 0, arg);
+        return;
+    }
+    pool.busy = true;
+    pool.body = body;
+    pool.arg = arg;
+    pool.count = count;
+    pool.shareSize = shareSize;
+    pool.shares = (int)((count + shareSize - 1) / shareSize);
+    pool.pending = pool.threadCount - 1;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    runShare(0);
+
+    /* Wait for every worker, including those without a share, so the next loop starts clean */
+    pthread_mutex_lock(&pool.lock);
+    while (pool.pending > 0) {
+        pthread_cond_wait(&pool.finished, &pool.lock);
+    }
+    pool.busy = false;
+    pthread_mutex_unlock(&pool.lock);
+}
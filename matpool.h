@@ -0,0 +1,97 @@
+/*
+ * Worker Thread Pool Header
+ * -------------------------
+ * This C header file declares the persistent pthread worker pool implemented in "matpool.c". The pool
+ * is created once at startup and reused by every parallel kernel, so a parallel operation only pays
+ * for waking the workers, never for creating threads.
+ *
+ * Core Functions:
+ * - initThreadPool:        Starts the worker threads.
+ * - shutdownThreadPool:    Stops and joins the worker threads.
+ * - getThreadCount:        Number of threads (workers plus caller) taking part in a parallel loop.
+ * - parallelFor:           Splits an index range across the pool and waits for it to complete.
+ *
+ * Note:
+ * The calling thread always takes the first share of a parallel loop itself. Loops with too little
+ * work for more than one share, loops started while the pool is busy (nested loops) and loops started
+ * on a single-threaded pool run entirely on the calling thread without touching any lock.
+ */
+
+#ifndef MATPOOL_H
+#define MATPOOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Name of the environment variable giving the default number of threads */
+#define THREADS_ENV "MATRIX_THREADS"
+
+/* Upper bound on the number of threads in the pool */
+#define MAX_POOL_THREADS 256
+
+/* Minimum number of elements an element-wise operation needs before it is split across threads */
+#define PARALLEL_MIN_ELEMENTS (1 << 15)
+
+/*
+ * Body of a parallel loop: processes indices [begin, end). 'worker' is the index (0 for the caller,
+ * below getThreadCount()) of the thread running the share, usable to pick per-thread scratch memory.
+ */
+typedef void (*ParallelBody)(size_t begin, size_t end, int worker, void *arg);
+
+
+/*
+ * Function: initThreadPool
+ * Purpose: Starts the worker threads of the pool.
+ * Detailed Description:
+ *   'threads' is the total number of threads taking part in a parallel loop, including the caller,
+ *   so 'threads' - 1 workers are started. A value of 0 selects the MATRIX_THREADS environment variable
+ *   if set, and otherwise the number of online processors. The value is clamped to MAX_POOL_THREADS.
+ *   If some workers cannot be started the pool runs with the ones that did.
+ *
+ * Parameters:
+ *   threads - Requested number of threads, or 0 for the default.
+ *
+ * Returns:
+ *   true if every requested worker was started; false otherwise.
+ */
+bool initThreadPool(int threads);
+
+
+/*
+ * Function: shutdownThreadPool
+ * Purpose: Stops and joins every worker thread; afterwards parallel loops run on the caller.
+ *
+ * Returns: None (void function).
+ */
+void shutdownThreadPool(void);
+
+
+/*
+ * Function: getThreadCount
+ * Purpose: Returns the number of threads, including the caller, that can run shares of a parallel loop.
+ *
+ * Returns:
+ *   The thread count; 1 if the pool was never started.
+ */
+int getThreadCount(void);
+
+
+/*
+ * Function: parallelFor
+ * Purpose: Runs 'body' over the index range [0, count) split across the pool.
+ * Detailed Description:
+ *   The range is cut into at most getThreadCount() contiguous shares, each a multiple of 'grain'
+ *   indices (except the last), and no share is created for less than 'grain' indices. The function
+ *   returns once every share has completed.
+ *
+ * Parameters:
+ *   count - Number of indices.
+ *   grain - Smallest number of indices worth giving to one thread.
+ *   body - Function processing one share.
+ *   arg - Argument passed unchanged to 'body'.
+ *
+ * Returns: None (void function).
+ */
+void parallelFor(size_t count, size_t grain, ParallelBody body, void *arg);
+
+#endif /* MATPOOL_H */
@@ -0,0 +1,475 @@
+/*
+ * QR Factorization
+ * ----------------
+ * This C source file implements the blocked Householder QR factorization and the least-squares solver
+ * declared in "matqr.h".
+ *
+ * Core Functionalities:
+ * 1.   generateReflector:  Computes one Householder reflector, with the norm scaled against overflow.
+ * 2.   factorPanel:        Computes the reflectors of a panel one column at a time, applying each to the
+ *                          columns of the panel on its right, and builds the T of the panel as it goes
+ *                          (LAPACK's 'dlarft'). Every update runs along the contiguous rows of the panel.
+ * 3.   formBlockFactor:    Builds the T of reflectors computed elsewhere, from their products V^T V.
+ * 4.   applyReflectors:    Applies I - V T V^T or its transpose as W = V^T C, W = op(T) W, C -= V W, three
+ *                          'gemm' calls. V is copied out QR_CHUNK_ROWS rows at a time with its unit
+ *                          diagonal and zeros, so a matrix of a million rows needs no copy of all of V.
+ * 5.   factorQR:           Factors every panel, then applies its block to all the columns on its right.
+ * 6.   qrMatrix:           Factors a copy of A, and forms the thin Q by applying the blocks backward to the
+ *                          first columns of the identity, each only to the columns it can change.
+ * 7.   leastSquaresMatrix: Reads waves of row blocks of [A B], factors the blocks of a wave in parallel
+ *                          ('factorWave'), and refactors their triangles stacked under the running [R Q^T B].
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "matqr.h"
+#include "matgemm.h"
+#include "matsimd.h"
+#include "matpool.h"
+
+
+/* Row blocks of [A B] factored together by the least-squares solver */
+typedef struct {
+    double *blocks;         /* Blocks of 'blockRows' rows of 'cols' elements, one after the other */
+    double *factors;        /* Triangular factors of the blocks, n x QR_BLOCK each */
+    int *rows;              /* Rows of every block */
+    MatrixStatus *statuses; /* Outcome of every block */
+    int blockRows;          /* Rows a block has room for */
+    int n;                  /* Columns of A, which are factored */
+    int cols;               /* Columns of A and B */
+} TsqrWave;
+
+
+static double columnNorm(const double *a, int count, int lda) {
+    /*
+     * Short Description:
+     * Returns the Euclidean norm of 'count' elements 'lda' apart, scaled by the largest magnitude so
+     * that squaring neither overflows nor underflows.
+     */
+    double largest = 0.0;   /* Largest magnitude */
+    double sum = 0.0;       /* Sum of the scaled squares */
+    double value;           /* Element being added */
+    int index;              /* Variable for iterating over the elements */
+
+    for (index = 0; index < count; ++index) {
+        value = a[(size_t)index * lda];
+        value = (value < 0.0) ? -value : value;
+        largest = (value > largest) ? value : largest;
+    }
+    if (largest == 0.0) {
+        return 0.0;
+    }
+    for (index = 0; index < count; ++index) {
+        value = a[(size_t)index * lda] / largest;
+        sum += value * value;
+    }
+    return largest * sqrt(sum);
+}
+
+
+double generateReflector(double *x, int count, int inc) {
+    /*
+     * Short Description:
+     * LAPACK's 'dlarfg': beta = -sign(alpha) ||x||, v = x / (alpha - beta) below its first element, and
+     * tau = (beta - alpha) / beta. The norm of (alpha, x) is scaled by its larger part.
+     */
+    double alpha = x[0];    /* Element the reflector maps the vector onto */
+    double norm;            /* Norm of the rest of the vector */
+    double largest;         /* Larger of |alpha| and 'norm' */
+    double beta;            /* New first element */
+    double scale;           /* Inverse of alpha - beta, which normalizes v */
+    int index;              /* Variable for iterating over the elements */
+
+    norm = (count > 1) ? columnNorm(&x[inc], count - 1, inc) : 0.0;
+    if (norm == 0.0) {
+        return 0.0;
+    }
+    largest = (alpha < 0.0) ? -alpha : alpha;
+    largest = (norm > largest) ? norm : largest;
+    beta = largest * sqrt((alpha / largest) * (alpha / largest) + (norm / largest) * (norm / largest));
+    beta = (alpha >= 0.0) ? -beta : beta;
+    scale = 1.0 / (alpha - beta);
+    for (index = 1; index < count; ++index) {
+        x[(size_t)index * inc] *= scale;
+    }
+    x[0] = beta;
+    return (beta - alpha) / beta;
+}
+
+
+static void factorPanel(double *a, int m, int lda, int start, int end, double *t) {
+    /*
+     * Short Description:
+     * Computes the reflectors of columns start .. end - 1 and the upper triangular T of the panel, with
+     * H_start ... H_end-1 = I - V T V^T. For every column, one pass over its rows gathers the products
+     * of the reflector with the columns of the panel: those on its left give the new column of T, those
+     * on its right the rank-1 update of the second pass.
+     */
+    const SimdKernels *simd = getSimdKernels();     /* Element-wise kernels */
+    int width = end - start;        /* Columns of the panel */
+    double sums[QR_BLOCK];          /* v_j^T times every column of the panel */
+    double tau;                     /* Scale of the reflector */
+    double value;                   /* Element of T being computed */
+    double *row;                    /* Row of the panel */
+    int col, index;                 /* Column of the reflector and its index in the panel */
+    int r, i, s;                    /* Variables for iterating over the rows and over T */
+
+    memset(t, 0, (size_t)width * QR_BLOCK * sizeof(double));
+    for (col = start; col < end; ++col) {
+        index = col - start;
+        tau = generateReflector(&a[(size_t)col * lda + col], m - col, lda);
+        if (tau == 0.0) {
+            continue;   /* H = I, so its column of T stays zero */
+        }
+
+        memcpy(sums, &a[(size_t)col * lda + start], (size_t)width * sizeof(double));
+        for (r = col + 1; r < m; ++r) {
+            row = &a[(size_t)r * lda];
+            if (row[col] != 0.0) {
+                simd->axpy(&row[start], row[col], sums, (size_t)width);
+            }
+        }
+        if (index + 1 < width) {
+            simd->axpy(&sums[index + 1], -tau, &a[(size_t)col * lda + col + 1], (size_t)(width - index - 1));
+            for (r = col + 1; r < m; ++r) {
+                row = &a[(size_t)r * lda];
+                if (row[col] != 0.0) {
+                    simd->axpy(&sums[index + 1], -tau * row[col], &row[col + 1], (size_t)(width - index - 1));
+                }
+            }
+        }
+
+        /* T(0:j, j) = -tau T(0:j, 0:j) V(:, 0:j)^T v_j */
+        t[(size_t)index * QR_BLOCK + index] = tau;
+        for (i = 0; i < index; ++i) {
+            value = 0.0;
+            for (s = i; s < index; ++s) {
+                value += t[(size_t)i * QR_BLOCK + s] * sums[s];
+            }
+            t[(size_t)i * QR_BLOCK + index] = -tau * value;
+        }
+    }
+}
+
+
+static void copyReflectors(const double *a, int lda, int start, int width, int first, int count, double *v) {
+    /*
+     * Short Description:
+     * Copies rows first .. first + count - 1 of the reflectors of the panel starting at 'start' into a
+     * count x QR_BLOCK buffer, with the implicit unit diagonal and zeros above it.
+     */
+    const double *row;  /* Row of the panel */
+    double *target;     /* Row of the copy */
+    int r, col;         /* Variables for iterating over the rows and the columns */
+
+    for (r = first; r < first + count; ++r) {
+        row = &a[(size_t)r * lda + start];
+        target = &v[(size_t)(r - first) * QR_BLOCK];
+        for (col = 0; col < width; ++col) {
+            target[col] = (r > start + col) ? row[col] : (r == start + col) ? 1.0 : 0.0;
+        }
+    }
+}
+
+
+MatrixStatus formBlockFactor(const double *a, int m, int lda, int start, int end, const double *tau, double *t) {
+    /*
+     * Short Description:
+     * LAPACK's 'dlarft', with the products of the reflectors with each other taken from one V^T V
+     * computed by 'gemm' over chunks of V.
+     */
+    int width = end - start;        /* Reflectors of the block */
+    double products[QR_BLOCK * QR_BLOCK];   /* V^T V */
+    double *v;                      /* Rows of V */
+    double value;                   /* Element of T being computed */
+    int first, count;               /* Rows of the current chunk of V */
+    int i, j, s;                    /* Variables for iterating over T */
+    MatrixStatus status = MATRIX_OK;
+
+    memset(t, 0, (size_t)width * QR_BLOCK * sizeof(double));
+    v = allocElements((size_t)QR_CHUNK_ROWS * QR_BLOCK);
+    if (v == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    for (first = start; first < m && status == MATRIX_OK; first += count) {
+        count = (m - first < QR_CHUNK_ROWS) ? m - first : QR_CHUNK_ROWS;
+        copyReflectors(a, lda, start, width, first, count, v);
+        status = gemm(GEMM_TRANS, GEMM_NO_TRANS, width, width, count, 1.0, v, QR_BLOCK, v, QR_BLOCK,
+                      (first == start) ? 0.0 : 1.0, products, QR_BLOCK);
+    }
+    free(v);
+
+    /* T(0:j, j) = -tau_j T(0:j, 0:j) V(:, 0:j)^T v_j */
+    for (j = 0; j < width && status == MATRIX_OK; ++j) {
+        t[(size_t)j * QR_BLOCK + j] = tau[start + j];
+        for (i = 0; i < j; ++i) {
+            value = 0.0;
+            for (s = i; s < j; ++s) {
+                value += t[(size_t)i * QR_BLOCK + s] * products[s * QR_BLOCK + j];
+            }
+            t[(size_t)i * QR_BLOCK + j] = -tau[start + j] * value;
+        }
+    }
+    return status;
+}
+
+
+MatrixStatus applyReflectors(const double *a, int m, int lda, int start, int end, const double *t,
+                             double *c, int ldc, int cols, bool transposed) {
+    int width = end - start;    /* Reflectors of the block */
+    double *v;                  /* Rows of V */
+    double *w;                  /* V^T C, then op(T) V^T C */
+    double *product;            /* op(T) V^T C */
+    int first, count;           /* Rows of the current chunk of V */
+    MatrixStatus status = MATRIX_OK;
+
+    v = allocElements((size_t)QR_CHUNK_ROWS * QR_BLOCK + 2 * (size_t)QR_BLOCK * (size_t)cols);
+    if (v == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    w = v + (size_t)QR_CHUNK_ROWS * QR_BLOCK;
+    product = w + (size_t)QR_BLOCK * (size_t)cols;
+
+    for (first = start; first < m && status == MATRIX_OK; first += count) {
+        count = (m - first < QR_CHUNK_ROWS) ? m - first : QR_CHUNK_ROWS;
+        copyReflectors(a, lda, start, width, first, count, v);
+        status = gemm(GEMM_TRANS, GEMM_NO_TRANS, width, cols, count, 1.0, v, QR_BLOCK,
+                      &c[(size_t)(first - start) * ldc], ldc, (first == start) ? 0.0 : 1.0, w, cols);
+    }
+    if (status == MATRIX_OK) {
+        status = gemm(transposed ? GEMM_TRANS : GEMM_NO_TRANS, GEMM_NO_TRANS, width, cols, width,
+                      1.0, t, QR_BLOCK, w, cols, 0.0, product, cols);
+    }
+    for (first = start; first < m && status == MATRIX_OK; first += count) {
+        count = (m - first < QR_CHUNK_ROWS) ? m - first : QR_CHUNK_ROWS;
+        copyReflectors(a, lda, start, width, first, count, v);
+        status = gemm(GEMM_NO_TRANS, GEMM_NO_TRANS, count, cols, width, -1.0, v, QR_BLOCK, product, cols,
+                      1.0, &c[(size_t)(first - start) * ldc], ldc);
+    }
+    free(v);
+    return status;
+}
+
+
+MatrixStatus factorQR(double *a, int m, int n, int cols, int lda, double *t) {
+    int k = (m < n) ? m : n;    /* Number of reflectors */
+    int start, end;             /* Columns of the current panel */
+    MatrixStatus status = MATRIX_OK;
+
+    for (start = 0; start < k && status == MATRIX_OK; start = end) {
+        end = (k - start < QR_BLOCK) ? k : start + QR_BLOCK;
+        factorPanel(a, m, lda, start, end, &t[(size_t)start * QR_BLOCK]);
+        if (end < cols) {
+            status = applyReflectors(a, m, lda, start, end, &t[(size_t)start * QR_BLOCK],
+                                &a[(size_t)start * lda + end], lda, cols - end, true);
+        }
+    }
+    return status;
+}
+
+
+MatrixStatus qrMatrix(const Matrix *a, Matrix *q, Matrix *r) {
+    int m = a->rows;            /* Rows of A and Q */
+    int n = a->cols;            /* Columns of A and R */
+    int k = (m < n) ? m : n;    /* Columns of Q and rows of R */
+    double *elements;           /* Copy of A, then its reflectors and R */
+    double *t;                  /* Triangular factors of the panels */
+    double *thinQ;              /* Q */
+    double *upper;              /* R */
+    int start, end;             /* Columns of the current panel */
+    int row;                    /* Variable for iterating over the rows */
+    MatrixStatus status;
+
+    elements = allocElements((size_t)m * (size_t)n);
+    t = allocElements((size_t)k * QR_BLOCK);
+    thinQ = allocElements((size_t)m * (size_t)k);
+    upper = allocElements((size_t)k * (size_t)n);
+    if (elements == NULL || t == NULL || thinQ == NULL || upper == NULL) {
+        status = MATRIX_ALLOCATION_FAILED;
+    } else {
+        status = exportMatrix(a, elements, (size_t)n);
+    }
+    if (status == MATRIX_OK) {
+        status = factorQR(elements, m, n, n, n, t);
+    }
+
+    if (status == MATRIX_OK) {
+        memset(upper, 0, (size_t)k * (size_t)n * sizeof(double));
+        for (row = 0; row < k; ++row) {
+            memcpy(&upper[(size_t)row * n + row], &elements[(size_t)row * n + row], (size_t)(n - row) * sizeof(double));
+        }
+
+        /* Q = H_0 ... H_k-1 I; columns left of a block are still those of I, which it leaves unchanged */
+        memset(thinQ, 0, (size_t)m * (size_t)k * sizeof(double));
+        for (row = 0; row < k; ++row) {
+            thinQ[(size_t)row * k + row] = 1.0;
+        }
+        for (start = (k - 1) / QR_BLOCK * QR_BLOCK; start >= 0 && status == MATRIX_OK; start -= QR_BLOCK) {
+            end = (k - start < QR_BLOCK) ? k : start + QR_BLOCK;
+            status = applyReflectors(elements, m, n, start, end, &t[(size_t)start * QR_BLOCK],
+                                &thinQ[(size_t)start * k + start], k, k - start, false);
+        }
+    }
+
+    if (status == MATRIX_OK) {
+        status = readMatrix(q, m, k, thinQ, (size_t)m * (size_t)k);
+    }
+    if (status == MATRIX_OK) {
+        status = readMatrix(r, k, n, upper, (size_t)k * (size_t)n);
+    }
+    free(elements);
+    free(t);
+    free(thinQ);
+    free(upper);
+    return status;
+}
+
+
+static void factorWave(size_t begin, size_t end, int worker, void *arg) {
+    /*
+     * Short Description:
+     * Factors blocks begin .. end - 1 of a wave; every block has its own buffers, and the 'gemm' calls
+     * of a share run on its thread, since loops nested in a parallel loop do not split again.
+     */
+    TsqrWave *wave = (TsqrWave *)arg;   /* Blocks of the wave */
+    size_t block;                       /* Variable for iterating over the blocks */
+
+    (void)worker;
+    for (block = begin; block < end; ++block) {
+        wave->statuses[block] = factorQR(&wave->blocks[block * (size_t)wave->blockRows * (size_t)wave->cols],
+                                         wave->rows[block], wave->n, wave->cols, wave->cols,
+                                         &wave->factors[block * (size_t)wave->n * QR_BLOCK]);
+    }
+}
+
+
+static void stackTriangle(const double *source, int rows, int n, int cols, double *target) {
+    /*
+     * Short Description:
+     * Copies the first min(rows, n) rows of a factored block, its R and Q^T B, without the reflectors
+     * stored below the diagonal of R.
+     */
+    int row;    /* Variable for iterating over the rows */
+
+    for (row = 0; row < rows && row < n; ++row) {
+        memset(&target[(size_t)row * cols], 0, (size_t)row * sizeof(double));
+        memcpy(&target[(size_t)row * cols + row], &source[(size_t)row * cols + row], (size_t)(cols - row) * sizeof(double));
+    }
+}
+
+
+static MatrixStatus solveTriangle(double *stack, int n, int cols, double *solution) {
+    /*
+     * Short Description:
+     * Solves R X = C by back substitution, R being the first n columns of the top n rows of 'stack' and
+     * C the others, into the n x (cols - n) buffer 'solution'.
+     */
+    const SimdKernels *simd = getSimdKernels();     /* Element-wise kernels */
+    int width = cols - n;   /* Columns of X */
+    double *target;         /* Row of X being solved */
+    double pivot;           /* Diagonal element of R */
+    int row, col;           /* Variables for iterating over the rows of R and their elements */
+
+    for (row = n - 1; row >= 0; --row) {
+        target = &solution[(size_t)row * width];
+        memcpy(target, &stack[(size_t)row * cols + n], (size_t)width * sizeof(double));
+        for (col = row + 1; col < n; ++col) {
+            if (stack[(size_t)row * cols + col] != 0.0) {
+                simd->axpy(&solution[(size_t)col * width], -stack[(size_t)row * cols + col], target, (size_t)width);
+            }
+        }
+        pivot = stack[(size_t)row * cols + row];
+        if (pivot == 0.0) {
+            return MATRIX_RANK_DEFICIENT;
+        }
+        simd->scale(target, 1.0 / pivot, target, (size_t)width);
+    }
+    return MATRIX_OK;
+}
+
+
+MatrixStatus leastSquaresMatrix(const Matrix *a, const Matrix *b, Matrix *x) {
+    int m = a->rows;            /* Rows of A and B */
+    int n = a->cols;            /* Columns of A */
+    int cols = n + b->cols;     /* Columns of [A B] */
+    TsqrWave wave;              /* Blocks read and factored together */
+    int capacity;               /* Blocks of a wave */
+    int count;                  /* Blocks of the current wave */
+    int first;                  /* First row of the next block */
+    int stacked;                /* Rows of the running triangle, then of the stack */
+    int block;                  /* Variable for iterating over the blocks of a wave */
+    double *stack;              /* Running [R Q^T B] over the triangles of the current wave */
+    double *stackFactors;       /* Triangular factors of the stack */
+    double *solution;           /* X */
+    MatrixStatus status = MATRIX_OK;
+
+    if (b->rows != m) {
+        return MATRIX_DIMENSION_MISMATCH;
+    }
+    if (m < n) {
+        return MATRIX_RANK_DEFICIENT;
+    }
+    wave.n = n;
+    wave.cols = cols;
+    wave.blockRows = (TSQR_BLOCK_ROWS < 2 * n) ? 2 * n : TSQR_BLOCK_ROWS;
+    capacity = (m + wave.blockRows - 1) / wave.blockRows;
+    capacity = (capacity < getThreadCount()) ? capacity : getThreadCount();
+    wave.blocks = allocElements((size_t)capacity * (size_t)wave.blockRows * (size_t)cols);
+    wave.factors = allocElements((size_t)capacity * (size_t)n * QR_BLOCK);
+    wave.rows = malloc((size_t)capacity * sizeof(int));
+    wave.statuses = malloc((size_t)capacity * sizeof(MatrixStatus));
+    stack = allocElements((size_t)(capacity + 1) * (size_t)n * (size_t)cols);
+    stackFactors = allocElements((size_t)n * QR_BLOCK);
+    solution = allocElements((size_t)n * (size_t)b->cols);
+    if (wave.blocks == NULL || wave.factors == NULL || wave.rows == NULL || wave.statuses == NULL ||
+        stack == NULL || stackFactors == NULL || solution == NULL) {
+        status = MATRIX_ALLOCATION_FAILED;
+    }
+
+    stacked = 0;
+    for (first = 0; first < m && status == MATRIX_OK; ) {
+        for (count = 0; count < capacity && first < m && status == MATRIX_OK; ++count) {
+            wave.rows[count] = (m - first < wave.blockRows) ? m - first : wave.blockRows;
+            status = exportRows(a, first, wave.rows[count], &wave.blocks[(size_t)count * wave.blockRows * cols],
+                                (size_t)cols);
+            if (status == MATRIX_OK) {
+                status = exportRows(b, first, wave.rows[count],
+                                    &wave.blocks[(size_t)count * wave.blockRows * cols + n], (size_t)cols);
+            }
+            first += wave.rows[count];
+        }
+        if (status != MATRIX_OK) {
+            break;
+        }
+        parallelFor((size_t)count, 1, factorWave, &wave);
+
+        /* Stack the triangles of the wave under the running one and fold them into it */
+        for (block = 0; block < count && status == MATRIX_OK; ++block) {
+            status = wave.statuses[block];
+            stackTriangle(&wave.blocks[(size_t)block * wave.blockRows * cols], wave.rows[block], n, cols,
+                          &stack[(size_t)stacked * cols]);
+            stacked += (wave.rows[block] < n) ? wave.rows[block] : n;
+        }
+        if (status == MATRIX_OK && stacked > n) {
+            status = factorQR(stack, stacked, n, cols, cols, stackFactors);
+            stackTriangle(stack, stacked, n, cols, stack);
+            stacked = n;
+        }
+    }
+
+    if (status == MATRIX_OK) {
+        status = solveTriangle(stack, n, cols, solution);
+    }
+    if (status == MATRIX_OK) {
+        status = readMatrix(x, n, b->cols, solution, (size_t)n * (size_t)b->cols);
+    }
+    free(wave.blocks);
+    free(wave.factors);
+    free(wave.rows);
+    free(wave.statuses);
+    free(stack);
+    free(stackFactors);
+    free(solution);
+    return status;
+}
@@ -0,0 +1,159 @@
+/*
+ * QR Factorization Header
+ * -----------------------
+ * This C header file declares the Householder QR factorization and the least-squares solver
+ * implemented in "matqr.c". The factorization is blocked: the QR_BLOCK reflectors of a panel are
+ * gathered into the compact WY form I - V T V^T, so applying them to the rest of the matrix takes
+ * three calls of the GEMM engine of "matgemm.h" instead of one rank-1 update per reflector.
+ *
+ * Core Functions:
+ * - generateReflector:     Computes the Householder reflector of one vector.
+ * - formBlockFactor:       Gathers reflectors stored by columns into the compact WY form.
+ * - applyReflectors:       Applies a block of reflectors in the compact WY form to a matrix.
+ * - factorQR:              Computes the reflectors of A = Q R in place.
+ * - qrMatrix:              Computes the thin factors Q and R of a matrix.
+ * - leastSquaresMatrix:    Minimizes ||A X - B|| by a tall-skinny QR (TSQR) over blocks of rows.
+ *
+ * Note:
+ * The least-squares solver never holds A in memory: it reads TSQR_BLOCK_ROWS rows of A and B at a
+ * time, whatever their storage (see "matdisk.h"), factors as many blocks as there are threads at once,
+ * and folds their triangles into a running R. A 10^6 x 100 matrix stored on disk needs a few MiB.
+ */
+
+#ifndef MATQR_H
+#define MATQR_H
+
+#include <stdbool.h>
+#include "mymat.h"
+
+/* Reflectors of a panel, gathered into one compact WY block */
+#define QR_BLOCK 32
+/* Rows of the reflectors copied out at a time when a block of them is applied */
+#define QR_CHUNK_ROWS 1024
+/* Rows of A read and factored at a time by the least-squares solver, at least the columns of A */
+#define TSQR_BLOCK_ROWS 4096
+
+
+/*
+ * Function: generateReflector
+ * Purpose: Computes the reflector H = I - tau v v^T with H x = (beta, 0, ..., 0)^T.
+ *
+ * Parameters:
+ *   x - Vector of 'count' elements 'inc' apart; receives beta in its first element and v, whose first
+ *       element is an implicit 1, in the others.
+ *   count - Number of elements of the vector.
+ *   inc - Distance in elements between consecutive elements of the vector.
+ *
+ * Returns:
+ *   tau, or 0 with the vector unchanged (H = I) when its elements after the first are all zero.
+ */
+double generateReflector(double *x, int count, int inc);
+
+
+/*
+ * Function: formBlockFactor
+ * Purpose: Computes the T with H_start ... H_end-1 = I - V T V^T for reflectors stored as by 'factorQR'.
+ *
+ * Parameters:
+ *   a - Row-major matrix holding v_j below its diagonal in column j, with an implicit 1 on the diagonal.
+ *   m - Rows of the matrix.
+ *   lda - Distance in elements between consecutive rows of 'a'.
+ *   start, end - Columns of the reflectors, at most QR_BLOCK of them.
+ *   tau - Scales of the reflectors, by column.
+ *   t - Receives T in (end - start) rows of QR_BLOCK elements.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the work buffers could not be allocated.
+ */
+MatrixStatus formBlockFactor(const double *a, int m, int lda, int start, int end, const double *tau, double *t);
+
+
+/*
+ * Function: applyReflectors
+ * Purpose: Overwrites C with H C or H^T C, where H = I - V T V^T gathers a block of reflectors.
+ * Detailed Description:
+ *   W = V^T C, W = op(T) W and C -= V W are three calls of 'gemm'. V is copied out QR_CHUNK_ROWS rows
+ *   at a time, with its unit diagonal and zeros made explicit.
+ *
+ * Parameters:
+ *   a - Row-major matrix holding the reflectors as for 'formBlockFactor'.
+ *   m - Rows of the matrix, and of C below 'start'.
+ *   lda - Distance in elements between consecutive rows of 'a'.
+ *   start, end - Columns of the reflectors, at most QR_BLOCK of them.
+ *   t - T of the block, in rows of QR_BLOCK elements.
+ *   c - First element of row 'start' of C; rows start .. m - 1 are overwritten.
+ *   ldc - Distance in elements between consecutive rows of 'c'.
+ *   cols - Columns of C.
+ *   transposed - Whether to apply H^T rather than H.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the work buffers could not be allocated.
+ */
+MatrixStatus applyReflectors(const double *a, int m, int lda, int start, int end, const double *t,
+                             double *c, int ldc, int cols, bool transposed);
+
+
+/*
+ * Function: factorQR
+ * Purpose: Computes the Householder QR factorization of the first n columns of a row-major matrix.
+ * Detailed Description:
+ *   The min(m, n) reflectors H_j = I - tau_j v_j v_j^T, with Q = H_0 H_1 ..., are applied to all 'cols'
+ *   columns, so columns past n receive Q^T times themselves. On return R is on and above the diagonal
+ *   of the first n columns and v_j, whose element j is an implicit 1, below it in column j.
+ *
+ * Parameters:
+ *   a - m x cols row-major matrix, factored in place.
+ *   m - Rows of the matrix.
+ *   n - Columns to factor, at most 'cols'.
+ *   cols - Columns of the matrix.
+ *   lda - Distance in elements between consecutive rows of 'a'.
+ *   t - Receives the triangular factors T of the panels: rows j to j + QR_BLOCK - 1 of a
+ *       min(m, n) x QR_BLOCK row-major buffer hold the T of the panel starting at column j, whose
+ *       diagonal holds the tau_j.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the work buffers could not be allocated.
+ */
+MatrixStatus factorQR(double *a, int m, int n, int cols, int lda, double *t);
+
+
+/*
+ * Function: qrMatrix
+ * Purpose: Computes the thin QR factorization A = Q R of an m x n matrix.
+ * Detailed Description:
+ *   With k = min(m, n), Q is m x k with orthonormal columns and R is k x n upper triangular, so a tall
+ *   matrix gets a Q of its own size rather than m x m.
+ *
+ * Parameters:
+ *   a - Pointer to the Matrix to factor, in any storage.
+ *   q - Pointer to the Matrix receiving Q.
+ *   r - Pointer to the Matrix receiving R, stored after Q; any of the three may be the same matrix.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the work buffers could not be allocated, or the
+ *   status of reading A or storing the results.
+ */
+MatrixStatus qrMatrix(const Matrix *a, Matrix *q, Matrix *r);
+
+
+/*
+ * Function: leastSquaresMatrix
+ * Purpose: Computes the X minimizing the Euclidean norm of every column of A X - B.
+ * Detailed Description:
+ *   The rows of [A B] are read by blocks and factored by QR, the blocks of a wave in parallel, then
+ *   the triangles of the wave are stacked under the running one and factored again. What is left is
+ *   R X = Q^T B with R of order n, solved by back substitution.
+ *
+ * Parameters:
+ *   a - Pointer to the m x n Matrix A, m >= n, in any storage.
+ *   b - Pointer to the m x k Matrix B.
+ *   x - Pointer to the Matrix receiving the n x k solution; it may be 'a' or 'b'.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_DIMENSION_MISMATCH if B has not m rows, MATRIX_RANK_DEFICIENT if A
+ *   has fewer rows than columns or R a zero on its diagonal, MATRIX_ALLOCATION_FAILED if the work
+ *   buffers could not be allocated, or the status of reading the operands or storing the result.
+ */
+MatrixStatus leastSquaresMatrix(const Matrix *a, const Matrix *b, Matrix *x);
+
+#endif /* MATQR_H */
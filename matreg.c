@@ -0,0 +1,260 @@
+/*
+ * Matrix Registry
+ * ---------------
+ * This C source file implements the registry of named matrices declared in "matreg.h".
+ *
+ * Core Functionalities:
+ * 1.   hashName:               FNV-1a hash of a name.
+ * 2.   findMatrix:             Linear probing from the slot of the hash until the name or a free slot.
+ * 3.   registerMatrix:         Interns a new name, allocates its matrix and inserts its handle,
+ *                              doubling the table first when it would become more than half full.
+ *      touchMatrix:            Gives a written matrix the next version of the context.
+ * 4.   isMatrixIdentifier:     Syntax of the names of new matrices.
+ * 5.   freeRegistry:           Releases the registry.
+ *
+ * The hash of every name is kept next to it, so probing compares hashes before strings and growing
+ * the table does not hash the names again.
+ */
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "matreg.h"
+
+
+/* Number of slots of the first hash table */
+#define INITIAL_SLOT_COUNT 16
+
+/* Number of matrices the first handle arrays have room for */
+#define INITIAL_MATRIX_CAPACITY 8
+
+/* FNV-1a parameters, 32-bit variant */
+#define FNV_OFFSET_BASIS 2166136261UL
+#define FNV_PRIME 16777619UL
+
+
+static unsigned long hashName(const char *name, size_t length) {
+    /*
+     * Short Description:
+     * FNV-1a over the characters of the name, kept to 32 bits.
+     */
+    unsigned long hash = FNV_OFFSET_BASIS;  /* Running hash */
+    size_t index;                           /* Index of the current character */
+
+    for (index = 0; index < length; ++index) {
+        hash = ((hash ^ (unsigned char)name[index]) * FNV_PRIME) & 0xFFFFFFFFUL;
+    }
+    return hash;
+}
+
+
+static size_t findSlot(const MatrixContext *ctx, const char *name, size_t length, unsigned long hash) {
+    /*
+     * Short Description:
+     * Returns the slot holding the name, or the free slot that ends its probe sequence.
+     */
+    size_t mask = ctx->slotCount - 1;   /* Slot count is a power of two */
+    size_t slot = hash & mask;          /* Slot being probed */
+    MatrixHandle handle;                /* Handle stored in the slot */
+
+    for (;;) {
+        handle = ctx->slots[slot];
+        if (handle == NO_MATRIX) {
+            return slot;
+        }
+        if (ctx->hashes[handle] == hash && strncmp(ctx->names[handle], name, length) == 0 &&
+            ctx->names[handle][length] == '\0') {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+
+static MatrixStatus growSlots(MatrixContext *ctx) {
+    /*
+     * Short Description:
+     * Doubles the hash table and reinserts every handle from the stored hashes.
+     */
+    size_t slotCount = ctx->slotCount ? ctx->slotCount * 2 : INITIAL_SLOT_COUNT;   /* New number of slots */
+    MatrixHandle *slots;        /* New table */
+    size_t slot;                /* Variable for iterating over the slots */
+    size_t mask = slotCount - 1;    /* Slot count is a power of two */
+    MatrixHandle handle;        /* Variable for iterating over the handles */
+
+    if (slotCount > (size_t)-1 / sizeof(MatrixHandle)) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    slots = malloc(slotCount * sizeof(MatrixHandle));
+    if (slots == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    for (slot = 0; slot < slotCount; ++slot) {
+        slots[slot] = NO_MATRIX;
+    }
+    for (handle = 0; handle < ctx->count; ++handle) {
+        slot = ctx->hashes[handle] & mask;
+        while (slots[slot] != NO_MATRIX) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = handle;
+    }
+
+    free(ctx->slots);
+    ctx->slots = slots;
+    ctx->slotCount = slotCount;
+    return MATRIX_OK;
+}
+
+
+static MatrixStatus growMatrices(MatrixContext *ctx) {
+    /*
+     * Short Description:
+     * Doubles the arrays indexed by handle. An array that was already grown when a later one fails
+     * stays valid, so the old capacity remains correct for all of them.
+     */
+    int capacity;               /* New number of entries */
+    Matrix *matrices;           /* Grown array of matrices */
+    char **names;               /* Grown array of names */
+    unsigned long *hashes;      /* Grown array of hashes */
+    unsigned long *versions;    /* Grown array of versions */
+
+    if (ctx->capacity > INT_MAX / 2) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    capacity = ctx->capacity ? ctx->capacity * 2 : INITIAL_MATRIX_CAPACITY;
+
+    matrices = realloc(ctx->matrices, (size_t)capacity * sizeof(Matrix));
+    if (matrices == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    ctx->matrices = matrices;
+    names = realloc(ctx->names, (size_t)capacity * sizeof(char *));
+    if (names == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    ctx->names = names;
+    hashes = realloc(ctx->hashes, (size_t)capacity * sizeof(unsigned long));
+    if (hashes == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    ctx->hashes = hashes;
+    versions = realloc(ctx->versions, (size_t)capacity * sizeof(unsigned long));
+    if (versions == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    ctx->versions = versions;
+
+    ctx->capacity = capacity;
+    return MATRIX_OK;
+}
+
+
+MatrixHandle findMatrix(const MatrixContext *ctx, const char *name, size_t length) {
+    if (ctx->count == 0) {
+        return NO_MATRIX;
+    }
+    return ctx->slots[findSlot(ctx, name, length, hashName(name, length))];
+}
+
+
+MatrixStatus registerMatrix(MatrixContext *ctx, const char *name, size_t length, MatrixHandle *handle) {
+    /*
+     * Short Description:
+     * Returns the existing handle of the name, or appends a zero matrix under a copy of the name.
+     */
+    unsigned long hash = hashName(name, length);    /* Hash of the name */
+    Matrix mat = {NULL, 0, 0, 0, 0, NULL, 0, NULL, NULL};      /* Matrix of the new name */
+    char *copy;                                     /* Interned copy of the name */
+    MatrixStatus status;
+
+    if (ctx->count > 0) {
+        *handle = ctx->slots[findSlot(ctx, name, length, hash)];
+        if (*handle != NO_MATRIX) {
+            return MATRIX_OK;
+        }
+    }
+
+    /* Make room first, so nothing below has to be undone once the name is inserted */
+    if (ctx->count == INT_MAX) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    if (ctx->count == ctx->capacity) {
+        status = growMatrices(ctx);
+        if (status != MATRIX_OK) {
+            return status;
+        }
+    }
+    if ((size_t)ctx->count + 1 > ctx->slotCount / 2) {
+        status = growSlots(ctx);
+        if (status != MATRIX_OK) {
+            return status;
+        }
+    }
+
+    copy = malloc(length + 1);
+    if (copy == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+
+    status = resizeMatrix(&mat, DEFAULT_ROWS, DEFAULT_COLS);
+    if (status != MATRIX_OK) {
+        free(copy);
+        return status;
+    }
+    memset(mat.data, 0, (size_t)DEFAULT_ROWS * DEFAULT_COLS * sizeof(double));
+
+    *handle = ctx->count++;
+    ctx->matrices[*handle] = mat;
+    ctx->names[*handle] = copy;
+    ctx->hashes[*handle] = hash;
+    ctx->versions[*handle] = ++ctx->lastVersion;
+    ctx->slots[findSlot(ctx, name, length, hash)] = *handle;
+    return MATRIX_OK;
+}
+
+
+void touchMatrix(MatrixContext *ctx, MatrixHandle handle) {
+    ctx->versions[handle] = ++ctx->lastVersion;
+}
+
+
+bool isMatrixIdentifier(const char *name, size_t length, size_t maxLength) {
+    size_t index;   /* Index of the current character */
+
+    if (length == 0 || length >= maxLength || !(isalpha((unsigned char)name[0]) || name[0] == '_')) {
+        return false;
+    }
+    for (index = 1; index < length; ++index) {
+        if (!(isalnum((unsigned char)name[index]) || name[index] == '_')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void freeRegistry(MatrixContext *ctx) {
+    MatrixHandle handle;    /* Variable for iterating over the handles */
+
+    for (handle = 0; handle < ctx->count; ++handle) {
+        freeMatrix(&ctx->matrices[handle]);
+        free(ctx->names[handle]);
+    }
+    free(ctx->matrices);
+    free(ctx->names);
+    free(ctx->hashes);
+    free(ctx->versions);
+    free(ctx->slots);
+    ctx->matrices = NULL;
+    ctx->names = NULL;
+    ctx->hashes = NULL;
+    ctx->versions = NULL;
+    ctx->slots = NULL;
+    ctx->count = 0;
+    ctx->capacity = 0;
+    ctx->slotCount = 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Matrix Registry Header
+ * ----------------------
+ * This C header file declares the registry of named matrices implemented in "matreg.c". The registry
+ * lives in the MatrixContext (see "mymat.h"): matrices are stored in a dense array indexed by handle,
+ * and an open-addressing hash table maps every interned name to its handle, so a lookup costs one hash
+ * of the name and, in the common case, one comparison, however many matrices are registered.
+ *
+ * Core Functions:
+ * - findMatrix:        Looks a name up and returns the handle of its matrix.
+ * - registerMatrix:    Registers a name with a new zero matrix, or returns the handle it already has.
+ * - touchMatrix:       Gives a matrix a new version after it has been written.
+ * - isMatrixIdentifier: Checks that a string is acceptable as the name of a new matrix.
+ * - freeRegistry:      Releases every matrix and name of the registry.
+ *
+ * Note:
+ * Names are taken as a pointer and a length, so the parser can look up a token in place without
+ * copying it. Handles are never reused or invalidated, but registering a matrix may move the array of
+ * matrices, so pointers into 'ctx->matrices' must not be kept across a call to 'registerMatrix'.
+ *
+ * Every matrix carries a version drawn from a counter of the context: a matrix gets the next version
+ * when it is registered and again whenever it is written. Versions are never reused, even across
+ * matrices, so a version identifies one value of one matrix, which is what the result cache of
+ * "matcache.h" keys its entries on.
+ */
+
+#ifndef MATREG_H
+#define MATREG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "mymat.h"
+
+
+/*
+ * Function: findMatrix
+ * Purpose: Retrieves the handle of the matrix registered under a name.
+ *
+ * Parameters:
+ *   ctx - Pointer to the MatrixContext holding the registry.
+ *   name - The name to look up; it need not be null-terminated.
+ *   length - Number of characters in 'name'.
+ *
+ * Returns:
+ *   The handle of the matrix, or NO_MATRIX if the name is not registered.
+ */
+MatrixHandle findMatrix(const MatrixContext *ctx, const char *name, size_t length);
+
+
+/*
+ * Function: registerMatrix
+ * Purpose: Registers a name with a new matrix.
+ * Detailed Description:
+ *   If the name is already registered its handle is returned and the matrix is left untouched.
+ *   Otherwise a copy of the name is interned, a DEFAULT_ROWS x DEFAULT_COLS zero matrix is
+ *   allocated for it and it receives the next handle. The hash table doubles when it becomes
+ *   half full.
+ *
+ * Parameters:
+ *   ctx - Pointer to the MatrixContext holding the registry.
+ *   name - The name to register; it need not be null-terminated.
+ *   length - Number of characters in 'name'.
+ *   handle - Receives the handle of the matrix.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the matrix, the name or the table could
+ *   not be allocated.
+ */
+MatrixStatus registerMatrix(MatrixContext *ctx, const char *name, size_t length, MatrixHandle *handle);
+
+
+/*
+ * Function: touchMatrix
+ * Purpose: Records that a matrix has been written by giving it a new version.
+ *
+ * Parameters:
+ *   ctx - Pointer to the MatrixContext holding the registry.
+ *   handle - Handle of the matrix written.
+ *
+ * Returns: None (void function).
+ */
+void touchMatrix(MatrixContext *ctx, MatrixHandle handle);
+
+
+/*
+ * Function: isMatrixIdentifier
+ * Purpose: Checks that a string can name a new matrix.
+ * Detailed Description:
+ *   A name starts with a letter or an underscore, continues with letters, digits and underscores,
+ *   and is shorter than 'maxLength' characters.
+ *
+ * Parameters:
+ *   name - The candidate name; it need not be null-terminated.
+ *   length - Number of characters in 'name'.
+ *   maxLength - Bound on the length of a name.
+ *
+ * Returns:
+ *   true if the string is a valid name; false otherwise.
+ */
+bool isMatrixIdentifier(const char *name, size_t length, size_t maxLength);
+
+
+/*
+ * Function: freeRegistry
+ * Purpose: Releases every matrix and name of the registry and leaves it empty.
+ *
+ * Parameters:
+ *   ctx - Pointer to the MatrixContext holding the registry.
+ *
+ * Returns: None (void function).
+ */
+void freeRegistry(MatrixContext *ctx);
+
+#endif /* MATREG_H */
@@ -0,0 +1,398 @@
+/*
+ * SIMD Element-wise Kernels
+ * -------------------------
+ * This C source file implements the element-wise kernels and the runtime dispatch declared in "matsimd.h".
+ *
+ * Core Functionalities:
+ * 1.   Scalar kernels:     Portable loops used on any processor.
+ * 2.   SSE2 kernels:       Two doubles per instruction, unrolled by four vectors.
+ * 3.   AVX2 kernels:       Four doubles per instruction, unrolled by four vectors.
+ * 4.   AVX-512 kernels:    Eight doubles per instruction; the remainder uses a masked load/store
+ *                          instead of a scalar tail.
+ *      The multiply-add kernel (axpy) also loads the result, so its vector loops are unrolled by two; the
+ *      AVX2 and AVX-512 versions fuse the multiply and the add. The rotation kernel (rot) updates two
+ *      rows in place and is not unrolled.
+ * 5.   initSimdKernels:    Chooses a kernel table from cpuid and the MATRIX_SIMD cap.
+ *
+ * The vector kernels are compiled with per-function target attributes, so the program as a whole
+ * still runs on a baseline processor and only calls a kernel after cpuid reported its instruction set.
+ * Unaligned loads and stores are used throughout: rows of a matrix view need not start on a vector
+ * boundary, and on current processors they cost nothing extra for aligned addresses.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "matsimd.h"
+
+
+/*
+ * Defines the scalar, SSE2, AVX2 and AVX-512 versions of a binary element-wise kernel.
+ * 'name' is the kernel name suffix, 'op' the C operator and 'sse2Op', 'avx2Op', 'avx512Op'
+ * the matching intrinsics.
+ */
+#define DEFINE_SCALAR_BINARY_KERNEL(name, op)                                           \
+static void name##Scalar(const double *a, const double *b, double *result, size_t count) { \
+    size_t i;   /* Element index */                                                     \
+    for (i = 0; i < count; ++i) {                                                       \
+        result[i] = a[i] op b[i];                                                       \
+    }                                                                                   \
+}
+
+#define DEFINE_X86_BINARY_KERNELS(name, op, sse2Op, avx2Op, avx512Op)                   \
+__attribute__((target("sse2")))                                                         \
+static void name##Sse2(const double *a, const double *b, double *result, size_t count) { \
+    size_t i = 0;   /* Element index */                                                 \
+    for (; i + 8 <= count; i += 8) {                                                    \
+        _mm_storeu_pd(result + i, sse2Op(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));    \
+        _mm_storeu_pd(result + i + 2, sse2Op(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2))); \
+        _mm_storeu_pd(result + i + 4, sse2Op(_mm_loadu_pd(a + i + 4), _mm_loadu_pd(b + i + 4))); \
+        _mm_storeu_pd(result + i + 6, sse2Op(_mm_loadu_pd(a + i + 6), _mm_loadu_pd(b + i + 6))); \
+    }                                                                                   \
+    for (; i + 2 <= count; i += 2) {                                                    \
+        _mm_storeu_pd(result + i, sse2Op(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));    \
+    }                                                                                   \
+    for (; i < count; ++i) {                                                            \
+        result[i] = a[i] op b[i];                                                       \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+__attribute__((target("avx2")))                                                         \
+static void name##Avx2(const double *a, const double *b, double *result, size_t count) { \
+    size_t i = 0;   /* Element index */                                                 \
+    for (; i + 16 <= count; i += 16) {                                                  \
+        _mm256_storeu_pd(result + i, avx2Op(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); \
+        _mm256_storeu_pd(result + i + 4, avx2Op(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4))); \
+        _mm256_storeu_pd(result + i + 8, avx2Op(_mm256_loadu_pd(a + i + 8), _mm256_loadu_pd(b + i + 8))); \
+        _mm256_storeu_pd(result + i + 12, avx2Op(_mm256_loadu_pd(a + i + 12), _mm256_loadu_pd(b + i + 12))); \
+    }                                                                                   \
+    for (; i + 4 <= count; i += 4) {                                                    \
+        _mm256_storeu_pd(result + i, avx2Op(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); \
+    }                                                                                   \
+    for (; i < count; ++i) {                                                            \
+        result[i] = a[i] op b[i];                                                       \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+__attribute__((target("avx512f")))                                                      \
+static void name##Avx512(const double *a, const double *b, double *result, size_t count) { \
+    size_t i = 0;   /* Element index */                                                 \
+    __mmask8 mask;  /* Lanes still inside the array on the last iteration */            \
+    for (; i + 32 <= count; i += 32) {                                                  \
+        _mm512_storeu_pd(result + i, avx512Op(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i))); \
+        _mm512_storeu_pd(result + i + 8, avx512Op(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8))); \
+        _mm512_storeu_pd(result + i + 16, avx512Op(_mm512_loadu_pd(a + i + 16), _mm512_loadu_pd(b + i + 16))); \
+        _mm512_storeu_pd(result + i + 24, avx512Op(_mm512_loadu_pd(a + i + 24), _mm512_loadu_pd(b + i + 24))); \
+    }                                                                                   \
+    for (; i + 8 <= count; i += 8) {                                                    \
+        _mm512_storeu_pd(result + i, avx512Op(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i))); \
+    }                                                                                   \
+    if (i < count) {                                                                    \
+        mask = (__mmask8)((1u << (count - i)) - 1u);                                    \
+        _mm512_mask_storeu_pd(result + i, mask,                                         \
+                              avx512Op(_mm512_maskz_loadu_pd(mask, a + i),              \
+                                       _mm512_maskz_loadu_pd(mask, b + i)));            \
+    }                                                                                   \
+}
+
+
+DEFINE_SCALAR_BINARY_KERNEL(add, +)
+DEFINE_SCALAR_BINARY_KERNEL(sub, -)
+
+
+static void scaleScalar(const double *a, double scalar, double *result, size_t count) {
+    size_t i;   /* Element index */
+
+    for (i = 0; i < count; ++i) {
+        result[i] = scalar * a[i];
+    }
+}
+
+
+static void axpyScalar(const double *a, double scalar, double *result, size_t count) {
+    size_t i;   /* Element index */
+
+    for (i = 0; i < count; ++i) {
+        result[i] += scalar * a[i];
+    }
+}
+
+
+static void rotScalar(double *x, double *y, double c, double s, size_t count) {
+    size_t i;       /* Element index */
+    double value;   /* Element of x before the rotation */
+
+    for (i = 0; i < count; ++i) {
+        value = x[i];
+        x[i] = c * value + s * y[i];
+        y[i] = c * y[i] - s * value;
+    }
+}
+
+
+#if defined(__x86_64__) || defined(__i386__)
+
+DEFINE_X86_BINARY_KERNELS(add, +, _mm_add_pd, _mm256_add_pd, _mm512_add_pd)
+DEFINE_X86_BINARY_KERNELS(sub, -, _mm_sub_pd, _mm256_sub_pd, _mm512_sub_pd)
+
+
+__attribute__((target("sse2")))
+static void scaleSse2(const double *a, double scalar, double *result, size_t count) {
+    size_t i = 0;                               /* Element index */
+    const __m128d factor = _mm_set1_pd(scalar);  /* Scalar broadcast to every lane */
+
+    for (; i + 8 <= count; i += 8) {
+        _mm_storeu_pd(result + i, _mm_mul_pd(factor, _mm_loadu_pd(a + i)));
+        _mm_storeu_pd(result + i + 2, _mm_mul_pd(factor, _mm_loadu_pd(a + i + 2)));
+        _mm_storeu_pd(result + i + 4, _mm_mul_pd(factor, _mm_loadu_pd(a + i + 4)));
+        _mm_storeu_pd(result + i + 6, _mm_mul_pd(factor, _mm_loadu_pd(a + i + 6)));
+    }
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(result + i, _mm_mul_pd(factor, _mm_loadu_pd(a + i)));
+    }
+    for (; i < count; ++i) {
+        result[i] = scalar * a[i];
+    }
+}
+
+
+__attribute__((target("avx2")))
+static void scaleAvx2(const double *a, double scalar, double *result, size_t count) {
+    size_t i = 0;                                   /* Element index */
+    const __m256d factor = _mm256_set1_pd(scalar);   /* Scalar broadcast to every lane */
+
+    for (; i + 16 <= count; i += 16) {
+        _mm256_storeu_pd(result + i, _mm256_mul_pd(factor, _mm256_loadu_pd(a + i)));
+        _mm256_storeu_pd(result + i + 4, _mm256_mul_pd(factor, _mm256_loadu_pd(a + i + 4)));
+        _mm256_storeu_pd(result + i + 8, _mm256_mul_pd(factor, _mm256_loadu_pd(a + i + 8)));
+        _mm256_storeu_pd(result + i + 12, _mm256_mul_pd(factor, _mm256_loadu_pd(a + i + 12)));
+    }
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(result + i, _mm256_mul_pd(factor, _mm256_loadu_pd(a + i)));
+    }
+    for (; i < count; ++i) {
+        result[i] = scalar * a[i];
+    }
+}
+
+
+__attribute__((target("avx512f")))
+static void scaleAvx512(const double *a, double scalar, double *result, size_t count) {
+    size_t i = 0;                                   /* Element index */
+    const __m512d factor = _mm512_set1_pd(scalar);   /* Scalar broadcast to every lane */
+    __mmask8 mask;                                  /* Lanes still inside the array on the last iteration */
+
+    for (; i + 32 <= count; i += 32) {
+        _mm512_storeu_pd(result + i, _mm512_mul_pd(factor, _mm512_loadu_pd(a + i)));
+        _mm512_storeu_pd(result + i + 8, _mm512_mul_pd(factor, _mm512_loadu_pd(a + i + 8)));
+        _mm512_storeu_pd(result + i + 16, _mm512_mul_pd(factor, _mm512_loadu_pd(a + i + 16)));
+        _mm512_storeu_pd(result + i + 24, _mm512_mul_pd(factor, _mm512_loadu_pd(a + i + 24)));
+    }
+    for (; i + 8 <= count; i += 8) {
+        _mm512_storeu_pd(result + i, _mm512_mul_pd(factor, _mm512_loadu_pd(a + i)));
+    }
+    if (i < count) {
+        mask = (__mmask8)((1u << (count - i)) - 1u);
+        _mm512_mask_storeu_pd(result + i, mask, _mm512_mul_pd(factor, _mm512_maskz_loadu_pd(mask, a + i)));
+    }
+}
+
+
+
+__attribute__((target("sse2")))
+static void axpySse2(const double *a, double scalar, double *result, size_t count) {
+    size_t i = 0;                               /* Element index */
+    const __m128d factor = _mm_set1_pd(scalar);  /* Scalar broadcast to every lane */
+
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_pd(result + i, _mm_add_pd(_mm_loadu_pd(result + i), _mm_mul_pd(factor, _mm_loadu_pd(a + i))));
+        _mm_storeu_pd(result + i + 2,
+                      _mm_add_pd(_mm_loadu_pd(result + i + 2), _mm_mul_pd(factor, _mm_loadu_pd(a + i + 2))));
+    }
+    for (; i < count; ++i) {
+        result[i] += scalar * a[i];
+    }
+}
+
+
+__attribute__((target("avx2,fma")))
+static void axpyAvx2(const double *a, double scalar, double *result, size_t count) {
+    size_t i = 0;                                   /* Element index */
+    const __m256d factor = _mm256_set1_pd(scalar);   /* Scalar broadcast to every lane */
+
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_pd(result + i, _mm256_fmadd_pd(factor, _mm256_loadu_pd(a + i), _mm256_loadu_pd(result + i)));
+        _mm256_storeu_pd(result + i + 4,
+                         _mm256_fmadd_pd(factor, _mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(result + i + 4)));
+    }
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(result + i, _mm256_fmadd_pd(factor, _mm256_loadu_pd(a + i), _mm256_loadu_pd(result + i)));
+    }
+    for (; i < count; ++i) {
+        result[i] += scalar * a[i];
+    }
+}
+
+
+__attribute__((target("avx512f")))
+static void axpyAvx512(const double *a, double scalar, double *result, size_t count) {
+    size_t i = 0;                                   /* Element index */
+    const __m512d factor = _mm512_set1_pd(scalar);   /* Scalar broadcast to every lane */
+    __mmask8 mask;                                  /* Lanes still inside the array on the last iteration */
+
+    for (; i + 16 <= count; i += 16) {
+        _mm512_storeu_pd(result + i, _mm512_fmadd_pd(factor, _mm512_loadu_pd(a + i), _mm512_loadu_pd(result + i)));
+        _mm512_storeu_pd(result + i + 8,
+                         _mm512_fmadd_pd(factor, _mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(result + i + 8)));
+    }
+    for (; i + 8 <= count; i += 8) {
+        _mm512_storeu_pd(result + i, _mm512_fmadd_pd(factor, _mm512_loadu_pd(a + i), _mm512_loadu_pd(result + i)));
+    }
+    if (i < count) {
+        mask = (__mmask8)((1u << (count - i)) - 1u);
+        _mm512_mask_storeu_pd(result + i, mask,
+                              _mm512_fmadd_pd(factor, _mm512_maskz_loadu_pd(mask, a + i),
+                                              _mm512_maskz_loadu_pd(mask, result + i)));
+    }
+}
+
+
+
+__attribute__((target("sse2")))
+static void rotSse2(double *x, double *y, double c, double s, size_t count) {
+    size_t i = 0;                           /* Element index */
+    const __m128d cosine = _mm_set1_pd(c);   /* Cosine broadcast to every lane */
+    const __m128d sine = _mm_set1_pd(s);     /* Sine broadcast to every lane */
+    __m128d xv, yv;                         /* Elements of both rows before the rotation */
+    double value;                           /* Element of x before the rotation */
+
+    for (; i + 2 <= count; i += 2) {
+        xv = _mm_loadu_pd(x + i);
+        yv = _mm_loadu_pd(y + i);
+        _mm_storeu_pd(x + i, _mm_add_pd(_mm_mul_pd(cosine, xv), _mm_mul_pd(sine, yv)));
+        _mm_storeu_pd(y + i, _mm_sub_pd(_mm_mul_pd(cosine, yv), _mm_mul_pd(sine, xv)));
+    }
+    for (; i < count; ++i) {
+        value = x[i];
+        x[i] = c * value + s * y[i];
+        y[i] = c * y[i] - s * value;
+    }
+}
+
+
+__attribute__((target("avx2,fma")))
+static void rotAvx2(double *x, double *y, double c, double s, size_t count) {
+    size_t i = 0;                               /* Element index */
+    const __m256d cosine = _mm256_set1_pd(c);    /* Cosine broadcast to every lane */
+    const __m256d sine = _mm256_set1_pd(s);      /* Sine broadcast to every lane */
+    __m256d xv, yv;                             /* Elements of both rows before the rotation */
+    double value;                               /* Element of x before the rotation */
+
+    for (; i + 4 <= count; i += 4) {
+        xv = _mm256_loadu_pd(x + i);
+        yv = _mm256_loadu_pd(y + i);
+        _mm256_storeu_pd(x + i, _mm256_fmadd_pd(cosine, xv, _mm256_mul_pd(sine, yv)));
+        _mm256_storeu_pd(y + i, _mm256_fmsub_pd(cosine, yv, _mm256_mul_pd(sine, xv)));
+    }
+    for (; i < count; ++i) {
+        value = x[i];
+        x[i] = c * value + s * y[i];
+        y[i] = c * y[i] - s * value;
+    }
+}
+
+
+__attribute__((target("avx512f")))
+static void rotAvx512(double *x, double *y, double c, double s, size_t count) {
+    size_t i = 0;                               /* Element index */
+    const __m512d cosine = _mm512_set1_pd(c);    /* Cosine broadcast to every lane */
+    const __m512d sine = _mm512_set1_pd(s);      /* Sine broadcast to every lane */
+    __m512d xv, yv;                             /* Elements of both rows before the rotation */
+    __mmask8 mask;                              /* Lanes still inside the rows on the last iteration */
+
+    for (; i + 8 <= count; i += 8) {
+        xv = _mm512_loadu_pd(x + i);
+        yv = _mm512_loadu_pd(y + i);
+        _mm512_storeu_pd(x + i, _mm512_fmadd_pd(cosine, xv, _mm512_mul_pd(sine, yv)));
+        _mm512_storeu_pd(y + i, _mm512_fmsub_pd(cosine, yv, _mm512_mul_pd(sine, xv)));
+    }
+    if (i < count) {
+        mask = (__mmask8)((1u << (count - i)) - 1u);
+        xv = _mm512_maskz_loadu_pd(mask, x + i);
+        yv = _mm512_maskz_loadu_pd(mask, y + i);
+        _mm512_mask_storeu_pd(x + i, mask, _mm512_fmadd_pd(cosine, xv, _mm512_mul_pd(sine, yv)));
+        _mm512_mask_storeu_pd(y + i, mask, _mm512_fmsub_pd(cosine, yv, _mm512_mul_pd(sine, xv)));
+    }
+}
+
+#endif
+
+
+/* Kernel tables, indexed by SimdLevel; levels unavailable on this architecture fall back to scalar */
+static const SimdKernels kernelTables[NUM_SIMD_LEVELS] = {
+    {SIMD_SCALAR, "scalar", addScalar, subScalar, scaleScalar, axpyScalar, rotScalar},
+#if defined(__x86_64__) || defined(__i386__)
+    {SIMD_SSE2, "sse2", addSse2, subSse2, scaleSse2, axpySse2, rotSse2},
+    {SIMD_AVX2, "avx2", addAvx2, subAvx2, scaleAvx2, axpyAvx2, rotAvx2},
+    {SIMD_AVX512, "avx512", addAvx512, subAvx512, scaleAvx512, axpyAvx512, rotAvx512}
+#else
+    {SIMD_SCALAR, "scalar", addScalar, subScalar, scaleScalar, axpyScalar, rotScalar},
+    {SIMD_SCALAR, "scalar", addScalar, subScalar, scaleScalar, axpyScalar, rotScalar},
+    {SIMD_SCALAR, "scalar", addScalar, subScalar, scaleScalar, axpyScalar, rotScalar}
+#endif
+};
+
+/* Table selected by initSimdKernels, or NULL before the first selection */
+static const SimdKernels *selectedKernels = NULL;
+
+
+static SimdLevel detectSimdLevel(void) {
+    /*
+     * Short Description:
+     * Returns the widest level whose instructions the processor (and operating system) support.
+     */
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SIMD_SSE2;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+
+void initSimdKernels(void) {
+    SimdLevel level = detectSimdLevel();    /* Widest supported level */
+    const char *cap = getenv(SIMD_LEVEL_ENV); /* Optional user cap on the level */
+    int index;                              /* Index for iterating over the levels */
+
+    if (cap != NULL) {
+        for (index = 0; index < NUM_SIMD_LEVELS; index++) {
+            if (!strcmp(kernelTables[index].levelName, cap) && (SimdLevel)index < level) {
+                level = (SimdLevel)index;
+            }
+        }
+    }
+    selectedKernels = &kernelTables[level];
+}
+
+
+const SimdKernels *getSimdKernels(void) {
+    if (selectedKernels == NULL) {
+        initSimdKernels();
+    }
+    return selectedKernels;
+}
+
+
+SimdLevel getSimdLevel(void) {
+    return getSimdKernels()->level;
+}
@@ -0,0 +1,88 @@
+/*
+ * SIMD Element-wise Kernels Header
+ * --------------------------------
+ * This C header file declares the vectorized element-wise kernels implemented in "matsimd.c" and the
+ * runtime dispatch that selects them. Each kernel exists in a portable scalar version and in SSE2, AVX2
+ * and AVX-512 versions; the widest one the running processor supports is chosen once at startup.
+ *
+ * Structures and Enumerations:
+ * - SimdLevel:     Enumeration of the instruction set levels a kernel can be built for.
+ * - SimdKernels:   Table of element-wise kernels for one SimdLevel.
+ *
+ * Core Functions:
+ * - initSimdKernels:   Detects the processor features and selects the kernel table.
+ * - getSimdKernels:    Returns the selected kernel table.
+ * - getSimdLevel:      Returns the level of the selected kernel table.
+ *
+ * Note:
+ * The environment variable MATRIX_SIMD (scalar, sse2, avx2 or avx512) caps the selected level, which
+ * makes it possible to test and benchmark every variant on one machine. A level the processor does
+ * not support is never selected.
+ */
+
+#ifndef MATSIMD_H
+#define MATSIMD_H
+
+#include <stddef.h>
+
+/* Name of the environment variable that caps the selected SIMD level */
+#define SIMD_LEVEL_ENV "MATRIX_SIMD"
+
+/* Enumeration of the instruction set levels, from narrowest to widest */
+typedef enum {
+    SIMD_SCALAR,    /* Plain C, one element at a time */
+    SIMD_SSE2,      /* 128-bit vectors, two doubles */
+    SIMD_AVX2,      /* 256-bit vectors, four doubles, with FMA */
+    SIMD_AVX512,    /* 512-bit vectors, eight doubles, masked remainders */
+    NUM_SIMD_LEVELS /* Sentinel value for the number of levels */
+} SimdLevel;
+
+/* Table of element-wise kernels; every kernel handles any length, including the remainder */
+typedef struct {
+    SimdLevel level;        /* Instruction set the kernels are built for */
+    const char *levelName;  /* Printable name of the level */
+    /* result[i] = a[i] + b[i] for i < count */
+    void (*add)(const double *a, const double *b, double *result, size_t count);
+    /* result[i] = a[i] - b[i] for i < count */
+    void (*sub)(const double *a, const double *b, double *result, size_t count);
+    /* result[i] = scalar * a[i] for i < count */
+    void (*scale)(const double *a, double scalar, double *result, size_t count);
+    /* result[i] += scalar * a[i] for i < count, fused where the level has FMA */
+    void (*axpy)(const double *a, double scalar, double *result, size_t count);
+    /* (x[i], y[i]) = (c x[i] + s y[i], c y[i] - s x[i]) for i < count, a plane rotation of two rows */
+    void (*rot)(double *x, double *y, double c, double s, size_t count);
+} SimdKernels;
+
+
+/*
+ * Function: initSimdKernels
+ * Purpose: Selects the widest kernel table supported by the processor.
+ * Detailed Description:
+ *   Queries the processor features through cpuid, applies the cap given in the MATRIX_SIMD
+ *   environment variable, and records the chosen table. Calling it again re-runs the selection.
+ *
+ * Returns: None (void function).
+ */
+void initSimdKernels(void);
+
+
+/*
+ * Function: getSimdKernels
+ * Purpose: Returns the selected kernel table, selecting it first if 'initSimdKernels' was not called.
+ *
+ * Returns:
+ *   Pointer to the kernel table; never NULL.
+ */
+const SimdKernels *getSimdKernels(void);
+
+
+/*
+ * Function: getSimdLevel
+ * Purpose: Returns the instruction set level of the selected kernel table.
+ *
+ * Returns:
+ *   The selected SimdLevel.
+ */
+SimdLevel getSimdLevel(void);
+
+#endif /* MATSIMD_H */
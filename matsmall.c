@@ -0,0 +1,222 @@
+/*
+ * Small Matrix Kernels
+ * --------------------
+ * This C source file implements the size-specialized kernels declared in "matsmall.h".
+ *
+ * Core Functionalities:
+ * 1.   DEFINE_SMALL_KERNELS:       Generates multiply, add, sub and transpose for one dimension. The loop
+ *                                  bounds are the dimension itself and every loop carries an unroll pragma,
+ *                                  so the generated functions are straight-line code the compiler can
+ *                                  vectorize across a row.
+ * 2.   determinantSmall2/3/4:      Closed-form determinants (cofactor expansion; 2x2 minors for 4x4).
+ * 3.   DEFINE_SMALL_DETERMINANT:   Generates a fixed-size Gaussian elimination with partial pivoting,
+ *                                  used for 6x6 and 8x8 where cofactor expansion would cost too much.
+ * 4.   getSmallKernels:            Dispatch table indexed by dimension.
+ *
+ * Products accumulate one row of the result in a local array starting from zero, in the same i-k-j
+ * order as the direct loop of the GEMM engine, so they round exactly like it does (signed zeros included).
+ */
+
+#include <stddef.h>
+#include "matsmall.h"
+
+
+/* Fully unroll the following loop; every loop here has at most SMALL_MAX_DIM iterations */
+#define SMALL_UNROLL _Pragma("GCC unroll 8")
+
+/* Absolute value of a double without a call to the math library */
+#define SMALL_ABS(x) ((x) < 0.0 ? -(x) : (x))
+
+
+/*
+ * Defines the multiply, add, sub and transpose kernels for N x N matrices.
+ */
+#define DEFINE_SMALL_KERNELS(N)                                                         \
+static void multiplySmall##N(const double *a, int lda, const double *b, int ldb, double *c, int ldc) { \
+    double row[N];          /* Row of the product being accumulated */                  \
+    int i, j, k;            /* Row, column and inner indices */                         \
+    SMALL_UNROLL                                                                        \
+    for (i = 0; i < N; ++i) {                                                           \
+        SMALL_UNROLL                                                                    \
+        for (j = 0; j < N; ++j) {                                                       \
+            row[j] = 0.0;                                                               \
+        }                                                                               \
+        SMALL_UNROLL                                                                    \
+        for (k = 0; k < N; ++k) {                                                       \
+            SMALL_UNROLL                                                                \
+            for (j = 0; j < N; ++j) {                                                   \
+                row[j] += a[(size_t)i * lda + k] * b[(size_t)k * ldb + j];              \
+            }                                                                           \
+        }                                                                               \
+        SMALL_UNROLL                                                                    \
+        for (j = 0; j < N; ++j) {                                                       \
+            c[(size_t)i * ldc + j] = row[j];                                            \
+        }                                                                               \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static void addSmall##N(const double *a, int lda, const double *b, int ldb, double *c, int ldc) { \
+    double row[N];          /* Row of the result, stored once both operand rows are read */ \
+    int i, j;               /* Row and column indices */                                \
+    SMALL_UNROLL                                                                        \
+    for (i = 0; i < N; ++i) {                                                           \
+        SMALL_UNROLL                                                                    \
+        for (j = 0; j < N; ++j) {                                                       \
+            row[j] = a[(size_t)i * lda + j] + b[(size_t)i * ldb + j];                 \
+        }                                                                               \
+        SMALL_UNROLL                                                                    \
+        for (j = 0; j < N; ++j) {                                                       \
+            c[(size_t)i * ldc + j] = row[j];                                            \
+        }                                                                               \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static void subSmall##N(const double *a, int lda, const double *b, int ldb, double *c, int ldc) { \
+    double row[N];          /* Row of the result, stored once both operand rows are read */ \
+    int i, j;               /* Row and column indices */                                \
+    SMALL_UNROLL                                                                        \
+    for (i = 0; i < N; ++i) {                                                           \
+        SMALL_UNROLL                                                                    \
+        for (j = 0; j < N; ++j) {                                                       \
+            row[j] = a[(size_t)i * lda + j] - b[(size_t)i * ldb + j];                 \
+        }                                                                               \
+        SMALL_UNROLL                                                                    \
+        for (j = 0; j < N; ++j) {                                                       \
+            c[(size_t)i * ldc + j] = row[j];                                            \
+        }                                                                               \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static void transposeSmall##N(const double *a, int lda, double *c, int ldc) {           \
+    int i, j;               /* Row and column indices */                                \
+    SMALL_UNROLL                                                                        \
+    for (i = 0; i < N; ++i) {                                                           \
+        SMALL_UNROLL                                                                    \
+        for (j = 0; j < N; ++j) {                                                       \
+            c[(size_t)j * ldc + i] = a[(size_t)i * lda + j];                            \
+        }                                                                               \
+    }                                                                                   \
+}
+
+
+/*
+ * Defines a determinant kernel for N x N matrices by Gaussian elimination with partial pivoting
+ * on a local copy.
+ */
+#define DEFINE_SMALL_DETERMINANT(N)                                                     \
+static double determinantSmall##N(const double *a, int lda) {                           \
+    double m[N][N];         /* Working copy, reduced to upper triangular form */        \
+    double det = 1.0;       /* Product of the pivots, with the sign of the row swaps */ \
+    double factor, temp;    /* Elimination factor and swap temporary */                 \
+    int i, j, k, pivot;     /* Row, column, step and pivot row indices */               \
+    SMALL_UNROLL                                                                        \
+    for (i = 0; i < N; ++i) {                                                           \
+        SMALL_UNROLL                                                                    \
+        for (j = 0; j < N; ++j) {                                                       \
+            m[i][j] = a[(size_t)i * lda + j];                                           \
+        }                                                                               \
+    }                                                                                   \
+    for (k = 0; k < N; ++k) {                                                           \
+        pivot = k;                                                                      \
+        for (i = k + 1; i < N; ++i) {                                                   \
+            if (SMALL_ABS(m[i][k]) > SMALL_ABS(m[pivot][k])) {                          \
+                pivot = i;                                                              \
+            }                                                                           \
+        }                                                                               \
+        if (m[pivot][k] == 0.0) {                                                       \
+            return 0.0;                                                                 \
+        }                                                                               \
+        if (pivot != k) {                                                               \
+            SMALL_UNROLL                                                                \
+            for (j = 0; j < N; ++j) {                                                   \
+                temp = m[k][j];                                                         \
+                m[k][j] = m[pivot][j];                                                  \
+                m[pivot][j] = temp;                                                     \
+            }                                                                           \
+            det = -det;                                                                 \
+        }                                                                               \
+        det *= m[k][k];                                                                 \
+        for (i = k + 1; i < N; ++i) {                                                   \
+            factor = m[i][k] / m[k][k];                                                 \
+            for (j = k + 1; j < N; ++j) {                                               \
+                m[i][j] -= factor * m[k][j];                                            \
+            }                                                                           \
+        }                                                                               \
+    }                                                                                   \
+    return det;                                                                         \
+}
+
+
+DEFINE_SMALL_KERNELS(2)
+DEFINE_SMALL_KERNELS(3)
+DEFINE_SMALL_KERNELS(4)
+DEFINE_SMALL_KERNELS(6)
+DEFINE_SMALL_KERNELS(8)
+
+DEFINE_SMALL_DETERMINANT(6)
+DEFINE_SMALL_DETERMINANT(8)
+
+
+/* Element (row, col) of the operand of a determinant kernel */
+#define DET_AT(row, col) a[(size_t)(row) * lda + (col)]
+
+
+static double determinantSmall2(const double *a, int lda) {
+    return DET_AT(0, 0) * DET_AT(1, 1) - DET_AT(0, 1) * DET_AT(1, 0);
+}
+
+
+static double determinantSmall3(const double *a, int lda) {
+    /*
+     * Short Description:
+     * Cofactor expansion along the first row.
+     */
+    return DET_AT(0, 0) * (DET_AT(1, 1) * DET_AT(2, 2) - DET_AT(1, 2) * DET_AT(2, 1))
+         - DET_AT(0, 1) * (DET_AT(1, 0) * DET_AT(2, 2) - DET_AT(1, 2) * DET_AT(2, 0))
+         + DET_AT(0, 2) * (DET_AT(1, 0) * DET_AT(2, 1) - DET_AT(1, 1) * DET_AT(2, 0));
+}
+
+
+static double determinantSmall4(const double *a, int lda) {
+    /*
+     * Short Description:
+     * Laplace expansion along the first two rows: the sum of the products of the complementary
+     * 2x2 minors of rows 0-1 and rows 2-3, twelve minors in all.
+     */
+    double s0 = DET_AT(0, 0) * DET_AT(1, 1) - DET_AT(1, 0) * DET_AT(0, 1);  /* Minors of rows 0-1 */
+    double s1 = DET_AT(0, 0) * DET_AT(1, 2) - DET_AT(1, 0) * DET_AT(0, 2);
+    double s2 = DET_AT(0, 0) * DET_AT(1, 3) - DET_AT(1, 0) * DET_AT(0, 3);
+    double s3 = DET_AT(0, 1) * DET_AT(1, 2) - DET_AT(1, 1) * DET_AT(0, 2);
+    double s4 = DET_AT(0, 1) * DET_AT(1, 3) - DET_AT(1, 1) * DET_AT(0, 3);
+    double s5 = DET_AT(0, 2) * DET_AT(1, 3) - DET_AT(1, 2) * DET_AT(0, 3);
+    double c5 = DET_AT(2, 2) * DET_AT(3, 3) - DET_AT(3, 2) * DET_AT(2, 3);  /* Minors of rows 2-3 */
+    double c4 = DET_AT(2, 1) * DET_AT(3, 3) - DET_AT(3, 1) * DET_AT(2, 3);
+    double c3 = DET_AT(2, 1) * DET_AT(3, 2) - DET_AT(3, 1) * DET_AT(2, 2);
+    double c2 = DET_AT(2, 0) * DET_AT(3, 3) - DET_AT(3, 0) * DET_AT(2, 3);
+    double c1 = DET_AT(2, 0) * DET_AT(3, 2) - DET_AT(3, 0) * DET_AT(2, 2);
+    double c0 = DET_AT(2, 0) * DET_AT(3, 1) - DET_AT(3, 0) * DET_AT(2, 1);
+
+    return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+}
+
+
+/* Kernels indexed by dimension; a zero 'dim' marks a dimension without specialization */
+static const SmallKernels smallKernelTable[SMALL_MAX_DIM + 1] = {
+    {0, NULL, NULL, NULL, NULL, NULL},
+    {0, NULL, NULL, NULL, NULL, NULL},
+    {2, multiplySmall2, addSmall2, subSmall2, transposeSmall2, determinantSmall2},
+    {3, multiplySmall3, addSmall3, subSmall3, transposeSmall3, determinantSmall3},
+    {4, multiplySmall4, addSmall4, subSmall4, transposeSmall4, determinantSmall4},
+    {0, NULL, NULL, NULL, NULL, NULL},
+    {6, multiplySmall6, addSmall6, subSmall6, transposeSmall6, determinantSmall6},
+    {0, NULL, NULL, NULL, NULL, NULL},
+    {8, multiplySmall8, addSmall8, subSmall8, transposeSmall8, determinantSmall8}
+};
+
+
+const SmallKernels *getSmallKernels(int rows, int cols) {
+    if (rows != cols || rows < 0 || rows > SMALL_MAX_DIM || smallKernelTable[rows].dim == 0) {
+        return NULL;
+    }
+    return &smallKernelTable[rows];
+}
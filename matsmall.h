@@ -0,0 +1,53 @@
+/*
+ * Small Matrix Kernels Header
+ * ---------------------------
+ * This C header file declares the size-specialized kernels implemented in "matsmall.c". For the square
+ * shapes that dominate interactive use (2x2, 3x3, 4x4, 6x6 and 8x8) every operation has a version whose
+ * loop bounds are compile-time constants and whose loops are fully unrolled, so a small operation costs
+ * a handful of instructions instead of the setup of the general engines.
+ *
+ * Core Functions:
+ * - getSmallKernels:   Looks up the kernels specialized for a shape in the dispatch table.
+ *
+ * Note:
+ * All kernels work on row-major buffers with leading dimensions. The 'multiply' and 'transpose'
+ * kernels write a result that must not overlap their operands; 'add' and 'sub' allow any aliasing.
+ */
+
+#ifndef MATSMALL_H
+#define MATSMALL_H
+
+/* Largest dimension with specialized kernels */
+#define SMALL_MAX_DIM 8
+
+/* Table of the kernels specialized for one square dimension */
+typedef struct {
+    int dim;    /* Dimension the kernels are specialized for */
+    /* c = a * b */
+    void (*multiply)(const double *a, int lda, const double *b, int ldb, double *c, int ldc);
+    /* c = a + b */
+    void (*add)(const double *a, int lda, const double *b, int ldb, double *c, int ldc);
+    /* c = a - b */
+    void (*sub)(const double *a, int lda, const double *b, int ldb, double *c, int ldc);
+    /* c = transpose(a) */
+    void (*transpose)(const double *a, int lda, double *c, int ldc);
+    /* Returns det(a) */
+    double (*determinant)(const double *a, int lda);
+} SmallKernels;
+
+
+/*
+ * Function: getSmallKernels
+ * Purpose: Returns the kernels specialized for a rows x cols shape.
+ * Detailed Description:
+ *   The table is indexed directly by the dimension, so the lookup costs one comparison and one load.
+ *
+ * Parameters:
+ *   rows, cols - Shape of the operands.
+ *
+ * Returns:
+ *   Pointer to the kernel table, or NULL if the shape has no specialization.
+ */
+const SmallKernels *getSmallKernels(int rows, int cols);
+
+#endif /* MATSMALL_H */
@@ -0,0 +1,704 @@
+/*
+ * Sparse Matrices
+ * ---------------
+ * This C source file implements the sparse matrices declared in "matsparse.h".
+ *
+ * Core Functionalities:
+ * 1.   Storage:            Row offsets, columns and values (CSR), built from dense values in one pass or from
+ *                          COO triples by a counting sort on the rows and two transposes.
+ * 2.   Element-wise:       Sums and differences merge the sorted rows of both operands; a dense operand gets
+ *                          the stored elements added to its rows.
+ * 3.   Products:           Sparse x dense adds, with the SIMD axpy kernel, the row of the dense operand picked
+ *                          by every stored element; dense x sparse adds the picked rows of the sparse operand.
+ *                          Both split the rows of the result across the thread pool.
+ * 4.   SpGEMM:             Gustavson's algorithm in two passes over the thread pool: the first counts the
+ *                          columns of every row of the product, the second accumulates the row in a dense
+ *                          per-thread buffer and writes the touched columns in order.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "matsparse.h"
+#include "matdisk.h"
+#include "matpool.h"
+#include "matsimd.h"
+
+
+/* A row of a product reaching more than 1/SPGEMM_SCAN_RATIO of the columns is written by scanning the
+   marks of every column, which is cheaper than sorting the columns reached */
+#define SPGEMM_SCAN_RATIO 16
+
+/* Elements of a sparse matrix in compressed sparse row form */
+struct SparseStore {
+    int rows;           /* Number of rows */
+    size_t *rowStart;   /* Index in 'columns' and 'values' of the first element of every row, then the count */
+    int *columns;       /* Column of every element, increasing within a row */
+    double *values;     /* Value of every element */
+};
+
+/* Per-thread buffers of the product of two sparse matrices */
+typedef struct {
+    int *marks;             /* Last row of the product that touched every column, or -1 */
+    double *sums;           /* Sum accumulated in every touched column */
+    int *touched;           /* Columns touched by the current row, in the order they were reached */
+} SpgemmScratch;
+
+/* Operands of the product of two sparse matrices */
+typedef struct {
+    const struct SparseStore *left;     /* Elements of the left operand */
+    const struct SparseStore *right;    /* Elements of the right operand */
+    struct SparseStore *product;        /* Elements of the product: row counts, then the elements */
+    SpgemmScratch *scratch;             /* Buffers of every thread */
+    int cols;                           /* Number of columns of the product */
+    bool numeric;                       /* false while counting, true while computing */
+} SpgemmTask;
+
+/* Operands of an operation producing a dense matrix, split across the thread pool by rows */
+typedef struct {
+    const Matrix *sparse;   /* Sparse operand */
+    const Matrix *dense;    /* Dense operand */
+    Matrix *result;         /* Dense result */
+    double sparseFactor;    /* Factor of the sparse operand of a sum */
+    double denseFactor;     /* Factor of the dense operand of a sum */
+} SparseTask;
+
+
+static double sparseThreshold = DEFAULT_SPARSE_THRESHOLD;   /* Largest density of a sparse matrix */
+
+
+static struct SparseStore *allocStore(int rows, size_t capacity) {
+    /*
+     * Short Description:
+     * Allocates the elements of a matrix of 'rows' rows with room for 'capacity' elements; the first row
+     * offset is set to 0. Returns NULL if an allocation fails.
+     */
+    struct SparseStore *store = malloc(sizeof(*store));    /* The new elements */
+
+    if (store == NULL) {
+        return NULL;
+    }
+    store->rows = rows;
+    store->rowStart = malloc(((size_t)rows + 1) * sizeof(size_t));
+    store->columns = malloc((capacity > 0 ? capacity : 1) * sizeof(int));
+    store->values = malloc((capacity > 0 ? capacity : 1) * sizeof(double));
+    if (store->rowStart == NULL || store->columns == NULL || store->values == NULL) {
+        freeSparseStore(store);
+        return NULL;
+    }
+    store->rowStart[0] = 0;
+    return store;
+}
+
+
+static void compactStore(struct SparseStore *store) {
+    /*
+     * Short Description:
+     * Adds up the values of repeated columns within a row and drops the elements that are zero, in place.
+     * The columns of every row must be sorted.
+     */
+    size_t start = 0;       /* First element of the current row before compaction */
+    size_t end;             /* Element after the current row before compaction */
+    size_t kept = 0;        /* Elements kept so far */
+    size_t index;           /* Variable for iterating over the elements of a row */
+    int row;                /* Variable for iterating over the rows */
+    int column;             /* Column of the element being summed */
+    double sum;             /* Sum of the values of that column */
+
+    for (row = 0; row < store->rows; ++row) {
+        end = store->rowStart[row + 1];
+        store->rowStart[row] = kept;
+        index = start;
+        while (index < end) {
+            column = store->columns[index];
+            sum = store->values[index++];
+            while (index < end && store->columns[index] == column) {
+                sum += store->values[index++];
+            }
+            if (sum != 0.0) {
+                store->columns[kept] = column;
+                store->values[kept++] = sum;
+            }
+        }
+        start = end;
+    }
+    store->rowStart[store->rows] = kept;
+}
+
+
+static MatrixStatus transposeStore(const struct SparseStore *store, int cols, struct SparseStore **result) {
+    /*
+     * Short Description:
+     * Builds the elements of the transpose: counts the elements of every column, then visits the rows in
+     * order and appends each element to its column, so the rows of the result come out sorted.
+     */
+    size_t count = store->rowStart[store->rows];   /* Number of elements */
+    struct SparseStore *transposed;                 /* Elements of the transpose */
+    size_t *next;                                   /* Next free position of every row of the transpose */
+    size_t index;                                   /* Variable for iterating over the elements */
+    size_t position;                                /* Position of an element in the transpose */
+    int row, column;                                /* Variables for iterating over rows and columns */
+
+    transposed = allocStore(cols, count);
+    next = malloc(((size_t)cols + 1) * sizeof(size_t));
+    if (transposed == NULL || next == NULL) {
+        freeSparseStore(transposed);
+        free(next);
+        return MATRIX_ALLOCATION_FAILED;
+    }
+
+    memset(next, 0, ((size_t)cols + 1) * sizeof(size_t));
+    for (index = 0; index < count; ++index) {
+        next[store->columns[index] + 1]++;
+    }
+    for (column = 0; column < cols; ++column) {
+        next[column + 1] += next[column];
+    }
+    memcpy(transposed->rowStart, next, ((size_t)cols + 1) * sizeof(size_t));
+
+    for (row = 0; row < store->rows; ++row) {
+        for (index = store->rowStart[row]; index < store->rowStart[row + 1]; ++index) {
+            position = next[store->columns[index]]++;
+            transposed->columns[position] = row;
+            transposed->values[position] = store->values[index];
+        }
+    }
+    free(next);
+    *result = transposed;
+    return MATRIX_OK;
+}
+
+
+static bool isIndex(double value, int limit) {
+    /*
+     * Short Description:
+     * Tells whether a value read from a triple is a whole number in [0, limit).
+     */
+    return value >= 0.0 && value < (double)limit && (double)(int)value == value;
+}
+
+
+void setSparseThreshold(double density) {
+    sparseThreshold = density;
+}
+
+
+bool shouldStoreSparse(int rows, int cols, size_t nonzeros) {
+    double elements = (double)rows * (double)cols;     /* Number of elements of the matrix */
+
+    return sparseThreshold > 0.0 && elements >= (double)SPARSE_MIN_ELEMENTS &&
+           (double)nonzeros <= sparseThreshold * elements;
+}
+
+
+bool isSparseArray(int rows, int cols, const double *values, size_t count) {
+    size_t elements = (size_t)rows * (size_t)cols;     /* Number of elements of the matrix */
+    size_t limit;               /* Most non-zero values of a sparse matrix */
+    size_t nonzeros = 0;        /* Non-zero values seen so far */
+    size_t index;               /* Variable for iterating over the values */
+
+    if (!shouldStoreSparse(rows, cols, 0)) {
+        return false;
+    }
+    limit = (size_t)(sparseThreshold * (double)elements);
+    count = (count < elements) ? count : elements;
+    for (index = 0; index < count; ++index) {
+        if (values[index] != 0.0 && ++nonzeros > limit) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+MatrixStatus packSparse(int rows, int cols, const double *values, size_t count, struct SparseStore **store) {
+    size_t elements = (size_t)rows * (size_t)cols;     /* Number of elements of the matrix */
+    size_t nonzeros = 0;        /* Non-zero values */
+    size_t index;               /* Variable for iterating over the values */
+    size_t kept = 0;            /* Elements stored so far */
+    int row, column;            /* Variables for iterating over rows and columns */
+    struct SparseStore *packed; /* Elements of the matrix */
+
+    count = (count < elements) ? count : elements;
+    for (index = 0; index < count; ++index) {
+        nonzeros += (values[index] != 0.0);
+    }
+    packed = allocStore(rows, nonzeros);
+    if (packed == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+
+    index = 0;
+    for (row = 0; row < rows; ++row) {
+        for (column = 0; column < cols && index < count; ++column, ++index) {
+            if (values[index] != 0.0) {
+                packed->columns[kept] = column;
+                packed->values[kept++] = values[index];
+            }
+        }
+        packed->rowStart[row + 1] = kept;
+    }
+    *store = packed;
+    return MATRIX_OK;
+}
+
+
+MatrixStatus buildSparse(int rows, int cols, const double *triples, size_t count, struct SparseStore **store) {
+    size_t entries = count / 3;         /* Number of triples */
+    struct SparseStore *byRow;          /* Elements sorted by row only */
+    struct SparseStore *byColumn;       /* Their transpose */
+    size_t *next;                       /* Next free position of every row */
+    size_t entry;                       /* Variable for iterating over the triples */
+    size_t position;                    /* Position of an element in 'byRow' */
+    int row;                            /* Variable for iterating over the rows */
+    MatrixStatus status;
+
+    if (count % 3 != 0) {
+        return MATRIX_INVALID_ENTRY;
+    }
+    for (entry = 0; entry < entries; ++entry) {
+        if (!isIndex(triples[3 * entry], rows) || !isIndex(triples[3 * entry + 1], cols)) {
+            return MATRIX_INVALID_ENTRY;
+        }
+    }
+
+    /* Counting sort on the rows, keeping the order of the triples within a row */
+    byRow = allocStore(rows, entries);
+    next = malloc(((size_t)rows + 1) * sizeof(size_t));
+    if (byRow == NULL || next == NULL) {
+        freeSparseStore(byRow);
+        free(next);
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    memset(next, 0, ((size_t)rows + 1) * sizeof(size_t));
+    for (entry = 0; entry < entries; ++entry) {
+        next[(int)triples[3 * entry] + 1]++;
+    }
+    for (row = 0; row < rows; ++row) {
+        next[row + 1] += next[row];
+    }
+    memcpy(byRow->rowStart, next, ((size_t)rows + 1) * sizeof(size_t));
+    for (entry = 0; entry < entries; ++entry) {
+        position = next[(int)triples[3 * entry]]++;
+        byRow->columns[position] = (int)triples[3 * entry + 1];
+        byRow->values[position] = triples[3 * entry + 2];
+    }
+    free(next);
+
+    /* Transposing twice sorts every row by column; repeated coordinates end up next to each other */
+    status = transposeStore(byRow, cols, &byColumn);
+    freeSparseStore(byRow);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    status = transposeStore(byColumn, rows, store);
+    freeSparseStore(byColumn);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    compactStore(*store);
+    return MATRIX_OK;
+}
+
+
+void freeSparseStore(struct SparseStore *store) {
+    if (store == NULL) {
+        return;
+    }
+    free(store->rowStart);
+    free(store->columns);
+    free(store->values);
+    free(store);
+}
+
+
+size_t countStored(const struct SparseStore *store) {
+    return store->rowStart[store->rows];
+}
+
+
+void expandSparseRow(const Matrix *mat, int row, double *buffer) {
+    const struct SparseStore *store = mat->sparse;     /* Elements of the matrix */
+    size_t index;       /* Variable for iterating over the elements of the row */
+
+    memset(buffer, 0, (size_t)mat->cols * sizeof(double));
+    for (index = store->rowStart[row]; index < store->rowStart[row + 1]; ++index) {
+        buffer[store->columns[index]] = store->values[index];
+    }
+}
+
+
+MatrixStatus expandSparse(const Matrix *mat, Matrix *dense) {
+    double *buffer;     /* Row of a disk matrix */
+    int row;            /* Variable for iterating over the rows */
+    MatrixStatus status = MATRIX_OK;
+
+    if (dense->disk == NULL) {
+        for (row = 0; row < mat->rows; ++row) {
+            expandSparseRow(mat, row, &MATRIX_AT(dense, row, 0));
+        }
+        return MATRIX_OK;
+    }
+
+    buffer = allocElements((size_t)mat->cols);
+    if (buffer == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    for (row = 0; row < mat->rows && status == MATRIX_OK; ++row) {
+        expandSparseRow(mat, row, buffer);
+        status = writeTiledRow(dense, row, buffer);
+    }
+    free(buffer);
+    return status;
+}
+
+
+MatrixStatus scaleSparse(const Matrix *mat, double scalar, struct SparseStore **store) {
+    const struct SparseStore *source = mat->sparse;    /* Elements of the operand */
+    size_t count = (scalar != 0.0) ? countStored(source) : 0;  /* Elements of the result */
+    struct SparseStore *scaled;                         /* Elements of the result */
+    size_t index;                                       /* Variable for iterating over the elements */
+
+    scaled = allocStore(mat->rows, count);
+    if (scaled == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    if (count == 0) {
+        memset(scaled->rowStart, 0, ((size_t)mat->rows + 1) * sizeof(size_t));
+        *store = scaled;
+        return MATRIX_OK;
+    }
+    memcpy(scaled->rowStart, source->rowStart, ((size_t)mat->rows + 1) * sizeof(size_t));
+    memcpy(scaled->columns, source->columns, count * sizeof(int));
+    for (index = 0; index < count; ++index) {
+        scaled->values[index] = scalar * source->values[index];
+    }
+    if (scalar != 1.0) {
+        compactStore(scaled);   /* Products that underflow to zero */
+    }
+    *store = scaled;
+    return MATRIX_OK;
+}
+
+
+MatrixStatus transposeSparse(const Matrix *mat, struct SparseStore **store) {
+    return transposeStore(mat->sparse, mat->cols, store);
+}
+
+
+MatrixStatus addSparse(const Matrix *mat1, const Matrix *mat2, double factor, struct SparseStore **store) {
+    const struct SparseStore *left = mat1->sparse;     /* Elements of the first operand */
+    const struct SparseStore *right = mat2->sparse;    /* Elements of the second operand */
+    struct SparseStore *sum;        /* Elements of the result */
+    size_t i, iEnd, j, jEnd;        /* Positions in the current row of each operand, and their ends */
+    size_t kept = 0;                /* Elements stored so far */
+    int row;                        /* Variable for iterating over the rows */
+    int column;                     /* Column of the next element of the result */
+    double value;                   /* Its value */
+
+    sum = allocStore(mat1->rows, countStored(left) + countStored(right));
+    if (sum == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+
+    for (row = 0; row < mat1->rows; ++row) {
+        i = left->rowStart[row];
+        iEnd = left->rowStart[row + 1];
+        j = right->rowStart[row];
+        jEnd = right->rowStart[row + 1];
+        while (i < iEnd || j < jEnd) {
+            if (j == jEnd || (i < iEnd && left->columns[i] < right->columns[j])) {
+                column = left->columns[i];
+                value = left->values[i++];
+            } else if (i == iEnd || right->columns[j] < left->columns[i]) {
+                column = right->columns[j];
+                value = factor * right->values[j++];
+            } else {
+                column = left->columns[i];
+                value = left->values[i++] + factor * right->values[j++];
+            }
+            if (value != 0.0) {
+                sum->columns[kept] = column;
+                sum->values[kept++] = value;
+            }
+        }
+        sum->rowStart[row + 1] = kept;
+    }
+    *store = sum;
+    return MATRIX_OK;
+}
+
+
+static void runAddSparseDense(size_t begin, size_t end, int worker, void *arg) {
+    /*
+     * Short Description:
+     * Writes rows [begin, end) of the scaled dense operand to the result and adds the stored elements.
+     */
+    const SparseTask *task = arg;
+    const struct SparseStore *store = task->sparse->sparse;    /* Elements of the sparse operand */
+    double zero = task->sparseFactor * 0.0;     /* Element of the sparse operand that is not stored */
+    size_t cols = (size_t)task->result->cols;   /* Elements per row */
+    size_t row;                                 /* Variable for iterating over the rows */
+    size_t column;                              /* Variable for iterating over the columns */
+    size_t index;                               /* Variable for iterating over the elements of a row */
+    const double *source;                       /* Row of the dense operand */
+    double *target;                             /* Row of the result */
+    (void)worker;
+
+    for (row = begin; row < end; ++row) {
+        /* Adding the signed zero of the missing elements gives the signs of zero a dense sum would */
+        source = &MATRIX_AT(task->dense, row, 0);
+        target = &MATRIX_AT(task->result, row, 0);
+        for (column = 0; column < cols; ++column) {
+            target[column] = task->denseFactor * source[column] + zero;
+        }
+        for (index = store->rowStart[row]; index < store->rowStart[row + 1]; ++index) {
+            target[store->columns[index]] += task->sparseFactor * store->values[index];
+        }
+    }
+}
+
+
+void addSparseDense(const Matrix *sparse, double sparseFactor, const Matrix *dense, double denseFactor,
+                    Matrix *result) {
+    SparseTask task;
+
+    task.sparse = sparse;
+    task.dense = dense;
+    task.result = result;
+    task.sparseFactor = sparseFactor;
+    task.denseFactor = denseFactor;
+    parallelFor((size_t)result->rows, PARALLEL_MIN_ELEMENTS / (size_t)result->cols + 1, runAddSparseDense, &task);
+}
+
+
+static void runSparseDense(size_t begin, size_t end, int worker, void *arg) {
+    /*
+     * Short Description:
+     * Computes rows [begin, end) of sparse * dense: each stored element (row, k) adds its multiple of row k
+     * of the dense operand. A single column is a dot product with the stored elements (SpMV).
+     */
+    const SparseTask *task = arg;
+    const struct SparseStore *store = task->sparse->sparse;    /* Elements of the sparse operand */
+    size_t cols = (size_t)task->result->cols;   /* Elements per row of the result */
+    size_t row;                                 /* Variable for iterating over the rows */
+    size_t index;                               /* Variable for iterating over the elements of a row */
+    double *target;                             /* Row of the result */
+    double sum;                                 /* Element of a single-column result */
+    (void)worker;
+
+    for (row = begin; row < end; ++row) {
+        target = &MATRIX_AT(task->result, row, 0);
+        if (cols == 1) {
+            sum = 0.0;
+            for (index = store->rowStart[row]; index < store->rowStart[row + 1]; ++index) {
+                sum += store->values[index] * MATRIX_AT(task->dense, store->columns[index], 0);
+            }
+            *target = sum;
+            continue;
+        }
+        memset(target, 0, cols * sizeof(double));
+        for (index = store->rowStart[row]; index < store->rowStart[row + 1]; ++index) {
+            getSimdKernels()->axpy(&MATRIX_AT(task->dense, store->columns[index], 0), store->values[index],
+                                   target, cols);
+        }
+    }
+}
+
+
+void multiplySparseDense(const Matrix *sparse, const Matrix *dense, Matrix *result) {
+    SparseTask task;
+    size_t work;        /* Multiply-adds of an average row of the result, at least one */
+
+    task.sparse = sparse;
+    task.dense = dense;
+    task.result = result;
+    task.sparseFactor = 1.0;
+    task.denseFactor = 1.0;
+    work = (countStored(sparse->sparse) / (size_t)sparse->rows + 1) * (size_t)result->cols;
+    parallelFor((size_t)result->rows, PARALLEL_MIN_ELEMENTS / work + 1, runSparseDense, &task);
+}
+
+
+static void runDenseSparse(size_t begin, size_t end, int worker, void *arg) {
+    /*
+     * Short Description:
+     * Computes rows [begin, end) of dense * sparse: each non-zero element (row, k) of the dense operand
+     * adds its multiple of the stored elements of row k of the sparse operand.
+     */
+    const SparseTask *task = arg;
+    const struct SparseStore *store = task->sparse->sparse;    /* Elements of the sparse operand */
+    size_t row;             /* Variable for iterating over the rows */
+    size_t index;           /* Variable for iterating over the elements of a row of the sparse operand */
+    int inner;              /* Variable for iterating over the columns of the dense operand */
+    double factor;          /* Element of the dense operand */
+    double *target;         /* Row of the result */
+    (void)worker;
+
+    for (row = begin; row < end; ++row) {
+        target = &MATRIX_AT(task->result, row, 0);
+        memset(target, 0, (size_t)task->result->cols * sizeof(double));
+        for (inner = 0; inner < task->dense->cols; ++inner) {
+            factor = MATRIX_AT(task->dense, row, inner);
+            if (factor == 0.0) {
+                continue;
+            }
+            for (index = store->rowStart[inner]; index < store->rowStart[inner + 1]; ++index) {
+                target[store->columns[index]] += factor * store->values[index];
+            }
+        }
+    }
+}
+
+
+void multiplyDenseSparse(const Matrix *dense, const Matrix *sparse, Matrix *result) {
+    SparseTask task;
+    size_t work;        /* Multiply-adds of an average row of the result, at least one */
+
+    task.sparse = sparse;
+    task.dense = dense;
+    task.result = result;
+    task.sparseFactor = 1.0;
+    task.denseFactor = 1.0;
+    work = (size_t)dense->cols + countStored(sparse->sparse) + 1;
+    parallelFor((size_t)result->rows, PARALLEL_MIN_ELEMENTS / work + 1, runDenseSparse, &task);
+}
+
+
+static int compareColumns(const void *a, const void *b) {
+    int left = *(const int *)a;     /* First column */
+    int right = *(const int *)b;    /* Second column */
+
+    return (left > right) - (left < right);
+}
+
+
+static void runSpgemm(size_t begin, size_t end, int worker, void *arg) {
+    /*
+     * Short Description:
+     * Visits rows [begin, end) of the product. Every stored element (row, k) of the left operand reaches
+     * the columns of row k of the right operand; the first visit of a column in a row marks it. Counting
+     * records the number of columns reached; computing accumulates their sums and writes them sorted by
+     * column, scanning the marks instead of sorting when the row is dense enough.
+     */
+    const SpgemmTask *task = arg;
+    const struct SparseStore *left = task->left;       /* Elements of the left operand */
+    const struct SparseStore *right = task->right;     /* Elements of the right operand */
+    struct SparseStore *product = task->product;       /* Elements of the product */
+    SpgemmScratch *scratch = &task->scratch[worker];   /* Buffers of this thread */
+    size_t row;                 /* Variable for iterating over the rows */
+    size_t i, j;                /* Positions in the left and right operands */
+    size_t touched;             /* Columns reached by the current row */
+    size_t position;            /* Position of the next element of the product */
+    size_t t;                   /* Variable for iterating over the touched columns */
+    int column;                 /* Column reached */
+    double factor;              /* Element of the left operand */
+
+    for (row = begin; row < end; ++row) {
+        touched = 0;
+        for (i = left->rowStart[row]; i < left->rowStart[row + 1]; ++i) {
+            factor = left->values[i];
+            for (j = right->rowStart[left->columns[i]]; j < right->rowStart[left->columns[i] + 1]; ++j) {
+                column = right->columns[j];
+                if (scratch->marks[column] != (int)row) {
+                    scratch->marks[column] = (int)row;
+                    scratch->touched[touched++] = column;
+                    scratch->sums[column] = 0.0;
+                }
+                scratch->sums[column] += factor * right->values[j];
+            }
+        }
+
+        if (!task->numeric) {
+            product->rowStart[row + 1] = touched;
+            continue;
+        }
+        position = product->rowStart[row];
+        if (touched > (size_t)task->cols / SPGEMM_SCAN_RATIO) {
+            for (column = 0; column < task->cols; ++column) {
+                if (scratch->marks[column] == (int)row) {
+                    product->columns[position] = column;
+                    product->values[position++] = scratch->sums[column];
+                }
+            }
+            continue;
+        }
+        qsort(scratch->touched, touched, sizeof(int), compareColumns);
+        for (t = 0; t < touched; ++t) {
+            product->columns[position] = scratch->touched[t];
+            product->values[position++] = scratch->sums[scratch->touched[t]];
+        }
+    }
+}
+
+
+MatrixStatus multiplySparse(const Matrix *mat1, const Matrix *mat2, struct SparseStore **store) {
+    SpgemmTask task;
+    SpgemmScratch *scratch;         /* Buffers of every thread */
+    struct SparseStore *product;    /* Elements of the product */
+    int threads = getThreadCount(); /* Threads that may take part */
+    int thread;                     /* Variable for iterating over the threads */
+    int row;                        /* Variable for iterating over the rows */
+    int column;                     /* Variable for iterating over the columns */
+    size_t grain;                   /* Rows worth giving to one thread */
+    MatrixStatus status = MATRIX_OK;
+
+    product = allocStore(mat1->rows, 0);
+    scratch = calloc((size_t)threads, sizeof(*scratch));
+    if (product == NULL || scratch == NULL) {
+        freeSparseStore(product);
+        free(scratch);
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    for (thread = 0; thread < threads; ++thread) {
+        scratch[thread].marks = malloc((size_t)mat2->cols * sizeof(int));
+        scratch[thread].sums = malloc((size_t)mat2->cols * sizeof(double));
+        scratch[thread].touched = malloc((size_t)mat2->cols * sizeof(int));
+        if (scratch[thread].marks == NULL || scratch[thread].sums == NULL || scratch[thread].touched == NULL) {
+            status = MATRIX_ALLOCATION_FAILED;
+        }
+    }
+
+    task.left = mat1->sparse;
+    task.right = mat2->sparse;
+    task.product = product;
+    task.scratch = scratch;
+    task.cols = mat2->cols;
+    grain = PARALLEL_MIN_ELEMENTS / (countStored(mat1->sparse) / (size_t)mat1->rows + 1) + 1;
+
+    /* Count the columns of every row, then compute the rows into the positions the counts give */
+    for (task.numeric = false; status == MATRIX_OK; task.numeric = true) {
+        for (thread = 0; thread < threads; ++thread) {
+            for (column = 0; column < mat2->cols; ++column) {
+                scratch[thread].marks[column] = -1;
+            }
+        }
+        parallelFor((size_t)mat1->rows, grain, runSpgemm, &task);
+        if (task.numeric) {
+            break;
+        }
+        for (row = 0; row < mat1->rows; ++row) {
+            product->rowStart[row + 1] += product->rowStart[row];
+        }
+        free(product->columns);
+        free(product->values);
+        product->columns = malloc((product->rowStart[mat1->rows] + 1) * sizeof(int));
+        product->values = malloc((product->rowStart[mat1->rows] + 1) * sizeof(double));
+        if (product->columns == NULL || product->values == NULL) {
+            status = MATRIX_ALLOCATION_FAILED;
+        }
+    }
+
+    for (thread = 0; thread < threads; ++thread) {
+        free(scratch[thread].marks);
+        free(scratch[thread].sums);
+        free(scratch[thread].touched);
+    }
+    free(scratch);
+    if (status != MATRIX_OK) {
+        freeSparseStore(product);
+        return status;
+    }
+    compactStore(product);  /* Sums that cancelled out */
+    *store = product;
+    return MATRIX_OK;
+}
@@ -0,0 +1,293 @@
+/*
+ * Sparse Matrices Header
+ * ----------------------
+ * This C header file declares the sparse matrices implemented in "matsparse.c". A matrix whose share of
+ * non-zero elements is at most the sparse threshold is stored in compressed sparse row (CSR) form: for
+ * every row, the columns and values of its non-zero elements, in increasing column order. Only the
+ * elements that are stored take memory and time, so a product of two sparse n x n matrices costs in
+ * proportion to the multiply-adds of their non-zero elements rather than n^3.
+ *
+ * The operations of "mymat.c" hand any operation with a sparse operand to the kernels declared here:
+ * - sparse + sparse and sparse - sparse merge the rows of both operands;
+ * - sparse +/- dense adds the stored elements to a copy of the dense operand;
+ * - scaling and transposing a sparse matrix keep it sparse;
+ * - sparse x dense (SpMV for a single column, SpMM otherwise) adds the rows of the dense operand picked
+ *   by every stored element, dense x sparse the rows of the sparse operand picked by every element;
+ * - sparse x sparse (SpGEMM) accumulates each row of the product with Gustavson's algorithm.
+ * Scripts do not change: whether a matrix is sparse is decided by its density alone. 'read_mat' and
+ * 'new_mat' store a matrix sparse when few enough of its values are non-zero, 'read_sparse' builds one
+ * from coordinate (COO) triples, and a result is stored sparse or dense by the density it comes out with.
+ *
+ * Core Functions:
+ * - setSparseThreshold:    Sets the density below which matrices are stored sparse.
+ * - shouldStoreSparse / isSparseArray:
+ *                          Tell whether a matrix of a given density, or given values, is stored sparse.
+ * - packSparse / buildSparse:
+ *                          Build the CSR elements of dense row-major values, or of COO triples.
+ * - freeSparseStore / countStored:
+ *                          Release the elements of a sparse matrix, and count them.
+ * - expandSparseRow / expandSparse:
+ *                          Write one row, or every row, of a sparse matrix densely.
+ * - scaleSparse / transposeSparse / addSparse / addSparseDense:
+ *                          Element-wise operations and the transpose.
+ * - multiplySparseDense / multiplyDenseSparse / multiplySparse:
+ *                          SpMM (and SpMV), its mirror and SpGEMM.
+ *
+ * Note:
+ * Stored values are never zero: elements that cancel out in a sum or a product, and the whole matrix
+ * when it is scaled by 0, are dropped. The sparse operands of an operation involving a disk matrix are
+ * expanded first, so the tiled operations of "matdisk.h" only ever see dense operands.
+ */
+
+#ifndef MATSPARSE_H
+#define MATSPARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "mymat.h"
+
+/* Default largest share of non-zero elements of a sparse matrix */
+#define DEFAULT_SPARSE_THRESHOLD 0.05
+
+/* Matrices with fewer elements are always dense: their kernels are faster than any indexing */
+#define SPARSE_MIN_ELEMENTS 4096
+
+
+/*
+ * Function: setSparseThreshold
+ * Purpose: Sets the largest share of non-zero elements of a matrix stored sparse.
+ *
+ * Parameters:
+ *   density - Share between 0 and 1; 0 stores every matrix dense.
+ *
+ * Returns: None (void function).
+ */
+void setSparseThreshold(double density);
+
+
+/*
+ * Function: shouldStoreSparse
+ * Purpose: Tells whether a rows x cols matrix with a given number of non-zero elements is stored sparse.
+ *
+ * Parameters:
+ *   rows, cols - Shape of the matrix.
+ *   nonzeros - Number of its non-zero elements.
+ *
+ * Returns:
+ *   true if the matrix has at least SPARSE_MIN_ELEMENTS elements and a density within the threshold.
+ */
+bool shouldStoreSparse(int rows, int cols, size_t nonzeros);
+
+
+/*
+ * Function: isSparseArray
+ * Purpose: Tells whether row-major values assigned to a rows x cols matrix make it sparse.
+ * Detailed Description:
+ *   Elements beyond 'count' are zero and values beyond the size of the matrix are ignored, as in
+ *   'readMatrix'. Counting stops as soon as the threshold is exceeded, so dense values cost little.
+ *
+ * Parameters:
+ *   rows, cols - Shape of the matrix.
+ *   values - The values, or NULL if 'count' is 0.
+ *   count - Number of values.
+ *
+ * Returns:
+ *   true if the matrix is to be stored sparse.
+ */
+bool isSparseArray(int rows, int cols, const double *values, size_t count);
+
+
+/*
+ * Function: packSparse
+ * Purpose: Builds the CSR elements of a rows x cols matrix from row-major values.
+ *
+ * Parameters:
+ *   rows, cols - Shape of the matrix.
+ *   values - The values, or NULL if 'count' is 0; missing elements are zero, extra values are ignored.
+ *   count - Number of values.
+ *   store - Receives the elements.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the elements could not be allocated.
+ */
+MatrixStatus packSparse(int rows, int cols, const double *values, size_t count, struct SparseStore **store);
+
+
+/*
+ * Function: buildSparse
+ * Purpose: Builds the CSR elements of a rows x cols matrix from coordinate (COO) triples.
+ * Detailed Description:
+ *   The triples are sorted by row with a counting sort, then by column by transposing twice, and the
+ *   values of repeated coordinates are added up. Elements that no triple names are zero.
+ *
+ * Parameters:
+ *   rows, cols - Shape of the matrix.
+ *   triples - Row, column and value of each element, rows and columns counted from 0.
+ *   count - Number of values in 'triples', three per element.
+ *   store - Receives the elements.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_INVALID_ENTRY if the count is not a multiple of three or an index is
+ *   not a whole number within the shape, MATRIX_ALLOCATION_FAILED if the elements could not be allocated.
+ */
+MatrixStatus buildSparse(int rows, int cols, const double *triples, size_t count, struct SparseStore **store);
+
+
+/*
+ * Function: freeSparseStore
+ * Purpose: Releases the elements of a sparse matrix.
+ *
+ * Parameters:
+ *   store - The elements to release.
+ *
+ * Returns: None (void function).
+ */
+void freeSparseStore(struct SparseStore *store);
+
+
+/*
+ * Function: countStored
+ * Purpose: Returns the number of elements a sparse matrix stores: its non-zero elements.
+ *
+ * Parameters:
+ *   store - The elements of the matrix.
+ *
+ * Returns:
+ *   The number of stored elements.
+ */
+size_t countStored(const struct SparseStore *store);
+
+
+/*
+ * Function: expandSparseRow
+ * Purpose: Writes one row of a sparse matrix densely, for printing and saving.
+ *
+ * Parameters:
+ *   mat - Pointer to the sparse Matrix.
+ *   row - Index of the row.
+ *   buffer - Receives the 'mat->cols' elements of the row.
+ *
+ * Returns: None (void function).
+ */
+void expandSparseRow(const Matrix *mat, int row, double *buffer);
+
+
+/*
+ * Function: expandSparse
+ * Purpose: Writes every element of a sparse matrix into a dense matrix of its shape.
+ *
+ * Parameters:
+ *   mat - Pointer to the sparse Matrix.
+ *   dense - Pointer to a Matrix of the same shape, in memory or on disk.
+ *
+ * Returns:
+ *   MATRIX_OK on success, or the status of a failed allocation or tile access.
+ */
+MatrixStatus expandSparse(const Matrix *mat, Matrix *dense);
+
+
+/*
+ * Function: scaleSparse
+ * Purpose: Builds the elements of scalar * mat, which is also a copy when the scalar is 1.
+ *
+ * Parameters:
+ *   mat - Pointer to the sparse Matrix.
+ *   scalar - The factor.
+ *   store - Receives the elements.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the elements could not be allocated.
+ */
+MatrixStatus scaleSparse(const Matrix *mat, double scalar, struct SparseStore **store);
+
+
+/*
+ * Function: transposeSparse
+ * Purpose: Builds the elements of the transpose of a sparse matrix, by a counting sort on the columns.
+ *
+ * Parameters:
+ *   mat - Pointer to the sparse Matrix.
+ *   store - Receives the elements of the mat->cols x mat->rows transpose.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the elements could not be allocated.
+ */
+MatrixStatus transposeSparse(const Matrix *mat, struct SparseStore **store);
+
+
+/*
+ * Function: addSparse
+ * Purpose: Builds the elements of mat1 + factor * mat2 by merging the rows of two sparse matrices.
+ *
+ * Parameters:
+ *   mat1, mat2 - Pointers to sparse matrices of the same shape.
+ *   factor - 1 for a sum, -1 for a difference.
+ *   store - Receives the elements.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the elements could not be allocated.
+ */
+MatrixStatus addSparse(const Matrix *mat1, const Matrix *mat2, double factor, struct SparseStore **store);
+
+
+/*
+ * Function: addSparseDense
+ * Purpose: result = sparseFactor * sparse + denseFactor * dense.
+ *
+ * Parameters:
+ *   sparse - Pointer to a sparse Matrix.
+ *   sparseFactor - Its factor, 1 or -1.
+ *   dense - Pointer to a dense Matrix of the same shape, in memory.
+ *   denseFactor - Its factor, 1 or -1.
+ *   result - Pointer to a dense Matrix of the same shape, in memory; it may be 'dense' but not 'sparse'.
+ *
+ * Returns: None (void function).
+ */
+void addSparseDense(const Matrix *sparse, double sparseFactor, const Matrix *dense, double denseFactor,
+                    Matrix *result);
+
+
+/*
+ * Function: multiplySparseDense
+ * Purpose: result = sparse * dense (SpMV when 'dense' is a single column, SpMM otherwise).
+ *
+ * Parameters:
+ *   sparse - Pointer to a sparse m x k Matrix.
+ *   dense - Pointer to a dense k x n Matrix, in memory.
+ *   result - Pointer to a dense m x n Matrix, in memory; it must be neither operand.
+ *
+ * Returns: None (void function).
+ */
+void multiplySparseDense(const Matrix *sparse, const Matrix *dense, Matrix *result);
+
+
+/*
+ * Function: multiplyDenseSparse
+ * Purpose: result = dense * sparse.
+ *
+ * Parameters:
+ *   dense - Pointer to a dense m x k Matrix, in memory.
+ *   sparse - Pointer to a sparse k x n Matrix.
+ *   result - Pointer to a dense m x n Matrix, in memory; it must be neither operand.
+ *
+ * Returns: None (void function).
+ */
+void multiplyDenseSparse(const Matrix *dense, const Matrix *sparse, Matrix *result);
+
+
+/*
+ * Function: multiplySparse
+ * Purpose: Builds the elements of mat1 * mat2 for two sparse matrices (SpGEMM).
+ *
+ * Parameters:
+ *   mat1 - Pointer to a sparse m x k Matrix.
+ *   mat2 - Pointer to a sparse k x n Matrix.
+ *   store - Receives the elements of the m x n product.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the elements or the accumulator could not be
+ *   allocated.
+ */
+MatrixStatus multiplySparse(const Matrix *mat1, const Matrix *mat2, struct SparseStore **store);
+
+#endif /* MATSPARSE_H */
@@ -0,0 +1,216 @@
+/*
+ * Instruction Statistics
+ * ----------------------
+ * This C source file implements the timing statistics declared in "matstats.h".
+ *
+ * Core Functionalities:
+ * 1.   Recording:          Every recorded time adds to the count, total and maximum of its command and phase,
+ *                          and to the histogram bucket of its binary logarithm.
+ * 2.   Percentiles:        The bucket holding the requested rank gives an upper bound of the percentile.
+ * 3.   printStats:         Writes the input totals, the table of commands and their histograms.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <time.h>
+#include "matstats.h"
+
+
+/* Counters of one command */
+typedef struct {
+    unsigned long counts[NUM_STATS_PHASES];                     /* Instructions timed in each phase */
+    unsigned long totals[NUM_STATS_PHASES];                     /* Nanoseconds spent in each phase */
+    unsigned long maxima[NUM_STATS_PHASES];                     /* Longest time of each phase */
+    unsigned long histograms[NUM_STATS_PHASES][STATS_BUCKETS];  /* Times of each phase by power-of-two bucket */
+    size_t bytes;                                               /* Bytes of the matrices the instructions named */
+} CommandStats;
+
+
+static CommandStats *commandStats = NULL;       /* Counters by command, then those of rejected instructions */
+static const char *const *commandNames = NULL;  /* Names of the commands */
+static int commandCount = 0;                    /* Number of commands */
+static unsigned long inputLines = 0;            /* Lines read */
+static size_t inputBytes = 0;                   /* Bytes of the lines read */
+static unsigned long inputTime = 0;             /* Nanoseconds spent reading lines */
+
+
+static int bucketOf(unsigned long elapsed) {
+    /*
+     * Short Description:
+     * Returns the histogram bucket of a time: its binary logarithm, capped at the last bucket.
+     */
+    int bucket = 0;     /* Bucket of the time */
+
+    while (elapsed > 1 && bucket < STATS_BUCKETS - 1) {
+        elapsed >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+
+static void addTime(CommandStats *stats, StatsPhase phase, unsigned long elapsed) {
+    stats->counts[phase]++;
+    stats->totals[phase] += elapsed;
+    if (elapsed > stats->maxima[phase]) {
+        stats->maxima[phase] = elapsed;
+    }
+    stats->histograms[phase][bucketOf(elapsed)]++;
+}
+
+
+static double percentile(const CommandStats *stats, StatsPhase phase, int percent) {
+    /*
+     * Short Description:
+     * Returns, in microseconds, the upper bound of the bucket holding the given percentile (nearest
+     * rank), or the maximum if it is lower.
+     */
+    unsigned long rank = (stats->counts[phase] * (unsigned long)percent + 99) / 100;   /* Rank sought */
+    unsigned long seen = 0;     /* Times in the buckets up to the current one */
+    double bound;               /* Upper bound of the current bucket, in nanoseconds */
+    int bucket;                 /* Variable for iterating over the buckets */
+
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (bucket = 0; bucket < STATS_BUCKETS - 1; ++bucket) {
+        seen += stats->histograms[phase][bucket];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    bound = (double)(2UL << bucket);
+    if (bucket == STATS_BUCKETS - 1 || bound > (double)stats->maxima[phase]) {
+        bound = (double)stats->maxima[phase];
+    }
+    return bound / 1e3;
+}
+
+
+static void printHistogram(FILE *file, const char *name, const CommandStats *stats, StatsPhase phase) {
+    /*
+     * Short Description:
+     * Writes the non-empty buckets of one histogram on one line, each labelled by its lower bound.
+     */
+    static const char *const phaseNames[NUM_STATS_PHASES] = {"parse", "execute"};   /* Labels of the phases */
+    double lower;       /* Lower bound of the bucket, in nanoseconds */
+    int bucket;         /* Variable for iterating over the buckets */
+
+    if (stats->counts[phase] == 0) {
+        return;
+    }
+    fprintf(file, "%s %s:", name, phaseNames[phase]);
+    for (bucket = 0; bucket < STATS_BUCKETS; ++bucket) {
+        if (stats->histograms[phase][bucket] == 0) {
+            continue;
+        }
+        lower = (bucket == 0) ? 0.0 : (double)(1UL << bucket);
+        if (lower < 1e3) {
+            fprintf(file, " %.0fns:%lu", lower, stats->histograms[phase][bucket]);
+        } else if (lower < 1e6) {
+            fprintf(file, " %.3gus:%lu", lower / 1e3, stats->histograms[phase][bucket]);
+        } else if (lower < 1e9) {
+            fprintf(file, " %.3gms:%lu", lower / 1e6, stats->histograms[phase][bucket]);
+        } else {
+            fprintf(file, " %.3gs:%lu", lower / 1e9, stats->histograms[phase][bucket]);
+        }
+    }
+    fprintf(file, "\n");
+}
+
+
+bool initStats(const char *const names[], int count) {
+    freeStats();
+    commandStats = calloc((size_t)count + 1, sizeof(*commandStats));
+    if (commandStats == NULL) {
+        return false;
+    }
+    commandNames = names;
+    commandCount = count;
+    inputLines = 0;
+    inputBytes = 0;
+    inputTime = 0;
+    return true;
+}
+
+
+void freeStats(void) {
+    free(commandStats);
+    commandStats = NULL;
+    commandNames = NULL;
+    commandCount = 0;
+}
+
+
+bool isStatsEnabled(void) {
+    return commandStats != NULL;
+}
+
+
+unsigned long readStatsClock(void) {
+    struct timespec ts;     /* Time of the clock */
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000000UL + (unsigned long)ts.tv_nsec;
+}
+
+
+void recordInput(unsigned long elapsed, size_t bytes) {
+    inputLines++;
+    inputBytes += bytes;
+    inputTime += elapsed;
+}
+
+
+void recordCommand(int command, StatsPhase phase, unsigned long elapsed) {
+    addTime(&commandStats[command], phase, elapsed);
+}
+
+
+void recordRejected(unsigned long elapsed) {
+    addTime(&commandStats[commandCount], STATS_PARSE, elapsed);
+}
+
+
+void recordBytes(int command, size_t bytes) {
+    commandStats[command].bytes += bytes;
+}
+
+
+void printStats(FILE *file) {
+    const CommandStats *stats;  /* Counters of the current row */
+    const char *name;           /* Name of the current row */
+    int row;                    /* Variable for iterating over the commands, then the rejected instructions */
+
+    if (commandStats == NULL) {
+        fprintf(file, "Statistics: disabled (run with --stats)\n");
+        return;
+    }
+    fprintf(file, "Input: %lu lines, %lu bytes, %.1f us reading (including any wait for input)\n",
+            inputLines, (unsigned long)inputBytes, (double)inputTime / 1e3);
+    fprintf(file, "%-12s %8s %12s %12s %10s %10s %10s %10s %14s\n", "command", "count", "parse us", "execute us",
+            "mean us", "p50 us <=", "p99 us <=", "max us", "bytes");
+    for (row = 0; row <= commandCount; ++row) {
+        stats = &commandStats[row];
+        name = (row < commandCount) ? commandNames[row] : "(rejected)";
+        if (stats->counts[STATS_PARSE] == 0 && stats->counts[STATS_EXECUTE] == 0) {
+            continue;
+        }
+        fprintf(file, "%-12s %8lu %12.1f %12.1f ", name, stats->counts[STATS_PARSE],
+                (double)stats->totals[STATS_PARSE] / 1e3, (double)stats->totals[STATS_EXECUTE] / 1e3);
+        if (stats->counts[STATS_EXECUTE] > 0) {
+            fprintf(file, "%10.1f %10.1f %10.1f %10.1f %14lu\n",
+                    (double)stats->totals[STATS_EXECUTE] / 1e3 / (double)stats->counts[STATS_EXECUTE],
+                    percentile(stats, STATS_EXECUTE, 50), percentile(stats, STATS_EXECUTE, 99),
+                    (double)stats->maxima[STATS_EXECUTE] / 1e3, (unsigned long)stats->bytes);
+        } else {
+            fprintf(file, "%10s %10s %10s %10s %14s\n", "-", "-", "-", "-", "-");
+        }
+    }
+    for (row = 0; row <= commandCount; ++row) {
+        name = (row < commandCount) ? commandNames[row] : "(rejected)";
+        printHistogram(file, name, &commandStats[row], STATS_PARSE);
+        printHistogram(file, name, &commandStats[row], STATS_EXECUTE);
+    }
+}
@@ -0,0 +1,159 @@
+/*
+ * Instruction Statistics Header
+ * -----------------------------
+ * This C header file declares the timing statistics implemented in "matstats.c". When enabled, the main
+ * loop of "mainmat.c" reads a monotonic clock around readLine, readInstruction and processInstruction and
+ * records the elapsed times here, per command type and split into parse and execute time, together with
+ * the bytes of the matrices every instruction names. The 'stats' command prints the report, and
+ * '--stats-dump FILE' writes it when the program exits.
+ *
+ * Every phase of every command keeps a count, a total, a maximum and a histogram of its latencies in
+ * STATS_BUCKETS power-of-two buckets of nanoseconds, so recording is a few additions and the percentiles
+ * of the report are bounds read from the histogram.
+ *
+ * Core Functions:
+ * - initStats / freeStats: Enable the statistics for a table of command names, and release them.
+ * - isStatsEnabled:        Tells whether instructions are to be timed.
+ * - readStatsClock:        Reads the monotonic clock in nanoseconds.
+ * - recordInput:           Records the reading of one input line.
+ * - recordCommand:         Records one phase of one instruction.
+ * - recordRejected:        Records the parsing of an instruction that was rejected.
+ * - recordBytes:           Adds the bytes an instruction touched.
+ * - printStats:            Writes the report.
+ *
+ * Note:
+ * The statistics are disabled unless 'initStats' is called, and the main loop then reads no clock at all,
+ * so the only cost left is one test per instruction. They cover the whole process: the sessions of
+ * '--batch' add up.
+ */
+
+#ifndef MATSTATS_H
+#define MATSTATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Number of latency buckets; bucket b counts times of 2^b to 2^(b+1) - 1 ns, the last one every longer time */
+#define STATS_BUCKETS 40
+
+/* Phases of an instruction that are timed separately */
+typedef enum {
+    STATS_PARSE,        /* readInstruction */
+    STATS_EXECUTE,      /* processInstruction */
+    NUM_STATS_PHASES    /* Sentinel value for the number of phases */
+} StatsPhase;
+
+
+/*
+ * Function: initStats
+ * Purpose: Enables the statistics.
+ *
+ * Parameters:
+ *   names - Name of every command, indexed by command; the array must outlive the statistics.
+ *   count - Number of commands.
+ *
+ * Returns:
+ *   true on success; false if the counters could not be allocated, the statistics staying disabled.
+ */
+bool initStats(const char *const names[], int count);
+
+
+/*
+ * Function: freeStats
+ * Purpose: Releases the counters and disables the statistics.
+ *
+ * Returns: None (void function).
+ */
+void freeStats(void);
+
+
+/*
+ * Function: isStatsEnabled
+ * Purpose: Tells whether the statistics are enabled, so callers read the clock only when they are.
+ *
+ * Returns:
+ *   true if 'initStats' succeeded.
+ */
+bool isStatsEnabled(void);
+
+
+/*
+ * Function: readStatsClock
+ * Purpose: Reads the monotonic clock.
+ *
+ * Returns:
+ *   Nanoseconds since an arbitrary origin.
+ */
+unsigned long readStatsClock(void);
+
+
+/*
+ * Function: recordInput
+ * Purpose: Records the reading of one input line.
+ *
+ * Parameters:
+ *   elapsed - Nanoseconds spent in readLine, including any wait for input.
+ *   bytes - Bytes of the line, with its newline.
+ *
+ * Returns: None (void function).
+ */
+void recordInput(unsigned long elapsed, size_t bytes);
+
+
+/*
+ * Function: recordCommand
+ * Purpose: Records the time of one phase of an instruction.
+ *
+ * Parameters:
+ *   command - Command of the instruction, below the count given to 'initStats'.
+ *   phase - The phase timed.
+ *   elapsed - Nanoseconds it took.
+ *
+ * Returns: None (void function).
+ */
+void recordCommand(int command, StatsPhase phase, unsigned long elapsed);
+
+
+/*
+ * Function: recordRejected
+ * Purpose: Records the parsing time of an instruction rejected with an error, which has no command.
+ *
+ * Parameters:
+ *   elapsed - Nanoseconds readInstruction took.
+ *
+ * Returns: None (void function).
+ */
+void recordRejected(unsigned long elapsed);
+
+
+/*
+ * Function: recordBytes
+ * Purpose: Adds the bytes of the matrices an instruction named to the total of its command.
+ *
+ * Parameters:
+ *   command - Command of the instruction.
+ *   bytes - Bytes of its operands and result.
+ *
+ * Returns: None (void function).
+ */
+void recordBytes(int command, size_t bytes);
+
+
+/*
+ * Function: printStats
+ * Purpose: Writes the statistics gathered so far.
+ * Detailed Description:
+ *   Writes a table with a row per command that ran: counts, parse and execute totals, the mean, median,
+ *   99th percentile and maximum of the execute time and the bytes touched, then the non-empty buckets of
+ *   the histograms of both phases. Times are in microseconds; percentiles are the upper bounds of their
+ *   buckets, capped by the maximum.
+ *
+ * Parameters:
+ *   file - The stream to write to.
+ *
+ * Returns: None (void function).
+ */
+void printStats(FILE *file);
+
+#endif /* MATSTATS_H */
@@ -0,0 +1,253 @@
+/*
+ * Strassen-Winograd Multiplication
+ * --------------------------------
+ * This C source file implements the fast multiplication path declared in "matstrassen.h".
+ *
+ * Core Functionalities:
+ * 1.   strassen:               Entry point; sizes and allocates the workspace, then starts the recursion.
+ * 2.   strassenStep:           One level of the recursion, including the peeling of odd dimensions.
+ * 3.   winogradProducts:       The seven half-size products and fifteen block additions of one level.
+ * 4.   workspaceSize:          Number of doubles the temporaries of a recursion need.
+ * 5.   combineBlocks:          Adds or subtracts two strided blocks with the dispatched SIMD kernel.
+ *
+ * Each level works on the even part of the operands, split into 2 x 2 quadrants, and follows the
+ * two-temporary schedule of Boyer, Dumas, Pernet and Zhou: the four products P3, P5, P6 and P7 are
+ * written straight into the quadrants of C, so only X (m/2 x max(k/2, n/2)) and Y (k/2 x n/2) are
+ * needed. The temporaries of deeper levels follow in the same workspace, so it shrinks by a factor of
+ * four per level and the whole recursion needs less than 4/3 of the first level's temporaries.
+ */
+
+#include <stdlib.h>
+#include "matstrassen.h"
+#include "matgemm.h"
+#include "matsimd.h"
+
+
+const MultiplyAlgorithmProfile MultiplyAlgorithms[NUM_MULTIPLY_ALGORITHMS] = {
+    {MULTIPLY_AUTO, "auto"},            /* Chosen by shape */
+    {MULTIPLY_CLASSIC, "classic"},      /* Blocked GEMM */
+    {MULTIPLY_STRASSEN, "strassen"}     /* Strassen-Winograd */
+};
+
+/* Algorithm used by 'multiplyMatrices' */
+static MultiplyAlgorithm selectedAlgorithm = MULTIPLY_AUTO;
+
+/* Products whose smallest dimension is at most this use the classic kernel */
+static int strassenCutoff = STRASSEN_DEFAULT_CUTOFF;
+
+/* Signature of the add and sub kernels of the SIMD table */
+typedef void (*BlockKernel)(const double *a, const double *b, double *result, size_t count);
+
+
+/* Smallest of three dimensions */
+#define MIN3(a, b, c) ((a) < (b) ? ((a) < (c) ? (a) : (c)) : ((b) < (c) ? (b) : (c)))
+
+
+void setMultiplyAlgorithm(MultiplyAlgorithm algorithm) {
+    /*
+     * Short Description:
+     * Records the algorithm 'multiplyMatrices' should use.
+     */
+    selectedAlgorithm = algorithm;
+}
+
+
+void setStrassenCutoff(int cutoff) {
+    /*
+     * Short Description:
+     * Records the crossover dimension; non-positive values are ignored.
+     */
+    if (cutoff > 0) {
+        strassenCutoff = cutoff;
+    }
+}
+
+
+bool shouldUseStrassen(int m, int n, int k) {
+    /*
+     * Short Description:
+     * Applies the selected algorithm, or the cutoff when the choice is automatic.
+     */
+    switch (selectedAlgorithm) {
+        case MULTIPLY_CLASSIC:
+            return false;
+        case MULTIPLY_STRASSEN:
+            return MIN3(m, n, k) >= 2;
+        default:
+            return MIN3(m, n, k) > strassenCutoff;
+    }
+}
+
+
+static void combineBlocks(BlockKernel kernel, int rows, int cols, const double *x, int ldx,
+                          const double *y, int ldy, double *out, int ldout) {
+    /*
+     * Short Description:
+     * Computes out = x (+/-) y row by row; 'out' may be the same block as 'x' or 'y'.
+     */
+    int row;    /* Index of the current row */
+
+    for (row = 0; row < rows; row++) {
+        kernel(x + (size_t)row * ldx, y + (size_t)row * ldy, out + (size_t)row * ldout, (size_t)cols);
+    }
+}
+
+
+static size_t workspaceSize(int m, int n, int k, bool split) {
+    /*
+     * Short Description:
+     * Counts the doubles needed by X, Y and the temporaries of every deeper level.
+     */
+    int halfM = m / 2, halfN = n / 2, halfK = k / 2;   /* Quadrant dimensions */
+
+    if (!split) {
+        return 0;
+    }
+    return (size_t)halfM * (size_t)(halfK > halfN ? halfK : halfN) + (size_t)halfK * (size_t)halfN
+           + workspaceSize(halfM, halfN, halfK, MIN3(halfM, halfN, halfK) > strassenCutoff);
+}
+
+
+static MatrixStatus strassenStep(int m, int n, int k, const double *a, int lda, const double *b,
+                                 int ldb, double *c, int ldc, double *workspace, bool split);
+
+
+static MatrixStatus winogradProducts(int m, int n, int k, const double *a, int lda, const double *b,
+                                     int ldb, double *c, int ldc, double *workspace) {
+    /*
+     * Short Description:
+     * Computes C = A * B for even m, n and k from seven products of the quadrants.
+     * The comment on each step names the Winograd term it computes and where the term lives.
+     */
+    const SimdKernels *kernels = getSimdKernels();  /* Element-wise add and sub */
+    int halfM = m / 2, halfN = n / 2, halfK = k / 2;    /* Quadrant dimensions */
+    const double *a11 = a, *a12 = a + halfK;            /* Quadrants of A */
+    const double *a21 = a + (size_t)halfM * lda, *a22 = a21 + halfK;
+    const double *b11 = b, *b12 = b + halfN;            /* Quadrants of B */
+    const double *b21 = b + (size_t)halfK * ldb, *b22 = b21 + halfN;
+    double *c11 = c, *c12 = c + halfN;                  /* Quadrants of C */
+    double *c21 = c + (size_t)halfM * ldc, *c22 = c21 + halfN;
+    double *x = workspace;                              /* m/2 x k/2 sums of A, later P1 */
+    double *y = x + (size_t)halfM * (size_t)(halfK > halfN ? halfK : halfN); /* k/2 x n/2 sums of B */
+    double *deeper = y + (size_t)halfK * halfN;         /* Workspace of the next level */
+    bool split = MIN3(halfM, halfN, halfK) > strassenCutoff; /* Whether the next level splits again */
+    MatrixStatus status;
+
+    /* X = S3 = A11 - A21, Y = T3 = B22 - B12, C21 = P7 = S3 * T3 */
+    combineBlocks(kernels->sub, halfM, halfK, a11, lda, a21, lda, x, halfK);
+    combineBlocks(kernels->sub, halfK, halfN, b22, ldb, b12, ldb, y, halfN);
+    status = strassenStep(halfM, halfN, halfK, x, halfK, y, halfN, c21, ldc, deeper, split);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    /* X = S1 = A21 + A22, Y = T1 = B12 - B11, C22 = P5 = S1 * T1 */
+    combineBlocks(kernels->add, halfM, halfK, a21, lda, a22, lda, x, halfK);
+    combineBlocks(kernels->sub, halfK, halfN, b12, ldb, b11, ldb, y, halfN);
+    status = strassenStep(halfM, halfN, halfK, x, halfK, y, halfN, c22, ldc, deeper, split);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    /* X = S2 = S1 - A11, Y = T2 = B22 - T1, C12 = P6 = S2 * T2 */
+    combineBlocks(kernels->sub, halfM, halfK, x, halfK, a11, lda, x, halfK);
+    combineBlocks(kernels->sub, halfK, halfN, b22, ldb, y, halfN, y, halfN);
+    status = strassenStep(halfM, halfN, halfK, x, halfK, y, halfN, c12, ldc, deeper, split);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    /* X = S4 = A12 - S2, C11 = P3 = S4 * B22 */
+    combineBlocks(kernels->sub, halfM, halfK, a12, lda, x, halfK, x, halfK);
+    status = strassenStep(halfM, halfN, halfK, x, halfK, b22, ldb, c11, ldc, deeper, split);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    /* X = P1 = A11 * B11 */
+    status = strassenStep(halfM, halfN, halfK, a11, lda, b11, ldb, x, halfN, deeper, split);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    /* C12 = U2 = P1 + P6, C21 = U3 = U2 + P7, C12 = U4 = U2 + P5, C22 = U7 = U3 + P5, C12 = U5 = U4 + P3 */
+    combineBlocks(kernels->add, halfM, halfN, x, halfN, c12, ldc, c12, ldc);
+    combineBlocks(kernels->add, halfM, halfN, c12, ldc, c21, ldc, c21, ldc);
+    combineBlocks(kernels->add, halfM, halfN, c12, ldc, c22, ldc, c12, ldc);
+    combineBlocks(kernels->add, halfM, halfN, c21, ldc, c22, ldc, c22, ldc);
+    combineBlocks(kernels->add, halfM, halfN, c12, ldc, c11, ldc, c12, ldc);
+
+    /* Y = T4 = T2 - B21, C11 = P4 = A22 * T4, C21 = U6 = U3 - P4 */
+    combineBlocks(kernels->sub, halfK, halfN, y, halfN, b21, ldb, y, halfN);
+    status = strassenStep(halfM, halfN, halfK, a22, lda, y, halfN, c11, ldc, deeper, split);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    combineBlocks(kernels->sub, halfM, halfN, c21, ldc, c11, ldc, c21, ldc);
+
+    /* C11 = P2 = A12 * B21, C11 = U1 = P1 + P2 */
+    status = strassenStep(halfM, halfN, halfK, a12, lda, b21, ldb, c11, ldc, deeper, split);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    combineBlocks(kernels->add, halfM, halfN, x, halfN, c11, ldc, c11, ldc);
+
+    return MATRIX_OK;
+}
+
+
+static MatrixStatus strassenStep(int m, int n, int k, const double *a, int lda, const double *b,
+                                 int ldb, double *c, int ldc, double *workspace, bool split) {
+    /*
+     * Short Description:
+     * Computes C = A * B, splitting once more if requested, and peels odd dimensions off the split part.
+     */
+    int evenM = m & ~1, evenN = n & ~1, evenK = k & ~1;    /* Dimensions of the part that is split */
+    MatrixStatus status;
+
+    if (!split) {
+        return gemm(GEMM_NO_TRANS, GEMM_NO_TRANS, m, n, k, 1.0, a, lda, b, ldb, 0.0, c, ldc);
+    }
+
+    status = winogradProducts(evenM, evenN, evenK, a, lda, b, ldb, c, ldc, workspace);
+
+    /* Last inner step: C[0:evenM, 0:evenN] += A[0:evenM, k-1] * B[k-1, 0:evenN] */
+    if (status == MATRIX_OK && evenK != k) {
+        status = gemm(GEMM_NO_TRANS, GEMM_NO_TRANS, evenM, evenN, 1, 1.0, a + (k - 1), lda,
+                      b + (size_t)(k - 1) * ldb, ldb, 1.0, c, ldc);
+    }
+    /* Last column: C[0:m, n-1] = A * B[0:k, n-1] */
+    if (status == MATRIX_OK && evenN != n) {
+        status = gemm(GEMM_NO_TRANS, GEMM_NO_TRANS, m, 1, k, 1.0, a, lda, b + (n - 1), ldb,
+                      0.0, c + (n - 1), ldc);
+    }
+    /* Last row: C[m-1, 0:evenN] = A[m-1, 0:k] * B[0:k, 0:evenN] */
+    if (status == MATRIX_OK && evenM != m) {
+        status = gemm(GEMM_NO_TRANS, GEMM_NO_TRANS, 1, evenN, k, 1.0, a + (size_t)(m - 1) * lda, lda,
+                      b, ldb, 0.0, c + (size_t)(m - 1) * ldc, ldc);
+    }
+    return status;
+}
+
+
+MatrixStatus strassen(int m, int n, int k, const double *a, int lda, const double *b, int ldb,
+                      double *c, int ldc) {
+    /*
+     * Short Description:
+     * Allocates the workspace of the whole recursion once and runs it.
+     */
+    bool split = MIN3(m, n, k) >= 2;    /* The top level splits whenever it can */
+    size_t size = workspaceSize(m, n, k, split);    /* Doubles needed by every level */
+    double *workspace = NULL;           /* Temporaries of every level */
+    MatrixStatus status;
+
+    if (size > 0) {
+        workspace = allocElements(size);
+        if (workspace == NULL) {
+            return MATRIX_ALLOCATION_FAILED;
+        }
+    }
+    status = strassenStep(m, n, k, a, lda, b, ldb, c, ldc, workspace, split);
+    free(workspace);
+    return status;
+}
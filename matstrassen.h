@@ -0,0 +1,108 @@
+/*
+ * Strassen-Winograd Multiplication Header
+ * ---------------------------------------
+ * This C header file declares the fast matrix multiplication path implemented in "matstrassen.c".
+ * Large products are split recursively with the Winograd variant of Strassen's algorithm, which
+ * replaces one of the eight half-size products by fifteen additions at every level. Once a
+ * sub-product falls below the cutoff it is handed to the blocked GEMM engine of "matgemm.h".
+ *
+ * Core Functions:
+ * - setMultiplyAlgorithm:  Selects automatic choice, the classic kernel or Strassen-Winograd.
+ * - setStrassenCutoff:     Sets the dimension at or below which the classic kernel is used.
+ * - shouldUseStrassen:     Decides which algorithm a product of the given shape runs with.
+ * - strassen:              Computes C = A * B with Strassen-Winograd.
+ *
+ * Note:
+ * Odd dimensions are handled by dynamic peeling: the even part is multiplied recursively and the last
+ * row, column and inner step are fixed up with the classic kernel. Every temporary of the recursion
+ * lives in one workspace allocated per product.
+ */
+
+#ifndef MATSTRASSEN_H
+#define MATSTRASSEN_H
+
+#include <stdbool.h>
+#include "mymat.h"
+
+/* Default dimension at or below which a (sub-)product uses the classic kernel */
+#define STRASSEN_DEFAULT_CUTOFF 1024
+
+/* Enumeration of the matrix multiplication algorithms 'mul_mat' can use */
+typedef enum {
+    MULTIPLY_AUTO,          /* Strassen-Winograd above the cutoff, the classic kernel otherwise */
+    MULTIPLY_CLASSIC,       /* Always the blocked classic kernel */
+    MULTIPLY_STRASSEN,      /* Strassen-Winograd for every product that can be split at least once */
+    NUM_MULTIPLY_ALGORITHMS
+} MultiplyAlgorithm;
+
+/* Structure pairing an algorithm with its name on the command line */
+typedef struct {
+    MultiplyAlgorithm algorithm;    /* The algorithm */
+    const char *algorithmName;      /* Name used to select it */
+} MultiplyAlgorithmProfile;
+
+/* Names of the algorithms, indexed by MultiplyAlgorithm */
+extern const MultiplyAlgorithmProfile MultiplyAlgorithms[];
+
+
+/*
+ * Function: setMultiplyAlgorithm
+ * Purpose: Selects the algorithm used by 'multiplyMatrices'.
+ *
+ * Parameters:
+ *   algorithm - The algorithm to use; MULTIPLY_AUTO is the default.
+ *
+ * Returns: None (void function).
+ */
+void setMultiplyAlgorithm(MultiplyAlgorithm algorithm);
+
+
+/*
+ * Function: setStrassenCutoff
+ * Purpose: Sets the crossover between Strassen-Winograd and the classic kernel.
+ * Detailed Description:
+ *   Products whose smallest dimension is at most 'cutoff' use the classic kernel, both when choosing
+ *   an algorithm automatically and when stopping the recursion.
+ *
+ * Parameters:
+ *   cutoff - The crossover dimension; must be positive.
+ *
+ * Returns: None (void function).
+ */
+void setStrassenCutoff(int cutoff);
+
+
+/*
+ * Function: shouldUseStrassen
+ * Purpose: Decides whether an m x k by k x n product runs with Strassen-Winograd.
+ *
+ * Parameters:
+ *   m, n, k - Dimensions of the product.
+ *
+ * Returns:
+ *   true for Strassen-Winograd; false for the classic kernel.
+ */
+bool shouldUseStrassen(int m, int n, int k);
+
+
+/*
+ * Function: strassen
+ * Purpose: Computes C = A * B with the Strassen-Winograd algorithm.
+ * Detailed Description:
+ *   A is m x k and B is k x n, both row-major with leading dimensions lda and ldb; C is m x n with
+ *   leading dimension ldc and must not overlap A or B. The top level is always split (when every
+ *   dimension is at least 2); deeper levels are split while the smallest dimension exceeds the cutoff.
+ *
+ * Parameters:
+ *   m, n, k - Dimensions of the product.
+ *   a, lda - First operand and its leading dimension.
+ *   b, ldb - Second operand and its leading dimension.
+ *   c, ldc - Result and its leading dimension.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the workspace could not be allocated.
+ */
+MatrixStatus strassen(int m, int n, int k, const double *a, int lda, const double *b, int ldb,
+                      double *c, int ldc);
+
+#endif /* MATSTRASSEN_H */
@@ -0,0 +1,116 @@
+/*
+ * Matrix Transposition
+ * --------------------
+ * This C source file implements the transposition kernels declared in "mattrans.h".
+ *
+ * Core Functionalities:
+ * 1.   transposeBuffer:            Recursive out-of-place transpose; halves the larger dimension until a
+ *                                  block fits in a tile, then copies it with a plain double loop.
+ * 2.   transposeSquareInPlace:     Swaps mirror tiles across the diagonal of a square block.
+ * 3.   transposePackedInPlace:     Cycle-following transpose of a rectangular buffer without a second buffer.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include "mattrans.h"
+
+
+/* Number of bits in one word of the visited set */
+#define WORD_BITS (sizeof(unsigned long) * CHAR_BIT)
+
+
+void transposeBuffer(int rows, int cols, const double *src, int lds, double *dst, int ldd) {
+    /*
+     * Short Description:
+     * Splits the larger dimension in two until the block is at most one tile, then copies it.
+     */
+    int row, column;    /* Variables for row and column indices */
+    int half;           /* Size of the first half of the split dimension */
+
+    if (rows > TRANSPOSE_TILE && rows >= cols) {
+        half = rows / 2;
+        transposeBuffer(half, cols, src, lds, dst, ldd);
+        transposeBuffer(rows - half, cols, src + (size_t)half * lds, lds, dst + half, ldd);
+        return;
+    }
+    if (cols > TRANSPOSE_TILE) {
+        half = cols / 2;
+        transposeBuffer(rows, half, src, lds, dst, ldd);
+        transposeBuffer(rows, cols - half, src + half, lds, dst + (size_t)half * ldd, ldd);
+        return;
+    }
+
+    for (row = 0; row < rows; ++row) {
+        for (column = 0; column < cols; ++column) {
+            dst[(size_t)column * ldd + row] = src[(size_t)row * lds + column];
+        }
+    }
+}
+
+
+void transposeSquareInPlace(int n, double *data, int ld) {
+    /*
+     * Short Description:
+     * Swaps each tile above the diagonal with its mirror, element by element, and the diagonal tiles internally.
+     */
+    int tileRow, tileCol;       /* Top-left corner of the current tile */
+    int row, column;            /* Variables for row and column indices */
+    int rowEnd, colEnd;         /* Bottom-right bounds of the current tile */
+    double temp;                /* Temporary variable for swapping values */
+
+    for (tileRow = 0; tileRow < n; tileRow += TRANSPOSE_TILE) {
+        rowEnd = tileRow + TRANSPOSE_TILE < n ? tileRow + TRANSPOSE_TILE : n;
+        for (tileCol = tileRow; tileCol < n; tileCol += TRANSPOSE_TILE) {
+            colEnd = tileCol + TRANSPOSE_TILE < n ? tileCol + TRANSPOSE_TILE : n;
+            for (row = tileRow; row < rowEnd; ++row) {
+                /* On a diagonal tile only the part above the diagonal is swapped */
+                for (column = tileCol == tileRow ? row + 1 : tileCol; column < colEnd; ++column) {
+                    temp = data[(size_t)row * ld + column];
+                    data[(size_t)row * ld + column] = data[(size_t)column * ld + row];
+                    data[(size_t)column * ld + row] = temp;
+                }
+            }
+        }
+    }
+}
+
+
+MatrixStatus transposePackedInPlace(int rows, int cols, double *data) {
+    /*
+     * Short Description:
+     * Applies the transpose permutation cycle by cycle, marking each position as it is filled.
+     */
+    size_t count = (size_t)rows * (size_t)cols;             /* Number of elements */
+    size_t words = (count + WORD_BITS - 1) / WORD_BITS;     /* Words in the visited set */
+    unsigned long *visited;     /* One bit per element, set once the element is in place */
+    size_t start, position;     /* First and current position of the cycle being followed */
+    double carried, temp;       /* Element moving along the cycle, and the one it displaces */
+
+    if (rows <= 1 || cols <= 1) {
+        return MATRIX_OK;   /* A vector has the same layout either way */
+    }
+    visited = calloc(words, sizeof(unsigned long));
+    if (visited == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+
+    /* The first and last elements never move */
+    for (start = 1; start + 1 < count; ++start) {
+        if (visited[start / WORD_BITS] & (1UL << (start % WORD_BITS))) {
+            continue;
+        }
+        carried = data[start];
+        position = start;
+        do {
+            /* Element (r, c) at r * cols + c moves to c * rows + r */
+            position = (position % (size_t)cols) * (size_t)rows + position / (size_t)cols;
+            temp = data[position];
+            data[position] = carried;
+            carried = temp;
+            visited[position / WORD_BITS] |= 1UL << (position % WORD_BITS);
+        } while (position != start);
+    }
+
+    free(visited);
+    return MATRIX_OK;
+}
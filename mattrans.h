@@ -0,0 +1,76 @@
+/*
+ * Matrix Transposition Header
+ * ---------------------------
+ * This C header file declares the transposition kernels implemented in "mattrans.c". They work on
+ * raw row-major buffers with leading dimensions, like the GEMM engine of "matgemm.h", and are used by
+ * 'transposeMatrix' and 'transposeMatrixInPlace' in "mymat.c".
+ *
+ * Core Functions:
+ * - transposeBuffer:           Cache-oblivious out-of-place transpose.
+ * - transposeSquareInPlace:    Tiled in-place transpose of a square block.
+ * - transposePackedInPlace:    In-place transpose of a packed rectangular buffer by cycle-following.
+ *
+ * Note:
+ * The out-of-place transpose halves the larger dimension recursively until a block fits in
+ * TRANSPOSE_TILE x TRANSPOSE_TILE, so both the reads and the strided writes of a block stay in cache
+ * whatever the cache sizes are.
+ */
+
+#ifndef MATTRANS_H
+#define MATTRANS_H
+
+#include "mymat.h"
+
+/* Largest block the recursion of 'transposeBuffer' copies directly; two such blocks fit in L1 */
+#define TRANSPOSE_TILE 32
+
+
+/*
+ * Function: transposeBuffer
+ * Purpose: Writes the transpose of a rows x cols block into a cols x rows block.
+ *
+ * Parameters:
+ *   rows, cols - Dimensions of the source block.
+ *   src, lds - Source block and its leading dimension.
+ *   dst, ldd - Destination block and its leading dimension; must not overlap the source.
+ *
+ * Returns: None (void function).
+ */
+void transposeBuffer(int rows, int cols, const double *src, int lds, double *dst, int ldd);
+
+
+/*
+ * Function: transposeSquareInPlace
+ * Purpose: Transposes an n x n block in place.
+ * Detailed Description:
+ *   The block is walked in TRANSPOSE_TILE x TRANSPOSE_TILE tiles: each tile above the diagonal is
+ *   swapped with its mirror tile, and the diagonal tiles are transposed within themselves.
+ *
+ * Parameters:
+ *   n - Dimension of the block.
+ *   data, ld - The block and its leading dimension.
+ *
+ * Returns: None (void function).
+ */
+void transposeSquareInPlace(int n, double *data, int ld);
+
+
+/*
+ * Function: transposePackedInPlace
+ * Purpose: Transposes a packed rows x cols buffer in place into a packed cols x rows buffer.
+ * Detailed Description:
+ *   Element (r, c) at index r * cols + c moves to index c * rows + r. The permutation is applied by
+ *   following its cycles, carrying one element at a time; a bit per element records which positions
+ *   are already in place, so the only extra memory is 1/64 of the buffer.
+ *
+ * Parameters:
+ *   rows, cols - Dimensions of the buffer before the transpose.
+ *   data - The buffer, with leading dimension 'cols' before and 'rows' after the call.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the bit set could not be allocated
+ *   (the buffer is left untouched in that case).
+ */
+MatrixStatus transposePackedInPlace(int rows, int cols, double *data);
+
+#endif /* MATTRANS_H */
@@ -5,22 +5,33 @@
  * It includes functionalities for initializing, validating, reading, and performing basic arithmetic operations on matrices.
  *
  * Core Functionalities:
- * 1.   initMatrices:               Initializes matrices in the context to default values and sets their profiles.
- * 2.   isValidMatrixName:          Validates matrix names against predefined profiles in the context.
- * 3.   printMatrix:                Prints a matrix based on its name.
- * 4.   getMatrixEnumByName:        Retrieves the enum value of a matrix based on its name.
- * 5.   readMatrix:                 Reads data from an array and assigns it to the specified matrix in the context.
- * 6.   addMatrices:                Performs element-wise addition of two matrices.
- * 7.   subMatrices:                Performs element-wise subtraction between two matrices.
- * 8.   multiplyMatrices:           Conducts matrix multiplication of two matrices.
- * 9.   multiplyScalar:             Scales each element of a matrix by a scalar value.
- * 10.  transposeMatrix:            Transposes a matrix and stores the result in another matrix.
- * 11.  transposeMatrixInPlace:     Transposes a square matrix in-place.
- * 12.  multiplyMatricesInPlace:    Multiplies two matrices, storing the result in one of the input matrices using a temporary matrix.
- * 13.  printAllowedMatrixNames:    Prints a list of all available matrix names in the context.
-
- * The program relies on 'mymat.h' for the definition of structures and constants such as 'Matrix', 'MatrixContext', and 'MatrixProfile'.
- * It assumes matrices are of fixed size, defined by ROWS and COLS constants, and supports a set number of matrices defined by NUM_MATRICES.
+ * 1.   initMatrices:               Registers the initial matrices of the context (see "matreg.c") and sets the batch profiles.
+ *      freeMatrices / freeMatrix:  Release matrix storage.
+ *      resizeMatrix:               Gives a matrix new dimensions, growing its aligned storage when needed.
+ * 2.   printMatrix:                Prints a matrix.
+ * 3.   readMatrix:                 Reads data from an array and assigns it to a matrix.
+ *      readSparseMatrix:           Assigns the elements given as (row, column, value) triples to a matrix.
+ * 4.   addMatrices:                Performs element-wise addition of two matrices with the dispatched SIMD kernel
+ *                                  (or, like the product and transpose, a size-specialized kernel for small squares).
+ * 5.   subMatrices:                Performs element-wise subtraction between two matrices with the dispatched SIMD kernel.
+ * 6.   multiplyMatrices:           Conducts matrix multiplication of two matrices through the blocked GEMM engine,
+ *                                  or Strassen-Winograd for large products.
+ * 7.   multiplyScalar:             Scales each element of a matrix by a scalar value with the dispatched SIMD kernel.
+ * 8.   transposeMatrix:            Transposes a matrix and stores the result in another matrix.
+ * 9.   transposeMatrixInPlace:     Transposes a matrix in-place.
+ * 10.  multiplyMatricesInPlace:    Multiplies two matrices, storing the result in one of the input matrices using a temporary matrix.
+ * 11.  copyMatrix:                 Copies a matrix into another.
+ *      exportMatrix:               Copies the elements of a matrix, whatever its storage, into a row-major buffer.
+ *      exportRows:                 Copies some consecutive rows of a matrix the same way.
+ * 12.  printAllowedMatrixNames:    Prints a list of all available matrix names in the context.
+
+ * The program relies on 'mymat.h' for the definition of structures and constants such as 'Matrix', 'MatrixContext', and 'MatrixHandle'.
+ * Matrices are sized at runtime and stored in one contiguous, MATRIX_ALIGNMENT-aligned row-major buffer with a leading
+ * dimension. Every operation checks operand shapes and reports a MatrixStatus. The context holds any number of named matrices.
+ * Element-wise operations, transposes and products large enough to amortize waking the workers are split across the
+ * thread pool of "matpool.c"; smaller ones run on the calling thread. Matrices larger than the memory budget live in
+ * tiles on disk, and every operation involving one is handed to the tiled versions of "matdisk.c". Matrices that are
+ * mostly zeros keep only their non-zero elements, and operations with a sparse operand use the kernels of "matsparse.c".
  *
  * Usage:
  * This library is designed to be used in applications requiring basic matrix operations. It is essential to initialize the
@@ -28,284 +39,905 @@
  */
 
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdbool.h>
 #include <stdio.h>  
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include "mymat.h"
+#include "matgemm.h"
+#include "matstrassen.h"
+#include "mattrans.h"
+#include "matbatch.h"
+#include "matreg.h"
+#include "matsmall.h"
+#include "matsimd.h"
+#include "matpool.h"
+#include "matfmt.h"
+#include "matdisk.h"
+#include "matsparse.h"
+
+
+/* Largest number of elements a single matrix buffer may hold */
+#define MAX_MATRIX_ELEMENTS ((size_t)-1 / sizeof(double))
+
+
+const MatrixStatusProfile MatrixStatuses[NUM_MATRIX_STATUSES] = {
+    {MATRIX_OK, "No error"},                                        /* The operation completed */
+    {MATRIX_DIMENSION_MISMATCH, "Matrix dimensions mismatch"},      /* Operand shapes are not compatible */
+    {MATRIX_INVALID_DIMENSIONS, "Invalid matrix dimensions"},       /* Requested shape cannot be represented */
+    {MATRIX_ALLOCATION_FAILED, "Out of memory"},                    /* Not enough memory for the result */
+    {MATRIX_FILE_ERROR, "Matrix file could not be accessed"},       /* Opening, writing or mapping failed */
+    {MATRIX_FILE_INVALID, "Invalid or corrupted matrix file"},      /* Bad header, size or checksum */
+    {MATRIX_INVALID_ENTRY, "Invalid sparse matrix entry"},          /* Index outside the matrix or not whole */
+    {MATRIX_NOT_SQUARE, "Matrix is not square"},                    /* Determinants, inverses and solves */
+    {MATRIX_SINGULAR, "Matrix is singular"},                        /* A pivot of the factorization is zero */
+    {MATRIX_NOT_SYMMETRIC, "Matrix is not symmetric"},              /* Cholesky factors */
+    {MATRIX_NOT_POSITIVE_DEFINITE, "Matrix is not positive definite"},  /* A pivot of Cholesky is not positive */
+    {MATRIX_RANK_DEFICIENT, "Matrix does not have full column rank"},   /* Least squares has no unique solution */
+    {MATRIX_NOT_CONVERGED, "Iteration did not converge"}                /* Eigenvalues and singular values */
+};
+
+
+double *allocElements(size_t count) {
+    /* 
+     * Allocates an uninitialized buffer of 'count' doubles aligned to MATRIX_ALIGNMENT bytes.
+     * Returns NULL if the allocation fails.
+     */
+    void *block = NULL;    /* Aligned block returned by the allocator */
+
+    if (posix_memalign(&block, MATRIX_ALIGNMENT, count * sizeof(double)) != 0) {
+        return NULL;
+    }
+    return (double *)block;
+}
 
 
-void initMatrices(MatrixContext *ctx, const MatrixProfile validMatrices[NUM_MATRICES]) {
+static void releaseStorage(Matrix *mat) {
     /* 
-     * Initializes matrices within the given MatrixContext to default values and sets their profiles.
-     * Assumes 'ctx' is pre-allocated and relevant size constants are correctly defined.
+     * Short Description:
+     * Releases the buffer of a matrix: unmaps a loaded file, frees allocated storage, tiles on disk or
+     * sparse elements, leaves views alone.
      */
-    int matrix_index;  /* Index for iterating over matrices */
-    int row_index;     /* Index for iterating over rows of a matrix */
-    int col_index;     /* Index for iterating over columns of a matrix */
+    if (mat->sparse != NULL) {
+        freeSparseStore(mat->sparse);
+    } else if (mat->disk != NULL) {
+        freeDiskStore(mat->disk);
+    } else if (mat->mapping != NULL) {
+        munmap(mat->mapping, mat->mappingSize);
+    } else if (mat->capacity > 0) {
+        free(mat->data);
+    }
+    mat->mapping = NULL;
+    mat->mappingSize = 0;
+    mat->disk = NULL;
+    mat->sparse = NULL;
+}
+
+
+static bool isValidShape(int rows, int cols) {
+    /* 
+     * Short Description:
+     * Tells whether a shape is not empty and its number of elements can be represented.
+     */
+    return rows > 0 && cols > 0 && (size_t)rows <= MAX_MATRIX_ELEMENTS / (size_t)cols;
+}
 
 
+static void installSparse(Matrix *mat, int rows, int cols, struct SparseStore *store) {
+    /* 
+     * Short Description:
+     * Replaces the storage of a matrix with sparse elements of the given shape.
+     */
+    releaseStorage(mat);
+    mat->data = NULL;
+    mat->capacity = 0;
+    mat->sparse = store;
+    mat->rows = rows;
+    mat->cols = cols;
+    mat->ld = cols;
+}
 
-    /* Iterate over each matrix to initialize its profile and elements. */
-    for (matrix_index = 0; matrix_index < NUM_MATRICES; ++matrix_index) {
-        /* Set the matrix profile from the predefined validMatrices array. */
-        ctx->profiles[matrix_index] = validMatrices[matrix_index];
 
-        /* Nested loops to initialize each element of the matrix to a default value.
-         * Here, we're initializing each element to 0.0.
-         */
-        for (row_index = 0; row_index < ROWS; ++row_index) {
-            for (col_index = 0; col_index < COLS; ++col_index) {
-                ctx->matrices[matrix_index].data[row_index][col_index] = 0.0;
-            }
+MatrixStatus resizeMatrix(Matrix *mat, int rows, int cols) {
+    /* 
+     * Sets the shape of 'mat', reallocating its buffer only when the current capacity is too small.
+     */
+    size_t needed;      /* Number of elements required by the new shape */
+    double *block;      /* Newly allocated buffer */
+    struct DiskStore *store;    /* Newly created tiles on disk */
+    MatrixStatus status;
+
+    /* Reject empty shapes and shapes whose size cannot be represented */
+    if (!isValidShape(rows, cols)) {
+        return MATRIX_INVALID_DIMENSIONS;
+    }
+    needed = (size_t)rows * (size_t)cols;
+
+    /* A matrix keeping its shape keeps its layout, so a padded (loaded) operand may also be the result;
+       a sparse matrix has neither buffer nor tiles, so it always gets new storage */
+    if (rows == mat->rows && cols == mat->cols && (mat->data != NULL || mat->disk != NULL)) {
+        return MATRIX_OK;
+    }
+
+    /* A shape over the memory budget goes to disk, replacing the storage whatever its size */
+    if (shouldSpill(rows, cols)) {
+        status = createDiskStore(rows, cols, &store);
+        if (status != MATRIX_OK) {
+            return status;
+        }
+        releaseStorage(mat);
+        mat->data = NULL;
+        mat->capacity = 0;
+        mat->disk = store;
+        mat->rows = rows;
+        mat->cols = cols;
+        mat->ld = cols;
+        return MATRIX_OK;
+    }
+
+    /* Grow the buffer if it cannot hold the new shape (a disk or sparse matrix has no buffer) */
+    if (needed > mat->capacity) {
+        block = allocElements(needed);
+        if (block == NULL) {
+            return MATRIX_ALLOCATION_FAILED;
         }
+        releaseStorage(mat);
+        mat->data = block;
+        mat->capacity = needed;
     }
+
+    mat->rows = rows;
+    mat->cols = cols;
+    mat->ld = cols;     /* Owned storage is always packed */
+    return MATRIX_OK;
 }
 
 
+void freeMatrix(Matrix *mat) {
+    /* 
+     * Releases the buffer owned by 'mat' and leaves it as an empty matrix.
+     */
+    releaseStorage(mat);
+    mat->data = NULL;
+    mat->rows = 0;
+    mat->cols = 0;
+    mat->ld = 0;
+    mat->capacity = 0;
+}
+
 
-bool isValidMatrixName(const MatrixContext *ctx, const char *matrixName) {
+MatrixStatus initMatrices(MatrixContext *ctx, const char *const matrixNames[], int matrixCount,
+                          const BatchProfile validBatches[NUM_BATCHES]) {
     /* 
-     * Checks for the validity of the given matrix name against the matrix profiles in the context.
-     * Assumes 'ctx' contains valid profiles and NUM_MATRICES is accurate.
+     * Registers the initial matrices of the given MatrixContext and sets the batch profiles.
+     * Assumes 'ctx' is pre-allocated.
      */
+    int matrix_index;  /* Index for iterating over matrices */
+    int batch_index;   /* Index for iterating over batches */
+    MatrixHandle handle;    /* Handle given to the current matrix */
+    MatrixStatus status;
+
+
+    /* Start the registry and every batch empty so 'freeMatrices' is safe even if an allocation below fails */
+    ctx->matrices = NULL;
+    ctx->names = NULL;
+    ctx->hashes = NULL;
+    ctx->slots = NULL;
+    ctx->count = 0;
+    ctx->capacity = 0;
+    ctx->slotCount = 0;
+    ctx->versions = NULL;
+    ctx->lastVersion = 0;
+    ctx->cache = NULL;
+    ctx->factors = NULL;
+    for (batch_index = 0; batch_index < NUM_BATCHES; ++batch_index) {
+        ctx->batches[batch_index].data = NULL;
+        freeBatch(&ctx->batches[batch_index]);
+    }
 
-    int matrix_index;  /* Index for iterating over the matrix profiles */
+    /* Register each initial name with a zero matrix of the default shape */
+    for (matrix_index = 0; matrix_index < matrixCount; ++matrix_index) {
+        status = registerMatrix(ctx, matrixNames[matrix_index], strlen(matrixNames[matrix_index]), &handle);
+        if (status != MATRIX_OK) {
+            return status;
+        }
+    }
 
-    /* Loop through each matrix profile in the context */
-    for (matrix_index = 0; matrix_index < NUM_MATRICES; matrix_index++) {
-        /* Compare the current matrix name in the context with the provided matrixName
-         * strcmp returns 0 if the strings are equal */
-        if (!strcmp(ctx->profiles[matrix_index].nameString, matrixName)) {
-            return true;    /* Return true if a match is found */
+    /* Every batch starts with a single zero matrix */
+    for (batch_index = 0; batch_index < NUM_BATCHES; ++batch_index) {
+        ctx->batchProfiles[batch_index] = validBatches[batch_index];
+        status = readBatch(&ctx->batches[batch_index], 1, NULL, 0);
+        if (status != MATRIX_OK) {
+            return status;
         }
     }
-    return false;           /* Return false if no match is found after checking all profiles */
+    return MATRIX_OK;
+}
+
+
+void freeMatrices(MatrixContext *ctx) {
+    /* 
+     * Releases the storage of every matrix, name and batch in the context.
+     */
+    int batch_index;   /* Index for iterating over batches */
+
+    freeRegistry(ctx);
+    for (batch_index = 0; batch_index < NUM_BATCHES; ++batch_index) {
+        freeBatch(&ctx->batches[batch_index]);
+    }
+}
+
+
+/* Source of the rows printed from a matrix on disk or a sparse matrix */
+typedef struct {
+    const Matrix *mat;      /* Disk or sparse matrix being printed */
+    double *row;            /* Buffer receiving one row */
+    MatrixStatus status;    /* Status of the last read */
+} TiledRows;
+
+
+static const double *readTiledRows(void *source, int row) {
+    /* 
+     * Short Description:
+     * RowReader of 'printRows' gathering the rows of a disk matrix from its tiles.
+     */
+    TiledRows *rows = source;
+
+    rows->status = readTiledRow(rows->mat, row, rows->row);
+    return (rows->status == MATRIX_OK) ? rows->row : NULL;
+}
+
+
+static const double *readSparseRows(void *source, int row) {
+    /* 
+     * Short Description:
+     * RowReader of 'printRows' expanding the rows of a sparse matrix.
+     */
+    TiledRows *rows = source;
+
+    expandSparseRow(rows->mat, row, rows->row);
+    return rows->row;
 }
 
 
-void printMatrix(const MatrixContext *ctx, const char *matrixName) {
+MatrixStatus printMatrix(const Matrix *mat) {
     /* 
      * Function to print the matrix
-     * Retrieve the matrix by its name from the context 
      */
-    const Matrix mat = ctx->matrices[getMatrixEnumByName(matrixName, ctx)];
+    TiledRows rows;     /* Rows of a disk or sparse matrix */
+
+    if (mat->disk == NULL && mat->sparse == NULL) {
+        printElements(mat->data, (size_t)mat->ld, mat->rows, mat->cols);
+        return MATRIX_OK;
+    }
+
+    /* Only the rows shown are read, so a summary of a large matrix reads few tiles or expands few rows */
+    rows.mat = mat;
+    rows.row = allocElements((size_t)mat->cols);
+    rows.status = MATRIX_OK;
+    if (rows.row == NULL) {
+        return MATRIX_ALLOCATION_FAILED;
+    }
+    printRows((mat->disk != NULL) ? readTiledRows : readSparseRows, &rows, mat->rows, mat->cols);
+    free(rows.row);
+    return rows.status;
+}
+
+
+MatrixStatus readMatrix(Matrix *mat, int rows, int cols, const double *array, size_t count) {
+    /* 
+     * Short Description:
+     * Reads data from an array and assigns it to the matrix.
+     */
+
+    size_t index = 0;   /* Index for iterating over the elements in the input array */
+    int row, column;    /* Variables for row and column indices in the matrix */
+    struct SparseStore *store;  /* Elements of a sparse matrix */
+    MatrixStatus status;
+
+    /* Values that are mostly zeros are packed directly, without a dense buffer */
+    if (rows <= 0 || cols <= 0) {
+        rows = mat->rows;
+        cols = mat->cols;
+    }
+    if (isValidShape(rows, cols) && isSparseArray(rows, cols, array, count)) {
+        status = packSparse(rows, cols, array, count, &store);
+        if (status == MATRIX_OK) {
+            installSparse(mat, rows, cols, store);
+        }
+        return status;
+    }
+
+    /* Apply the requested shape; a sparse matrix keeping its shape gets a dense buffer */
+    status = resizeMatrix(mat, rows, cols);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    if (mat->disk != NULL) {
+        return fillTiled(mat, array, count);
+    }
+
+    /* Iterate over each row and column of the matrix */
+    for (row = 0; row < mat->rows; ++row) {
+        for (column = 0; column < mat->cols; ++column) {
+            /* Assign each element from the array to the corresponding matrix cell, padding with zeros */
+            MATRIX_AT(mat, row, column) = (index < count) ? array[index] : 0.0;
+            index++;
+        }
+    }
+    return MATRIX_OK;
+}
+
+
+static MatrixStatus storeSparseResult(Matrix *result, int rows, int cols, struct SparseStore *store) {
+    /* 
+     * Short Description:
+     * Gives a result built sparse to 'result': as it is if it is sparse enough, otherwise expanded into
+     * dense storage (on disk if it is too large for memory). Takes ownership of 'store'.
+     */
+    Matrix built = {NULL, 0, 0, 0, 0, NULL, 0, NULL, NULL};    /* The result as a sparse matrix */
+    MatrixStatus status;
 
-    int row, column;                    /* Variables for row and column indices */
-    char formatStr[FORMAT_STR_SIZE];    /* Character array to hold the formatted output string */
+    if (shouldStoreSparse(rows, cols, countStored(store))) {
+        installSparse(result, rows, cols, store);
+        return MATRIX_OK;
+    }
+    built.rows = rows;
+    built.cols = cols;
+    built.ld = cols;
+    built.sparse = store;
+    status = resizeMatrix(result, rows, cols);
+    if (status == MATRIX_OK) {
+        status = expandSparse(&built, result);
+    }
+    freeSparseStore(store);
+    return status;
+}
 
-    /* Dynamically create the format string based on the width and precision for matrix element printing */
-    sprintf(formatStr, "%%%d.%df ", MATRIX_PRINT_WIDTH, MATRIX_PRINT_PREC);
 
+MatrixStatus readSparseMatrix(Matrix *mat, int rows, int cols, const double *triples, size_t count) {
+    /* 
+     * Short Description:
+     * Builds the elements from their coordinates and stores them like the result of an operation.
+     */
+    struct SparseStore *store;  /* Elements of the matrix */
+    MatrixStatus status;
 
-    for (row = 0; row < ROWS; ++row) {                  /* Iterate over each row of the matrix */
-        for (column = 0; column < COLS; ++column) {     /* Iterate over each column in the current row */
-            printf(formatStr, mat.data[row][column]);   /* Print each element in the row using the formatted string */
-        } 
-        printf("\n");                                   /* Print a new line at the end of each row for better readability */
+    if (rows <= 0 || cols <= 0) {
+        rows = mat->rows;
+        cols = mat->cols;
+    }
+    if (!isValidShape(rows, cols)) {
+        return MATRIX_INVALID_DIMENSIONS;
     }
+    status = buildSparse(rows, cols, triples, count, &store);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+    return storeSparseResult(mat, rows, cols, store);
 }
 
 
 
-MatrixEnum getMatrixEnumByName(const char *matrixName, const MatrixContext *ctx) {
+static bool isPacked(const Matrix *mat) {
     /* 
      * Short Description:
-     * Finds and returns the enum value of a matrix based on its name.
-     * Returns -1 if the matrix name is not found.
+     * Tells whether the rows of a matrix follow each other without gaps.
      */
+    return mat->ld == mat->cols || mat->rows == 1;
+}
+
+
+/* Arguments of an element-wise operation split across the thread pool */
+typedef struct {
+    void (*binary)(const double *, const double *, double *, size_t);  /* Kernel for two operands, or NULL */
+    void (*scale)(const double *, double, double *, size_t);           /* Kernel for one operand and a scalar */
+    const Matrix *mat1;     /* First operand */
+    const Matrix *mat2;     /* Second operand (binary kernels only) */
+    Matrix *result;         /* Result, shaped like the operands */
+    double scalar;          /* Scalar operand (scale kernel only) */
+    bool packed;            /* Whether indices are elements of packed buffers rather than rows */
+} ElementwiseTask;
 
-    MatrixEnum mat;  /* Variable for iterating over matrix profiles*/
 
-    /* Loop through each matrix profile in the context */
-    for (mat = 0; mat < NUM_MATRICES; ++mat) {
-        
-        /* Compare the current matrix name in the context with the provided matrixName
-         * strcmp returns 0 if strings are equal */
-        if (!strcmp(ctx->profiles[mat].nameString, matrixName)) {
-            return ctx->profiles[mat].name;  /* Return the enum value of the matrix if a match is found */
+static void runElementwiseTask(size_t begin, size_t end, int worker, void *arg) {
+    /* 
+     * Short Description:
+     * Applies the kernel of an ElementwiseTask to elements (packed) or rows (views) [begin, end).
+     */
+    const ElementwiseTask *task = arg;
+    size_t row;     /* Variable for row index */
+    size_t count;   /* Elements handled per kernel call */
+    (void)worker;
+
+    if (task->packed) {
+        count = end - begin;
+        if (task->binary != NULL) {
+            task->binary(task->mat1->data + begin, task->mat2->data + begin, task->result->data + begin, count);
+        } else {
+            task->scale(task->mat1->data + begin, task->scalar, task->result->data + begin, count);
+        }
+        return;
+    }
+    for (row = begin; row < end; ++row) {
+        count = (size_t)task->mat1->cols;
+        if (task->binary != NULL) {
+            task->binary(&MATRIX_AT(task->mat1, row, 0), &MATRIX_AT(task->mat2, row, 0),
+                         &MATRIX_AT(task->result, row, 0), count);
+        } else {
+            task->scale(&MATRIX_AT(task->mat1, row, 0), task->scalar, &MATRIX_AT(task->result, row, 0), count);
         }
     }
-    /* Return -1 if no match is found after checking all profiles*/
-    return -1;
 }
 
 
-void readMatrix(MatrixContext *ctx, const char *matrixName, const double array[ROWS * COLS]) {
+static void runElementwise(ElementwiseTask *task) {
     /* 
      * Short Description:
-     * Reads data from an array and assigns it to the specified matrix in the context.
-     * Relies on 'getMatrixEnumByName' to find the correct matrix by name.
+     * Runs an element-wise operation, splitting it across the thread pool when it is large enough.
+     * Packed matrices are processed as one flat array, views row by row.
      */
+    size_t elements = (size_t)task->mat1->rows * (size_t)task->mat1->cols;  /* Total number of elements */
+
+    task->packed = isPacked(task->mat1) && isPacked(task->result) &&
+                   (task->binary == NULL || isPacked(task->mat2));
+    if (task->packed) {
+        parallelFor(elements, PARALLEL_MIN_ELEMENTS, runElementwiseTask, task);
+    } else {
+        parallelFor((size_t)task->mat1->rows, PARALLEL_MIN_ELEMENTS / (size_t)task->mat1->cols + 1,
+                    runElementwiseTask, task);
+    }
+}
 
-    int index = 0;      /* Index for iterating over the elements in the input array */
-    int row, column;    /* Variables for row and column indices in the matrix */
 
-    /* Iterate over each row and column of the matrix */
-    for (row = 0; row < ROWS; ++row) {
-        for (column = 0; column < COLS; ++column) {
-            /* Assign each element from the array to the corresponding matrix cell */
-            /* Uses 'index' to access elements in the linear input array */
-            ctx->matrices[getMatrixEnumByName(matrixName, ctx)].data[row][column] = array[index++];
-        }
+static void applyBinaryKernel(void (*kernel)(const double *, const double *, double *, size_t),
+                              const Matrix *mat1, const Matrix *mat2, Matrix *result) {
+    /* 
+     * Short Description:
+     * Runs an element-wise SIMD kernel over two equally shaped matrices.
+     */
+    ElementwiseTask task;
+
+    task.binary = kernel;
+    task.scale = NULL;
+    task.mat1 = mat1;
+    task.mat2 = mat2;
+    task.result = result;
+    task.scalar = 0.0;
+    runElementwise(&task);
+}
+
+
+static MatrixStatus expandOperand(const Matrix *mat, Matrix *dense) {
+    /* 
+     * Short Description:
+     * Writes a sparse operand into a dense temporary matrix, for the operations that need dense operands.
+     */
+    MatrixStatus status;
+
+    status = resizeMatrix(dense, mat->rows, mat->cols);
+    if (status == MATRIX_OK) {
+        status = expandSparse(mat, dense);
     }
+    return status;
 }
 
 
+static MatrixStatus combineSparse(const Matrix *mat1, const Matrix *mat2, bool subtract, Matrix *result) {
+    /* 
+     * Short Description:
+     * Adds or subtracts two equally shaped matrices of which at least one is sparse. Two sparse operands
+     * give a sparse result (unless too few elements cancel out); a dense operand in memory gives a dense
+     * result; a dense operand on disk, or a result too large for memory, takes the tiled path with the
+     * sparse operand expanded.
+     */
+    Matrix temp = {NULL, 0, 0, 0, 0, NULL, 0, NULL, NULL};    /* Expanded operand, or result apart from them */
+    const Matrix *sparse = (mat1->sparse != NULL) ? mat1 : mat2;   /* The sparse operand */
+    const Matrix *dense = (sparse == mat1) ? mat2 : mat1;           /* The other operand */
+    double factor = subtract ? -1.0 : 1.0;      /* Factor of the second operand */
+    Matrix *target;                             /* Matrix receiving a dense result */
+    struct SparseStore *store;                  /* Elements of a sparse result */
+    MatrixStatus status;
+
+    if (mat1->sparse != NULL && mat2->sparse != NULL) {
+        status = addSparse(mat1, mat2, factor, &store);
+        return (status == MATRIX_OK) ? storeSparseResult(result, mat1->rows, mat1->cols, store) : status;
+    }
+
+    if (dense->disk != NULL || shouldSpill(mat1->rows, mat1->cols)) {
+        status = expandOperand(sparse, &temp);
+        if (status == MATRIX_OK) {
+            status = subtract ? subMatrices((sparse == mat1) ? &temp : mat1, (sparse == mat2) ? &temp : mat2, result)
+                              : addMatrices((sparse == mat1) ? &temp : mat1, (sparse == mat2) ? &temp : mat2, result);
+        }
+        freeMatrix(&temp);
+        return status;
+    }
+
+    /* The result is written row by row over the dense operand, so it must not be the sparse one */
+    target = (result == sparse) ? &temp : result;
+    status = resizeMatrix(target, mat1->rows, mat1->cols);
+    if (status == MATRIX_OK) {
+        addSparseDense(sparse, (sparse == mat2) ? factor : 1.0, dense, (dense == mat2) ? factor : 1.0, target);
+    }
+    if (target == &temp && status == MATRIX_OK) {
+        freeMatrix(result);
+        *result = temp;
+    } else {
+        freeMatrix(&temp);
+    }
+    return status;
+}
+
 
-void addMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result) {
+MatrixStatus addMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result) {
     /* 
      * Short Description:
      * Performs element-wise addition of two matrices and stores the result in a third matrix.
      */
 
-    int row;    /* Variable for row index */
-    int column; /* Variable for column index */
+    const SmallKernels *small;  /* Kernels specialized for the shape, if any */
+    MatrixStatus status;
 
-    /* Iterate over each row and column of the matrices */
-    for (row = 0; row < ROWS; ++row) {
-        for (column = 0; column < COLS; ++column) {
-            /* Add corresponding elements from mat1 and mat2, and store in result */
-            result->data[row][column] = mat1->data[row][column] + mat2->data[row][column];
-        }
+    if (mat1->rows != mat2->rows || mat1->cols != mat2->cols) {
+        return MATRIX_DIMENSION_MISMATCH;
+    }
+    if (mat1->sparse != NULL || mat2->sparse != NULL) {
+        return combineSparse(mat1, mat2, false, result);
+    }
+    if (mat1->disk != NULL || mat2->disk != NULL || shouldSpill(mat1->rows, mat1->cols)) {
+        return addTiled(mat1, mat2, result);
+    }
+    status = resizeMatrix(result, mat1->rows, mat1->cols);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    small = getSmallKernels(mat1->rows, mat1->cols);
+    if (small != NULL) {
+        small->add(mat1->data, mat1->ld, mat2->data, mat2->ld, result->data, result->ld);
+        return MATRIX_OK;
     }
+
+    /* Add corresponding elements from mat1 and mat2, and store in result */
+    applyBinaryKernel(getSimdKernels()->add, mat1, mat2, result);
+    return MATRIX_OK;
 }
 
 
-void subMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result) {
+MatrixStatus subMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result) {
     /* 
      * Short Description:
      * Performs element-wise subtraction of two matrices and stores the result in a third matrix.
      */
 
-    int row;    /* Variable for row index */
-    int column; /* Variable for column index */
+    const SmallKernels *small;  /* Kernels specialized for the shape, if any */
+    MatrixStatus status;
 
-    /* Iterate over each row and column of the matrices */
-    for (row = 0; row < ROWS; ++row) {
-        for (column = 0; column < COLS; ++column) {
-            /* Subtract corresponding elements of mat2 from mat1, store in result */
-            result->data[row][column] = mat1->data[row][column] - mat2->data[row][column];
-        }
+    if (mat1->rows != mat2->rows || mat1->cols != mat2->cols) {
+        return MATRIX_DIMENSION_MISMATCH;
+    }
+    if (mat1->sparse != NULL || mat2->sparse != NULL) {
+        return combineSparse(mat1, mat2, true, result);
+    }
+    if (mat1->disk != NULL || mat2->disk != NULL || shouldSpill(mat1->rows, mat1->cols)) {
+        return subTiled(mat1, mat2, result);
+    }
+    status = resizeMatrix(result, mat1->rows, mat1->cols);
+    if (status != MATRIX_OK) {
+        return status;
     }
+
+    small = getSmallKernels(mat1->rows, mat1->cols);
+    if (small != NULL) {
+        small->sub(mat1->data, mat1->ld, mat2->data, mat2->ld, result->data, result->ld);
+        return MATRIX_OK;
+    }
+
+    /* Subtract corresponding elements of mat2 from mat1, store in result */
+    applyBinaryKernel(getSimdKernels()->sub, mat1, mat2, result);
+    return MATRIX_OK;
 }
 
 
 
-void multiplyMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result) {
+static MatrixStatus multiplySparseOperands(const Matrix *mat1, const Matrix *mat2, Matrix *result) {
     /* 
      * Short Description:
-     * Performs matrix multiplication of two matrices and stores the result in a third matrix.
+     * Multiplies two matrices of which at least one is sparse: SpGEMM for two sparse operands, SpMM (or
+     * SpMV) and its mirror for one sparse operand and one dense operand in memory, and the tiled product
+     * with the sparse operand expanded when a dense operand is on disk or the result too large for memory.
      */
+    Matrix temp = {NULL, 0, 0, 0, 0, NULL, 0, NULL, NULL};    /* Expanded sparse operand */
+    struct SparseStore *store;      /* Elements of a sparse product */
+    MatrixStatus status;
 
-    int row, column, inner; /* Variables for row, column, and inner loop indices */
+    if (mat1->sparse != NULL && mat2->sparse != NULL) {
+        status = multiplySparse(mat1, mat2, &store);
+        return (status == MATRIX_OK) ? storeSparseResult(result, mat1->rows, mat2->cols, store) : status;
+    }
 
-    /* Initialize the result matrix to all zeros */
-    for (row = 0; row < ROWS; ++row) {
-        for (column = 0; column < COLS; ++column) {
-            result->data[row][column] = 0.0;
+    if (mat1->disk != NULL || mat2->disk != NULL || shouldSpill(mat1->rows, mat2->cols)) {
+        status = expandOperand((mat1->sparse != NULL) ? mat1 : mat2, &temp);
+        if (status == MATRIX_OK) {
+            status = multiplyMatrices((mat1->sparse != NULL) ? &temp : mat1, (mat2->sparse != NULL) ? &temp : mat2,
+                                      result);
         }
+        freeMatrix(&temp);
+        return status;
     }
 
-    /* Perform matrix multiplication */
-    for (row = 0; row < ROWS; ++row) {
-        for (column = 0; column < COLS; ++column) {
-            for (inner = 0; inner < COLS; ++inner) {
-                /* Accumulate the dot product of the row of mat1 and column of mat2 */
-                result->data[row][column] += mat1->data[row][inner] * mat2->data[inner][column];
-            }
-        }
+    status = resizeMatrix(result, mat1->rows, mat2->cols);
+    if (status != MATRIX_OK) {
+        return status;
     }
+    if (mat1->sparse != NULL) {
+        multiplySparseDense(mat1, mat2, result);
+    } else {
+        multiplyDenseSparse(mat1, mat2, result);
+    }
+    return MATRIX_OK;
 }
 
 
-void multiplyScalar(const Matrix *mat, const double scalar, Matrix *result) {
+MatrixStatus multiplyMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result) {
+    /* 
+     * Short Description:
+     * Performs matrix multiplication of two matrices and stores the result in a third matrix.
+     * Large products use Strassen-Winograd, small square ones a size-specialized kernel and the
+     * others the cache-blocked GEMM engine.
+     */
+
+    const SmallKernels *small;  /* Kernels specialized for the shape, if any */
+    MatrixStatus status;
+
+    if (mat1->cols != mat2->rows) {
+        return MATRIX_DIMENSION_MISMATCH;
+    }
+    if (mat1->sparse != NULL || mat2->sparse != NULL) {
+        return multiplySparseOperands(mat1, mat2, result);
+    }
+    if (mat1->disk != NULL || mat2->disk != NULL || shouldSpill(mat1->rows, mat2->cols)) {
+        return multiplyTiled(mat1, mat2, result);
+    }
+    status = resizeMatrix(result, mat1->rows, mat2->cols);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    if (shouldUseStrassen(mat1->rows, mat2->cols, mat1->cols)) {
+        return strassen(mat1->rows, mat2->cols, mat1->cols, mat1->data, mat1->ld, mat2->data, mat2->ld,
+                        result->data, result->ld);
+    }
+
+    small = getSmallKernels(mat1->rows, mat1->cols);
+    if (small != NULL && mat2->cols == mat2->rows) {
+        small->multiply(mat1->data, mat1->ld, mat2->data, mat2->ld, result->data, result->ld);
+        return MATRIX_OK;
+    }
+
+    /* result = 1.0 * mat1 * mat2 + 0.0 * result */
+    return gemm(GEMM_NO_TRANS, GEMM_NO_TRANS, mat1->rows, mat2->cols, mat1->cols,
+                1.0, mat1->data, mat1->ld, mat2->data, mat2->ld, 0.0, result->data, result->ld);
+}
+
+
+MatrixStatus multiplyScalar(const Matrix *mat, const double scalar, Matrix *result) {
     /* 
      * Short Description:
      * Scales each element of a matrix by a scalar value and stores the result in another matrix.
      */
 
-    int row, column; /* Variables for row and column indices */
+    ElementwiseTask task;
+    struct SparseStore *store;  /* Elements of a sparse result */
+    MatrixStatus status;
 
-    /* Iterate over each row and column of the matrix */
-    for (row = 0; row < ROWS; ++row) {
-        for (column = 0; column < COLS; ++column) {
-            /* Multiply each element by the scalar and store in the result */
-            result->data[row][column] = scalar * mat->data[row][column]; 
-        } 
+    if (mat->sparse != NULL) {
+        status = scaleSparse(mat, scalar, &store);
+        return (status == MATRIX_OK) ? storeSparseResult(result, mat->rows, mat->cols, store) : status;
+    }
+    if (mat->disk != NULL || shouldSpill(mat->rows, mat->cols)) {
+        return scaleTiled(mat, scalar, result);
     }
+    status = resizeMatrix(result, mat->rows, mat->cols);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    /* Multiply each element by the scalar and store in the result */
+    task.binary = NULL;
+    task.scale = getSimdKernels()->scale;
+    task.mat1 = mat;
+    task.mat2 = NULL;
+    task.result = result;
+    task.scalar = scalar;
+    runElementwise(&task);
+    return MATRIX_OK;
+}
+
+/* Operands of a transpose split across the thread pool */
+typedef struct {
+    const Matrix *original;     /* Matrix being transposed */
+    Matrix *transposed;         /* Destination, shaped cols x rows */
+} TransposeTask;
+
+
+static void runTransposeTask(size_t begin, size_t end, int worker, void *arg) {
+    /* 
+     * Short Description:
+     * Transposes the rows [begin, end) of the original matrix into columns of the destination.
+     */
+    const TransposeTask *task = arg;
+    (void)worker;
+
+    /* Place the element at [row][column] in the original to [column][row] in the transposed */
+    transposeBuffer((int)(end - begin), task->original->cols, &MATRIX_AT(task->original, begin, 0),
+                    task->original->ld, &MATRIX_AT(task->transposed, 0, begin), task->transposed->ld);
 }
 
-void transposeMatrix(const Matrix *original, Matrix *transposed) {
+
+MatrixStatus transposeMatrix(const Matrix *original, Matrix *transposed) {
     /* 
      * Short Description:
      * Transposes a matrix, flipping its rows and columns, and stores the result in another matrix.
+     * Rows of the original are split across the thread pool; each band is transposed cache-obliviously.
      */
 
-    int row, column; /* Variables for row and column indices */
+    TransposeTask task;
+    const SmallKernels *small;  /* Kernels specialized for the shape, if any */
+    struct SparseStore *store;  /* Elements of a sparse result */
+    MatrixStatus status;
 
-    /* Iterate over each row and column of the original matrix */
-    for (row = 0; row < ROWS; ++row) {
-        for (column = 0; column < COLS; ++column) { 
-            /* Place the element at [row][column] in the original to [column][row] in the transposed */
-            transposed->data[column][row] = original->data[row][column];
-        }
+    if (original->sparse != NULL) {
+        status = transposeSparse(original, &store);
+        return (status == MATRIX_OK) ? storeSparseResult(transposed, original->cols, original->rows, store) : status;
+    }
+    if (original->disk != NULL || shouldSpill(original->cols, original->rows)) {
+        return transposeTiled(original, transposed);
+    }
+    status = resizeMatrix(transposed, original->cols, original->rows);
+    if (status != MATRIX_OK) {
+        return status;
     }
+
+    small = getSmallKernels(original->rows, original->cols);
+    if (small != NULL) {
+        small->transpose(original->data, original->ld, transposed->data, transposed->ld);
+        return MATRIX_OK;
+    }
+
+    task.original = original;
+    task.transposed = transposed;
+    parallelFor((size_t)original->rows, PARALLEL_MIN_ELEMENTS / (size_t)original->cols + 1, runTransposeTask, &task);
+    return MATRIX_OK;
 }
 
 
-void transposeMatrixInPlace(Matrix *matrix) {
+MatrixStatus transposeMatrixInPlace(Matrix *matrix) {
     /* 
      * Short Description:
-     * Transposes a square matrix in-place, modifying the original matrix.
+     * Transposes a matrix in-place, modifying the original matrix.
+     * Square matrices swap tiles across the diagonal; packed rectangular ones follow the cycles
+     * of the transpose permutation, so neither needs a second buffer. Disk and sparse matrices are copied.
      */
 
-    int row, column; /* Variables for row and column indices */
-    double temp;     /* Temporary variable for swapping values */
+    Matrix copy = {NULL, 0, 0, 0, 0, NULL, 0, NULL, NULL};    /* Temporary transposed copy for padded rectangular matrices */
+    MatrixStatus status;
+    int rows = matrix->rows;           /* Number of rows before the transpose */
 
-    /* Iterate over the upper triangle of the matrix */
-    for (row = 0; row < ROWS; ++row) {
-        for (column = row + 1; column < COLS; ++column) {
-            /* Swap elements across the diagonal */
-            temp = matrix->data[row][column];
-            matrix->data[row][column] = matrix->data[column][row];
-            matrix->data[column][row] = temp;
+    if (matrix->disk == NULL && matrix->sparse == NULL && matrix->rows == matrix->cols) {
+        transposeSquareInPlace(matrix->rows, matrix->data, matrix->ld);
+        return MATRIX_OK;
+    }
+
+    if (matrix->disk == NULL && matrix->sparse == NULL && isPacked(matrix)) {
+        status = transposePackedInPlace(matrix->rows, matrix->cols, matrix->data);
+        if (status != MATRIX_OK) {
+            return status;
         }
+        matrix->rows = matrix->cols;
+        matrix->cols = rows;
+        matrix->ld = rows;
+        return MATRIX_OK;
+    }
+
+    /* A padded rectangular matrix changes layout as well as shape, tiles on disk move between tiles of
+       the file and sparse elements move between rows, so go through a temporary copy */
+    status = transposeMatrix(matrix, &copy);
+    if (status != MATRIX_OK) {
+        freeMatrix(&copy);
+        return status;
     }
+    freeMatrix(matrix);
+    *matrix = copy;
+    return MATRIX_OK;
 }
 
 
-void multiplyMatricesInPlace(const Matrix *mat1, Matrix *result) {
+MatrixStatus multiplyMatricesInPlace(const Matrix *mat1, const Matrix *mat2, Matrix *result) {
     /* 
      * Short Description:
      * Multiplies two matrices and stores the result in the 'result' matrix.
      * Uses a temporary matrix to avoid overwriting data in 'result' prematurely.
      */
 
-    Matrix temp; /* Temporary matrix to store intermediate results */
-    int row, column, inner; /* Variables for row, column, and inner loop indices */
+    Matrix temp = {NULL, 0, 0, 0, 0, NULL, 0, NULL, NULL};     /* Temporary matrix to store intermediate results */
+    MatrixStatus status;
 
-    /* Initialize the temp matrix to all zeros */
-    for (row = 0; row < ROWS; ++row) {
-        for (column = 0; column < COLS; ++column) {
-            temp.data[row][column] = 0.0;
-        }
+    /* Perform matrix multiplication and store in temp */
+    status = multiplyMatrices(mat1, mat2, &temp);
+    if (status != MATRIX_OK) {
+        freeMatrix(&temp);
+        return status;
     }
 
-    /* Perform matrix multiplication and store in temp */
-    for (row = 0; row < ROWS; ++row) {
-        for (column = 0; column < COLS; ++column) {
-            for (inner = 0; inner < COLS; ++inner) {
-                temp.data[row][column] += result->data[row][inner] * mat1->data[inner][column];
-            }
-        }
+    /* Hand the storage of temp over to result */
+    freeMatrix(result);
+    *result = temp;
+    return MATRIX_OK;
+}
+
+
+MatrixStatus copyMatrix(const Matrix *source, Matrix *destination) {
+    /* 
+     * Short Description:
+     * Copies the elements of a matrix into another, in one block when both are packed and row by row
+     * otherwise. A matrix on disk, or too large for memory, is copied tile by tile by scaling by 1,
+     * which is exact; so is a sparse matrix, element by element.
+     */
+    int row;    /* Variable for row index */
+    MatrixStatus status;
+
+    if (source == destination) {
+        return MATRIX_OK;
+    }
+    if (source->sparse != NULL) {
+        return multiplyScalar(source, 1.0, destination);
     }
+    if (source->disk != NULL || shouldSpill(source->rows, source->cols)) {
+        return scaleTiled(source, 1.0, destination);
+    }
+    status = resizeMatrix(destination, source->rows, source->cols);
+    if (status != MATRIX_OK) {
+        return status;
+    }
+
+    if (isPacked(source) && isPacked(destination)) {
+        memcpy(destination->data, source->data, (size_t)source->rows * (size_t)source->cols * sizeof(double));
+        return MATRIX_OK;
+    }
+    for (row = 0; row < source->rows; ++row) {
+        memcpy(&MATRIX_AT(destination, row, 0), &MATRIX_AT(source, row, 0), (size_t)source->cols * sizeof(double));
+    }
+    return MATRIX_OK;
+}
+
 
-    /* Copy the result from temp back into result */
-    for (row = 0; row < ROWS; ++row) {
-        for (column = 0; column < COLS; ++column) {
-            result->data[row][column] = temp.data[row][column];
+MatrixStatus exportMatrix(const Matrix *mat, double *buffer, size_t ld) {
+    return exportRows(mat, 0, mat->rows, buffer, ld);
+}
+
+
+MatrixStatus exportRows(const Matrix *mat, int first, int count, double *buffer, size_t ld) {
+    int row;    /* Variable for row index */
+    MatrixStatus status;
+
+    for (row = 0; row < count; ++row) {
+        if (mat->sparse != NULL) {
+            expandSparseRow(mat, first + row, &buffer[(size_t)row * ld]);
+        } else if (mat->disk != NULL) {
+            status = readTiledRow(mat, first + row, &buffer[(size_t)row * ld]);
+            if (status != MATRIX_OK) {
+                return status;
+            }
+        } else {
+            memcpy(&buffer[(size_t)row * ld], &MATRIX_AT(mat, first + row, 0), (size_t)mat->cols * sizeof(double));
         }
     }
+    return MATRIX_OK;
 }
 
 
@@ -315,14 +947,19 @@ void printAllowedMatrixNames(const MatrixContext *ctx) {
      * Prints a list of all available matrix names in the provided MatrixContext.
      */
 
-    int matrix_index; /* Variable for iterating over matrix profiles */
+    int matrix_index; /* Variable for iterating over the matrix handles */
 
     /* Header message for the list of matrix names */
     printf("Below are the available matrix Names:\n");
 
-    /* Iterate through matrix profiles and print each name */
-    for (matrix_index = 0; matrix_index < NUM_MATRICES; matrix_index++)
-        printf("%d: %s\t", matrix_index + 1, ctx->profiles[matrix_index].nameString);
+    /* Iterate through the registered names and print each one */
+    for (matrix_index = 0; matrix_index < ctx->count; matrix_index++)
+        printf("%d: %s\t", matrix_index + 1, ctx->names[matrix_index]);
+
+    /* Batches of 4x4 matrices have names of their own */
+    printf("\n\nBelow are the available batch Names:\n");
+    for (matrix_index = 0; matrix_index < NUM_BATCHES; matrix_index++)
+        printf("%d: %s\t", matrix_index + 1, ctx->batchProfiles[matrix_index].nameString);
     
     /* Print a newline for better formatting */
     printf("\n\n");
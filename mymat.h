@@ -6,24 +6,35 @@
  * a predefined context, 'MatrixContext'.
  *
  * Core Structures and Constants:
- * - Matrix:        A structure representing a 2D matrix with double-precision elements.
- * - MatrixEnum:    An enumeration representing different matrix names.
- * - MatrixProfile: A structure associating matrix names with their string representations.
- * - MatrixContext: A structure to store multiple matrices and their profiles.
+ * - Matrix:        A runtime-sized 2D matrix stored in one contiguous, aligned row-major buffer, in tiles
+ *                  on disk when it exceeds the memory budget (see "matdisk.h"), or as its non-zero elements
+ *                  when few enough of them are (see "matsparse.h").
+ * - MatrixStatus:  An enumeration of the outcomes of a matrix operation.
+ * - MatrixHandle:  The index of a named matrix in the context (see "matreg.h").
+ * - MatrixBatch:   A runtime-sized batch of BATCH_DIM x BATCH_DIM matrices in an AoSoA layout (see "matbatch.h").
+ * - BatchEnum:     An enumeration representing different batch names.
+ * - BatchProfile:  A structure associating batch names with their string representations.
+ * - MatrixContext: A structure to store the named matrices, the batches and their profiles.
  *
  * Core Functions:
- * - initMatrices:              Initializes matrices in the context to default values and sets their profiles.
- * - isValidMatrixName:         Validates matrix names against predefined profiles in the context.
- * - printMatrix:               Prints a matrix based on its name.
- * - getMatrixEnumByName:       Retrieves the enum value of a matrix based on its name.
- * - readMatrix:                Reads data from an array and assigns it to the specified matrix in the context.
+ * - initMatrices:              Registers the initial matrices of the context with default values and sets the batch profiles.
+ * - freeMatrices:              Releases the storage of every matrix and name in the context.
+ * - resizeMatrix:              Gives a matrix new dimensions, growing its storage when needed.
+ * - freeMatrix:                Releases the storage of a single matrix.
+ * - allocElements:             Allocates an aligned buffer of doubles.
+ * - printMatrix:               Prints a matrix.
+ * - readMatrix:                Reads data from an array and assigns it to a matrix.
+ * - readSparseMatrix:          Assigns the elements given as (row, column, value) triples to a matrix.
  * - addMatrices:               Performs element-wise addition of two matrices.
  * - subMatrices:               Performs element-wise subtraction between two matrices.
  * - multiplyMatrices:          Conducts matrix multiplication of two matrices.
  * - multiplyScalar:            Scales each element of a matrix by a scalar value.
  * - transposeMatrix:           Transposes a matrix and stores the result in another matrix.
- * - transposeMatrixInPlace:    Transposes a square matrix in-place.
+ * - transposeMatrixInPlace:    Transposes a matrix in-place.
  * - multiplyMatricesInPlace:   Multiplies two matrices, storing the result in one of the input matrices using a temporary matrix.
+ * - copyMatrix:                Copies a matrix into another.
+ * - exportMatrix:              Copies the elements of a matrix, whatever its storage, into a row-major buffer.
+ * - exportRows:                Copies some consecutive rows of a matrix the same way.
  * - printAllowedMatrixNames:   Prints a list of all available matrix names in the context.
  *
  * Usage:
@@ -32,53 +43,153 @@
  * the 'MatrixContext' structure before using these functions to ensure correct operation and data integrity.
  *
  * Note:
- * This library assumes matrices are of fixed size, defined by ROWS and COLS constants, and supports a
- * set number of matrices defined by NUM_MATRICES. Ensure that the constants in "mymat.c" and "mymat.h"
- * match the intended matrix dimensions and context size.
+ * Matrices are sized at runtime. Every operation checks the shapes of its operands and reports a
+ * MatrixStatus, resizing its result to the shape of the outcome. The context holds any number of
+ * named matrices, each starting as a DEFAULT_ROWS x DEFAULT_COLS zero matrix; names are looked up
+ * once, when an instruction is parsed, and operations take the matrices themselves.
  */
 
-/* Constants for controlling the dimentions of the matrix */
-#define ROWS 4
-#define COLS 4
+#ifndef MYMAT_H
+#define MYMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Dimensions given to a matrix that has not yet been read with an explicit shape */
+#define DEFAULT_ROWS 4
+#define DEFAULT_COLS 4
+
+/* Byte alignment of every matrix buffer (one cache line) */
+#define MATRIX_ALIGNMENT 64
 
 /* Constants for controlling the format of the printed matrix elements */
 /* Total width of each printed number */
 #define MATRIX_PRINT_WIDTH 8
 /* Number of decimal places */
 #define MATRIX_PRINT_PREC  2   
-/* format size string for printing matrix elements */
-#define FORMAT_STR_SIZE MATRIX_PRINT_WIDTH + MATRIX_PRINT_PREC
+
+/* Access the element at (row, col) of a matrix, honouring its leading dimension */
+#define MATRIX_AT(mat, row, col) ((mat)->data[(size_t)(row) * (size_t)(mat)->ld + (size_t)(col)])
+
+/* Dimension of every matrix of a batch */
+#define BATCH_DIM 4
+/* Number of elements of one matrix of a batch */
+#define BATCH_ELEMENTS (BATCH_DIM * BATCH_DIM)
+/* Matrices interleaved in one group of a batch: one AVX-512 register, or two AVX2 registers, of doubles */
+#define BATCH_LANES 8
+
+/* Access element (row, col) of matrix 'index' of a batch */
+#define BATCH_AT(batch, index, row, col)                                                        \
+    ((batch)->data[((size_t)(index) / BATCH_LANES) * (BATCH_ELEMENTS * BATCH_LANES)              \
+                   + ((size_t)(row) * BATCH_DIM + (size_t)(col)) * BATCH_LANES                  \
+                   + (size_t)(index) % BATCH_LANES])
+
+/* Tiles of a matrix stored on disk, defined in matdisk.c */
+struct DiskStore;
+
+/* Non-zero elements of a sparse matrix, defined in matsparse.c */
+struct SparseStore;
+
+/* Cache of the results of earlier operations, defined in matcache.c */
+struct ResultCache;
+
+/* Cache of the factorizations of recently used matrices, defined in matfactor.c */
+struct FactorCache;
 
 /* Define a structure to represent a matrix */
 typedef struct {
-    /*  2D array to store the elements of the matrix.
-        Each element is of type double, which allows storing real numbers with double precision.
-        The size of the array is determined by the ROWS and COLS constants,
-        representing the dimensions of the matrix */
-    double data[ROWS][COLS];
+    /*  Contiguous row-major buffer holding the elements of the matrix.
+        The buffer is aligned to MATRIX_ALIGNMENT bytes and element (row, col)
+        lives at data[row * ld + col], so a matrix may also describe a view
+        into a larger buffer whose rows are 'ld' elements apart */
+    double *data;
+    int rows;           /* Number of rows */
+    int cols;           /* Number of columns */
+    int ld;             /* Leading dimension: distance in elements between consecutive rows */
+    size_t capacity;    /* Number of elements allocated in 'data' (0 for views) */
+    void *mapping;      /* Start of the file mapping holding 'data' (see "matio.h"), NULL if 'data' is allocated */
+    size_t mappingSize; /* Number of bytes mapped at 'mapping' */
+    struct DiskStore *disk;     /* Tiles of a matrix larger than the memory budget (see "matdisk.h"), else NULL;
+                                   'data' is NULL while the matrix is on disk */
+    struct SparseStore *sparse; /* Non-zero elements of a sparse matrix (see "matsparse.h"), else NULL;
+                                   'data' is NULL while the matrix is sparse */
 } Matrix;
 
-/* Define an enumeration to represent different matrix names */
+/* Enumeration of the outcomes of a matrix operation */
+typedef enum {
+    MATRIX_OK,                      /* The operation completed */
+    MATRIX_DIMENSION_MISMATCH,      /* Operand shapes are not compatible with the operation */
+    MATRIX_INVALID_DIMENSIONS,      /* Requested dimensions are zero, negative or too large */
+    MATRIX_ALLOCATION_FAILED,       /* Not enough memory for the result */
+    MATRIX_FILE_ERROR,              /* A matrix file could not be opened, written or mapped */
+    MATRIX_FILE_INVALID,            /* A matrix file is not in the expected format or is corrupted */
+    MATRIX_INVALID_ENTRY,           /* A sparse element names no element of the matrix */
+    MATRIX_NOT_SQUARE,              /* The operation needs a square matrix */
+    MATRIX_SINGULAR,                /* The matrix has no inverse */
+    MATRIX_NOT_SYMMETRIC,           /* The operation needs a symmetric matrix */
+    MATRIX_NOT_POSITIVE_DEFINITE,   /* The symmetric matrix has no Cholesky factor */
+    MATRIX_RANK_DEFICIENT,          /* The columns of the matrix are not linearly independent */
+    MATRIX_NOT_CONVERGED,           /* An iterative method did not converge */
+    NUM_MATRIX_STATUSES             /* Sentinel value for the number of statuses */
+} MatrixStatus;
+
+/* Structure to associate a matrix status with its printable description */
+typedef struct {
+    MatrixStatus status;
+    const char *statusName;
+} MatrixStatusProfile;
+
+/* Array mapping every MatrixStatus to its description, defined in mymat.c */
+extern const MatrixStatusProfile MatrixStatuses[NUM_MATRIX_STATUSES];
+
+/* Handle of a named matrix: its index in the matrices of the context */
+typedef int MatrixHandle;
+
+/* Handle value standing for no matrix */
+#define NO_MATRIX (-1)
+
+/* Define a structure to represent a batch of BATCH_DIM x BATCH_DIM matrices */
+typedef struct {
+    /*  Array-of-structures-of-arrays buffer, aligned to MATRIX_ALIGNMENT bytes.
+        Matrices are grouped BATCH_LANES at a time; within a group, element (row, col)
+        of all BATCH_LANES matrices is stored contiguously, so one vector load reads
+        the same element of every matrix of the group. Lanes past 'count' in the
+        last group are padding */
+    double *data;
+    size_t count;       /* Number of matrices in the batch */
+    size_t capacity;    /* Number of groups allocated in 'data' */
+} MatrixBatch;
+
+/* Define an enumeration to represent different batch names */
 typedef enum {
-    MAT_A,
-    MAT_B,
-    MAT_C,
-    MAT_D,
-    MAT_E,
-    MAT_F,
-    NUM_MATRICES /* Total number of matrices in the enumeration */
-} MatrixEnum;
-
-/* Define a structure to associate matrix names with their string representations */
+    BAT_A,
+    BAT_B,
+    BAT_C,
+    BAT_D,
+    NUM_BATCHES /* Total number of batches in the enumeration */
+} BatchEnum;
+
+/* Define a structure to associate batch names with their string representations */
 typedef struct {
-    MatrixEnum name;
+    BatchEnum name;
     const char *nameString;
-} MatrixProfile;
+} BatchProfile;
 
-/* Define a structure to store multiple matrices and their profiles */
+/* Define a structure to store the named matrices, the batches and their profiles */
 typedef struct {
-    Matrix matrices[NUM_MATRICES];
-    MatrixProfile profiles[NUM_MATRICES];
+    Matrix *matrices;           /* Matrices indexed by handle */
+    char **names;               /* Interned name of each matrix, indexed by handle */
+    unsigned long *hashes;      /* Hash of each name, indexed by handle */
+    int count;                  /* Number of named matrices */
+    int capacity;               /* Entries allocated in 'matrices', 'names' and 'hashes' */
+    MatrixHandle *slots;        /* Open-addressing hash table of handles; NO_MATRIX marks a free slot */
+    size_t slotCount;           /* Number of slots, a power of two */
+    unsigned long *versions;    /* Version of each matrix, indexed by handle; a new one on every write */
+    unsigned long lastVersion;  /* Last version given to any matrix, so versions are never reused */
+    struct ResultCache *cache;  /* Results of earlier operations (see "matcache.h"), NULL when disabled */
+    struct FactorCache *factors;    /* Factorizations of recently used matrices (see "matfactor.h") */
+    MatrixBatch batches[NUM_BATCHES];
+    BatchProfile batchProfiles[NUM_BATCHES];
 } MatrixContext;
 
 
@@ -86,63 +197,149 @@ typedef struct {
  * Function: initMatrices
  * Purpose: Initialize the matrices in a given MatrixContext.
  * Detailed Description:
- *   This function is designed to initialize each matrix within a provided MatrixContext structure.
- *   It sets the profiles for each matrix from a predefined set of valid matrices and initializes
- *   all matrix elements to a default value (zero). The function assumes that the MatrixContext
- *   structure (pointed by 'ctx') is pre-allocated, and that the constants for the number of matrices 
- *   (NUM_MATRICES), rows (ROWS), and columns (COLS) are predefined and correctly represent the 
- *   dimensions of the matrices.
+ *   This function is designed to initialize a provided MatrixContext structure. It registers one
+ *   matrix under each of the given names, in order, so the first name gets handle 0, and allocates
+ *   every matrix with the default DEFAULT_ROWS x DEFAULT_COLS shape, with all elements set to zero.
+ *   More matrices can be registered later with 'registerMatrix'.
+ *   Every batch likewise gets its profile and starts with a single zero matrix.
+ *   The function assumes that the MatrixContext structure (pointed by 'ctx') is pre-allocated.
+ *   Storage allocated here is released with 'freeMatrices', even if this function fails.
  *
  * Parameters:
  *   ctx - Pointer to the MatrixContext structure to be initialized.
+ *   matrixNames - Array of the names of the initial matrices.
+ *   matrixCount - Number of names in 'matrixNames'.
+ *   validBatches - Array of profiles naming every batch of the context.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if a matrix could not be allocated.
+ */
+MatrixStatus initMatrices(MatrixContext *ctx, const char *const matrixNames[], int matrixCount,
+                          const BatchProfile validBatches[NUM_BATCHES]);
+
+
+/*
+ * Function: freeMatrices
+ * Purpose: Release the storage of every matrix, name and batch in a MatrixContext.
+ *
+ * Parameters:
+ *   ctx - Pointer to the MatrixContext structure whose matrices and batches are released.
  *
  * Returns: None (void function).
  */
-void initMatrices(MatrixContext *ctx, const MatrixProfile validMatrices[NUM_MATRICES]);
+void freeMatrices(MatrixContext *ctx);
+
+
+/*
+ * Function: resizeMatrix
+ * Purpose: Give a matrix new dimensions, growing its storage when needed.
+ * Detailed Description:
+ *   The buffer is only reallocated when the new shape needs more elements than the current
+ *   capacity, so resizing a matrix to its own shape never moves or changes its data. After a
+ *   reallocation the element values are unspecified. The leading dimension is set to 'cols'.
+ *   A sparse matrix always gets a dense buffer, so its elements are unspecified too.
+ *   A shape larger than the memory budget ('shouldSpill' in "matdisk.h") gets zero-filled tiles
+ *   on disk instead of a buffer.
+ *
+ * Parameters:
+ *   mat - Pointer to the Matrix to resize.
+ *   rows - Requested number of rows (at least 1).
+ *   cols - Requested number of columns (at least 1).
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_INVALID_DIMENSIONS for an unrepresentable shape,
+ *   MATRIX_ALLOCATION_FAILED if the storage could not be grown, MATRIX_FILE_ERROR if the
+ *   tile file of a disk matrix could not be created.
+ */
+MatrixStatus resizeMatrix(Matrix *mat, int rows, int cols);
+
+
+/*
+ * Function: allocElements
+ * Purpose: Allocate an uninitialized buffer of doubles aligned to MATRIX_ALIGNMENT bytes.
+ *
+ * Parameters:
+ *   count - Number of doubles to allocate.
+ *
+ * Returns:
+ *   Pointer to the buffer, to be released with free(), or NULL if the allocation failed.
+ */
+double *allocElements(size_t count);
+
+
+/*
+ * Function: freeMatrix
+ * Purpose: Release the storage owned by a matrix and reset it to an empty 0 x 0 matrix.
+ *
+ * Parameters:
+ *   mat - Pointer to the Matrix to release.
+ *
+ * Returns: None (void function).
+ */
+void freeMatrix(Matrix *mat);
 
 
 /*
  * Function: printMatrix
  * Purpose: Prints the elements of a specified matrix in a formatted way.
  * Detailed Description:
- *   This function is designed to print the elements of a matrix whose name is provided. It first
- *   retrieves the matrix from the MatrixContext based on the given name. Then, it iterates over
- *   each element of the matrix, printing them with a specified width and precision.
- * 
- *   The function assumes that the matrix name provided exists in the context and that the constants 
- *   ROWS and COLS accurately represent the dimensions of the matrix. It also relies on a helper 
- *   function 'getMatrixEnumByName' to map the matrix name to its corresponding enum value.
+ *   This function prints the elements of the matrix, one line per row, with a specified width and
+ *   precision, through the buffered formatter of "matfmt.h" (which also selects full precision,
+ *   CSV or a head/tail summary).
  * 
  * Parameters:
- *   ctx - Pointer to the MatrixContext structure containing the matrix.
- *   matrixName - Pointer to a character array (string) representing the name of the matrix to be printed.
+ *   mat - Pointer to the Matrix to be printed.
  *
- * Returns: None (void function).
+ * Returns:
+ *   MATRIX_OK on success, or the status of a failed read of a matrix stored on disk.
  */
-void printMatrix(const MatrixContext *ctx, const char *matrixName);
+MatrixStatus printMatrix(const Matrix *mat);
 
 
 /*
  * Function: readMatrix
- * Purpose: Reads data from an array and fills a specified matrix within the MatrixContext.
+ * Purpose: Reads data from an array and fills a specified matrix.
  * Detailed Description:
- *   This function takes a linear array of double values and assigns these values to the 
- *   corresponding matrix in the MatrixContext identified by the matrixName. The function assumes
- *   the array contains enough elements (ROWS * COLS) to fill the entire matrix and that the
- *   matrix name provided exists in the context.
- *
- *   It uses 'getMatrixEnumByName' to find the index of the matrix in the MatrixContext and then
- *   iterates over each element of the array, assigning it to the appropriate position in the
- *   matrix.
+ *   This function takes a linear array of double values and assigns these values, in row-major
+ *   order, to the matrix. When 'rows' and 'cols' are positive the matrix is first resized to that
+ *   shape; otherwise it keeps its current shape. Elements beyond 'count' are set to zero and values
+ *   beyond the size of the matrix are ignored. Values that are mostly zeros ('isSparseArray' in
+ *   "matsparse.h") make a sparse matrix, without ever allocating the dense buffer.
  *
  * Parameters:
- *   ctx - Pointer to the MatrixContext structure containing the matrix to be filled.
- *   matrixName - Pointer to a character array (string) representing the name of the matrix.
+ *   mat - Pointer to the Matrix to be filled.
+ *   rows - New number of rows, or 0 to keep the current shape.
+ *   cols - New number of columns, or 0 to keep the current shape.
  *   array - Pointer to the array of double values to be read into the matrix.
+ *   count - Number of values in 'array'.
  *
- * Returns: None (void function).
+ * Returns:
+ *   MATRIX_OK on success, or the status reported by 'resizeMatrix'.
+ */
+MatrixStatus readMatrix(Matrix *mat, int rows, int cols, const double *array, size_t count);
+
+
+/*
+ * Function: readSparseMatrix
+ * Purpose: Assigns elements given in coordinate (COO) form to a matrix.
+ * Detailed Description:
+ *   Every triple of 'triples' holds the row, the column (both counted from 0) and the value of one
+ *   element; values given for the same element add up and every other element is zero. Like the
+ *   result of an operation, the matrix is stored sparse or dense according to its density.
+ *
+ * Parameters:
+ *   mat - Pointer to the Matrix to be filled.
+ *   rows - New number of rows, or 0 to keep the current shape.
+ *   cols - New number of columns, or 0 to keep the current shape.
+ *   triples - Pointer to the triples.
+ *   count - Number of values in 'triples'.
+ *
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_INVALID_ENTRY if 'count' is not a multiple of three or an index does
+ *   not name an element of the matrix, MATRIX_INVALID_DIMENSIONS for an unrepresentable shape,
+ *   MATRIX_ALLOCATION_FAILED if the elements could not be allocated.
  */
-void readMatrix(MatrixContext *ctx, const char *matrixName, const double array[ROWS * COLS]);
+MatrixStatus readSparseMatrix(Matrix *mat, int rows, int cols, const double *triples, size_t count);
 
 
 /*
@@ -150,20 +347,19 @@ void readMatrix(MatrixContext *ctx, const char *matrixName, const double array[R
  * Purpose: Adds two matrices and stores the result in a third matrix.
  * Detailed Description:
  *   This function performs element-wise addition of two matrices (mat1 and mat2) and stores 
- *   the result in the 'result' matrix. It assumes that all matrices are of the same size, defined
- *   by the constants ROWS and COLS.
- *
- *   The function iterates over each element of the matrices, summing the corresponding elements
- *   from mat1 and mat2, and storing the result in the same position in the 'result' matrix.
+ *   the result in the 'result' matrix, which takes the shape of the operands. Both operands
+ *   must have the same shape. 'result' may be the same matrix as either operand.
  *
  * Parameters:
  *   mat1 - Pointer to the first Matrix structure for addition.
  *   mat2 - Pointer to the second Matrix structure for addition.
  *   result - Pointer to the Matrix structure where the result will be stored.
  *
- * Returns: None (void function).
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_DIMENSION_MISMATCH if the operand shapes differ,
+ *   MATRIX_ALLOCATION_FAILED if the result could not be allocated.
  */
-void addMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result);
+MatrixStatus addMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result);
 
 
 /*
@@ -171,65 +367,62 @@ void addMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result);
  * Purpose: Subtracts one matrix from another and stores the result in a third matrix.
  * Detailed Description:
  *   This function performs element-wise subtraction between two matrices (mat1 and mat2)
- *   and stores the result in the 'result' matrix. It iterates over each element of the matrices,
- *   subtracting the corresponding elements of mat2 from mat1, and storing the outcome in the 
- *   respective position in the 'result' matrix.
- *
- *   The function assumes that all involved matrices have the same dimensions, defined by 
- *   the constants ROWS and COLS.
+ *   and stores the result in the 'result' matrix, which takes the shape of the operands.
+ *   Both operands must have the same shape. 'result' may be the same matrix as either operand.
  *
  * Parameters:
  *   mat1 - Pointer to the first Matrix structure for subtraction (minuend).
  *   mat2 - Pointer to the second Matrix structure for subtraction (subtrahend).
  *   result - Pointer to the Matrix structure where the result will be stored (difference).
  *
- * Returns: None (void function).
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_DIMENSION_MISMATCH if the operand shapes differ,
+ *   MATRIX_ALLOCATION_FAILED if the result could not be allocated.
  */
-void subMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result);
+MatrixStatus subMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result);
 
 
 /*
  * Function: multiplyMatrices
  * Purpose: Multiplies two matrices and stores the result in a third matrix.
  * Detailed Description:
- *   This function performs matrix multiplication of two matrices (mat1 and mat2)
- *   and stores the result in the 'result' matrix. The multiplication is carried out by 
- *   taking the dot product of rows from mat1 with columns from mat2. The function first
- *   initializes the 'result' matrix to all zeros and then computes the product.
+ *   This function performs matrix multiplication of an m x k matrix (mat1) by a k x n matrix
+ *   (mat2) and stores the m x n product in the 'result' matrix. The multiplication is carried
+ *   out by taking the dot product of rows from mat1 with columns from mat2.
  *
- *   It assumes that the matrices are square (or at least conformable for multiplication),
- *   with dimensions defined by the constants ROWS and COLS.
+ *   'result' must not be the same matrix as either operand; use 'multiplyMatricesInPlace'
+ *   for that case.
  *
  * Parameters:
  *   mat1 - Pointer to the first Matrix structure for multiplication.
  *   mat2 - Pointer to the second Matrix structure for multiplication.
  *   result - Pointer to the Matrix structure where the result will be stored.
  *
- * Returns: None (void function).
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_DIMENSION_MISMATCH if mat1 has not as many columns as mat2
+ *   has rows, MATRIX_ALLOCATION_FAILED if the result could not be allocated.
  */
-void multiplyMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result);
+MatrixStatus multiplyMatrices(const Matrix *mat1, const Matrix *mat2, Matrix *result);
 
 
 /*
  * Function: multiplyMatricesInPlace
  * Purpose: Multiplies two matrices and stores the result in one of the input matrices.
  * Detailed Description:
- *   This function multiplies a given matrix (mat1) with another matrix (result) and stores 
- *   the result back in the 'result' matrix. To avoid modifying the 'result' matrix before 
- *   the multiplication is complete, a temporary matrix (temp) is used. After computing the 
- *   multiplication, the function copies the results from the temp matrix back into the 'result' 
- *   matrix.
- *
- *   The function assumes that both matrices are of the same size and square, with dimensions 
- *   defined by the constants ROWS and COLS.
+ *   This function computes mat1 * mat2 where 'result' is the same matrix as mat1, mat2 or both.
+ *   To avoid modifying an operand before the multiplication is complete, the product is computed
+ *   into a temporary matrix whose storage then replaces the storage of 'result'.
  *
  * Parameters:
  *   mat1 - Pointer to the first Matrix structure used in multiplication.
- *   result - Pointer to the second Matrix structure; the result will be stored here.
+ *   mat2 - Pointer to the second Matrix structure used in multiplication.
+ *   result - Pointer to the Matrix structure where the result will be stored.
  *
- * Returns: None (void function).
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_DIMENSION_MISMATCH if the operands are not conformable,
+ *   MATRIX_ALLOCATION_FAILED if the temporary matrix could not be allocated.
  */
-void multiplyMatricesInPlace(const Matrix *mat1, Matrix *result);
+MatrixStatus multiplyMatricesInPlace(const Matrix *mat1, const Matrix *mat2, Matrix *result);
 
 
 /*
@@ -237,119 +430,122 @@ void multiplyMatricesInPlace(const Matrix *mat1, Matrix *result);
  * Purpose: Multiplies a matrix by a scalar value and stores the result in another matrix.
  * Detailed Description:
  *   This function scales each element of a given matrix (mat) by a specified scalar value
- *   and stores the resulting scaled matrix in the 'result' matrix. It iterates over each
- *   element of the input matrix, multiplies it by the scalar, and assigns the result to the
- *   corresponding position in the 'result' matrix.
- *
- *   The function assumes that the dimensions of the input and result matrices are the same, 
- *   defined by the constants ROWS and COLS.
+ *   and stores the resulting scaled matrix in the 'result' matrix, which takes the shape of
+ *   'mat'. 'result' may be the same matrix as 'mat'.
  *
  * Parameters:
  *   mat - Pointer to the Matrix structure to be scaled.
  *   scalar - The scalar value by which each element of the matrix is multiplied.
  *   result - Pointer to the Matrix structure where the result will be stored.
  *
- * Returns: None (void function).
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the result could not be allocated.
  */
-void multiplyScalar(const Matrix *mat, const double scalar, Matrix *result);
+MatrixStatus multiplyScalar(const Matrix *mat, const double scalar, Matrix *result);
 
 
 /*
  * Function: transposeMatrix
  * Purpose: Transposes a matrix and stores the result in another matrix.
  * Detailed Description:
- *   This function transposes a given matrix (original) and stores the transposed matrix
- *   in 'transposed'. Transposing a matrix involves swapping rows with columns; the element
- *   at [row][column] in the original matrix is placed at [column][row] in the transposed matrix.
- *
- *   The function assumes that the dimensions of the input and result matrices are compatible
- *   for transposition, defined by the constants ROWS and COLS.
+ *   This function transposes a given rows x cols matrix (original) and stores the cols x rows
+ *   transposed matrix in 'transposed'. The element at [row][column] in the original matrix is
+ *   placed at [column][row] in the transposed matrix. 'transposed' must not be the same matrix
+ *   as 'original'; use 'transposeMatrixInPlace' for that case.
  *
  * Parameters:
  *   original - Pointer to the Matrix structure to be transposed.
  *   transposed - Pointer to the Matrix structure where the transposed matrix will be stored.
  *
- * Returns: None (void function).
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the result could not be allocated.
  */
-void transposeMatrix(const Matrix *original, Matrix *transposed);
+MatrixStatus transposeMatrix(const Matrix *original, Matrix *transposed);
 
 
 /*
  * Function: transposeMatrixInPlace
  * Purpose: Transposes a matrix in-place.
  * Detailed Description:
- *   This function transposes the given matrix (matrix) in-place, meaning that it 
- *   modifies the matrix directly rather than creating a new transposed matrix. The function 
- *   swaps elements across the diagonal of the matrix, effectively flipping its rows and columns.
- *
- *   It is important to note that this operation is only valid for square matrices (where the 
- *   number of rows equals the number of columns). The function assumes that the matrix is square,
- *   with dimensions defined by the constants ROWS and COLS.
+ *   This function transposes the given matrix (matrix) in-place. A square matrix is transposed
+ *   by swapping elements across its diagonal. A packed rectangular matrix is permuted in its own
+ *   buffer by cycle-following, using one bit of bookkeeping per element; a padded one goes through
+ *   a temporary copy. Either way its shape changes from rows x cols to cols x rows.
  *
  * Parameters:
  *   matrix - Pointer to the Matrix structure that will be transposed in-place.
  *
- * Returns: None (void function).
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the bookkeeping or the temporary copy could
+ *   not be allocated.
  */
-void transposeMatrixInPlace(Matrix *matrix);
+MatrixStatus transposeMatrixInPlace(Matrix *matrix);
 
 
 /*
- * Function: printAllowedMatrixNames
- * Purpose: Prints the names of all matrices available in the MatrixContext.
+ * Function: copyMatrix
+ * Purpose: Copies a matrix into another.
  * Detailed Description:
- *   This function lists all the matrix names stored in the MatrixContext. It iterates
- *   through the matrix profiles within the context and prints each matrix's name. The function
- *   assumes that the MatrixContext is populated with valid matrix profiles and that the constant
- *   NUM_MATRICES accurately represents the number of matrices in the context.
+ *   'destination' takes the shape and the elements of 'source'. Like the other operations, a copy
+ *   larger than the memory budget is stored on disk.
  *
  * Parameters:
- *   ctx - Pointer to the MatrixContext structure containing matrix profiles.
+ *   source - Pointer to the Matrix structure to copy.
+ *   destination - Pointer to the Matrix structure receiving the copy.
  *
- * Returns: None (void function).
+ * Returns:
+ *   MATRIX_OK on success, MATRIX_ALLOCATION_FAILED if the copy could not be allocated.
  */
-void printAllowedMatrixNames(const MatrixContext *ctx);
+MatrixStatus copyMatrix(const Matrix *source, Matrix *destination);
+
 
 /*
- * Function: isValidMatrixName
- * Purpose: Checks if a given matrix name is valid within the context of predefined matrix profiles.
+ * Function: exportMatrix
+ * Purpose: Copies the elements of a matrix into a row-major buffer.
  * Detailed Description:
- *   This function iterates through the matrix profiles in a given MatrixContext to determine if
- *   the provided matrix name matches any of the predefined matrix names. It's used to validate
- *   if a given matrix name corresponds to any matrix within the context.
+ *   Dense matrices are copied row by row, matrices on disk read from their tiles and sparse matrices
+ *   expanded, so kernels that need every element in memory can work on any matrix.
  *
- *   The function assumes that the MatrixContext structure (pointed by 'ctx') contains valid 
- *   matrix profiles and that the constant NUM_MATRICES correctly represents the total number of
- *   matrices in the context.
+ * Parameters:
+ *   mat - Pointer to the Matrix to copy.
+ *   buffer - Receives element (row, col) at buffer[row * ld + col].
+ *   ld - Distance in elements between consecutive rows of 'buffer', at least 'mat->cols'.
+ *
+ * Returns:
+ *   MATRIX_OK on success, or the status of a failed read of a matrix stored on disk.
+ */
+MatrixStatus exportMatrix(const Matrix *mat, double *buffer, size_t ld);
+
+
+/*
+ * Function: exportRows
+ * Purpose: Copies consecutive rows of a matrix into a row-major buffer, like 'exportMatrix'.
  *
  * Parameters:
- *   ctx - Pointer to the MatrixContext structure containing matrix profiles.
- *   matrixName - Pointer to a character array (string) representing the name of the matrix to be validated.
+ *   mat - Pointer to the Matrix to copy.
+ *   first - First row to copy.
+ *   count - Number of rows to copy, at most mat->rows - first.
+ *   buffer - Receives element (first + row, col) at buffer[row * ld + col].
+ *   ld - Distance in elements between consecutive rows of 'buffer', at least 'mat->cols'.
  *
  * Returns:
- *   A boolean value: 'true' if the matrix name is valid, 'false' otherwise.
+ *   MATRIX_OK on success, or the status of a failed read of a matrix stored on disk.
  */
-bool isValidMatrixName(const MatrixContext *ctx, const char *matrixName);
+MatrixStatus exportRows(const Matrix *mat, int first, int count, double *buffer, size_t ld);
+
 
 /*
- * Function: getMatrixEnumByName
- * Purpose: Retrieves the enum value of a matrix given its name.
+ * Function: printAllowedMatrixNames
+ * Purpose: Prints the names of all matrices available in the MatrixContext.
  * Detailed Description:
- *   This function searches through the matrix profiles in a given MatrixContext to find
- *   a matrix that matches the provided name. Upon finding a match, it returns the enum
- *   value associated with that matrix. If no matching matrix is found, the function
- *   returns -1, indicating an invalid or nonexistent matrix name.
- * 
- *   The function assumes that the MatrixContext structure (pointed by 'ctx') contains valid
- *   matrix profiles and that the constant NUM_MATRICES correctly represents the total number
- *   of matrices in the context.
+ *   This function lists all the matrix names registered in the MatrixContext, in the order of
+ *   their handles. The batch names follow on a line of their own.
  *
  * Parameters:
- *   matrixName - Pointer to a character array (string) representing the name of the matrix.
- *   ctx - Pointer to the MatrixContext structure containing matrix profiles.
+ *   ctx - Pointer to the MatrixContext structure containing the matrix names.
  *
- * Returns:
- *   The enum value of the matrix if found, or -1 if not found.
+ * Returns: None (void function).
  */
-MatrixEnum getMatrixEnumByName(const char *matrixName, const MatrixContext *ctx);
+void printAllowedMatrixNames(const MatrixContext *ctx);
 
+#endif /* MYMAT_H */